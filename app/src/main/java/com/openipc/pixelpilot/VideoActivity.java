@@ -316,6 +316,8 @@ public class VideoActivity extends AppCompatActivity implements IVideoParamsChan
     private void initializeVideoPlayers() {
         videoPlayer = new VideoPlayer(this);
         videoPlayer.setIVideoParamsChanged(this);
+        // Lost video packets make the link ask the drone for a keyframe right away
+        videoPlayer.setKeyFrameRequester(wfbLink.getKeyFrameRequestFunction(), wfbLink.getKeyFrameRequestContext());
 
         isVRMode = getVRSetting();
 
@@ -0,0 +1,150 @@
+//
+// AccessUnitAssembler.h
+// Collects the NALUs of one access unit (a frame with its parameter sets, SEIs and all of its slices) into a single
+// codec input buffer, so the frame costs one dequeue / queue round-trip instead of one per NALU. The NALUs are
+// written straight into the input buffer.
+// An access unit ends with the NALU from the packet with the RTP marker bit. If that packet was lost (or the sender
+// does not set the bit), it ends before the first NALU that can only start a new one: AUD, parameter sets, SEI or the
+// first slice of the next picture.
+// With slice streaming every slice is submitted as soon as it is complete, flagged as a partial frame. The codec
+// batches the buffers until one without the flag completes the frame.
+//
+
+#ifndef FPVUE_ACCESSUNITASSEMBLER_H
+#define FPVUE_ACCESSUNITASSEMBLER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "NALU/NALU.hpp"
+
+class AccessUnitAssembler
+{
+  public:
+    // Same values as MediaCodec's BUFFER_FLAG_KEY_FRAME / BUFFER_FLAG_CODEC_CONFIG / BUFFER_FLAG_PARTIAL_FRAME
+    static constexpr uint32_t FLAG_KEY_FRAME     = 1;
+    static constexpr uint32_t FLAG_CODEC_CONFIG  = 2;
+    static constexpr uint32_t FLAG_PARTIAL_FRAME = 8;
+
+    // Only for a codec that supports partial frames (MediaCodecInfo.CodecCapabilities.FEATURE_PartialFrame)
+    void setSliceStreaming(bool enabled) { mSliceStreaming = enabled; }
+
+    /**
+     * Sink is the codec input, with
+     *   bool acquire(uint8_t*& data, size_t& capacity): dequeue an empty input buffer, false if there is none
+     *   void submit(size_t size, uint32_t flags, std::chrono::steady_clock::time_point creationTime): queue the buffer
+     *        returned by the last acquire(). @param creationTime is the one of the first NALU in it.
+     * A NALU is dropped if no input buffer could be acquired for it.
+     */
+    template <typename Sink>
+    void add(const NALU& nalu, Sink& sink)
+    {
+        if (pending() && mHasVCL &&
+            (nalu.starts_access_unit_after_vcl() || (nalu.is_vcl() && nalu.is_first_slice_of_picture())))
+        {
+            // the marker bit of the previous access unit got lost
+            flush(sink);
+        }
+        if (mData != nullptr && mSize + nalu.getSize() > mCapacity)
+        {
+            // does not fit, the decoder gets the access unit in two buffers
+            flush(sink);
+        }
+        if (mData == nullptr)
+        {
+            if (!sink.acquire(mData, mCapacity))
+            {
+                mData = nullptr;
+                mNDropped++;
+                return;
+            }
+            mSize = 0;
+        }
+        if (nalu.getSize() > mCapacity)
+        {
+            mNDropped++;
+            return;
+        }
+        if (mSize == 0) mCreationTime = nalu.creationTime;
+        nalu.copyTo(mData + mSize);
+        mSize += nalu.getSize();
+        if (nalu.is_keyframe()) mFlags |= FLAG_KEY_FRAME;
+        if (nalu.is_vcl()) mHasVCL = true;
+        if (nalu.isEndOfAccessUnit())
+        {
+            flush(sink);
+        }
+        else if (mSliceStreaming && nalu.is_vcl())
+        {
+            submit(sink, mFlags | FLAG_PARTIAL_FRAME);
+            mPartialFrame = true;
+        }
+    }
+
+    // Submit the pending access unit (if any) as it is
+    template <typename Sink>
+    void flush(Sink& sink)
+    {
+        if (mSize == 0 && mPartialFrame)
+        {
+            // all slices went out as partial frames, the codec needs a buffer without the flag to complete the frame
+            if (mData == nullptr && !sink.acquire(mData, mCapacity))
+            {
+                mData = nullptr;
+                return;
+            }
+        }
+        else if (mData == nullptr || mSize == 0)
+        {
+            return;
+        }
+        // parameter sets without a picture (only possible if a marker bit is set after them)
+        submit(sink, (mHasVCL || mPartialFrame) ? mFlags : FLAG_CODEC_CONFIG);
+        mFlags        = 0;
+        mHasVCL       = false;
+        mPartialFrame = false;
+    }
+
+    // True if NALUs are waiting for the rest of their access unit
+    bool pending() const { return mSize > 0 || mPartialFrame; }
+
+    // Forget the pending access unit and the input buffer, e.g. because the codec was released
+    void reset()
+    {
+        mData         = nullptr;
+        mSize         = 0;
+        mFlags        = 0;
+        mHasVCL       = false;
+        mPartialFrame = false;
+    }
+
+    // n of input buffers submitted
+    long getNSubmitted() const { return mNSubmitted; }
+
+    // n of NALUs dropped because there was no (big enough) input buffer
+    long getNDropped() const { return mNDropped; }
+
+  private:
+    template <typename Sink>
+    void submit(Sink& sink, uint32_t flags)
+    {
+        sink.submit(mSize, flags, mCreationTime);
+        mData = nullptr;
+        mSize = 0;
+        mNSubmitted++;
+    }
+
+    uint8_t*                              mData           = nullptr;
+    size_t                                mCapacity       = 0;
+    size_t                                mSize           = 0;
+    uint32_t                              mFlags          = 0;
+    bool                                  mHasVCL         = false;
+    bool                                  mSliceStreaming = false;
+    // slices of the current access unit were submitted with FLAG_PARTIAL_FRAME
+    bool                                  mPartialFrame = false;
+    std::chrono::steady_clock::time_point mCreationTime;
+    long                                  mNSubmitted = 0;
+    long                                  mNDropped   = 0;
+};
+
+#endif  // FPVUE_ACCESSUNITASSEMBLER_H
@@ -0,0 +1,130 @@
+//
+// AsyncCodec.h
+// Support for running a decoder in asynchronous mode (AMediaCodec_setAsyncNotifyCallback): the codec tells us about
+// free input buffers and decoded frames from its own thread instead of us polling dequeueInputBuffer /
+// dequeueOutputBuffer with a timeout. Nothing in here depends on the NDK, a fake codec can drive it on the host.
+//
+
+#ifndef FPVUE_ASYNCCODEC_H
+#define FPVUE_ASYNCCODEC_H
+
+#include <sys/types.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include "SpscRing.h"
+
+/**
+ * What a codec in asynchronous mode reports. MediaCodec calls these one at a time on its callback thread, so they
+ * must not block for long.
+ */
+class AsyncCodecListener
+{
+  public:
+    // onError() action codes (AMEDIACODEC_ERROR_*), 0 is fatal: the codec has to be created again. A recoverable error
+    // needs stop(), configure() and start(), a transient one passes by itself.
+    static constexpr int32_t ACTION_TRANSIENT   = 1;
+    static constexpr int32_t ACTION_RECOVERABLE = 2;
+
+    virtual ~AsyncCodecListener() = default;
+
+    // Input buffer @param index is free to be filled and queued
+    virtual void onInputAvailable(int32_t index) = 0;
+
+    // Output buffer @param index holds a decoded frame, it has to be released
+    virtual void onOutputAvailable(int32_t index, int64_t presentationTimeUs, uint32_t flags) = 0;
+
+    virtual void onFormatChanged(int32_t width, int32_t height) = 0;
+
+    // The codec failed with media_status_t @param error, @param actionCode tells whether it goes on by itself
+    virtual void onError(int32_t error, int32_t actionCode) = 0;
+};
+
+/**
+ * The free input buffer indices of one async codec, on their way from the codec's callback thread (push) to the
+ * thread that feeds the codec (pop). Lock free unless the feeder has to wait for a buffer.
+ */
+class AsyncInputBuffers
+{
+  public:
+    // More than any codec has input buffers
+    static constexpr size_t MAX_INPUT_BUFFERS = 64;
+
+    /**
+     * Callback thread: input buffer @param index is free.
+     * @return false if more indices are queued than there can be buffers (the codec is not the one we know).
+     */
+    bool push(int32_t index)
+    {
+        int32_t* slot = mIndices.writeSlot();
+        if (slot == nullptr) return false;
+        *slot = index;
+        mIndices.publish();
+        // Pairs with the fence in pop(): either the feeder sees the index or we see it waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mWaiting.load(std::memory_order_relaxed))
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCondition.notify_one();
+        }
+        return true;
+    }
+
+    /**
+     * Feeder thread: the index of a free input buffer, waits up to @param timeout for one.
+     * @return -1 if none became free in time.
+     */
+    ssize_t pop(std::chrono::microseconds timeout)
+    {
+        if (const int32_t* index = mIndices.readSlot())
+        {
+            return take(*index);
+        }
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        mCondition.wait_for(lock, timeout, [this] { return !mIndices.empty() || mInterrupted; });
+        mWaiting.store(false, std::memory_order_relaxed);
+        mInterrupted = false;
+        const int32_t* index = mIndices.readSlot();
+        return index == nullptr ? -1 : take(*index);
+    }
+
+    // Callback thread: the codec failed, a pop() that waits returns -1 right away instead of after its timeout
+    void interrupt()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mInterrupted = true;
+        mCondition.notify_one();
+    }
+
+    /**
+     * Forget the queued indices, they are invalid once the codec was stopped or flushed. Feeder thread (or with the
+     * feeder excluded), while the codec does not call push().
+     */
+    void clear()
+    {
+        while (mIndices.readSlot() != nullptr) mIndices.release();
+    }
+
+    // Free input buffers nobody took yet
+    size_t size() const { return mIndices.size(); }
+
+  private:
+    ssize_t take(int32_t index)
+    {
+        mIndices.release();
+        return index;
+    }
+
+    SpscRing<int32_t>       mIndices{MAX_INPUT_BUFFERS};
+    std::atomic<bool>       mWaiting = false;
+    std::mutex              mMutex;
+    std::condition_variable mCondition;
+    // Guarded by mMutex
+    bool mInterrupted = false;
+};
+
+#endif  // FPVUE_ASYNCCODEC_H
@@ -1,3 +1,6 @@
+#ifndef FPVUE_BUFFEREDPACKETQUEUE_H
+#define FPVUE_BUFFEREDPACKETQUEUE_H
+
 #if defined(__ANDROID__) || defined(__ANDROID_API__)
 #include <android/log.h>
 #else
@@ -5,13 +8,19 @@
 #include <cstdio>
 #endif
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdarg>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <limits>
+#include <memory>
+#include <type_traits>
 
-#include <unordered_map>
-#include <vector>
+#include "Metrics.h"
+#include "PacketPool.h"
 
 // Define logging tag and maximum buffer size
 #define BUFFERED_QUEUE_LOG_TAG "BufferedPacketQueue"
@@ -19,6 +28,11 @@
 constexpr size_t MAX_BUFFER_SIZE = 15;
 // Number of monotonically increasing packets
 constexpr size_t MONOTONIC_THRESHOLD = 5;
+// Slots of the reorder window, indexed by seq & (REORDER_RING_SIZE - 1). One occupancy bit per slot in a uint64_t.
+constexpr size_t REORDER_RING_SIZE = 64;
+static_assert((REORDER_RING_SIZE & (REORDER_RING_SIZE - 1)) == 0, "REORDER_RING_SIZE must be a power of two");
+static_assert(REORDER_RING_SIZE == 64, "the occupancy bitmap is a single uint64_t");
+static_assert(MAX_BUFFER_SIZE < REORDER_RING_SIZE, "the window must hold MAX_BUFFER_SIZE packets");
 
 // Type definition for sequence numbers
 using SeqType   = uint16_t;
@@ -27,15 +41,113 @@ using SignedSeq = std::make_signed_t<SeqType>;
 /**
  * @brief BufferedPacketQueue class handles packet processing with sequence numbers,
  *        ensuring in-order delivery and buffering out-of-order packets.
+ *
+ * By default held packets are released by count heuristics (MAX_BUFFER_SIZE, MONOTONIC_THRESHOLD), so the latency a
+ * lost packet costs depends on the packet rate. In deadline mode every gap instead gets a wall-clock deadline that
+ * adapts to the measured reorder delay; once it expires the missing packets are skipped.
  */
 class BufferedPacketQueue
 {
   public:
+    using Clock       = std::chrono::steady_clock;
+    using NowFunction = Clock::time_point (*)();
+
+    struct DeadlineConfig
+    {
+        // Max time a gap may hold back the packets behind it
+        std::chrono::microseconds maxWait = std::chrono::milliseconds(3);
+        // The adaptive deadline never drops below this
+        std::chrono::microseconds minWait = std::chrono::microseconds(500);
+        // The deadline is this multiple of the measured reorder delay
+        int reorderDelayFactor = 2;
+    };
+
+    // Deadline mode counters. Written by the thread feeding the queue, may be read from any thread.
+    struct JitterStats
+    {
+        // gaps closed by a reordered packet before the deadline
+        long nGapsFilled = 0;
+        // gaps given up on when the deadline expired
+        long nGapsSkipped = 0;
+        // missing packets in the skipped gaps
+        long nPacketsSkipped = 0;
+        // packets that arrived after their gap had been skipped (the deadline was too short)
+        long nGapsFilledLate = 0;
+        // packets held back in the window and the sum of the time they were held
+        long                      nHeldPackets = 0;
+        std::chrono::microseconds addedLatency{0};
+        // current adaptive deadline
+        std::chrono::microseconds deadline{0};
+    };
+
     /**
      * @brief Constructs a BufferedPacketQueue instance.
      */
     BufferedPacketQueue() : mFirstPacket(true), mLastPacketIdx(0), mMonotonicOutOfOrderIncreaseCount(0) {}
 
+    /**
+     * @brief Number of packets currently held in the reorder window.
+     */
+    size_t getNBufferedPackets() const { return mNBuffered; }
+
+    /**
+     * @brief Switches to deadline mode. Must be called from the thread that feeds the queue.
+     * @param config Deadline bounds. Until a reorder delay has been measured, maxWait is used.
+     */
+    void enableDeadlineMode(const DeadlineConfig& config)
+    {
+        mDeadlineConfig = config;
+        mReorderDelay   = std::chrono::microseconds(0);
+        mDeadline       = config.maxWait;
+        mDeadlineMode   = true;
+        store(mStats.deadline, mDeadline.count());
+        // packets buffered in count mode start their deadline now
+        mNowCached = mGapSince = mNow();
+        for (Slot& slot : mRing) slot.arrival = mNowCached;
+    }
+
+    /**
+     * @brief Back to the count heuristics. Must be called from the thread that feeds the queue.
+     */
+    void disableDeadlineMode() { mDeadlineMode = false; }
+
+    bool isDeadlineMode() const { return mDeadlineMode; }
+
+    /**
+     * @brief Snapshot of the deadline mode counters.
+     */
+    JitterStats getJitterStats() const
+    {
+        JitterStats stats;
+        stats.nGapsFilled     = mStats.nGapsFilled.load(std::memory_order_relaxed);
+        stats.nGapsSkipped    = mStats.nGapsSkipped.load(std::memory_order_relaxed);
+        stats.nPacketsSkipped = mStats.nPacketsSkipped.load(std::memory_order_relaxed);
+        stats.nGapsFilledLate = mStats.nGapsFilledLate.load(std::memory_order_relaxed);
+        stats.nHeldPackets    = mStats.nHeldPackets.load(std::memory_order_relaxed);
+        stats.addedLatency    = std::chrono::microseconds(mStats.addedLatencyUs.load(std::memory_order_relaxed));
+        stats.deadline        = std::chrono::microseconds(mStats.deadline.load(std::memory_order_relaxed));
+        return stats;
+    }
+
+    /**
+     * @brief Replaces the clock used in deadline mode (for tests).
+     */
+    void setClock(NowFunction now) { mNow = now; }
+
+    /**
+     * @brief In deadline mode, skips gaps whose deadline has expired. processPacket() does this on every packet,
+     *        callers that can wake up on a timer may call it in between to bound the latency of the last gap.
+     * @tparam Callback A callable type that processes the packet data.
+     * @param callback Callable to handle processed packets.
+     */
+    template <typename Callback>
+    void flushExpired(Callback& callback)
+    {
+        if (!mDeadlineMode || mNBuffered == 0) return;
+        mNowCached = mNow();
+        skipExpiredGaps(callback);
+    }
+
     /**
      * @brief Processes an incoming packet based on its sequence index.
      * @tparam Callback A callable type that processes the packet data.
@@ -46,6 +158,101 @@ class BufferedPacketQueue
      */
     template <typename Callback>
     void processPacket(SeqType currPacketIdx, const uint8_t* data, std::size_t data_length, Callback& callback)
+    {
+        mCurrentTimestamp = {};
+        mCurrentPacket    = nullptr;
+        // Only copied if the packet has to be buffered (or handed to a callback that takes a PacketRef)
+        process(currPacketIdx, data, data_length, [&] { return copyPacket(data, data_length); }, callback);
+    }
+
+    /**
+     * @brief Same as above for a packet that is already owned by a ref-counted buffer. Buffering it out of order
+     *        moves the handle, no copy is made. A callback that also takes a Clock::time_point gets the packet's
+     *        receive timestamp (PacketRef::timestamp()) with every packet it is handed. A callback that takes a
+     *        const PacketRef& gets the handle itself, so it can keep referencing the buffer after it returns.
+     * @tparam Callback A callable type that processes the packet data.
+     * @param currPacketIdx Sequence index of the incoming packet.
+     * @param packet The packet.
+     * @param callback Callable to handle processed packets.
+     */
+    template <typename Callback>
+    void processPacket(SeqType currPacketIdx, PacketRef packet, Callback& callback)
+    {
+        const uint8_t*    data        = packet.data();
+        const std::size_t data_length = packet.size();
+        mCurrentTimestamp             = packet.timestamp();
+        mCurrentPacket                = &packet;
+        process(currPacketIdx, data, data_length, [&] { return std::move(packet); }, callback);
+        mCurrentPacket = nullptr;
+    }
+
+  private:
+    bool    mFirstPacket;
+    SeqType mLastPacketIdx;
+
+    struct Slot
+    {
+        PacketRef packet;
+        SeqType   seq = 0;
+        // only maintained in deadline mode
+        Clock::time_point arrival;
+    };
+
+    static constexpr SeqType RING_MASK = REORDER_RING_SIZE - 1;
+
+    // Out-of-order packets, preallocated. Bit i of mOccupied is set if mRing[i] holds a packet.
+    std::array<Slot, REORDER_RING_SIZE> mRing;
+    uint64_t                            mOccupied  = 0;
+    size_t                              mNBuffered = 0;
+    // Only used by the raw pointer processPacket() overload, created on first use
+    std::shared_ptr<PacketPool> mCopyPool;
+    // Receive timestamp of the packet passed to processPacket(), default for the raw pointer overload
+    Clock::time_point mCurrentTimestamp;
+    // The packet passed to processPacket(), nullptr for the raw pointer overload. Only valid while it is not buffered.
+    const PacketRef* mCurrentPacket = nullptr;
+
+    // Deadline mode state
+    bool              mDeadlineMode = false;
+    DeadlineConfig    mDeadlineConfig;
+    NowFunction       mNow = &Clock::now;
+    Clock::time_point mNowCached;
+    // When the oldest packet still held back by the current gap arrived
+    Clock::time_point mGapSince;
+    // Smoothed time between a gap opening and the missing packet arriving (fast attack, slow decay)
+    std::chrono::microseconds mReorderDelay{0};
+    std::chrono::microseconds mDeadline{0};
+    // Sequence range of the last skipped gap and when it was skipped, to detect packets that arrive too late
+    SeqType           mSkippedFirst = 0;
+    SeqType           mSkippedLast  = 0;
+    Clock::time_point mSkippedAt;
+
+    struct
+    {
+        std::atomic<long> nGapsFilled{0};
+        std::atomic<long> nGapsSkipped{0};
+        std::atomic<long> nPacketsSkipped{0};
+        std::atomic<long> nGapsFilledLate{0};
+        std::atomic<long> nHeldPackets{0};
+        std::atomic<long> addedLatencyUs{0};
+        std::atomic<long> deadline{0};
+    } mStats;
+
+    // This variable is used to track a situation where the sequence number is increasing monotonically while packets
+    // are out of order. if this counter reaches MONOTONIC_THRESHOLD, we will restart buffering and update lastPacketIdx
+    // to the highest sequence index received.
+    size_t mMonotonicOutOfOrderIncreaseCount;
+
+    /**
+     * @brief Common part of both processPacket() overloads.
+     * @param takePacket Returns an owning handle to the packet, only called if the packet has to be buffered.
+     */
+    template <typename TakePacket, typename Callback>
+    void process(
+        SeqType        currPacketIdx,
+        const uint8_t* data,
+        std::size_t    data_length,
+        TakePacket&&   takePacket,
+        Callback&      callback)
     {
         logDebug(
             "Processing packet with Sequence=%u, lastPacketIdx=%u, firstPacket=%s",
@@ -57,15 +264,21 @@ class BufferedPacketQueue
         {
             handleFirstPacket(currPacketIdx);
             // Continue processing the first packet
-            processInOrderPacket(currPacketIdx, data, data_length, callback);
+            processInOrderPacket(currPacketIdx, data, data_length, mCurrentPacket, callback);
             processBufferedPackets(callback);
             return;
         }
 
+        if (mDeadlineMode)
+        {
+            processWithDeadline(currPacketIdx, data, data_length, std::forward<TakePacket>(takePacket), callback);
+            return;
+        }
+
         if (isNextExpectedPacket(currPacketIdx))
         {
             // In-order packet
-            processInOrderPacket(currPacketIdx, data, data_length, callback);
+            processInOrderPacket(currPacketIdx, data, data_length, mCurrentPacket, callback);
             processBufferedPackets(callback);
             // Reset monotonic increase counter after in-order packet
             mMonotonicOutOfOrderIncreaseCount = 0;
@@ -73,20 +286,166 @@ class BufferedPacketQueue
         else
         {
             // Out-of-order packet
-            handleOutOfOrderPacket(currPacketIdx, data, data_length, callback);
+            handleOutOfOrderPacket(currPacketIdx, takePacket(), callback);
         }
     }
 
-  private:
-    bool    mFirstPacket;
-    SeqType mLastPacketIdx;
+    /**
+     * @brief Deadline mode part of process(). Gaps are skipped once their deadline expired, the count heuristics are
+     *        not used. Packets behind the window are dropped.
+     */
+    template <typename TakePacket, typename Callback>
+    void processWithDeadline(
+        SeqType        currPacketIdx,
+        const uint8_t* data,
+        std::size_t    data_length,
+        TakePacket&&   takePacket,
+        Callback&      callback)
+    {
+        mNowCached = mNow();
+        if (mNBuffered > 0)
+        {
+            skipExpiredGaps(callback);
+        }
 
-    std::unordered_map<SeqType, std::vector<uint8_t>> mPackets;
+        if (isNextExpectedPacket(currPacketIdx))
+        {
+            if (mNBuffered > 0)
+            {
+                // this packet closes the gap
+                Metrics::increment(mStats.nGapsFilled);
+                updateDeadline(std::chrono::duration_cast<std::chrono::microseconds>(mNowCached - mGapSince));
+            }
+            processInOrderPacket(currPacketIdx, data, data_length, mCurrentPacket, callback);
+            processBufferedPackets(callback);
+            if (mNBuffered > 0) mGapSince = oldestArrival();
+            return;
+        }
 
-    // This variable is used to track a situation where the sequence number is increasing monotonically while packets
-    // are out of order. if this counter reaches MONOTONIC_THRESHOLD, we will restart buffering and update lastPacketIdx
-    // to the highest sequence index received.
-    size_t mMonotonicOutOfOrderIncreaseCount;
+        const auto dist = calculateDistance(mLastPacketIdx, currPacketIdx);
+        if (dist <= 0)
+        {
+            if (calculateDistance(mSkippedFirst, currPacketIdx) >= 0 &&
+                calculateDistance(currPacketIdx, mSkippedLast) >= 0)
+            {
+                // Arrived after we gave up on it, the deadline was too short for the current reorder delay
+                Metrics::increment(mStats.nGapsFilledLate);
+                updateDeadline(
+                    std::chrono::duration_cast<std::chrono::microseconds>(mNowCached - mSkippedAt) + mDeadline);
+            }
+            logDebug("Dropping late packet Sequence=%u", currPacketIdx);
+            return;
+        }
+
+        if (!fitsWindow(currPacketIdx))
+        {
+            logWarning("Sequence=%u outside of the reorder window (distance %d). Restarting.", currPacketIdx, dist);
+            restartBuffering(callback, mLastPacketIdx);
+            processInOrderPacket(currPacketIdx, data, data_length, mCurrentPacket, callback);
+            return;
+        }
+
+        if (mNBuffered == 0) mGapSince = mNowCached;
+        bufferPacket(currPacketIdx, takePacket());
+        mRing[currPacketIdx & RING_MASK].arrival = mNowCached;
+    }
+
+    /**
+     * @brief Skips every gap whose deadline has expired and delivers the packets behind it.
+     * @tparam Callback A callable type that processes the packet data.
+     * @param callback Callable to handle processed packets.
+     */
+    template <typename Callback>
+    void skipExpiredGaps(Callback& callback)
+    {
+        while (mNBuffered > 0 && mNowCached - mGapSince >= mDeadline)
+        {
+            const SeqType first   = firstBufferedSeq();
+            const auto    missing = static_cast<SeqType>(first - mLastPacketIdx - 1);
+            logDebug("Deadline expired, skipping %u packets before Sequence=%u", missing, first);
+            Metrics::increment(mStats.nGapsSkipped);
+            Metrics::increment(mStats.nPacketsSkipped, missing);
+            mSkippedFirst  = mLastPacketIdx + 1;
+            mSkippedLast   = first - 1;
+            mSkippedAt     = mNowCached;
+            mLastPacketIdx = first - 1;
+            processBufferedPackets(callback);
+            if (mNBuffered > 0) mGapSince = oldestArrival();
+        }
+    }
+
+    /**
+     * @brief Feeds a measured reorder delay into the adaptive deadline.
+     * @param sample Time between a gap opening and its missing packet arriving.
+     */
+    void updateDeadline(std::chrono::microseconds sample)
+    {
+        // fast attack, slow decay: one late packet raises the deadline, it takes a while of short gaps to lower it
+        mReorderDelay = sample > mReorderDelay ? sample : mReorderDelay - (mReorderDelay - sample) / 16;
+        mDeadline     = std::clamp(
+            mReorderDelay * mDeadlineConfig.reorderDelayFactor, mDeadlineConfig.minWait, mDeadlineConfig.maxWait);
+        store(mStats.deadline, mDeadline.count());
+    }
+
+    /**
+     * @brief Sequence index of the first buffered packet after lastPacketIdx. Only valid if mNBuffered > 0.
+     */
+    SeqType firstBufferedSeq() const
+    {
+        const size_t   start   = (mLastPacketIdx + 1) & RING_MASK;
+        const uint64_t pending = start == 0 ? mOccupied : (mOccupied >> start) | (mOccupied << (64 - start));
+        return mRing[(start + __builtin_ctzll(pending)) & RING_MASK].seq;
+    }
+
+    /**
+     * @brief Arrival time of the oldest buffered packet. Only valid if mNBuffered > 0.
+     */
+    Clock::time_point oldestArrival() const
+    {
+        Clock::time_point oldest  = Clock::time_point::max();
+        uint64_t          pending = mOccupied;
+        while (pending != 0)
+        {
+            oldest = std::min(oldest, mRing[__builtin_ctzll(pending)].arrival);
+            pending &= pending - 1;
+        }
+        return oldest;
+    }
+
+    /**
+     * @brief Hands one packet to the callback, with its receive timestamp if the callback takes one. A callback that
+     *        takes a const PacketRef& gets @p packet, or a pooled copy of the data if we do not own it.
+     */
+    template <typename Callback>
+    void deliver(
+        Callback&         callback,
+        const uint8_t*    data,
+        std::size_t       data_length,
+        Clock::time_point timestamp,
+        const PacketRef*  packet)
+    {
+        if constexpr (std::is_invocable_v<Callback&, const PacketRef&>)
+        {
+            if (packet != nullptr)
+            {
+                callback(*packet);
+                return;
+            }
+            PacketRef copy = copyPacket(data, data_length);
+            copy.setTimestamp(timestamp);
+            callback(copy);
+        }
+        else if constexpr (std::is_invocable_v<Callback&, const uint8_t*, std::size_t, Clock::time_point>)
+        {
+            callback(data, data_length, timestamp);
+        }
+        else
+        {
+            callback(data, data_length);
+        }
+    }
+
+    static void store(std::atomic<long>& counter, long value) { counter.store(value, std::memory_order_relaxed); }
 
     /**
      * @brief Determines if the incoming packet is the first packet.
@@ -122,17 +481,23 @@ class BufferedPacketQueue
      * @param currPacketIdx Sequence index of the packet.
      * @param data Pointer to the packet data.
      * @param data_length Size of the packet data.
+     * @param packet Owning handle to the packet data, nullptr if we do not own it.
      * @param callback Callable to handle processed packets.
      */
     template <typename Callback>
-    void processInOrderPacket(SeqType currPacketIdx, const uint8_t* data, std::size_t data_length, Callback& callback)
+    void processInOrderPacket(
+        SeqType          currPacketIdx,
+        const uint8_t*   data,
+        std::size_t      data_length,
+        const PacketRef* packet,
+        Callback&        callback)
     {
         logDebug("In-order packet detected. Processing immediately.");
 
         // in-order packet receiver which means we restart tracking out of order monotonic increases
         mMonotonicOutOfOrderIncreaseCount = 0;
 
-        callback(data, data_length);
+        deliver(callback, data, data_length, mCurrentTimestamp, packet);
         mLastPacketIdx = currPacketIdx;
         logDebug("Updated lastPacketIdx to %u", mLastPacketIdx);
     }
@@ -145,23 +510,19 @@ class BufferedPacketQueue
     template <typename Callback>
     void processBufferedPackets(Callback& callback)
     {
-        while (true)
+        while (mNBuffered > 0)
         {
-            SeqType nextIdx = mLastPacketIdx + 1;
-            auto    it      = mPackets.find(nextIdx);
-            if (it != mPackets.end())
-            {
-                logDebug("Found buffered packet with Sequence=%u. Processing.", it->first);
-                callback(it->second.data(), it->second.size());
-                mLastPacketIdx = it->first;
-                logDebug("Updated lastPacketIdx to %u after processing buffered packet.", mLastPacketIdx);
-                mPackets.erase(it);
-            }
-            else
+            const SeqType nextIdx = mLastPacketIdx + 1;
+            if (!isBuffered(nextIdx))
             {
                 logDebug("No buffered packet found for Sequence=%u.", nextIdx);
                 break;
             }
+            logDebug("Found buffered packet with Sequence=%u. Processing.", nextIdx);
+            const PacketRef packet = takeSlot(nextIdx & RING_MASK);
+            deliver(callback, packet.data(), packet.size(), packet.timestamp(), &packet);
+            mLastPacketIdx = nextIdx;
+            logDebug("Updated lastPacketIdx to %u after processing buffered packet.", mLastPacketIdx);
         }
     }
 
@@ -169,12 +530,11 @@ class BufferedPacketQueue
      * @brief Handles out-of-order packets by buffering or ignoring based on distance and monotonic increases.
      * @tparam Callback A callable type that processes the packet data.
      * @param currPacketIdx Sequence index of the incoming packet.
-     * @param data Pointer to the packet data.
-     * @param data_length Size of the packet data.
+     * @param packet The packet.
      * @param callback Callable to handle processed packets.
      */
     template <typename Callback>
-    void handleOutOfOrderPacket(SeqType currPacketIdx, const uint8_t* data, std::size_t data_length, Callback& callback)
+    void handleOutOfOrderPacket(SeqType currPacketIdx, PacketRef packet, Callback& callback)
     {
         logDebug("Out-of-order packet detected. Sequence=%u", currPacketIdx);
 
@@ -184,9 +544,19 @@ class BufferedPacketQueue
             // return;
         }
 
-        bufferPacket(currPacketIdx, data, data_length);
-
         auto dist = calculateDistance(currPacketIdx, mLastPacketIdx);
+        if (!fitsWindow(currPacketIdx))
+        {
+            // Too far from the window (stream restart / huge loss) or its slot is taken by a packet 64 seqs away.
+            // Flush what we have and restart from this packet.
+            logWarning("Sequence=%u outside of the reorder window (distance %d). Restarting.", currPacketIdx, dist);
+            restartBuffering(callback, mLastPacketIdx);
+            processInOrderPacket(currPacketIdx, packet.data(), packet.size(), &packet, callback);
+            return;
+        }
+
+        bufferPacket(currPacketIdx, std::move(packet));
+
         if (std::abs(dist) < MONOTONIC_THRESHOLD)
         {
             // Check for monotonic increases
@@ -210,7 +580,7 @@ class BufferedPacketQueue
             }
         }
         // If buffer size exceeds MAX_BUFFER_SIZE, handle buffer overflow
-        if (mPackets.size() >= MAX_BUFFER_SIZE)
+        if (mNBuffered >= MAX_BUFFER_SIZE)
         {
             logWarning(
                 "Buffer size exceeded MAX_BUFFER_SIZE (%zu). Processing in-order buffered packets.", MAX_BUFFER_SIZE);
@@ -223,18 +593,90 @@ class BufferedPacketQueue
      * @param currPacketIdx Sequence index of the incoming packet.
      * @return True if the packet is a duplicate; otherwise, false.
      */
-    bool isDuplicatePacket(SeqType currPacketIdx) const { return mPackets.find(currPacketIdx) != mPackets.end(); }
+    bool isDuplicatePacket(SeqType currPacketIdx) const { return isBuffered(currPacketIdx); }
 
     /**
-     * @brief Buffers an out-of-order packet.
+     * @brief Checks if the window holds the packet with the given sequence index.
+     * @param seq Sequence index.
+     * @return True if the packet is buffered; otherwise, false.
+     */
+    bool isBuffered(SeqType seq) const
+    {
+        const size_t slot = seq & RING_MASK;
+        return (mOccupied >> slot & 1) && mRing[slot].seq == seq;
+    }
+
+    /**
+     * @brief Checks if a packet can be buffered without evicting a different sequence index from its slot.
+     * @param seq Sequence index.
+     * @return True if the packet is less than REORDER_RING_SIZE away from lastPacketIdx and its slot is free (or
+     *         holds a duplicate of it).
+     */
+    bool fitsWindow(SeqType seq) const
+    {
+        const size_t slot = seq & RING_MASK;
+        return static_cast<size_t>(std::abs(calculateDistance(mLastPacketIdx, seq))) < REORDER_RING_SIZE &&
+               (!(mOccupied >> slot & 1) || mRing[slot].seq == seq);
+    }
+
+    /**
+     * @brief Buffers an out-of-order packet. A duplicate replaces the buffered copy.
      * @param currPacketIdx Sequence index of the incoming packet.
+     * @param packet The packet, the handle is moved into the buffer.
+     */
+    void bufferPacket(SeqType currPacketIdx, PacketRef packet)
+    {
+        const size_t slot = currPacketIdx & RING_MASK;
+        if (!(mOccupied >> slot & 1))
+        {
+            mOccupied |= uint64_t{1} << slot;
+            mNBuffered++;
+        }
+        mRing[slot].packet = std::move(packet);
+        mRing[slot].seq    = currPacketIdx;
+        logDebug("Buffered out-of-order packet. Buffer size: %zu", mNBuffered);
+    }
+
+    /**
+     * @brief Removes the packet from an occupied slot.
+     * @param slot Slot index.
+     * @return The packet.
+     */
+    PacketRef takeSlot(size_t slot)
+    {
+        if (mDeadlineMode)
+        {
+            Metrics::increment(mStats.nHeldPackets);
+            Metrics::increment(
+                mStats.addedLatencyUs,
+                std::chrono::duration_cast<std::chrono::microseconds>(mNowCached - mRing[slot].arrival).count());
+        }
+        mOccupied &= ~(uint64_t{1} << slot);
+        mNBuffered--;
+        return std::move(mRing[slot].packet);
+    }
+
+    /**
+     * @brief Copies a packet we do not own into a buffer of mCopyPool (heap if it does not fit).
      * @param data Pointer to the packet data.
      * @param data_length Size of the packet data.
+     * @return Owning handle to the copy.
      */
-    void bufferPacket(SeqType currPacketIdx, const uint8_t* data, std::size_t data_length)
+    PacketRef copyPacket(const uint8_t* data, std::size_t data_length)
     {
-        mPackets[currPacketIdx] = std::vector<uint8_t>(data, data + data_length);
-        logDebug("Buffered out-of-order packet. Buffer size: %zu", mPackets.size());
+        if (!mCopyPool)
+        {
+            // one buffer per slot plus the one being delivered
+            mCopyPool = PacketPool::create(PacketPool::DEFAULT_BUFFER_SIZE, REORDER_RING_SIZE + 1);
+        }
+        if (data_length > mCopyPool->getBufferSize())
+        {
+            return PacketPool::copyOf(data, data_length);
+        }
+        PacketRef packet = mCopyPool->acquire();
+        std::memcpy(packet.data(), data, data_length);
+        packet.setSize(data_length);
+        return packet;
     }
 
     /**
@@ -248,35 +690,23 @@ class BufferedPacketQueue
         // Process as many in-order buffered packets as possible
         processBufferedPackets(callback);
 
-        if (!mPackets.empty())
+        if (mNBuffered > 0)
         {
-            logWarning("Processing %zu buffered packets that might be out of order.", mPackets.size());
-
-            // Create a vector of iterators to the map elements
-            std::vector<std::unordered_map<uint16_t, std::vector<uint8_t>>::const_iterator> sortedPackets;
-            sortedPackets.reserve(mPackets.size());
+            logWarning("Processing %zu buffered packets that might be out of order.", mNBuffered);
 
-            // Populate the vector with iterators to the map elements
-            for (auto it = mPackets.cbegin(); it != mPackets.cend(); ++it)
+            // Walk the occupied slots starting after lastPacketIdx, which yields sequence order across the 16 bit
+            // wrap-around (packets older than lastPacketIdx come last). Bit k of pending is slot (start + k).
+            const size_t start   = (mLastPacketIdx + 1) & RING_MASK;
+            uint64_t     pending = start == 0 ? mOccupied : (mOccupied >> start) | (mOccupied << (64 - start));
+            while (pending != 0)
             {
-                sortedPackets.push_back(it);
+                const size_t slot = (start + __builtin_ctzll(pending)) & RING_MASK;
+                pending &= pending - 1;
+                logDebug("Processing possibly out-of-order buffered packet with Sequence=%u.", mRing[slot].seq);
+                const PacketRef packet = takeSlot(slot);
+                deliver(callback, packet.data(), packet.size(), packet.timestamp(), &packet);
             }
 
-            // Sort the vector based on the keys
-            std::sort(
-                sortedPackets.begin(),
-                sortedPackets.end(),
-                [](const auto& a, const auto& b) { return a->first < b->first; });
-
-            // Iterate over the sorted packets and invoke the callback
-            for (const auto& it : sortedPackets)
-            {
-                const auto& packet = it->second;
-                logDebug("Processing possibly out-of-order buffered packet with Sequence=%u.", it->first);
-                callback(packet.data(), packet.size());
-            }
-
-            mPackets.clear();
             // Reset the monotonic increase counter
             mMonotonicOutOfOrderIncreaseCount = 0;
         }
@@ -322,8 +752,10 @@ class BufferedPacketQueue
      */
     void logDebug(const char* format, ...) const
     {
-#if defined(__ANDROID__) || defined(__ANDROID_API__)
-        return;
+#if !defined(BUFFERED_QUEUE_DEBUG)
+        // Called several times per packet, only compiled in on request
+        (void) format;
+#elif defined(__ANDROID__) || defined(__ANDROID_API__)
         va_list args;
         va_start(args, format);
         __android_log_vprint(ANDROID_LOG_DEBUG, BUFFERED_QUEUE_LOG_TAG, format, args);
@@ -360,3 +792,5 @@ class BufferedPacketQueue
 #endif
     }
 };
+
+#endif  // FPVUE_BUFFEREDPACKETQUEUE_H
@@ -0,0 +1,114 @@
+//
+// CatchUpController.h
+// Bounds the latency after a hiccup (GC pause, thermal throttling, a codec stall): instead of decoding the whole
+// backlog, the decoder skips frames until it is back within the budget. The backlog of a picture is its age at the
+// codec input, from the (kernel) receive timestamp of its first packet, so the time it waited in the socket, the
+// reorder queue and the feed queue, plus the last wait for a codec input buffer.
+// Over the budget, non-reference pictures are skipped first. If that does not bring the backlog down within one
+// budget (or it is twice the budget), everything is skipped up to the next key frame (IRAP for H.265).
+//
+
+#ifndef FPVUE_CATCHUPCONTROLLER_H
+#define FPVUE_CATCHUPCONTROLLER_H
+
+#include <atomic>
+#include <chrono>
+#include "Metrics.h"
+#include "NALU/NALU.hpp"
+
+class CatchUpController
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Mode : uint8_t
+    {
+        OFF,
+        DROP_NON_REFERENCE,
+        DROP_UNTIL_KEY_FRAME
+    };
+
+    // 0 (default) never skips anything. From any thread, takes effect with the next picture.
+    void setBudget(Clock::duration budget) { mBudget.store(budget.count(), std::memory_order_relaxed); }
+
+    Clock::duration getBudget() const { return Clock::duration(mBudget.load(std::memory_order_relaxed)); }
+
+    /**
+     * Called by the feed thread for each NALU before it goes to the codec, at @param now. @param codecInputWait is
+     * how long the last input buffer took. The decision is made at the first slice of a picture and holds for all of
+     * its slices, NALUs that are not slices (parameter sets, SEI, ...) are never skipped.
+     * @return true if the NALU is to be skipped.
+     */
+    bool skip(const NALU& nalu, Clock::time_point now, Clock::duration codecInputWait)
+    {
+        const Clock::duration budget = getBudget();
+        if (budget == Clock::duration::zero())
+        {
+            mMode = Mode::OFF;
+            return false;
+        }
+        if (!nalu.is_vcl()) return false;
+        if (!nalu.is_first_slice_of_picture()) return mSkipPicture;
+        const Clock::duration backlog = now - nalu.creationTime + codecInputWait;
+        switch (mMode)
+        {
+            case Mode::OFF:
+                if (backlog > budget)
+                {
+                    mMode    = backlog > 2 * budget ? Mode::DROP_UNTIL_KEY_FRAME : Mode::DROP_NON_REFERENCE;
+                    mEntered = now;
+                    Metrics::increment(mNEvents);
+                    mMetricEvents.add();
+                }
+                break;
+            case Mode::DROP_NON_REFERENCE:
+                if (backlog < budget / 2)
+                {
+                    mMode = Mode::OFF;
+                }
+                else if (backlog > 2 * budget || (backlog > budget && now - mEntered > budget))
+                {
+                    mMode = Mode::DROP_UNTIL_KEY_FRAME;
+                }
+                break;
+            case Mode::DROP_UNTIL_KEY_FRAME:
+                break;
+        }
+        if (mMode == Mode::DROP_UNTIL_KEY_FRAME && nalu.is_keyframe())
+        {
+            // decoding restarts here, if this one is late as well the non-reference pictures after it go
+            mMode    = backlog > budget ? Mode::DROP_NON_REFERENCE : Mode::OFF;
+            mEntered = now;
+        }
+        mSkipPicture = (mMode == Mode::DROP_NON_REFERENCE && nalu.is_non_reference()) ||
+                       (mMode == Mode::DROP_UNTIL_KEY_FRAME && !nalu.is_keyframe());
+        if (mSkipPicture)
+        {
+            Metrics::increment(mNSkippedFrames);
+            mMetricSkippedFrames.add();
+        }
+        return mSkipPicture;
+    }
+
+    // Only for the feed thread
+    Mode getMode() const { return mMode; }
+
+    // Times the backlog went over the budget, from any thread
+    long getNEvents() const { return mNEvents.load(std::memory_order_relaxed); }
+
+    // Pictures skipped to catch up, from any thread
+    long getNSkippedFrames() const { return mNSkippedFrames.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<Clock::rep> mBudget{0};
+    // Only touched by the feed thread
+    Mode              mMode        = Mode::OFF;
+    bool              mSkipPicture = false;
+    Clock::time_point mEntered{};
+    std::atomic<long> mNEvents        = 0;
+    std::atomic<long> mNSkippedFrames = 0;
+    Metrics::Counter& mMetricEvents        = Metrics::global().counter("decoder_catch_ups");
+    Metrics::Counter& mMetricSkippedFrames = Metrics::global().counter("decoder_catch_up_skipped_frames");
+};
+
+#endif  // FPVUE_CATCHUPCONTROLLER_H
@@ -0,0 +1,170 @@
+//
+// CodecWatchdog.h
+// Notices a wedged codec: one that takes (or stops taking) input but outputs nothing, as hardware decoders sometimes
+// do after corrupt input. Waiting for output starts with the first NALU fed after the last output. A codec that
+// has not output anything for a number of frame intervals (at least MIN_TIMEOUT) while the stream keeps coming is
+// wedged, the decoder then flushes it, or creates it again if that did not help, and primes it from the GOP cache.
+// Before it got a key frame a codec is allowed to output nothing, and a pause of the stream pauses the watchdog.
+// A codec that reported an error it does not recover from by itself is wedged right away.
+//
+
+#ifndef FPVUE_CODECWATCHDOG_H
+#define FPVUE_CODECWATCHDOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include "Metrics.h"
+
+class CodecWatchdog
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int DEFAULT_FRAME_INTERVALS = 30;
+    // However fast the stream, a frame that takes long to decode (a big key frame) is not a wedge
+    static constexpr auto MIN_TIMEOUT = std::chrono::milliseconds(200);
+
+    // Frame intervals without output, 0 disables the watchdog. From any thread.
+    void setFrameIntervals(int n) { mFrameIntervals.store(n, std::memory_order_relaxed); }
+
+    int getFrameIntervals() const { return mFrameIntervals.load(std::memory_order_relaxed); }
+
+    // How long without output is a wedge, zero if disabled
+    Clock::duration getTimeout() const
+    {
+        const int n = getFrameIntervals();
+        if (n <= 0) return Clock::duration::zero();
+        const Clock::duration interval(mFrameInterval.load(std::memory_order_relaxed));
+        return std::max<Clock::duration>(n * interval, MIN_TIMEOUT);
+    }
+
+    /**
+     * Feed thread: the first NALU of a picture of the stream, received at @param received. Measures the frame
+     * interval, after a pause of the stream no codec is waiting for output.
+     */
+    void onPicture(Clock::time_point received)
+    {
+        const Clock::duration gap = received - mLastPicture;
+        mLastPicture              = received;
+        if (gap > getTimeout())
+        {
+            for (auto& since : mWaitingSince) since.store(NONE, std::memory_order_relaxed);
+            return;
+        }
+        if (gap <= Clock::duration::zero()) return;
+        // smoothed over about 8 pictures, the receive times jitter
+        const Clock::rep interval = mFrameInterval.load(std::memory_order_relaxed);
+        mFrameInterval.store(interval + (gap.count() - interval) / 8, std::memory_order_relaxed);
+    }
+
+    // Codec @param idx was configured, flushed or created again: nothing is expected of it until the next key frame
+    void onStart(int idx)
+    {
+        mArmed[idx].store(false, std::memory_order_relaxed);
+        mWaitingSince[idx].store(NONE, std::memory_order_relaxed);
+        mFailed[idx].store(false, std::memory_order_relaxed);
+    }
+
+    // Codec @param idx was released, a recovery that did not finish is given up
+    void onRelease(int idx)
+    {
+        onStart(idx);
+        mResetAt[idx].store(NONE, std::memory_order_relaxed);
+    }
+
+    // The thread that feeds codec @param idx: a key frame goes to it, from now on it has to output something
+    void onKeyFrame(int idx) { mArmed[idx].store(true, std::memory_order_relaxed); }
+
+    // The thread that feeds codec @param idx: a NALU goes to it at @param now, whether it takes it or not
+    void onInput(int idx, Clock::time_point now)
+    {
+        if (!mArmed[idx].load(std::memory_order_relaxed)) return;
+        Clock::rep none = NONE;
+        mWaitingSince[idx].compare_exchange_strong(none, now.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    // Callback of codec @param idx: it reported an error it does not recover from by itself
+    void onError(int idx) { mFailed[idx].store(true, std::memory_order_relaxed); }
+
+    // Codec @param idx reported such an error since it was started, flushing it does not help
+    bool hasFailed(int idx) const { return mFailed[idx].load(std::memory_order_relaxed); }
+
+    /**
+     * Output thread (or callback) of codec @param idx: a frame was output at @param now. @param shown: it was not
+     * one the codec was primed with, the first such frame after a reset ends the recovery.
+     */
+    void onOutput(int idx, Clock::time_point now, bool shown)
+    {
+        mWaitingSince[idx].store(NONE, std::memory_order_relaxed);
+        if (!shown || mResetAt[idx].load(std::memory_order_relaxed) == NONE) return;
+        const Clock::rep resetAt = mResetAt[idx].exchange(NONE, std::memory_order_relaxed);
+        if (resetAt == NONE) return;
+        const Clock::duration recovery = now.time_since_epoch() - Clock::duration(resetAt);
+        mLastRecovery.store(recovery.count(), std::memory_order_relaxed);
+        mMetricRecovery.record(recovery);
+    }
+
+    /**
+     * When codec @param idx counts as wedged, time_point::max() if it is not waiting for output, the epoch if it
+     * failed. From any thread.
+     */
+    Clock::time_point getDeadline(int idx) const
+    {
+        const Clock::rep      since   = mWaitingSince[idx].load(std::memory_order_relaxed);
+        const Clock::duration timeout = getTimeout();
+        if (timeout == Clock::duration::zero()) return Clock::time_point::max();
+        if (hasFailed(idx)) return Clock::time_point{};
+        if (since == NONE) return Clock::time_point::max();
+        return Clock::time_point(Clock::duration(since)) + timeout;
+    }
+
+    bool isWedged(int idx, Clock::time_point now) const { return now >= getDeadline(idx); }
+
+    // The last reset of codec @param idx did not bring its output back (yet)
+    bool isRecovering(int idx) const { return mResetAt[idx].load(std::memory_order_relaxed) != NONE; }
+
+    /**
+     * Feed thread: codec @param idx is reset at @param now, flushed or, if @param recreated, created again. The
+     * recovery time is from here to the first frame shown.
+     */
+    void onReset(int idx, Clock::time_point now, bool recreated)
+    {
+        onStart(idx);
+        // a reset that did not help keeps the time of the first one
+        if (!isRecovering(idx)) mResetAt[idx].store(now.time_since_epoch().count(), std::memory_order_relaxed);
+        Metrics::increment(recreated ? mNRecreated : mNFlushed);
+        (recreated ? mMetricRecreated : mMetricFlushed).add();
+    }
+
+    // Resets by flushing / by creating the codec again, from any thread
+    long getNFlushed() const { return mNFlushed.load(std::memory_order_relaxed); }
+
+    long getNRecreated() const { return mNRecreated.load(std::memory_order_relaxed); }
+
+    // From the last reset to the first frame shown after it, zero before the first recovery
+    Clock::duration getLastRecovery() const { return Clock::duration(mLastRecovery.load(std::memory_order_relaxed)); }
+
+  private:
+    static constexpr Clock::rep NONE = 0;
+
+    std::atomic<int> mFrameIntervals{DEFAULT_FRAME_INTERVALS};
+    // 60 fps until the stream tells otherwise
+    std::atomic<Clock::rep> mFrameInterval{
+        std::chrono::duration_cast<Clock::duration>(std::chrono::microseconds(16667)).count()};
+    // Only touched by the feed thread
+    Clock::time_point mLastPicture{};
+    // Per codec, NONE: not waiting for output / not recovering
+    std::atomic<bool>       mArmed[2]        = {false, false};
+    std::atomic<Clock::rep> mWaitingSince[2] = {NONE, NONE};
+    std::atomic<Clock::rep> mResetAt[2]      = {NONE, NONE};
+    std::atomic<bool>       mFailed[2]       = {false, false};
+    std::atomic<long>       mNFlushed        = 0;
+    std::atomic<long>       mNRecreated      = 0;
+    std::atomic<Clock::rep> mLastRecovery{0};
+    Metrics::Counter&   mMetricFlushed   = Metrics::global().counter("decoder_watchdog_flushes");
+    Metrics::Counter&   mMetricRecreated = Metrics::global().counter("decoder_watchdog_recreates");
+    Metrics::Histogram& mMetricRecovery  = Metrics::global().histogram("decoder_watchdog_recovery_us");
+};
+
+#endif  // FPVUE_CODECWATCHDOG_H
@@ -0,0 +1,149 @@
+//
+// DecoderBackend.h
+// What VideoDecoder needs from a video codec, one codec instance together with its output surface. On Android this is
+// MediaCodec (MediaCodecBackend), on the host a scripted fake (FakeDecoderBackend) stands in, so the feed, output,
+// statistics and reconfigure logic of the decoder can be tested and measured without a device. The calls and their
+// semantics are those of AMediaCodec, the constants have the same values as their NDK counterparts.
+//
+
+#ifndef FPVUE_DECODERBACKEND_H
+#define FPVUE_DECODERBACKEND_H
+
+#include <sys/types.h>
+#include <cstdint>
+#include <vector>
+#include "AsyncCodec.h"
+#include "NALU/KeyFrameFinder.hpp"
+
+// What a codec is configured with
+struct DecoderConfig
+{
+    bool h265 = false;
+    // From the SPS. If it could not be parsed only width and height are set, see formatParsed.
+    VideoFormat format;
+    bool        formatParsed = false;
+    // The parameter sets with their prefix. H.264: SPS and PPS, H.265: all three in csd0.
+    std::vector<uint8_t> csd0;
+    std::vector<uint8_t> csd1;
+
+    // From the parameter sets in @param kff, all of them have to be available
+    static DecoderConfig fromKeyFrames(const KeyFrameFinder& kff, bool h265)
+    {
+        DecoderConfig config;
+        config.h265        = h265;
+        const auto& sps    = kff.getCSD0();
+        const auto  parsed = sps.getVideoFormatSPS();
+        if (parsed.has_value())
+        {
+            config.format       = *parsed;
+            config.formatParsed = true;
+        }
+        else
+        {
+            // falls back to the old fixed size
+            const auto videoWH   = sps.getVideoWidthHeightSPS();
+            config.format.width  = videoWH[0];
+            config.format.height = videoWH[1];
+        }
+        MLOGD << "Video format:" << config.format.asString();
+        if (h265)
+        {
+            KeyFrameFinder::appendNaluData(config.csd0, kff.getVPS());
+            KeyFrameFinder::appendNaluData(config.csd0, sps);
+            KeyFrameFinder::appendNaluData(config.csd0, kff.getCSD1());
+        }
+        else
+        {
+            config.csd0.resize(sps.getSize());
+            sps.copyTo(config.csd0.data());
+            config.csd1.resize(kff.getCSD1().getSize());
+            kff.getCSD1().copyTo(config.csd1.data());
+        }
+        return config;
+    }
+};
+
+class IDecoderBackend
+{
+  public:
+    // dequeueInputBuffer() / dequeueOutputBuffer() results that are not a buffer index (AMEDIACODEC_INFO_*).
+    // Anything else below 0 is an error, e.g. the codec was stopped.
+    static constexpr ssize_t INFO_TRY_AGAIN_LATER        = -1;
+    static constexpr ssize_t INFO_OUTPUT_FORMAT_CHANGED  = -2;
+    static constexpr ssize_t INFO_OUTPUT_BUFFERS_CHANGED = -3;
+    // AMEDIA_ERROR_UNKNOWN
+    static constexpr ssize_t ERROR_UNKNOWN = -10000;
+    // Buffer flags (AMEDIACODEC_BUFFER_FLAG_*)
+    static constexpr uint32_t FLAG_CODEC_CONFIG  = 2;
+    static constexpr uint32_t FLAG_END_OF_STREAM = 4;
+    static constexpr uint32_t FLAG_PARTIAL_FRAME = 8;
+
+    struct OutputInfo
+    {
+        int64_t  presentationTimeUs = 0;
+        uint32_t flags              = 0;
+        size_t   size               = 0;
+    };
+
+    // Releases the codec and the output surface
+    virtual ~IDecoderBackend() = default;
+
+    // For the log
+    virtual const char* name() const = 0;
+
+    // Creates the codec instance for H.264 / H.265, a codec that exists already is released first
+    virtual bool create(bool h265) = 0;
+
+    virtual bool isCreated() const = 0;
+
+    // Releases the codec instance (stopping it if needed), the output surface stays
+    virtual void release() = 0;
+
+    /**
+     * Asynchronous mode: @param listener gets the free input buffers and the decoded frames from the codec's thread
+     * from start() to stop(). Call after create(), before configure().
+     * @return false if the codec can only run synchronously.
+     */
+    virtual bool setAsyncListener(AsyncCodecListener* listener) = 0;
+
+    virtual bool configure(const DecoderConfig& config) = 0;
+
+    virtual bool start() = 0;
+
+    // Any buffer index handed out before is invalid after this, no more async callbacks
+    virtual bool stop() = 0;
+
+    /**
+     * Drops the queued input and the pending output, the codec keeps its configuration and waits for a key frame.
+     * Any buffer index handed out before is invalid after this. Synchronous mode: all input buffers can be dequeued
+     * right away. Asynchronous mode: no callbacks until start() is called again, which hands out the input buffers.
+     */
+    virtual bool flush() = 0;
+
+    // Synchronous mode: index of a free input buffer, waits up to @param timeoutUs
+    virtual ssize_t dequeueInputBuffer(int64_t timeoutUs) = 0;
+
+    // Input buffer @param index and its @param capacity, nullptr if there is none
+    virtual uint8_t* getInputBuffer(size_t index, size_t& capacity) = 0;
+
+    virtual bool queueInputBuffer(size_t index, size_t size, uint64_t presentationTimeUs, uint32_t flags) = 0;
+
+    // Synchronous mode: index of a decoded frame, waits up to @param timeoutUs
+    virtual ssize_t dequeueOutputBuffer(OutputInfo& info, int64_t timeoutUs) = 0;
+
+    // @param render: to the output surface, as soon as possible
+    virtual void releaseOutputBuffer(size_t index, bool render) = 0;
+
+    // The output size, after INFO_OUTPUT_FORMAT_CHANGED
+    virtual void getOutputSize(int32_t& width, int32_t& height) = 0;
+
+    /**
+     * Moves the output of the created codec to the surface of @param surface, a backend of the same kind that has no
+     * codec and gives its surface up. nullptr parks the codec on a surface of its own that is never shown, so the
+     * app may delete the old one. The codec keeps running, with its configuration and reference frames.
+     * @return false if the codec cannot switch surfaces, then it has to be released and created again.
+     */
+    virtual bool setOutputSurface(IDecoderBackend* surface) = 0;
+};
+
+#endif  // FPVUE_DECODERBACKEND_H
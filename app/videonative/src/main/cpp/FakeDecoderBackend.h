@@ -0,0 +1,433 @@
+//
+// FakeDecoderBackend.h
+// A decoder backend without a codec, for tests and benchmarks of VideoDecoder on the host. Every queued input buffer
+// is "decoded" after a scripted latency, then its input buffer is free again and (unless it was config data or a
+// partial frame) a frame is output. The number and size of the input buffers and stalls, where the codec neither
+// frees input nor outputs anything for a while, are scripted as well. Runs in synchronous mode (dequeue with a
+// timeout) and in asynchronous mode (callbacks from its own thread), as MediaCodec does. Like a real decoder it can
+// be scripted to output nothing after a configure until it got a key frame, and to wedge: hang until it is flushed
+// or created again, optionally reporting an error in asynchronous mode.
+//
+
+#ifndef FPVUE_FAKEDECODERBACKEND_H
+#define FPVUE_FAKEDECODERBACKEND_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "DecoderBackend.h"
+
+class FakeDecoderBackend : public IDecoderBackend
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stall
+    {
+        // The stall starts when this input buffer (counted over the lifetime of the backend, from 0) is queued
+        long                      atInput = 0;
+        std::chrono::microseconds duration{0};
+    };
+
+    struct Script
+    {
+        int                       nInputBuffers   = 4;
+        size_t                    inputBufferSize = 1024 * 1024;
+        std::chrono::microseconds latency{2000};
+        std::vector<Stall>        stalls;
+        // false: setAsyncListener() fails, as on devices before Android 9
+        bool asyncSupported = true;
+        // false: setOutputSurface() fails, the codec has to be created again for another surface
+        bool surfaceChangeSupported = true;
+        // true: as a real decoder, nothing is output after configure() until a key frame was queued
+        bool waitForKeyFrame = false;
+        // When this input buffer (counted as for the stalls) is queued the codec wedges: it hangs like in a stall,
+        // but until flush() or, with wedgeSurvivesFlush, until it is created again. -1: never.
+        long wedgeAtInput       = -1;
+        bool wedgeSurvivesFlush = false;
+        // Asynchronous mode: the wedge comes with an error callback with errorActionCode. After a recoverable error
+        // configure() ends the wedge as well.
+        bool    errorAtWedge    = false;
+        int32_t errorActionCode = 0;
+    };
+
+    // What VideoDecoder did with the codec, readable from any thread
+    struct Stats
+    {
+        long    nCreated       = 0;
+        long    nConfigured    = 0;
+        long    nStarted       = 0;
+        long    nQueuedBuffers = 0;
+        long    nQueuedBytes   = 0;
+        long    nConfigBuffers = 0;
+        long    nOutputs       = 0;
+        long    nRendered      = 0;
+        bool    h265           = false;
+        bool    async          = false;
+        int32_t width          = 0;
+        int32_t height         = 0;
+        // setOutputSurface() calls that succeeded, parked by the last one
+        long nSurfaceChanges = 0;
+        bool parked          = false;
+        // Script::waitForKeyFrame: frames queued before the key frame, not output
+        long nBeforeKeyFrame = 0;
+        long nFlushes        = 0;
+        // Script::wedgeAtInput: hanging right now
+        bool wedged  = false;
+        long nErrors = 0;
+    };
+
+    FakeDecoderBackend() : mScript() {}
+
+    explicit FakeDecoderBackend(Script script) : mScript(std::move(script)) {}
+
+    ~FakeDecoderBackend() override { release(); }
+
+    const char* name() const override { return "Fake"; }
+
+    bool create(bool h265) override
+    {
+        release();
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCreated      = true;
+        mStats.h265   = h265;
+        mStats.async  = false;
+        mStats.wedged = false;
+        mListener     = nullptr;
+        mStats.nCreated++;
+        return true;
+    }
+
+    bool isCreated() const override
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mCreated;
+    }
+
+    void release() override
+    {
+        stop();
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCreated  = false;
+        mListener = nullptr;
+    }
+
+    bool setAsyncListener(AsyncCodecListener* listener) override
+    {
+        if (!mScript.asyncSupported) return false;
+        std::lock_guard<std::mutex> lock(mMutex);
+        mListener    = listener;
+        mStats.async = listener != nullptr;
+        return true;
+    }
+
+    bool configure(const DecoderConfig& config) override
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mCreated || mStarted) return false;
+        mInputBuffers.assign(mScript.nInputBuffers, std::vector<uint8_t>(mScript.inputBufferSize));
+        mStats.width         = config.format.width;
+        mStats.height        = config.format.height;
+        mFormatChangePending = true;
+        mKeyFrameQueued      = false;
+        if (mScript.errorAtWedge && mScript.errorActionCode == AsyncCodecListener::ACTION_RECOVERABLE)
+        {
+            mStats.wedged = false;
+        }
+        mStats.nConfigured++;
+        return true;
+    }
+
+    bool start() override
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mStarted && mFlushed)
+        {
+            // async mode: running again after a flush
+            mFlushed = false;
+            freeAllInputBuffers();
+            mCondition.notify_all();
+            return true;
+        }
+        if (!mCreated || mStarted) return false;
+        mStarted = true;
+        mFree.clear();
+        mOutputs.clear();
+        freeAllInputBuffers();
+        mThread = std::thread(&FakeDecoderBackend::loop, this);
+        mStats.nStarted++;
+        return true;
+    }
+
+    bool stop() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mStarted) return false;
+            mStarted = false;
+        }
+        mCondition.notify_all();
+        mThread.join();
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEvents.clear();
+        mFree.clear();
+        mOutputs.clear();
+        mStallUntil   = {};
+        mFlushed      = false;
+        mErrorPending = false;
+        return true;
+    }
+
+    bool flush() override
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            if (!mStarted) return false;
+            // like MediaCodec: not in the middle of a callback, none with an index from before after this
+            while (mInCallback) mCondition.wait_for(lock, std::chrono::milliseconds(10));
+            mEvents.clear();
+            mFree.clear();
+            mOutputs.clear();
+            mStallUntil = {};
+            if (!mScript.wedgeSurvivesFlush) mStats.wedged = false;
+            mKeyFrameQueued = false;
+            mStats.nFlushes++;
+            if (mListener != nullptr)
+            {
+                mFlushed = true;
+            }
+            else
+            {
+                freeAllInputBuffers();
+            }
+        }
+        mCondition.notify_all();
+        return true;
+    }
+
+    ssize_t dequeueInputBuffer(int64_t timeoutUs) override
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        const auto                   deadline = Clock::now() + std::chrono::microseconds(timeoutUs);
+        mCondition.wait_until(lock, deadline, [this] { return !mStarted || !mFree.empty(); });
+        if (!mStarted) return ERROR_UNKNOWN;
+        if (mFree.empty()) return INFO_TRY_AGAIN_LATER;
+        const int32_t index = mFree.front();
+        mFree.pop_front();
+        return index;
+    }
+
+    uint8_t* getInputBuffer(size_t index, size_t& capacity) override
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (index >= mInputBuffers.size()) return nullptr;
+        capacity = mInputBuffers[index].size();
+        return mInputBuffers[index].data();
+    }
+
+    bool queueInputBuffer(size_t index, size_t size, uint64_t presentationTimeUs, uint32_t flags) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mStarted || index >= mInputBuffers.size()) return false;
+            const auto now = Clock::now();
+            for (const Stall& stall : mScript.stalls)
+            {
+                if (stall.atInput == mStats.nQueuedBuffers) mStallUntil = std::max(mStallUntil, now + stall.duration);
+            }
+            if (mScript.wedgeAtInput == mStats.nQueuedBuffers)
+            {
+                mStats.wedged = true;
+                mErrorPending = mScript.errorAtWedge;
+            }
+            bool output = (flags & (FLAG_CODEC_CONFIG | FLAG_PARTIAL_FRAME)) == 0;
+            if (mScript.waitForKeyFrame && !mKeyFrameQueued)
+            {
+                mKeyFrameQueued = containsKeyFrame(mInputBuffers[index].data(), size, mStats.h265);
+                if (output && !mKeyFrameQueued)
+                {
+                    output = false;
+                    mStats.nBeforeKeyFrame++;
+                }
+            }
+            mEvents.push_back({now + mScript.latency, (int32_t) index, output, (int64_t) presentationTimeUs, flags});
+            mStats.nQueuedBuffers++;
+            mStats.nQueuedBytes += (long) size;
+            if ((flags & FLAG_CODEC_CONFIG) != 0) mStats.nConfigBuffers++;
+        }
+        mCondition.notify_all();
+        return true;
+    }
+
+    ssize_t dequeueOutputBuffer(OutputInfo& info, int64_t timeoutUs) override
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        const auto                   deadline = Clock::now() + std::chrono::microseconds(timeoutUs);
+        mCondition.wait_until(lock, deadline, [this] { return !mStarted || !mOutputs.empty() || mFormatChangeReady; });
+        if (!mStarted) return ERROR_UNKNOWN;
+        if (mFormatChangeReady)
+        {
+            mFormatChangeReady = false;
+            return INFO_OUTPUT_FORMAT_CHANGED;
+        }
+        if (mOutputs.empty()) return INFO_TRY_AGAIN_LATER;
+        const ssize_t index = mOutputs.front().first;
+        info                = mOutputs.front().second;
+        mOutputs.pop_front();
+        return index;
+    }
+
+    void releaseOutputBuffer(size_t, bool render) override
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.nOutputs++;
+        if (render) mStats.nRendered++;
+    }
+
+    void getOutputSize(int32_t& width, int32_t& height) override
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        width  = mStats.width;
+        height = mStats.height;
+    }
+
+    bool setOutputSurface(IDecoderBackend* surface) override
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mCreated || !mScript.surfaceChangeSupported) return false;
+        mStats.nSurfaceChanges++;
+        mStats.parked = surface == nullptr;
+        return true;
+    }
+
+    Stats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
+  private:
+    // All input buffers become free right away, with mMutex held
+    void freeAllInputBuffers()
+    {
+        for (int32_t i = 0; i < mScript.nInputBuffers; i++) mEvents.push_back({Clock::now(), i, false, 0, 0});
+    }
+
+    // A NALU of an IDR / IRAP picture in the Annex B @param data
+    static bool containsKeyFrame(const uint8_t* data, size_t size, bool h265)
+    {
+        for (size_t i = 0; i + 3 < size; i++)
+        {
+            if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) continue;
+            const int type = h265 ? (data[i + 3] >> 1) & 0x3F : data[i + 3] & 0x1F;
+            if (h265 ? (type >= 16 && type <= 21) : type == 5) return true;
+        }
+        return false;
+    }
+
+    struct Event
+    {
+        Clock::time_point due;
+        int32_t           input;
+        // false: only the input buffer becomes free
+        bool     output;
+        int64_t  presentationTimeUs;
+        uint32_t flags;
+    };
+
+    // The codec thread: completes the queued buffers in order once they are due and no stall is going on
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (mStarted)
+        {
+            const auto now = Clock::now();
+            if (mErrorPending && mListener != nullptr)
+            {
+                AsyncCodecListener* listener = mListener;
+                mErrorPending                = false;
+                mStats.nErrors++;
+                mInCallback = true;
+                lock.unlock();
+                listener->onError((int32_t) ERROR_UNKNOWN, mScript.errorActionCode);
+                lock.lock();
+                mInCallback = false;
+                mCondition.notify_all();
+                continue;
+            }
+            if (mStats.wedged || mFlushed)
+            {
+                mCondition.wait_until(lock, now + std::chrono::milliseconds(100));
+                continue;
+            }
+            if (mEvents.empty() || mEvents.front().due > now || mStallUntil > now)
+            {
+                const auto until =
+                    mEvents.empty() ? now + std::chrono::milliseconds(100) : std::max(mEvents.front().due, mStallUntil);
+                mCondition.wait_until(lock, until);
+                continue;
+            }
+            const Event event = mEvents.front();
+            mEvents.pop_front();
+            const int32_t outputIndex = mNextOutput++;
+            if (mListener != nullptr)
+            {
+                AsyncCodecListener* listener      = mListener;
+                const bool          formatChanged = event.output && mFormatChangePending;
+                if (formatChanged) mFormatChangePending = false;
+                const int32_t width = mStats.width, height = mStats.height;
+                // like MediaCodec: callbacks one at a time, without holding our lock
+                mInCallback = true;
+                lock.unlock();
+                if (formatChanged) listener->onFormatChanged(width, height);
+                if (event.output) listener->onOutputAvailable(outputIndex, event.presentationTimeUs, event.flags);
+                listener->onInputAvailable(event.input);
+                lock.lock();
+                mInCallback = false;
+                mCondition.notify_all();
+                continue;
+            }
+            if (event.output)
+            {
+                if (mFormatChangePending)
+                {
+                    mFormatChangePending = false;
+                    mFormatChangeReady   = true;
+                }
+                mOutputs.push_back({outputIndex, {event.presentationTimeUs, event.flags, 0}});
+            }
+            mFree.push_back(event.input);
+            mCondition.notify_all();
+        }
+    }
+
+    const Script                               mScript;
+    mutable std::mutex                         mMutex;
+    std::condition_variable                    mCondition;
+    std::thread                                mThread;
+    bool                                       mCreated  = false;
+    bool                                       mStarted  = false;
+    AsyncCodecListener*                        mListener = nullptr;
+    std::vector<std::vector<uint8_t>>          mInputBuffers;
+    std::deque<Event>                          mEvents;
+    std::deque<int32_t>                        mFree;
+    std::deque<std::pair<int32_t, OutputInfo>> mOutputs;
+    int32_t                                    mNextOutput = 0;
+    Clock::time_point                          mStallUntil{};
+    // The first frame after configure() is preceded by a format change
+    bool mFormatChangePending = false;
+    bool mFormatChangeReady   = false;
+    bool mKeyFrameQueued      = false;
+    // async mode: flush() was called, nothing happens until start()
+    bool  mFlushed    = false;
+    bool  mInCallback = false;
+    // Script::errorAtWedge: the error callback is still to come
+    bool  mErrorPending = false;
+    Stats mStats;
+};
+
+#endif  // FPVUE_FAKEDECODERBACKEND_H
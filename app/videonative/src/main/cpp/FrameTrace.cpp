@@ -0,0 +1,211 @@
+//
+// FrameTrace.cpp
+//
+
+#include "FrameTrace.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+std::atomic<uint64_t> nextTraceId{1};
+
+// The ring a thread records into, for the last FrameTrace it recorded to. Given back when the thread exits.
+template <typename Ring>
+struct ThreadRing
+{
+    uint64_t              traceId = 0;
+    std::shared_ptr<Ring> ring;
+
+    void release()
+    {
+        if (ring) ring->inUse.store(false, std::memory_order_release);
+        ring.reset();
+        traceId = 0;
+    }
+
+    ~ThreadRing() { release(); }
+};
+
+// Name of the time from a stage to the next one the frame reached
+const char* const STAGE_NAMES[] = {"network + reorder", "depacketize", "feed", "decode", "render release"};
+
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == (size_t) FrameTrace::Stage::N_STAGES - 1);
+}  // namespace
+
+FrameTrace::FrameTrace() : mId(nextTraceId.fetch_add(1, std::memory_order_relaxed)) {}
+
+void FrameTrace::Ring::write(const Event& event)
+{
+    const uint64_t n    = mNWritten.load(std::memory_order_relaxed);
+    Slot&          slot = mSlots[n % RING_SIZE];
+    slot.sequence.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timeUs.store(event.timeUs, std::memory_order_relaxed);
+    slot.presentationTimeUs.store(event.presentationTimeUs, std::memory_order_relaxed);
+    slot.frameStage.store(((uint64_t) event.stage << 32) | event.frameId, std::memory_order_relaxed);
+    slot.sequence.store(2 * n + 2, std::memory_order_release);
+    mNWritten.store(n + 1, std::memory_order_release);
+}
+
+void FrameTrace::Ring::read(std::vector<Event>& out) const
+{
+    const uint64_t nWritten = mNWritten.load(std::memory_order_acquire);
+    for (uint64_t n = nWritten > RING_SIZE ? nWritten - RING_SIZE : 0; n < nWritten; n++)
+    {
+        const Slot&    slot     = mSlots[n % RING_SIZE];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * n + 2) continue;
+        Event event{};
+        event.timeUs              = slot.timeUs.load(std::memory_order_relaxed);
+        event.presentationTimeUs  = slot.presentationTimeUs.load(std::memory_order_relaxed);
+        const uint64_t frameStage = slot.frameStage.load(std::memory_order_relaxed);
+        event.frameId             = (uint32_t) frameStage;
+        event.stage               = (Stage) (frameStage >> 32);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // overwritten by the writer in the meantime
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+        out.push_back(event);
+    }
+}
+
+FrameTrace::Ring* FrameTrace::threadRing()
+{
+    thread_local ThreadRing<Ring> threadRing;
+    if (threadRing.traceId == mId) return threadRing.ring.get();
+    // first event of this thread (or of this thread on this trace): take over a ring of an exited thread, or a new one
+    threadRing.release();
+    std::lock_guard<std::mutex> lock(mRingsMutex);
+    for (const std::shared_ptr<Ring>& ring : mRings)
+    {
+        bool inUse = false;
+        if (ring->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+        {
+            threadRing.ring = ring;
+            break;
+        }
+    }
+    if (threadRing.ring == nullptr)
+    {
+        if (mRings.size() == MAX_RINGS) return nullptr;
+        threadRing.ring = std::make_shared<Ring>();
+        threadRing.ring->inUse.store(true, std::memory_order_relaxed);
+        mRings.push_back(threadRing.ring);
+    }
+    threadRing.traceId = mId;
+    return threadRing.ring.get();
+}
+
+std::vector<FrameTrace::Event> FrameTrace::collect() const
+{
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::lock_guard<std::mutex> lock(mRingsMutex);
+        rings = mRings;
+    }
+    std::vector<Event> events;
+    events.reserve(rings.size() * RING_SIZE);
+    for (const std::shared_ptr<Ring>& ring : rings) ring->read(events);
+    return events;
+}
+
+std::string FrameTrace::toChromeJSON(Clock::duration window, Clock::time_point now) const
+{
+    constexpr size_t         N_STAGES = (size_t) Stage::N_STAGES;
+    const std::vector<Event> events   = collect();
+    const int64_t nowUs  = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+    const int64_t fromUs = nowUs - std::chrono::duration_cast<std::chrono::microseconds>(window).count();
+    // the codec stages know the frame through the presentation time of the buffer it was queued in
+    std::unordered_map<int64_t, uint32_t> framesByPresentationTime;
+    for (const Event& event : events)
+    {
+        if (event.stage == Stage::CODEC_QUEUE) framesByPresentationTime[event.presentationTimeUs] = event.frameId;
+    }
+    // per frame the time it reached each stage, 0 if it did not. The first packet counts for RECEIVE, the last
+    // buffer for the others (a frame may go to the codec in several buffers).
+    std::map<uint32_t, std::array<int64_t, N_STAGES>> frames;
+    for (const Event& event : events)
+    {
+        uint32_t frameId = event.frameId;
+        if (event.stage == Stage::CODEC_OUTPUT || event.stage == Stage::RENDER_RELEASE)
+        {
+            const auto frame = framesByPresentationTime.find(event.presentationTimeUs);
+            if (frame == framesByPresentationTime.end()) continue;
+            frameId = frame->second;
+        }
+        auto inserted = frames.try_emplace(frameId);
+        if (inserted.second) inserted.first->second.fill(0);
+        int64_t& time = inserted.first->second[(size_t) event.stage];
+        if (time == 0 || (event.stage == Stage::RECEIVE ? event.timeUs < time : event.timeUs > time))
+        {
+            time = event.timeUs;
+        }
+    }
+    // oldest frame first
+    std::vector<std::pair<int64_t, uint32_t>> order;
+    for (const auto& frame : frames)
+    {
+        int64_t first = 0, last = 0;
+        for (const int64_t time : frame.second)
+        {
+            if (time == 0) continue;
+            if (first == 0 || time < first) first = time;
+            last = std::max(last, time);
+        }
+        if (last >= fromUs && first <= nowUs) order.emplace_back(first, frame.first);
+    }
+    std::sort(order.begin(), order.end());
+
+    std::ostringstream json;
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    json << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Video frames\"}}";
+    const auto event = [&json](const char* name, char phase, uint32_t frameId, int64_t timeUs)
+    {
+        json << ",\n{\"name\":\"" << name << "\",\"cat\":\"frame\",\"ph\":\"" << phase << "\",\"id\":" << frameId
+             << ",\"pid\":1,\"tid\":1,\"ts\":" << timeUs;
+    };
+    for (const auto& entry : order)
+    {
+        const uint32_t                       frameId   = entry.second;
+        const std::array<int64_t, N_STAGES>& times     = frames[frameId];
+        size_t                               lastStage = 0;
+        for (size_t stage = 0; stage < N_STAGES; stage++)
+        {
+            if (times[stage] != 0) lastStage = stage;
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame %u", frameId);
+        event(name, 'b', frameId, entry.first);
+        json << ",\"args\":{\"rtp_timestamp\":" << frameId << ",\"total_us\":" << times[lastStage] - entry.first
+             << "}}";
+        // each stage lasts until the next one the frame reached
+        for (size_t stage = 0; stage < lastStage; stage++)
+        {
+            if (times[stage] == 0) continue;
+            size_t next = stage + 1;
+            while (times[next] == 0) next++;
+            event(STAGE_NAMES[stage], 'b', frameId, times[stage]);
+            json << "}";
+            event(STAGE_NAMES[stage], 'e', frameId, times[next]);
+            json << "}";
+        }
+        event(name, 'e', frameId, times[lastStage]);
+        json << "}";
+    }
+    json << "]}\n";
+    return json.str();
+}
+
+bool FrameTrace::writeChromeJSON(const std::string& path, Clock::duration window) const
+{
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file) return false;
+    file << toChromeJSON(window);
+    file.close();
+    return !file.fail();
+}
@@ -0,0 +1,142 @@
+//
+// FrameTrace.h
+// Per-frame latency trace. Every access unit is identified by its RTP timestamp and timestamped at each stage of the
+// pipeline, from the socket to the release of its output buffer to the surface. Each thread records into its own
+// ring without locks or allocations, the oldest events are overwritten. The last seconds can be exported as Chrome
+// trace JSON (chrome://tracing, ui.perfetto.dev): one track per frame, split into the time it spent in each stage.
+//
+
+#ifndef FPVUE_FRAMETRACE_H
+#define FPVUE_FRAMETRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class FrameTrace
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // In pipeline order
+    enum class Stage : uint8_t
+    {
+        // the first packet of the frame was received (kernel receive timestamp if there is one)
+        RECEIVE,
+        // the reorder queue released the last packet of the frame, the one with the RTP marker bit
+        REORDER_RELEASE,
+        // the depacketizer completed the last NALU of the frame
+        NALU_COMPLETE,
+        // a buffer with (the end of) the frame was queued to the codec
+        CODEC_QUEUE,
+        // the codec output the frame
+        CODEC_OUTPUT,
+        // the output buffer was released to the surface
+        RENDER_RELEASE,
+        N_STAGES
+    };
+
+    // Events per thread. A thread records one or two stages per frame, at 120 fps that is 15 seconds or more.
+    static constexpr size_t RING_SIZE = 4096;
+    // More threads than that (at the same time) do not get a ring, their events are dropped
+    static constexpr size_t MAX_RINGS = 32;
+
+    FrameTrace();
+
+    FrameTrace(const FrameTrace&)            = delete;
+    FrameTrace& operator=(const FrameTrace&) = delete;
+
+    // Off by default, record() does nothing then
+    void setEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+
+    bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+    /**
+     * Frame @param frameId reached @param stage at @param time. Lock-free, from any thread.
+     * The codec only knows the presentation time of its buffers: CODEC_QUEUE records the @param presentationTimeUs of
+     * the buffer with the frame id, CODEC_OUTPUT / RENDER_RELEASE only need the presentation time.
+     */
+    void record(Stage stage, uint32_t frameId, Clock::time_point time, int64_t presentationTimeUs = 0)
+    {
+        if (!isEnabled()) return;
+        Ring* ring = threadRing();
+        if (ring == nullptr)
+        {
+            mNDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ring->write(
+            {std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count(),
+             presentationTimeUs,
+             frameId,
+             stage});
+    }
+
+    // The frames that reached any stage within the last @param window before @param now, as Chrome trace JSON
+    std::string toChromeJSON(Clock::duration window, Clock::time_point now = Clock::now()) const;
+
+    // toChromeJSON() into the file at @param path, false if it could not be written
+    bool writeChromeJSON(const std::string& path, Clock::duration window) const;
+
+    // Events dropped because their thread got no ring
+    long getNDropped() const { return mNDropped.load(std::memory_order_relaxed); }
+
+  private:
+    struct Event
+    {
+        int64_t  timeUs;
+        int64_t  presentationTimeUs;
+        uint32_t frameId;
+        Stage    stage;
+    };
+
+    // Single writer (the thread that holds it), any number of readers. A slot that is overwritten while it is read
+    // is skipped by the reader (seqlock).
+    class Ring
+    {
+      public:
+        Ring() : mSlots(std::make_unique<Slot[]>(RING_SIZE)) {}
+
+        void write(const Event& event);
+
+        // Appends the events still in the ring to @param out, oldest first
+        void read(std::vector<Event>& out) const;
+
+        // Held by a thread, a ring is given to another thread once its thread exited
+        std::atomic<bool> inUse{false};
+
+      private:
+        struct Slot
+        {
+            // 2 * (n + 1) once event n is written, odd while it is written
+            std::atomic<uint64_t> sequence{0};
+            std::atomic<int64_t>  timeUs{0};
+            std::atomic<int64_t>  presentationTimeUs{0};
+            // frame id in the low, stage in the high 32 bits
+            std::atomic<uint64_t> frameStage{0};
+        };
+
+        std::unique_ptr<Slot[]> mSlots;
+        std::atomic<uint64_t>   mNWritten{0};
+    };
+
+    // The ring of the calling thread, nullptr if there are MAX_RINGS threads holding one
+    Ring* threadRing();
+
+    // All events of the rings, in no particular order
+    std::vector<Event> collect() const;
+
+    // Tells apart the instances in the thread local ring cache, an address could be reused
+    const uint64_t                     mId;
+    std::atomic<bool>                  mEnabled  = false;
+    std::atomic<long>                  mNDropped = 0;
+    mutable std::mutex                 mRingsMutex;
+    std::vector<std::shared_ptr<Ring>> mRings;
+};
+
+#endif  // FPVUE_FRAMETRACE_H
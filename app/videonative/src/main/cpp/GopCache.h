@@ -0,0 +1,101 @@
+//
+// GopCache.h
+// The NALUs of the stream from the last key frame on. A codec configured in the middle of a GOP (a surface attached,
+// the second codec of the VR mode, a codec reset) is fed from it and is current right away, instead of waiting for
+// the next key frame of the camera, which takes seconds with long GOPs. Only a complete GOP is of any use: when the
+// cache goes over its limit, misses a NALU or the SPS changes it is emptied and starts again with the next key frame.
+// The entries are ref-counted copies that the cache shares with the other consumers of the NALU (the feeders of the
+// VR mode), one copy of a NALU however many of them hold it. Only the feed thread changes the cache.
+//
+
+#ifndef FPVUE_GOPCACHE_H
+#define FPVUE_GOPCACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Metrics.h"
+#include "NALU/NALU.hpp"
+#include "helper/AndroidLogger.hpp"
+
+class GopCache
+{
+  public:
+    using Entry = std::shared_ptr<NALUBuffer>;
+
+    static constexpr size_t DEFAULT_LIMIT = 8 * 1024 * 1024;
+
+    // Most bytes of NALU data held, 0 disables the cache. From any thread, takes effect with the next NALU.
+    void setLimit(size_t bytes) { mLimit.store(bytes, std::memory_order_relaxed); }
+
+    size_t getLimit() const { return mLimit.load(std::memory_order_relaxed); }
+
+    /**
+     * @param nalu is the next NALU of the stream.
+     * @return the cached copy of it, nullptr if it is not cached (there is no complete GOP).
+     */
+    Entry add(const NALU& nalu)
+    {
+        const size_t limit = getLimit();
+        if (nalu.isSPS())
+        {
+            // a new format starts with the next key frame, a codec configured with it cannot decode the old GOP
+            mScratch.resize(nalu.getSize());
+            nalu.copyTo(mScratch.data());
+            if (mScratch != mSPS)
+            {
+                mSPS.swap(mScratch);
+                clear();
+            }
+        }
+        if (nalu.is_keyframe() && nalu.is_first_slice_of_picture())
+        {
+            clear();
+            mComplete = true;
+        }
+        if (!mComplete) return nullptr;
+        const size_t bytes = getBytes() + nalu.getSize();
+        if (bytes > limit)
+        {
+            if (limit != 0) MLOGD << "GOP over the cache limit of " << limit << " bytes, not cached";
+            clear();
+            return nullptr;
+        }
+        Entry entry = std::make_shared<NALUBuffer>(nalu);
+        mEntries.push_back(entry);
+        mBytes.store(bytes, std::memory_order_relaxed);
+        mMetricBytes.set((int64_t) bytes);
+        return entry;
+    }
+
+    // A NALU of the stream went missing, the GOP is incomplete
+    void invalidate() { clear(); }
+
+    // From the key frame to the last NALU added, empty without a complete GOP
+    const std::vector<Entry>& entries() const { return mEntries; }
+
+    // From any thread
+    size_t getBytes() const { return mBytes.load(std::memory_order_relaxed); }
+
+  private:
+    void clear()
+    {
+        mEntries.clear();
+        mBytes.store(0, std::memory_order_relaxed);
+        mComplete = false;
+        mMetricBytes.set(0);
+    }
+
+    std::atomic<size_t> mLimit{DEFAULT_LIMIT};
+    std::vector<Entry>  mEntries;
+    std::atomic<size_t> mBytes{0};
+    bool                mComplete = false;
+    // The SPS of the cached GOP
+    std::vector<uint8_t> mSPS;
+    std::vector<uint8_t> mScratch;
+    Metrics::Gauge& mMetricBytes = Metrics::global().gauge("decoder_gop_cache_bytes");
+};
+
+#endif  // FPVUE_GOPCACHE_H
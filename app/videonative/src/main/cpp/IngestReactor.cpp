@@ -0,0 +1,155 @@
+//
+// IngestReactor.cpp
+//
+
+#include "IngestReactor.h"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include "helper/AndroidLogger.hpp"
+#ifdef __ANDROID__
+#include "helper/NDKThreadHelper.hpp"
+#endif
+
+// epoll user data of the wakeup eventfd, sources use their index
+static constexpr uint64_t WAKEUP_TAG = ~uint64_t{0};
+
+IngestReactor::IngestReactor(JavaVM* javaVm, std::string name, int CPUPriority, BATCH_CALLBACK onBatch)
+    : mName(std::move(name)),
+      mCPUPriority(CPUPriority),
+      onBatch(std::move(onBatch)),
+      javaVm(javaVm)
+{
+    mEpollFd  = epoll_create1(EPOLL_CLOEXEC);
+    mWakeupFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mEpollFd == -1 || mWakeupFd == -1)
+    {
+        MLOGE << "epoll / eventfd setup failed: " << strerror(errno);
+        return;
+    }
+    epoll_event event{};
+    event.events   = EPOLLIN;
+    event.data.u64 = WAKEUP_TAG;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeupFd, &event);
+}
+
+IngestReactor::~IngestReactor()
+{
+    stop();
+    if (mWakeupFd != -1) close(mWakeupFd);
+    if (mEpollFd != -1) close(mEpollFd);
+}
+
+int IngestReactor::addSource(std::string name, int socketFd, std::shared_ptr<PacketPool> pool)
+{
+    if (socketFd < 0 || mEpollFd == -1)
+    {
+        return -1;
+    }
+    fcntl(socketFd, F_SETFL, fcntl(socketFd, F_GETFL) | O_NONBLOCK);
+
+    auto source      = std::make_unique<Source>();
+    source->name     = std::move(name);
+    source->socketFd = socketFd;
+    source->pool     = std::move(pool);
+    // io_uring waits on its own, with epoll readiness recvmmsg is the right fit
+    source->engine = std::make_unique<ReceiveEngine>(socketFd, source->pool, ReceiveEngine::Backend::RECVMMSG);
+
+    const int   index = (int) mSources.size();
+    epoll_event event{};
+    event.events   = EPOLLIN;
+    event.data.u64 = (uint64_t) index;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, socketFd, &event) == -1)
+    {
+        MLOGE << "epoll_ctl(" << source->name << ") failed: " << strerror(errno);
+        source->engine.reset();
+        close(socketFd);
+        return -1;
+    }
+    MLOGD << "Ingest source " << index << ": " << source->name;
+    mSources.push_back(std::move(source));
+    return index;
+}
+
+long IngestReactor::getNReceivedBytes() const
+{
+    long total = 0;
+    for (const auto& source : mSources) total += source->nReceivedBytes;
+    return total;
+}
+
+void IngestReactor::start()
+{
+    running = true;
+    mThread = std::make_unique<std::thread>([this] { loop(); });
+#ifdef __ANDROID__
+    NDKThreadHelper::setName(mThread->native_handle(), mName.c_str());
+#endif
+}
+
+void IngestReactor::stop()
+{
+    if (mThread)
+    {
+        running            = false;
+        const uint64_t           one = 1;
+        [[maybe_unused]] ssize_t ret = write(mWakeupFd, &one, sizeof(one));
+        if (mThread->joinable()) mThread->join();
+        mThread.reset();
+    }
+    for (const auto& source : mSources)
+    {
+        if (source->socketFd == -1) continue;
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, source->socketFd, nullptr);
+        // release the receive slots before the socket goes away
+        source->engine.reset();
+        close(source->socketFd);
+        source->socketFd = -1;
+        MLOGD << "Ingest source " << source->name << ": pool high water " << source->pool->getHighWaterMark() << "/"
+              << source->pool->getNBuffers() << " exhausted " << source->pool->getNExhausted();
+    }
+}
+
+void IngestReactor::loop()
+{
+#ifdef __ANDROID__
+    if (javaVm) NDKThreadHelper::setProcessThreadPriorityAttachDetach(javaVm, mCPUPriority, mName.c_str());
+#endif
+    constexpr int MAX_EVENTS = 8;
+    epoll_event   events[MAX_EVENTS];
+    DatagramBatch batch;
+
+    while (running)
+    {
+        const int n = epoll_wait(mEpollFd, events, MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            MLOGE << "epoll_wait failed: " << strerror(errno);
+            break;
+        }
+        for (int i = 0; i < n && running; i++)
+        {
+            if (events[i].data.u64 == WAKEUP_TAG) continue;
+            Source& source = *mSources[events[i].data.u64];
+            // One batch per wakeup. epoll is level triggered, whatever is left is reported again right away.
+            const int nDatagrams = source.engine->receive(batch);
+            if (nDatagrams > 0)
+            {
+                source.nReceivedBytes += (long) batch.totalBytes();
+                mMetricPackets.add(nDatagrams);
+                mMetricBytes.add((int64_t) batch.totalBytes());
+                onBatch(events[i].data.u64, batch);
+            }
+            else if (nDatagrams < 0)
+            {
+                MLOGE << "receive on " << source.name << " failed: " << strerror(errno);
+            }
+        }
+    }
+}
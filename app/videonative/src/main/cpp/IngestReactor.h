@@ -0,0 +1,89 @@
+//
+// IngestReactor.h
+// One thread that owns every receive socket and waits on all of them with epoll, so the RTP parser and the reorder
+// queues are fed from a single thread.
+//
+
+#ifndef FPVUE_INGESTREACTOR_H
+#define FPVUE_INGESTREACTOR_H
+
+#include <jni.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Metrics.h"
+#include "PacketPool.h"
+#include "ReceiveEngine.h"
+
+class IngestReactor
+{
+  public:
+    // @param source index returned by addSource()
+    using BATCH_CALLBACK = std::function<void(size_t source, const DatagramBatch& batch)>;
+
+    /**
+     * @param javaVm used to set the thread priority on android, nullptr when priority doesn't matter
+     * @param name thread name
+     * @param CPUPriority the priority the reactor thread runs with if javaVm != nullptr
+     * @param onBatch called on the reactor thread for every batch drained from any of the sources
+     */
+    IngestReactor(JavaVM* javaVm, std::string name, int CPUPriority, BATCH_CALLBACK onBatch);
+
+    ~IngestReactor();
+
+    IngestReactor(const IngestReactor&)            = delete;
+    IngestReactor& operator=(const IngestReactor&) = delete;
+
+    /**
+     * Register a bound datagram socket. Must be called before start(). The reactor takes ownership of @param socketFd
+     * (switches it to non-blocking and closes it in stop()). Sources are drained with recvmmsg, one batch per wakeup,
+     * so a busy source cannot starve the others.
+     * @return index of the source, passed to the batch callback. -1 if @param socketFd is invalid.
+     */
+    int addSource(std::string name, int socketFd, std::shared_ptr<PacketPool> pool = PacketPool::create());
+
+    void start();
+
+    // Wakes the thread up, joins it and closes all sources
+    void stop();
+
+    size_t getNSources() const { return mSources.size(); }
+
+    const std::string& getSourceName(size_t source) const { return mSources[source]->name; }
+
+    long getNReceivedBytes(size_t source) const { return mSources[source]->nReceivedBytes; }
+
+    // sum over all sources
+    long getNReceivedBytes() const;
+
+  private:
+    void loop();
+
+    struct Source
+    {
+        std::string                    name;
+        int                            socketFd = -1;
+        std::shared_ptr<PacketPool>    pool;
+        std::unique_ptr<ReceiveEngine> engine;
+        std::atomic<long>              nReceivedBytes = 0;
+    };
+
+    const std::string                    mName;
+    const int                            mCPUPriority;
+    const BATCH_CALLBACK                 onBatch;
+    JavaVM* const                        javaVm;
+    std::vector<std::unique_ptr<Source>> mSources;
+    int                                  mEpollFd = -1;
+    Metrics::Counter&                    mMetricPackets = Metrics::global().counter("net_received_packets");
+    Metrics::Counter&                    mMetricBytes   = Metrics::global().counter("net_received_bytes");
+    // written by stop() to wake the thread up
+    int                          mWakeupFd = -1;
+    std::atomic<bool>            running   = false;
+    std::unique_ptr<std::thread> mThread;
+};
+
+#endif  // FPVUE_INGESTREACTOR_H
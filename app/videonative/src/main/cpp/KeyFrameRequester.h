@@ -0,0 +1,108 @@
+//
+// KeyFrameRequester.h
+// Asks the sender for a key frame as soon as the parser hits a sequence gap the reorder queue could not fill, instead
+// of waiting for the link layer to notice the loss. The request goes out through a plain C function pointer, so the
+// receiving side can live in another shared library (the wfb-ng link) without either one linking the other.
+// Also measures how long the picture stays broken: the time from a gap to the next key frame.
+//
+
+#ifndef FPVUE_KEYFRAMEREQUESTER_H
+#define FPVUE_KEYFRAMEREQUESTER_H
+
+#include <atomic>
+#include <chrono>
+#include "Metrics.h"
+
+class KeyFrameRequester
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+    // Must not block, it is called on the thread that parses the packets
+    using RequestFunction = void (*)(void* context);
+
+    // The sender starts a new GOP for each request, this is the most we ask for
+    static constexpr std::chrono::milliseconds DEFAULT_MIN_INTERVAL{200};
+
+    explicit KeyFrameRequester(Clock::duration minInterval = DEFAULT_MIN_INTERVAL) : mMinInterval(minInterval) {}
+
+    /**
+     * Where requests go, @param function==nullptr disables them. Call from one thread at a time, @param context has
+     * to stay valid until the requester was disabled or destroyed.
+     */
+    void setTarget(RequestFunction function, void* context)
+    {
+        mFunction.store(nullptr, std::memory_order_release);
+        mContext.store(context, std::memory_order_release);
+        mFunction.store(function, std::memory_order_release);
+    }
+
+    bool hasTarget() const { return mFunction.load(std::memory_order_acquire) != nullptr; }
+
+    /**
+     * The parser lost packets at @param now. Requests a key frame unless one was requested less than the min
+     * interval ago, a key frame already on its way repairs this gap as well.
+     * @return true if a request was sent.
+     */
+    bool onGap(Clock::time_point now)
+    {
+        Metrics::increment(mNGaps);
+        if (mGapTime == Clock::time_point{})
+        {
+            mGapTime = now;
+        }
+        const RequestFunction function = mFunction.load(std::memory_order_acquire);
+        if (function == nullptr)
+        {
+            return false;
+        }
+        if (mLastRequest != Clock::time_point{} && now - mLastRequest < mMinInterval)
+        {
+            Metrics::increment(mNRateLimited);
+            return false;
+        }
+        mLastRequest = now;
+        function(mContext.load(std::memory_order_acquire));
+        Metrics::increment(mNRequests);
+        mMetricRequests.add();
+        return true;
+    }
+
+    // A complete (not corrupted) key frame NALU arrived at @param now, the picture is clean again
+    void onKeyFrame(Clock::time_point now)
+    {
+        if (mGapTime == Clock::time_point{})
+        {
+            return;
+        }
+        const auto recoveryUs = std::chrono::duration_cast<std::chrono::microseconds>(now - mGapTime).count();
+        Metrics::increment(mRecoverySumUs, recoveryUs);
+        Metrics::increment(mNRecoveries);
+        mMetricRecovery.record(recoveryUs);
+        mGapTime = Clock::time_point{};
+    }
+
+    // Written by the parsing thread, can be read from any thread
+    long getNGaps() const { return mNGaps.load(std::memory_order_relaxed); }
+    long getNRequests() const { return mNRequests.load(std::memory_order_relaxed); }
+    long getNRateLimited() const { return mNRateLimited.load(std::memory_order_relaxed); }
+    // Gap -> next key frame, summed over all recoveries so far
+    long getRecoverySumUs() const { return mRecoverySumUs.load(std::memory_order_relaxed); }
+    long getNRecoveries() const { return mNRecoveries.load(std::memory_order_relaxed); }
+
+  private:
+    const Clock::duration        mMinInterval;
+    std::atomic<RequestFunction> mFunction{nullptr};
+    std::atomic<void*>           mContext{nullptr};
+    // Only touched by the parsing thread. mGapTime is the first gap not repaired by a key frame yet.
+    Clock::time_point mLastRequest{};
+    Clock::time_point mGapTime{};
+    std::atomic<long> mNGaps         = 0;
+    std::atomic<long> mNRequests     = 0;
+    std::atomic<long> mNRateLimited  = 0;
+    std::atomic<long> mRecoverySumUs = 0;
+    std::atomic<long> mNRecoveries   = 0;
+    Metrics::Counter&   mMetricRequests = Metrics::global().counter("keyframe_requests");
+    Metrics::Histogram& mMetricRecovery = Metrics::global().histogram("keyframe_recovery_us");
+};
+
+#endif  // FPVUE_KEYFRAMEREQUESTER_H
@@ -0,0 +1,277 @@
+//
+// MediaCodecBackend.cpp
+//
+
+#include "MediaCodecBackend.h"
+#include <android/hardware_buffer.h>
+#include <android/native_window_jni.h>
+#include <dlfcn.h>
+#include <algorithm>
+#include "helper/AndroidMediaFormatHelper.h"
+
+static_assert(IDecoderBackend::INFO_TRY_AGAIN_LATER == AMEDIACODEC_INFO_TRY_AGAIN_LATER);
+static_assert(IDecoderBackend::INFO_OUTPUT_FORMAT_CHANGED == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED);
+static_assert(IDecoderBackend::INFO_OUTPUT_BUFFERS_CHANGED == AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED);
+static_assert(IDecoderBackend::ERROR_UNKNOWN == AMEDIA_ERROR_UNKNOWN);
+static_assert(IDecoderBackend::FLAG_CODEC_CONFIG == AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG);
+static_assert(IDecoderBackend::FLAG_END_OF_STREAM == AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
+static_assert(IDecoderBackend::FLAG_PARTIAL_FRAME == AMEDIACODEC_BUFFER_FLAG_PARTIAL_FRAME);
+
+namespace
+{
+// API 28 and our minSdk is lower, so it is looked up at runtime. nullptr if the device does not have it.
+using SetAsyncNotifyCallback = media_status_t (*)(AMediaCodec*, AMediaCodecOnAsyncNotifyCallback, void*);
+
+SetAsyncNotifyCallback setAsyncNotifyCallback()
+{
+    static const auto function =
+        reinterpret_cast<SetAsyncNotifyCallback>(dlsym(RTLD_DEFAULT, "AMediaCodec_setAsyncNotifyCallback"));
+    return function;
+}
+
+// The trampolines from MediaCodec to the AsyncCodecListener of the codec
+void onAsyncInputAvailable(AMediaCodec*, void* userdata, int32_t index)
+{
+    static_cast<AsyncCodecListener*>(userdata)->onInputAvailable(index);
+}
+
+void onAsyncOutputAvailable(AMediaCodec*, void* userdata, int32_t index, AMediaCodecBufferInfo* info)
+{
+    static_cast<AsyncCodecListener*>(userdata)->onOutputAvailable(index, info->presentationTimeUs, info->flags);
+}
+
+void onAsyncFormatChanged(AMediaCodec*, void* userdata, AMediaFormat* format)
+{
+    int32_t width = 0, height = 0;
+    AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_WIDTH, &width);
+    AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_HEIGHT, &height);
+    MLOGD << "Async output format changed " << AMediaFormat_toString(format);
+    static_cast<AsyncCodecListener*>(userdata)->onFormatChanged(width, height);
+}
+
+void onAsyncError(AMediaCodec*, void* userdata, media_status_t error, int32_t actionCode, const char* detail)
+{
+    MLOGE << "Async codec error " << (int) error << " action " << actionCode << " " << (detail ? detail : "");
+    static_cast<AsyncCodecListener*>(userdata)->onError(error, actionCode);
+}
+
+// The platform software decoders, Codec2 (Android 10+) first
+AMediaCodec* createSoftwareDecoder(bool h265)
+{
+    static const char* const H264[] = {"c2.android.avc.decoder", "OMX.google.h264.decoder"};
+    static const char* const H265[] = {"c2.android.hevc.decoder", "OMX.google.hevc.decoder"};
+    for (const char* name : h265 ? H265 : H264)
+    {
+        AMediaCodec* codec = AMediaCodec_createCodecByName(name);
+        if (codec != nullptr)
+        {
+            MLOGD << "Software decoder " << name;
+            return codec;
+        }
+    }
+    return nullptr;
+}
+
+const char* statusName(media_status_t status)
+{
+    switch (status)
+    {
+        case AMEDIA_OK:
+            return "OK";
+        case AMEDIA_ERROR_UNKNOWN:
+            return "AMEDIA_ERROR_UNKNOWN";
+        case AMEDIA_ERROR_MALFORMED:
+            return "AMEDIA_ERROR_MALFORMED";
+        case AMEDIA_ERROR_UNSUPPORTED:
+            return "AMEDIA_ERROR_UNSUPPORTED";
+        case AMEDIA_ERROR_INVALID_OBJECT:
+            return "AMEDIA_ERROR_INVALID_OBJECT";
+        case AMEDIA_ERROR_INVALID_PARAMETER:
+            return "AMEDIA_ERROR_INVALID_PARAMETER";
+        default:
+            return "other error";
+    }
+}
+}  // namespace
+
+MediaCodecBackend::MediaCodecBackend(ANativeWindow* window, bool software) : mWindow(window), mSoftware(software) {}
+
+MediaCodecBackend::~MediaCodecBackend()
+{
+    release();
+    // the window of the reader goes with it
+    if (mPlaceholder) AImageReader_delete(mPlaceholder);
+    if (mWindow) ANativeWindow_release(mWindow);
+}
+
+std::unique_ptr<MediaCodecBackend> MediaCodecBackend::fromSurface(JNIEnv* env, jobject surface, bool software)
+{
+    ANativeWindow* window = ANativeWindow_fromSurface(env, surface);
+    if (window == nullptr) return nullptr;
+    return std::make_unique<MediaCodecBackend>(window, software);
+}
+
+bool MediaCodecBackend::create(bool h265)
+{
+    release();
+    if (mSoftware) mCodec = createSoftwareDecoder(h265);
+    // without a software decoder the default one is better than none
+    if (mCodec == nullptr) mCodec = AMediaCodec_createDecoderByType(h265 ? "video/hevc" : "video/avc");
+    return mCodec != nullptr;
+}
+
+void MediaCodecBackend::release()
+{
+    if (mCodec == nullptr) return;
+    AMediaCodec_delete(mCodec);
+    mCodec = nullptr;
+}
+
+bool MediaCodecBackend::setAsyncListener(AsyncCodecListener* listener)
+{
+    const SetAsyncNotifyCallback setCallback = setAsyncNotifyCallback();
+    if (setCallback == nullptr)
+    {
+        MLOGD << "Async codec mode needs Android 9";
+        return false;
+    }
+    AMediaCodecOnAsyncNotifyCallback callback{};
+    callback.onAsyncInputAvailable  = onAsyncInputAvailable;
+    callback.onAsyncOutputAvailable = onAsyncOutputAvailable;
+    callback.onAsyncFormatChanged   = onAsyncFormatChanged;
+    callback.onAsyncError           = onAsyncError;
+    return setCallback(mCodec, callback, listener) == AMEDIA_OK;
+}
+
+bool MediaCodecBackend::configure(const DecoderConfig& config)
+{
+    AMediaFormat* format = AMediaFormat_new();
+    AMediaFormat_setString(format, AMEDIAFORMAT_KEY_MIME, config.h265 ? "video/hevc" : "video/avc");
+
+    // AMediaFormat_setInt32(format, "low-latency", 1);
+    // AMediaFormat_setInt32(format, "vendor.low-latency.enable", 1);
+    // AMediaFormat_setInt32(format, "vendor.qti-ext-dec-low-latency.enable", 1);
+    // AMediaFormat_setInt32(format, "vendor.hisi-ext-low-latency-video-dec.video-scene-for-low-latency-req", 1);
+    // AMediaFormat_setInt32(format, "vendor.rtc-ext-dec-low-latency.enable", 1);
+
+    // MediaCodec supports two priorities: 0 - realtime, 1 - best effort
+    // AMediaFormat_setInt32(format, "priority", 0);
+
+    if (config.h265)
+    {
+        h265_configureAMediaFormat(config, format);
+    }
+    else
+    {
+        h264_configureAMediaFormat(config, format);
+    }
+    mWidth  = config.format.width;
+    mHeight = config.format.height;
+    MLOGD << "Configuring decoder:" << AMediaFormat_toString(format);
+    const auto status = AMediaCodec_configure(mCodec, format, mWindow, nullptr, 0);
+    AMediaFormat_delete(format);
+    MLOGD << "AMediaCodec_configure: " << statusName(status);
+    return status == AMEDIA_OK;
+}
+
+bool MediaCodecBackend::start()
+{
+    return AMediaCodec_start(mCodec) == AMEDIA_OK;
+}
+
+bool MediaCodecBackend::stop()
+{
+    return AMediaCodec_stop(mCodec) == AMEDIA_OK;
+}
+
+bool MediaCodecBackend::flush()
+{
+    const auto status = AMediaCodec_flush(mCodec);
+    MLOGD << "AMediaCodec_flush: " << statusName(status);
+    return status == AMEDIA_OK;
+}
+
+ssize_t MediaCodecBackend::dequeueInputBuffer(int64_t timeoutUs)
+{
+    return AMediaCodec_dequeueInputBuffer(mCodec, timeoutUs);
+}
+
+uint8_t* MediaCodecBackend::getInputBuffer(size_t index, size_t& capacity)
+{
+    return AMediaCodec_getInputBuffer(mCodec, index, &capacity);
+}
+
+bool MediaCodecBackend::queueInputBuffer(size_t index, size_t size, uint64_t presentationTimeUs, uint32_t flags)
+{
+    return AMediaCodec_queueInputBuffer(mCodec, index, 0, size, presentationTimeUs, flags) == AMEDIA_OK;
+}
+
+ssize_t MediaCodecBackend::dequeueOutputBuffer(OutputInfo& info, int64_t timeoutUs)
+{
+    AMediaCodecBufferInfo bufferInfo{};
+    const ssize_t         index = AMediaCodec_dequeueOutputBuffer(mCodec, &bufferInfo, timeoutUs);
+    info.presentationTimeUs     = bufferInfo.presentationTimeUs;
+    info.flags                  = bufferInfo.flags;
+    info.size                   = (size_t) bufferInfo.size;
+    return index;
+}
+
+void MediaCodecBackend::releaseOutputBuffer(size_t index, bool render)
+{
+    // the timestamp for releasing the buffer is in NS, just release as fast as possible (e.g. now)
+    // https://android.googlesource.com/platform/frameworks/av/+/master/media/ndk/NdkMediaCodec.cpp
+    //-> renderOutputBufferAndRelease which is in
+    // https://android.googlesource.com/platform/frameworks/av/+/3fdb405/media/libstagefright/MediaCodec.cpp
+    //-> Message kWhatReleaseOutputBuffer -> onReleaseOutputBuffer
+    //  also https://android.googlesource.com/platform/frameworks/native/+/5c1139f/libs/gui/SurfaceTexture.cpp
+    AMediaCodec_releaseOutputBuffer(mCodec, index, render);
+}
+
+void MediaCodecBackend::getOutputSize(int32_t& width, int32_t& height)
+{
+    AMediaFormat* format = AMediaCodec_getOutputFormat(mCodec);
+    AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_WIDTH, &width);
+    AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_HEIGHT, &height);
+    MLOGD << "AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED " << width << " " << height << " "
+          << AMediaFormat_toString(format);
+    AMediaFormat_delete(format);
+}
+
+bool MediaCodecBackend::setOutputSurface(IDecoderBackend* surface)
+{
+    // the backends of one decoder are all of the same kind
+    auto*          other  = static_cast<MediaCodecBackend*>(surface);
+    ANativeWindow* window = other != nullptr ? other->mWindow : placeholderWindow();
+    if (mCodec == nullptr || window == nullptr) return false;
+    const auto status = AMediaCodec_setOutputSurface(mCodec, window);
+    MLOGD << "AMediaCodec_setOutputSurface " << (other != nullptr ? "" : "(placeholder) ") << statusName(status);
+    if (status != AMEDIA_OK) return false;
+    if (mWindow) ANativeWindow_release(mWindow);
+    mWindow = nullptr;
+    if (other != nullptr) std::swap(mWindow, other->mWindow);
+    return true;
+}
+
+ANativeWindow* MediaCodecBackend::placeholderWindow()
+{
+    if (mPlaceholder == nullptr)
+    {
+        // private format, the codec renders into it as into any other surface without a conversion
+        const auto status = AImageReader_newWithUsage(
+            std::max(mWidth, 16),
+            std::max(mHeight, 16),
+            AIMAGE_FORMAT_PRIVATE,
+            AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE,
+            2,
+            &mPlaceholder);
+        if (status != AMEDIA_OK)
+        {
+            MLOGE << "Cannot create the placeholder surface " << statusName(status);
+            mPlaceholder = nullptr;
+            return nullptr;
+        }
+    }
+    ANativeWindow* window = nullptr;
+    AImageReader_getWindow(mPlaceholder, &window);
+    return window;
+}
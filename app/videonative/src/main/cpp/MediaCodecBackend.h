@@ -0,0 +1,74 @@
+//
+// MediaCodecBackend.h
+// The decoder backend on Android: an AMediaCodec that renders into the ANativeWindow of a surface. Either the
+// default (hardware) decoder for the mime type or, if requested, the software decoder of the platform.
+//
+
+#ifndef FPVUE_MEDIACODECBACKEND_H
+#define FPVUE_MEDIACODECBACKEND_H
+
+#include <android/native_window.h>
+#include <jni.h>
+#include <media/NdkImageReader.h>
+#include <media/NdkMediaCodec.h>
+#include <memory>
+#include "DecoderBackend.h"
+
+class MediaCodecBackend : public IDecoderBackend
+{
+  public:
+    // Takes over @param window. @param software: use the platform software decoder instead of the default one.
+    MediaCodecBackend(ANativeWindow* window, bool software);
+
+    ~MediaCodecBackend() override;
+
+    // The backend for the output @param surface, nullptr if it has no native window
+    static std::unique_ptr<MediaCodecBackend> fromSurface(JNIEnv* env, jobject surface, bool software);
+
+    const char* name() const override { return mSoftware ? "MediaCodec (sw)" : "MediaCodec"; }
+
+    bool create(bool h265) override;
+
+    bool isCreated() const override { return mCodec != nullptr; }
+
+    void release() override;
+
+    bool setAsyncListener(AsyncCodecListener* listener) override;
+
+    bool configure(const DecoderConfig& config) override;
+
+    bool start() override;
+
+    bool stop() override;
+
+    bool flush() override;
+
+    ssize_t dequeueInputBuffer(int64_t timeoutUs) override;
+
+    uint8_t* getInputBuffer(size_t index, size_t& capacity) override;
+
+    bool queueInputBuffer(size_t index, size_t size, uint64_t presentationTimeUs, uint32_t flags) override;
+
+    ssize_t dequeueOutputBuffer(OutputInfo& info, int64_t timeoutUs) override;
+
+    void releaseOutputBuffer(size_t index, bool render) override;
+
+    void getOutputSize(int32_t& width, int32_t& height) override;
+
+    // AMediaCodec_setOutputSurface(), @param surface has to be a MediaCodecBackend as well
+    bool setOutputSurface(IDecoderBackend* surface) override;
+
+  private:
+    // The window of mPlaceholder, created on first use. nullptr if it cannot be created.
+    ANativeWindow* placeholderWindow();
+
+    ANativeWindow* mWindow = nullptr;
+    AMediaCodec*   mCodec  = nullptr;
+    const bool     mSoftware;
+    // Where a parked codec renders to (nothing is ever rendered there), and the size it is created with
+    AImageReader* mPlaceholder = nullptr;
+    int32_t       mWidth       = 0;
+    int32_t       mHeight      = 0;
+};
+
+#endif  // FPVUE_MEDIACODECBACKEND_H
@@ -0,0 +1,238 @@
+//
+// Metrics.cpp
+//
+
+#include "Metrics.h"
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include "helper/AndroidLogger.hpp"
+
+namespace
+{
+std::atomic<size_t> nextShard{0};
+
+// Highest bit set, value != 0
+int highestBit(uint64_t value) { return 63 - __builtin_clzll(value); }
+
+// How long the endpoint waits for a client before it looks at the stop flag again
+constexpr int POLL_TIMEOUT_MS = 200;
+}  // namespace
+
+size_t Metrics::shard()
+{
+    thread_local const size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % N_SHARDS;
+    return shard;
+}
+
+int64_t Metrics::Counter::value() const
+{
+    int64_t sum = 0;
+    for (const Shard& shard : mShards) sum += shard.value.load(std::memory_order_relaxed);
+    return sum;
+}
+
+size_t Metrics::Histogram::bucketOf(uint64_t value)
+{
+    constexpr uint64_t SUB = 1 << SUB_BITS;
+    if (value < SUB) return (size_t) value;
+    // value >> shift is in [SUB, 2 * SUB)
+    const int    shift  = highestBit(value) - SUB_BITS;
+    const size_t bucket = (size_t) (shift + 1) * SUB + (size_t) ((value >> shift) - SUB);
+    return std::min(bucket, N_BUCKETS - 1);
+}
+
+uint64_t Metrics::Histogram::upperBoundOf(size_t bucket)
+{
+    constexpr uint64_t SUB = 1 << SUB_BITS;
+    if (bucket < SUB) return bucket;
+    const size_t shift = bucket / SUB - 1;
+    return ((SUB + bucket % SUB + 1) << shift) - 1;
+}
+
+void Metrics::Histogram::record(int64_t value)
+{
+    value        = std::max<int64_t>(value, 0);
+    Shard& shard = mShards[Metrics::shard()];
+    shard.buckets[bucketOf((uint64_t) value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+    int64_t max = shard.max.load(std::memory_order_relaxed);
+    // only retried while another thread on the same shard raised the max
+    while (value > max && !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+    // last, a reader that sees the count sees the bucket as well (or one more in the buckets than in count)
+    shard.count.fetch_add(1, std::memory_order_release);
+}
+
+Metrics::Histogram::Summary Metrics::Histogram::summary() const
+{
+    Summary summary;
+    int64_t buckets[N_BUCKETS] = {};
+    for (size_t i = 0; i < N_SHARDS; i++)
+    {
+        const Shard& shard = mShards[i];
+        summary.count += shard.count.load(std::memory_order_acquire);
+        summary.sum += shard.sum.load(std::memory_order_relaxed);
+        summary.max = std::max(summary.max, shard.max.load(std::memory_order_relaxed));
+        for (size_t bucket = 0; bucket < N_BUCKETS; bucket++)
+        {
+            buckets[bucket] += shard.buckets[bucket].load(std::memory_order_relaxed);
+        }
+    }
+    const std::pair<double, int64_t*> percentiles[] = {
+        {0.50, &summary.p50}, {0.95, &summary.p95}, {0.99, &summary.p99}};
+    for (const auto& percentile : percentiles)
+    {
+        // the rank of the percentile among count values, 1 based
+        const int64_t rank  = std::max<int64_t>((int64_t) (percentile.first * (double) summary.count + 0.5), 1);
+        int64_t       below = 0;
+        for (size_t bucket = 0; bucket < N_BUCKETS && summary.count > 0; bucket++)
+        {
+            below += buckets[bucket];
+            if (below >= rank)
+            {
+                *percentile.second = std::min((int64_t) upperBoundOf(bucket), summary.max);
+                break;
+            }
+        }
+    }
+    return summary;
+}
+
+Metrics& Metrics::global()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Counter& Metrics::counter(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::unique_ptr<Counter>&   counter = mCounters[name];
+    if (counter == nullptr) counter = std::make_unique<Counter>();
+    return *counter;
+}
+
+Metrics::Gauge& Metrics::gauge(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::unique_ptr<Gauge>&     gauge = mGauges[name];
+    if (gauge == nullptr) gauge = std::make_unique<Gauge>();
+    return *gauge;
+}
+
+Metrics::Histogram& Metrics::histogram(const std::string& name)
+{
+    std::lock_guard<std::mutex>  lock(mMutex);
+    std::unique_ptr<Histogram>& histogram = mHistograms[name];
+    if (histogram == nullptr) histogram = std::make_unique<Histogram>();
+    return *histogram;
+}
+
+Metrics::Snapshot Metrics::snapshot() const
+{
+    Snapshot                    snapshot;
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& counter : mCounters) snapshot.counters.emplace_back(counter.first, counter.second->value());
+    for (const auto& gauge : mGauges) snapshot.gauges.emplace_back(gauge.first, gauge.second->value());
+    for (const auto& histogram : mHistograms)
+    {
+        snapshot.histograms.emplace_back(histogram.first, histogram.second->summary());
+    }
+    return snapshot;
+}
+
+std::string Metrics::Snapshot::toText() const
+{
+    std::ostringstream text;
+    for (const auto& counter : counters)
+    {
+        text << "# TYPE " << counter.first << " counter\n" << counter.first << " " << counter.second << "\n";
+    }
+    for (const auto& gauge : gauges)
+    {
+        text << "# TYPE " << gauge.first << " gauge\n" << gauge.first << " " << gauge.second << "\n";
+    }
+    for (const auto& histogram : histograms)
+    {
+        const std::string&        name    = histogram.first;
+        const Histogram::Summary& summary = histogram.second;
+        text << "# TYPE " << name << " summary\n";
+        text << name << "{quantile=\"0.5\"} " << summary.p50 << "\n";
+        text << name << "{quantile=\"0.95\"} " << summary.p95 << "\n";
+        text << name << "{quantile=\"0.99\"} " << summary.p99 << "\n";
+        text << name << "_sum " << summary.sum << "\n";
+        text << name << "_count " << summary.count << "\n";
+        text << "# TYPE " << name << "_max gauge\n" << name << "_max " << summary.max << "\n";
+    }
+    return text.str();
+}
+
+MetricsEndpoint::MetricsEndpoint(const Metrics& metrics, uint16_t port) : mMetrics(metrics)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+    {
+        MLOGE << "Metrics endpoint: cannot create socket " << strerror(errno);
+        return;
+    }
+    const int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address{};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length        = sizeof(address);
+    if (bind(fd, (sockaddr*) &address, sizeof(address)) == -1 || listen(fd, 4) == -1 ||
+        getsockname(fd, (sockaddr*) &address, &length) == -1)
+    {
+        MLOGE << "Metrics endpoint: cannot listen on port " << port << " " << strerror(errno);
+        close(fd);
+        return;
+    }
+    mSocket = fd;
+    mPort   = ntohs(address.sin_port);
+    MLOGD << "Metrics on 127.0.0.1:" << mPort;
+    mThread = std::thread(&MetricsEndpoint::serveLoop, this);
+}
+
+MetricsEndpoint::~MetricsEndpoint()
+{
+    mStop = true;
+    if (mThread.joinable()) mThread.join();
+    if (mSocket != -1) close(mSocket);
+}
+
+void MetricsEndpoint::serveLoop()
+{
+    while (!mStop)
+    {
+        pollfd pfd{mSocket, POLLIN, 0};
+        if (poll(&pfd, 1, POLL_TIMEOUT_MS) <= 0) continue;
+        const int client = accept(mSocket, nullptr, nullptr);
+        if (client == -1) continue;
+        // the request itself does not matter, whatever the client asks for it gets the snapshot
+        char request[1024];
+        (void) recv(client, request, sizeof(request), MSG_DONTWAIT);
+        const std::string  body = mMetrics.snapshot().toText();
+        std::ostringstream response;
+        response << "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " << body.size()
+                 << "\r\n\r\n"
+                 << body;
+        const std::string data = response.str();
+        for (size_t sent = 0; sent < data.size();)
+        {
+            const ssize_t n = send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent += (size_t) n;
+        }
+        close(client);
+    }
+}
@@ -0,0 +1,189 @@
+//
+// Metrics.h
+// Registry of the pipeline metrics: counters, gauges and latency histograms, found by name. A module looks its
+// metrics up once and keeps the reference, they live as long as the registry. Recording takes no locks and does not
+// allocate: relaxed atomic adds, spread over shards so that threads do not fight over a cache line. The adds are
+// wait-free. The max of a histogram is only lock-free: a CAS that retries while other threads of the same shard raise
+// it, so a thread can in theory be held up by a stream of larger values.
+// snapshot() reads all metrics in one pass, for JNI or the loopback text endpoint (MetricsEndpoint). Each metric is
+// read on its own, not all of them at one instant.
+//
+
+#ifndef FPVUE_METRICS_H
+#define FPVUE_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class Metrics
+{
+  public:
+    // Threads are spread over the shards round-robin, more threads than shards share them
+    static constexpr size_t N_SHARDS = 8;
+
+    // Monotonic, summed over the shards when read
+    class Counter
+    {
+      public:
+        void add(int64_t n = 1) { mShards[shard()].value.fetch_add(n, std::memory_order_relaxed); }
+
+        int64_t value() const;
+
+      private:
+        struct alignas(64) Shard
+        {
+            std::atomic<int64_t> value{0};
+        };
+
+        Shard mShards[N_SHARDS];
+    };
+
+    // The last value set
+    class Gauge
+    {
+      public:
+        void set(int64_t value) { mValue.store(value, std::memory_order_relaxed); }
+
+        int64_t value() const { return mValue.load(std::memory_order_relaxed); }
+
+      private:
+        alignas(64) std::atomic<int64_t> mValue{0};
+    };
+
+    /**
+     * Log-linear histogram of non-negative values (latencies in us). Values below 2^SUB_BITS get a bucket each,
+     * above that every power of two is split into 2^SUB_BITS buckets, a percentile is off by less than 1/2^SUB_BITS.
+     * Values of 2^MAX_BITS and more land in the last bucket.
+     */
+    class Histogram
+    {
+      public:
+        static constexpr int    SUB_BITS  = 3;
+        static constexpr int    MAX_BITS  = 36;
+        static constexpr size_t N_BUCKETS = (size_t) (MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+        struct Summary
+        {
+            int64_t count = 0;
+            int64_t sum   = 0;
+            int64_t max   = 0;
+            // upper bound of the bucket the percentile falls into, at most max
+            int64_t p50 = 0;
+            int64_t p95 = 0;
+            int64_t p99 = 0;
+
+            double avg() const { return count == 0 ? 0 : (double) sum / (double) count; }
+        };
+
+        // Wait-free but for the max, see the top of the file
+        void record(int64_t value);
+
+        template <typename Rep, typename Period>
+        void record(std::chrono::duration<Rep, Period> duration)
+        {
+            record((int64_t) std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+        }
+
+        Summary summary() const;
+
+        static size_t bucketOf(uint64_t value);
+
+        // The largest value that goes into @param bucket
+        static uint64_t upperBoundOf(size_t bucket);
+
+      private:
+        struct alignas(64) Shard
+        {
+            std::atomic<int64_t> count{0};
+            std::atomic<int64_t> sum{0};
+            std::atomic<int64_t> max{0};
+            std::atomic<int64_t> buckets[N_BUCKETS]{};
+        };
+
+        std::unique_ptr<Shard[]> mShards = std::make_unique<Shard[]>(N_SHARDS);
+    };
+
+    // All metrics as snapshot() read them, sorted by name
+    struct Snapshot
+    {
+        std::vector<std::pair<std::string, int64_t>>            counters;
+        std::vector<std::pair<std::string, int64_t>>            gauges;
+        std::vector<std::pair<std::string, Histogram::Summary>> histograms;
+
+        // Prometheus text format, the histograms as summaries with their p50 / p95 / p99 and max
+        std::string toText() const;
+    };
+
+    // The one all modules of the pipeline register into
+    static Metrics& global();
+
+    // The metric called @param name, created on first use. Names follow the Prometheus rules ([a-z_][a-z0-9_]*).
+    Counter&   counter(const std::string& name);
+    Gauge&     gauge(const std::string& name);
+    Histogram& histogram(const std::string& name);
+
+    /**
+     * Each metric in the snapshot is consistent with itself, not with the others: an event that was counted by one
+     * metric may be missing from another one that was read before it.
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * For the counts a module keeps next to its metrics, per instance: adds @param n to @param counter, which only
+     * one thread writes. A plain load + store, without the locked read-modify-write of fetch_add().
+     */
+    static void increment(std::atomic<long>& counter, long n = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+  private:
+    static size_t shard();
+
+    // Only locked to add a metric and for a snapshot, never while recording
+    mutable std::mutex                                mMutex;
+    std::map<std::string, std::unique_ptr<Counter>>   mCounters;
+    std::map<std::string, std::unique_ptr<Gauge>>     mGauges;
+    std::map<std::string, std::unique_ptr<Histogram>> mHistograms;
+};
+
+/**
+ * Serves Metrics::snapshot() as text on 127.0.0.1:port, to every client that connects (curl, a browser, a Prometheus
+ * scraper over adb forward). One request at a time, on its own thread.
+ */
+class MetricsEndpoint
+{
+  public:
+    // @param port 0 lets the system pick one, see getPort()
+    MetricsEndpoint(const Metrics& metrics, uint16_t port);
+
+    ~MetricsEndpoint();
+
+    MetricsEndpoint(const MetricsEndpoint&)            = delete;
+    MetricsEndpoint& operator=(const MetricsEndpoint&) = delete;
+
+    // False if the port could not be bound
+    bool isListening() const { return mSocket != -1; }
+
+    uint16_t getPort() const { return mPort; }
+
+  private:
+    void serveLoop();
+
+    const Metrics&    mMetrics;
+    int               mSocket = -1;
+    uint16_t          mPort   = 0;
+    std::atomic<bool> mStop{false};
+    std::thread       mThread;
+};
+
+#endif  // FPVUE_METRICS_H
@@ -0,0 +1,152 @@
+//
+// BitStream.hpp
+// MSB-first bit reader / writer for unescaped RBSP data, with the Exp-Golomb codes (ue(v) / se(v)) of H.264 / H.265.
+// Reading past the end yields zeros and sets overrun() instead of failing, the caller checks once at the end.
+//
+
+#ifndef FPVUE_BITSTREAM_HPP
+#define FPVUE_BITSTREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BitReader
+{
+  public:
+    BitReader(const uint8_t* data, size_t size) : m_data(data), m_size_bits(size * 8) {}
+
+    explicit BitReader(const std::vector<uint8_t>& data) : BitReader(data.data(), data.size()) {}
+
+    // u(n), n <= 32
+    uint32_t read_bits(int n)
+    {
+        uint32_t ret = 0;
+        for (int i = 0; i < n; i++)
+        {
+            ret = (ret << 1) | read_bit();
+        }
+        return ret;
+    }
+
+    bool read_flag() { return read_bit() != 0; }
+
+    // ue(v)
+    uint32_t read_ue()
+    {
+        int leading_zeros = 0;
+        while (read_bit() == 0)
+        {
+            if (m_overrun || ++leading_zeros > 31)
+            {
+                m_overrun = true;
+                return 0;
+            }
+        }
+        if (leading_zeros == 0) return 0;
+        return ((1u << leading_zeros) - 1) + read_bits(leading_zeros);
+    }
+
+    // se(v)
+    int32_t read_se()
+    {
+        const uint32_t code = read_ue();
+        return (code & 1) ? (int32_t) ((code + 1) / 2) : -(int32_t) (code / 2);
+    }
+
+    void skip_bits(size_t n)
+    {
+        m_pos += n;
+        if (m_pos > m_size_bits)
+        {
+            m_pos     = m_size_bits;
+            m_overrun = true;
+        }
+    }
+
+    // position in bits from the start
+    size_t position() const { return m_pos; }
+
+    size_t bits_left() const { return m_size_bits - m_pos; }
+
+    // true if more bits were read than there are
+    bool overrun() const { return m_overrun; }
+
+  private:
+    uint32_t read_bit()
+    {
+        if (m_pos >= m_size_bits)
+        {
+            m_overrun = true;
+            return 0;
+        }
+        const uint32_t bit = (m_data[m_pos / 8] >> (7 - m_pos % 8)) & 1;
+        m_pos++;
+        return bit;
+    }
+
+    const uint8_t* m_data;
+    size_t         m_size_bits;
+    size_t         m_pos     = 0;
+    bool           m_overrun = false;
+};
+
+class BitWriter
+{
+  public:
+    // u(n), n <= 32
+    void write_bits(uint32_t value, int n)
+    {
+        for (int i = n - 1; i >= 0; i--)
+        {
+            write_bit((value >> i) & 1);
+        }
+    }
+
+    void write_flag(bool flag) { write_bit(flag ? 1 : 0); }
+
+    // ue(v)
+    void write_ue(uint32_t value)
+    {
+        const uint64_t code = (uint64_t) value + 1;
+        int            bits = 0;
+        while ((code >> bits) > 1) bits++;
+        write_bits(0, bits);
+        // the leading 1 and the remaining bits, in two parts since the code can have 33 bits
+        write_bit(1);
+        write_bits((uint32_t) (code & ((1ull << bits) - 1)), bits);
+    }
+
+    // Bits [from, to) of @param data
+    void copy_bits(const uint8_t* data, size_t from, size_t to)
+    {
+        for (size_t pos = from; pos < to; pos++)
+        {
+            write_bit((data[pos / 8] >> (7 - pos % 8)) & 1);
+        }
+    }
+
+    // rbsp_trailing_bits(): the stop bit, then zeros up to the next byte
+    void write_trailing_bits()
+    {
+        write_bit(1);
+        while (m_pos % 8 != 0) write_bit(0);
+    }
+
+    size_t position() const { return m_pos; }
+
+    const std::vector<uint8_t>& data() const { return m_data; }
+
+  private:
+    void write_bit(uint32_t bit)
+    {
+        if (m_pos % 8 == 0) m_data.push_back(0);
+        m_data.back() |= (uint8_t) (bit << (7 - m_pos % 8));
+        m_pos++;
+    }
+
+    std::vector<uint8_t> m_data;
+    size_t               m_pos = 0;
+};
+
+#endif  // FPVUE_BITSTREAM_HPP
@@ -0,0 +1,132 @@
+//
+// FragmentedNALU.hpp
+// A NALU that is still scattered over the RTP packets it arrived in: a list of (pointer, length) segments into the
+// pooled packet buffers, which stay referenced until the NALU is cleared. The few bytes no packet holds (start code,
+// reconstructed FU NAL unit header) are kept in a small inline buffer. gather() writes the NALU into its final
+// destination, the only time the payload is copied.
+//
+
+#ifndef FPVUE_FRAGMENTEDNALU_HPP
+#define FPVUE_FRAGMENTEDNALU_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../PacketPool.h"
+
+class FragmentedNALU
+{
+  public:
+    // The first bytes are also kept contiguous: the start code, the NAL unit header and the start of a slice header
+    static constexpr size_t HEAD_SIZE = 32;
+
+    FragmentedNALU() = default;
+
+    // Drop all segments and the packet references, keeps the capacity of the containers
+    void clear()
+    {
+        mSegments.clear();
+        mOwners.clear();
+        mInline.clear();
+        mSize     = 0;
+        mHeadSize = 0;
+    }
+
+    // Append a copy of @param data, for bytes no packet buffer holds (e.g. start code, reconstructed NAL header)
+    void appendCopy(const uint8_t* data, size_t length)
+    {
+        if (length == 0) return;
+        appendHead(data, length);
+        const auto offset = static_cast<uint32_t>(mInline.size());
+        mInline.insert(mInline.end(), data, data + length);
+        if (!mSegments.empty() && mSegments.back().data == nullptr &&
+            mSegments.back().offset + mSegments.back().length == offset)
+        {
+            mSegments.back().length += static_cast<uint32_t>(length);
+        }
+        else
+        {
+            mSegments.push_back({nullptr, offset, static_cast<uint32_t>(length)});
+        }
+        mSize += length;
+    }
+
+    void appendCopy(uint8_t byte) { appendCopy(&byte, 1); }
+
+    // Append @param length bytes at @param data, which lie inside the buffer of @param owner. No copy is made, the
+    // buffer is kept alive instead.
+    void appendRef(const PacketRef& owner, const uint8_t* data, size_t length)
+    {
+        if (length == 0) return;
+        appendHead(data, length);
+        if (mOwners.empty() || mOwners.back().data() != owner.data())
+        {
+            mOwners.push_back(owner);
+        }
+        if (!mSegments.empty() && mSegments.back().data != nullptr &&
+            mSegments.back().data + mSegments.back().length == data)
+        {
+            mSegments.back().length += static_cast<uint32_t>(length);
+        }
+        else
+        {
+            mSegments.push_back({data, 0, static_cast<uint32_t>(length)});
+        }
+        mSize += length;
+    }
+
+    // Total size of the NALU
+    size_t size() const { return mSize; }
+
+    bool empty() const { return mSize == 0; }
+
+    // The first min(size(), HEAD_SIZE) bytes of the NALU, contiguous
+    const uint8_t* head() const { return mHead; }
+
+    size_t headSize() const { return mHeadSize; }
+
+    size_t getNSegments() const { return mSegments.size(); }
+
+    // Number of packet buffers referenced
+    size_t getNPackets() const { return mOwners.size(); }
+
+    // Write the whole NALU to @param dst, which must hold size() bytes
+    void gather(uint8_t* dst) const
+    {
+        for (const Segment& segment : mSegments)
+        {
+            const uint8_t* src = segment.data != nullptr ? segment.data : mInline.data() + segment.offset;
+            std::memcpy(dst, src, segment.length);
+            dst += segment.length;
+        }
+    }
+
+  private:
+    struct Segment
+    {
+        // nullptr if the bytes are in mInline at offset
+        const uint8_t* data;
+        uint32_t       offset;
+        uint32_t       length;
+    };
+
+    void appendHead(const uint8_t* data, size_t length)
+    {
+        if (mHeadSize == HEAD_SIZE) return;
+        const size_t n = std::min(length, HEAD_SIZE - mHeadSize);
+        std::memcpy(mHead + mHeadSize, data, n);
+        mHeadSize += n;
+    }
+
+    std::vector<Segment>   mSegments;
+    std::vector<PacketRef> mOwners;
+    std::vector<uint8_t>   mInline;
+    size_t                 mSize     = 0;
+    size_t                 mHeadSize = 0;
+    uint8_t                mHead[HEAD_SIZE]{};
+};
+
+#endif  // FPVUE_FRAGMENTEDNALU_HPP
@@ -5,22 +5,87 @@
 #ifndef FPVUE_H264_H
 #define FPVUE_H264_H
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "BitStream.hpp"
 #include "NALUnitType.hpp"
 
 // namespaces for H264 H265 helper
 // A H265 NALU is kind of similar to a H264 NALU in that it has the same [0,0,0,1] prefix
 
+// What the decoder needs to know about the stream before the first frame, from the SPS
+struct VideoFormat
+{
+    int width  = 0;
+    int height = 0;
+    // profile_idc (H264) / general_profile_idc (H265)
+    int profile = 0;
+    // level_idc (H264: 10 * level) / general_level_idc (H265: 30 * level)
+    int  level        = 0;
+    bool highTier     = false;
+    int  chromaFormat = 1;
+    int  bitDepth     = 8;
+
+    // Input buffer size that holds any coded frame: half the size of the decoded frame, the minimum compression ratio
+    // MediaCodec assumes by default.
+    int maxInputSize() const
+    {
+        const int alignedW = (width + 15) / 16 * 16;
+        const int alignedH = (height + 15) / 16 * 16;
+        // chroma samples per 4 luma samples: 4:0:0 0, 4:2:0 2, 4:2:2 4, 4:4:4 8
+        static constexpr int CHROMA[] = {0, 2, 4, 8};
+        const int            samples  = alignedW * alignedH * (4 + CHROMA[chromaFormat & 3]) / 4;
+        return samples * (bitDepth > 8 ? 2 : 1) / 2;
+    }
+
+    bool operator==(const VideoFormat& o) const
+    {
+        return width == o.width && height == o.height && profile == o.profile && level == o.level &&
+               highTier == o.highTier && chromaFormat == o.chromaFormat && bitDepth == o.bitDepth;
+    }
+
+    bool operator!=(const VideoFormat& o) const { return !(*this == o); }
+
+    std::string asString() const
+    {
+        std::stringstream ss;
+        ss << width << "x" << height << " profile:" << profile << " level:" << level << (highTier ? " high tier" : "")
+           << " chroma:" << chromaFormat << " bit depth:" << bitDepth << " max input size:" << maxInputSize();
+        return ss.str();
+    }
+};
+
 namespace RBSPHelper
 {
 // The rbsp buffer starts after 5 bytes for h264 (4 bytes prefix and 1 byte unit header)
 // and after 6 bytes for h265 (4 bytes prefix and 2 byte unit header)
-// the h264bitstream nal_to_rbsp function is buggy !
-// Also, its implementation unescapes the NAL unit header which is wrong (only the payload should be unescaped)
+// Only the payload is escaped, not the NAL unit header.
 // escaping/unescaping rbsp is the same for h264 and h265
 
+// Remove the emulation prevention bytes (0x000003 -> 0x0000)
 static std::vector<uint8_t> unescapeRbsp(const uint8_t* rbsp_buff, const std::size_t rbsp_buff_size)
 {
-    auto ret = h265nal::UnescapeRbsp(rbsp_buff, rbsp_buff_size);
+    std::vector<uint8_t> ret;
+    ret.reserve(rbsp_buff_size);
+    int zeros = 0;
+    for (std::size_t i = 0; i < rbsp_buff_size; i++)
+    {
+        const uint8_t byte = rbsp_buff[i];
+        if (zeros >= 2 && byte == 3)
+        {
+            zeros = 0;
+            continue;
+        }
+        zeros = byte == 0 ? zeros + 1 : 0;
+        ret.push_back(byte);
+    }
     return ret;
 }
 
@@ -29,34 +94,61 @@ static std::vector<uint8_t> unescapeRbsp(const std::vector<uint8_t>& rbspData)
     return unescapeRbsp(rbspData.data(), rbspData.size());
 }
 
+// Insert an emulation prevention byte wherever two zero bytes are followed by a byte <= 3
 static std::vector<uint8_t> escapeRbsp(const std::vector<uint8_t>& rbspBuff)
 {
-    std::vector<uint8_t> rbspBuffEscaped;
-    rbspBuffEscaped.resize(rbspBuff.size() + 32);
-    int  rbspSize            = rbspBuff.size();
-    int  rbspBuffEscapedSize = rbspBuffEscaped.size();
-    auto tmp                 = rbsp_to_nal(rbspBuff.data(), &rbspSize, rbspBuffEscaped.data(), &rbspBuffEscapedSize);
-    assert(tmp > 0);
-    rbspBuffEscaped.resize(tmp);
-    // workaround h264bitstream library
-    return std::vector<uint8_t>(&rbspBuffEscaped.data()[1], &rbspBuffEscaped.data()[1] + rbspBuffEscaped.size() - 1);
+    std::vector<uint8_t> ret;
+    ret.reserve(rbspBuff.size() + rbspBuff.size() / 64 + 1);
+    int zeros = 0;
+    for (const uint8_t byte : rbspBuff)
+    {
+        if (zeros >= 2 && byte <= 3)
+        {
+            ret.push_back(3);
+            zeros = 0;
+        }
+        zeros = byte == 0 ? zeros + 1 : 0;
+        ret.push_back(byte);
+    }
+    return ret;
+}
+
+// size of the 0001 / 001 prefix
+static std::size_t prefixSize(const uint8_t* nalu_data)
+{
+    return nalu_data[2] == 1 ? 3 : 4;
 }
 
-static void test_unescape_escape(const std::vector<uint8_t>& rbspDataEscaped)
+// Bit position of the rbsp_stop_one_bit (the last 1 bit), the end of the syntax elements
+static std::size_t stopBitPosition(const std::vector<uint8_t>& rbsp)
 {
-    auto unescapedData            = unescapeRbsp(rbspDataEscaped.data(), rbspDataEscaped.size());
-    auto unescapedThenEscapedData = escapeRbsp(unescapedData);
-    MLOGD << "Y1:" << StringHelper::vectorAsString(rbspDataEscaped);
-    MLOGD << "Y2:" << StringHelper::vectorAsString(unescapedData);
-    MLOGD << "Y3:" << StringHelper::vectorAsString(unescapedThenEscapedData);
-    // check if the data stayed the same after unescaping then escaping it again
-    assert(rbspDataEscaped.size() == unescapedThenEscapedData.size());
-    assert(std::memcmp(rbspDataEscaped.data(), unescapedThenEscapedData.data(), rbspDataEscaped.size()) == 0);
+    for (std::size_t i = rbsp.size(); i > 0; i--)
+    {
+        const uint8_t byte = rbsp[i - 1];
+        if (byte == 0) continue;
+        int bit = 0;
+        while (((byte >> bit) & 1) == 0) bit++;
+        return i * 8 - 1 - bit;
+    }
+    return 0;
+}
+
+// NALU with a 4 byte prefix from its unit header and (unescaped) rbsp
+static std::vector<uint8_t> asNALU(const uint8_t* header, std::size_t headerSize, const std::vector<uint8_t>& rbsp)
+{
+    const auto           escaped = escapeRbsp(rbsp);
+    std::vector<uint8_t> ret(4 + headerSize + escaped.size(), 0);
+    ret[3] = 1;
+    std::copy(header, header + headerSize, ret.begin() + 4);
+    std::copy(escaped.begin(), escaped.end(), ret.begin() + 4 + (long) headerSize);
+    return ret;
 }
 }  // namespace RBSPHelper
 
 namespace H264
 {
+using namespace NALUnitType::H264;
+
 // reverse order due to architecture
 // The nal unit header is not part of the rbsp-escaped bitstream and therefore can be read without unescaping anything
 typedef struct nal_unit_header
@@ -75,214 +167,315 @@ typedef struct nal_unit_header
 } __attribute__((packed)) nal_unit_header_t;
 static_assert(sizeof(nal_unit_header_t) == 1);
 
-// Parse raw NALU data into an sps struct (using the h264bitstream library)
+// Sequence parameter set (H.264 7.3.2.1.1), parsed up to and including the VUI
 class SPS
 {
   public:
-    nal_unit_header_t nal_header;
-    sps_t             parsed;
+    nal_unit_header_t nal_header{};
+    // false if the data was truncated or is not a SPS
+    bool valid = false;
+
+    uint32_t profile_idc                     = 0;
+    uint32_t constraint_flags                = 0;
+    uint32_t level_idc                       = 0;
+    uint32_t seq_parameter_set_id            = 0;
+    uint32_t chroma_format_idc               = 1;
+    bool     separate_colour_plane_flag      = false;
+    uint32_t bit_depth_luma_minus8           = 0;
+    uint32_t bit_depth_chroma_minus8         = 0;
+    uint32_t pic_order_cnt_type              = 0;
+    uint32_t max_num_ref_frames              = 0;
+    uint32_t pic_width_in_mbs_minus1         = 0;
+    uint32_t pic_height_in_map_units_minus1  = 0;
+    bool     frame_mbs_only_flag             = true;
+    uint32_t frame_crop_left_offset          = 0;
+    uint32_t frame_crop_right_offset         = 0;
+    uint32_t frame_crop_top_offset           = 0;
+    uint32_t frame_crop_bottom_offset        = 0;
+    bool     vui_parameters_present_flag     = false;
+    // bit position of vui_parameters_present_flag in the RBSP
+    std::size_t vui_position = 0;
+    // VUI
+    // bit position of bitstream_restriction_flag in the RBSP
+    std::size_t bitstream_restriction_position = 0;
+    bool        bitstream_restriction_flag     = false;
+    // defaults if bitstream_restriction_flag is not set (E.2.1)
+    bool     motion_vectors_over_pic_boundaries_flag = true;
+    uint32_t max_bytes_per_pic_denom                 = 2;
+    uint32_t max_bits_per_mb_denom                   = 1;
+    uint32_t log2_max_mv_length_horizontal           = 15;
+    uint32_t log2_max_mv_length_vertical             = 15;
+    uint32_t max_num_reorder_frames                  = 0;
+    uint32_t max_dec_frame_buffering                 = 0;
 
   public:
     // data buffer= NALU data with prefix
     SPS(const uint8_t* nalu_data, size_t data_len)
     {
-        memcpy(&nal_header, &nalu_data[4], 1);
-        assert(nal_header.forbidden_zero_bit == 0);
-        assert(nal_header.nal_unit_type == NAL_UNIT_TYPE_SPS);
-        auto      rbsp_buf = RBSPHelper::unescapeRbsp(&nalu_data[5], data_len - 5);
-        BitStream b(rbsp_buf);
-        read_seq_parameter_set_rbsp(&parsed, b.bs_t());
-        read_rbsp_trailing_bits(b.bs_t());
+        const std::size_t prefix = RBSPHelper::prefixSize(nalu_data);
+        if (data_len <= prefix + 1) return;
+        memcpy(&nal_header, &nalu_data[prefix], 1);
+        if (nal_header.forbidden_zero_bit != 0 || nal_header.nal_unit_type != NAL_UNIT_TYPE_SPS) return;
+        rbsp = RBSPHelper::unescapeRbsp(&nalu_data[prefix + 1], data_len - prefix - 1);
+        BitReader b(rbsp);
+        profile_idc          = b.read_bits(8);
+        constraint_flags     = b.read_bits(8);
+        level_idc            = b.read_bits(8);
+        seq_parameter_set_id = b.read_ue();
+        if (hasChromaInfo())
+        {
+            chroma_format_idc = b.read_ue();
+            if (chroma_format_idc == 3) separate_colour_plane_flag = b.read_flag();
+            bit_depth_luma_minus8   = b.read_ue();
+            bit_depth_chroma_minus8 = b.read_ue();
+            b.skip_bits(1);  // qpprime_y_zero_transform_bypass_flag
+            if (b.read_flag())  // seq_scaling_matrix_present_flag
+            {
+                for (int i = 0; i < (chroma_format_idc != 3 ? 8 : 12); i++)
+                {
+                    if (b.read_flag()) skipScalingList(b, i < 6 ? 16 : 64);
+                }
+            }
+        }
+        b.read_ue();  // log2_max_frame_num_minus4
+        pic_order_cnt_type = b.read_ue();
+        if (pic_order_cnt_type == 0)
+        {
+            b.read_ue();  // log2_max_pic_order_cnt_lsb_minus4
+        }
+        else if (pic_order_cnt_type == 1)
+        {
+            b.skip_bits(1);  // delta_pic_order_always_zero_flag
+            b.read_se();     // offset_for_non_ref_pic
+            b.read_se();     // offset_for_top_to_bottom_field
+            const uint32_t n = b.read_ue();
+            if (n > 255) return;
+            for (uint32_t i = 0; i < n; i++) b.read_se();
+        }
+        max_num_ref_frames = b.read_ue();
+        b.skip_bits(1);  // gaps_in_frame_num_value_allowed_flag
+        pic_width_in_mbs_minus1        = b.read_ue();
+        pic_height_in_map_units_minus1 = b.read_ue();
+        frame_mbs_only_flag            = b.read_flag();
+        if (!frame_mbs_only_flag) b.skip_bits(1);  // mb_adaptive_frame_field_flag
+        b.skip_bits(1);                            // direct_8x8_inference_flag
+        if (b.read_flag())                         // frame_cropping_flag
+        {
+            frame_crop_left_offset   = b.read_ue();
+            frame_crop_right_offset  = b.read_ue();
+            frame_crop_top_offset    = b.read_ue();
+            frame_crop_bottom_offset = b.read_ue();
+        }
+        vui_position                = b.position();
+        vui_parameters_present_flag = b.read_flag();
+        if (vui_parameters_present_flag) readVUI(b);
+        valid = !b.overrun();
     }
 
-    std::array<int, 2> getWidthHeightPx() const
+    // True if the decoder may output every frame as soon as it is decoded. Without bitstream_restriction it has to
+    // assume the maximum reorder depth of the level and holds back up to 16 frames.
+    bool isLowLatency() const
     {
-        int Width = ((parsed.pic_width_in_mbs_minus1 + 1) * 16) - parsed.frame_crop_right_offset * 2 -
-                    parsed.frame_crop_left_offset * 2;
-        int Height = ((2 - parsed.frame_mbs_only_flag) * (parsed.pic_height_in_map_units_minus1 + 1) * 16) -
-                     (parsed.frame_crop_bottom_offset * 2) - (parsed.frame_crop_top_offset * 2);
-        return {Width, Height};
+        return bitstream_restriction_flag && max_num_reorder_frames == 0 &&
+               max_dec_frame_buffering <= max_num_ref_frames;
     }
 
-    std::string asString() const { return H264Stream::spsAsString(&parsed); }
+    // This SPS with max_num_reorder_frames = 0 and the smallest max_dec_frame_buffering the references allow in the
+    // VUI, as NALU with a 4 byte prefix. A missing VUI / bitstream_restriction is added, everything else stays.
+    std::vector<uint8_t> asLowLatencyNALU() const
+    {
+        assert(valid);
+        BitWriter w;
+        if (vui_parameters_present_flag)
+        {
+            // the bitstream restriction is the end of the VUI and of the SPS
+            w.copy_bits(rbsp.data(), 0, bitstream_restriction_position);
+        }
+        else
+        {
+            w.copy_bits(rbsp.data(), 0, vui_position);
+            w.write_flag(true);  // vui_parameters_present_flag
+            // aspect ratio, overscan, video signal type, chroma loc, timing, nal / vcl hrd, pic_struct
+            w.write_bits(0, 8);
+        }
+        w.write_flag(true);  // bitstream_restriction_flag
+        w.write_flag(motion_vectors_over_pic_boundaries_flag);
+        w.write_ue(max_bytes_per_pic_denom);
+        w.write_ue(max_bits_per_mb_denom);
+        w.write_ue(log2_max_mv_length_horizontal);
+        w.write_ue(log2_max_mv_length_vertical);
+        w.write_ue(0);  // max_num_reorder_frames
+        w.write_ue(max_num_ref_frames);
+        w.write_trailing_bits();
+        uint8_t header;
+        memcpy(&header, &nal_header, 1);
+        return RBSPHelper::asNALU(&header, 1, w.data());
+    }
 
-    // --------------------------------------------- crude hacking --------------------------------------------
-    std::vector<uint8_t> asNALU() const
+    // High profiles carry chroma format, bit depth and scaling matrices
+    bool hasChromaInfo() const
     {
-        std::vector<uint8_t> naluBuff;
-        // write prefix and nalu header
-        naluBuff.resize(5);
-        naluBuff[0] = 0;
-        naluBuff[1] = 0;
-        naluBuff[2] = 0;
-        naluBuff[3] = 1;
-        std::memcpy(&naluBuff.data()[4], &nal_header, 1);
-        // write sps payload into rbspBuff
-        std::vector<uint8_t> rbspBuff;
-        rbspBuff.resize(14 + 64 * 4);
-        // MLOGD<<"rbspbuffSize"<<rbspBuff.size();
-        BitStream b(rbspBuff);
-        //
-        write_seq_parameter_set_rbsp(&parsed, b.bs_t());
-        write_rbsp_trailing_bits(b.bs_t());
-
-        if (bs_overrun(b.bs_t()))
+        switch (profile_idc)
         {
-            MLOGE << "BS overrun ";
+            case 100:
+            case 110:
+            case 122:
+            case 244:
+            case 44:
+            case 83:
+            case 86:
+            case 118:
+            case 128:
+            case 138:
+            case 139:
+            case 134:
+            case 135:
+                return true;
+            default:
+                return false;
         }
-        auto rbsp_size = bs_pos(b.bs_t());
-        rbspBuff.resize(rbsp_size);
-        // escape sps payload and append to nalu buffer
-        auto rbspBuffEscaped = RBSPHelper::escapeRbsp(rbspBuff);
-        naluBuff.insert(naluBuff.end(), rbspBuffEscaped.begin(), rbspBuffEscaped.end());
-        return naluBuff;
     }
 
-    // parsed.pic_order_cnt_type=0;
-    // parsed.log2_max_pic_order_cnt_lsb_minus4=4;
-    void experiment()
+    std::array<int, 2> getWidthHeightPx() const
     {
-        // parsed.level_idc=40;
-        // parsed.pic_order_cnt_type=2;
-        // parsed.log2_max_pic_order_cnt_lsb_minus4=4;
+        // 7.4.2.1.1, the crop offsets are in units of chroma samples
+        const int chroma     = separate_colour_plane_flag ? 0 : (int) chroma_format_idc;
+        const int cropUnitX  = (chroma == 1 || chroma == 2) ? 2 : 1;
+        const int cropUnitY  = (chroma == 1 ? 2 : 1) * (2 - frame_mbs_only_flag);
+        const int width      = (int) (pic_width_in_mbs_minus1 + 1) * 16 -
+                          cropUnitX * (int) (frame_crop_left_offset + frame_crop_right_offset);
+        const int height = (2 - frame_mbs_only_flag) * (int) (pic_height_in_map_units_minus1 + 1) * 16 -
+                           cropUnitY * (int) (frame_crop_top_offset + frame_crop_bottom_offset);
+        return {width, height};
     }
 
-    // adding VUI might decrease latency for some streams, if max_dec_frame_buffering is set properly
-    // https://community.intel.com/t5/Media-Intel-oneAPI-Video/h-264-decoder-gives-two-frames-latency-while-decoding-a-stream/td-p/1099694
-    void addVUI()
+    VideoFormat getVideoFormat() const
     {
-        // parsed.level_idc=40;
-        // parsed.constraint_set4_flag=true;
-        // parsed.constraint_set5_flag=true;
-        // parsed.log2_max_frame_num_minus4=12;
-        // parsed.log2_max_pic_order_cnt_lsb_minus4=12;
-
-        parsed.vui_parameters_present_flag                 = 1;
-        parsed.vui.aspect_ratio_info_present_flag          = 0;
-        parsed.vui.aspect_ratio_idc                        = 0;
-        parsed.vui.sar_width                               = 0;
-        parsed.vui.sar_height                              = 0;
-        parsed.vui.overscan_info_present_flag              = 0;
-        parsed.vui.overscan_appropriate_flag               = 0;
-        parsed.vui.video_signal_type_present_flag          = 1;
-        parsed.vui.video_format                            = 5;
-        parsed.vui.video_full_range_flag                   = 0;
-        parsed.vui.colour_description_present_flag         = 1;
-        parsed.vui.colour_primaries                        = 0;
-        parsed.vui.transfer_characteristics                = 0;
-        parsed.vui.matrix_coefficients                     = 5;
-        parsed.vui.chroma_loc_info_present_flag            = 0;
-        parsed.vui.chroma_sample_loc_type_top_field        = 0;
-        parsed.vui.chroma_sample_loc_type_bottom_field     = 0;
-        parsed.vui.timing_info_present_flag                = 1;
-        parsed.vui.num_units_in_tick                       = 1;
-        parsed.vui.time_scale                              = 120;
-        parsed.vui.fixed_frame_rate_flag                   = 1;
-        parsed.vui.nal_hrd_parameters_present_flag         = 0;
-        parsed.vui.vcl_hrd_parameters_present_flag         = 0;
-        parsed.vui.low_delay_hrd_flag                      = 0;
-        parsed.vui.pic_struct_present_flag                 = 0;
-        parsed.vui.bitstream_restriction_flag              = 1;
-        parsed.vui.motion_vectors_over_pic_boundaries_flag = 1;
-        parsed.vui.max_bytes_per_pic_denom                 = 0;
-        parsed.vui.max_bits_per_mb_denom                   = 0;
-        parsed.vui.log2_max_mv_length_horizontal           = 16;
-        parsed.vui.log2_max_mv_length_vertical             = 16;
-        parsed.vui.num_reorder_frames                      = 0;
-        parsed.vui.max_dec_frame_buffering                 = 1;
+        const auto  wh = getWidthHeightPx();
+        VideoFormat ret;
+        ret.width        = wh[0];
+        ret.height       = wh[1];
+        ret.profile      = (int) profile_idc;
+        ret.level        = (int) level_idc;
+        ret.chromaFormat = (int) chroma_format_idc;
+        ret.bitDepth     = 8 + (int) bit_depth_luma_minus8;
+        return ret;
     }
-};
 
-static void testSPSConversion(const uint8_t* nalu_data, size_t data_len)
-{
-    auto sps      = H264::SPS(nalu_data, data_len);
-    auto naluBuff = sps.asNALU();
-    MLOGD << "Z1:" << StringHelper::vectorAsString(std::vector<uint8_t>(nalu_data, nalu_data + data_len));
-    MLOGD << "Z2:" << StringHelper::vectorAsString(naluBuff);
-    assert(data_len == naluBuff.size());
-    assert(std::memcmp(nalu_data, naluBuff.data(), data_len) == 0);
-}
-// --------------------------------------------- crude hacking --------------------------------------------
+    std::string asString() const
+    {
+        std::stringstream ss;
+        ss << "[profile_idc=" << profile_idc << ",level_idc=" << level_idc << ",chroma_format_idc=" << chroma_format_idc
+           << ",pic_order_cnt_type=" << pic_order_cnt_type << ",max_num_ref_frames=" << max_num_ref_frames
+           << ",vui=" << vui_parameters_present_flag << ",bitstream_restriction=" << bitstream_restriction_flag
+           << ",max_num_reorder_frames=" << max_num_reorder_frames
+           << ",max_dec_frame_buffering=" << max_dec_frame_buffering << "]";
+        return ss.str();
+    }
 
-class PPS
-{
-  public:
-    nal_unit_header_t nal_header;
-    pps_t             parsed;
+  private:
+    static void skipScalingList(BitReader& b, int size)
+    {
+        int lastScale = 8, nextScale = 8;
+        for (int j = 0; j < size; j++)
+        {
+            if (nextScale != 0)
+            {
+                nextScale = (lastScale + b.read_se() + 256) % 256;
+            }
+            lastScale = nextScale == 0 ? lastScale : nextScale;
+        }
+    }
 
-  public:
-    // data buffer= NALU data with prefix
-    PPS(const uint8_t* nalu_data, size_t data_len)
+    static void skipHRD(BitReader& b)
     {
-        memcpy(&nal_header, &nalu_data[4], 1);
-        assert(nal_header.forbidden_zero_bit == 0);
-        assert(nal_header.nal_unit_type == NAL_UNIT_TYPE_PPS);
-        auto      rbsp_buf = RBSPHelper::unescapeRbsp(&nalu_data[5], data_len - 5);
-        BitStream b(rbsp_buf);
-        read_pic_parameter_set_rbsp(&parsed, b.bs_t());
-        read_rbsp_trailing_bits(b.bs_t());
+        const uint32_t cpb_cnt_minus1 = b.read_ue();
+        b.skip_bits(4 + 4);  // bit_rate_scale, cpb_size_scale
+        for (uint32_t i = 0; i <= cpb_cnt_minus1 && i < 32; i++)
+        {
+            b.read_ue();     // bit_rate_value_minus1
+            b.read_ue();     // cpb_size_value_minus1
+            b.skip_bits(1);  // cbr_flag
+        }
+        b.skip_bits(5 + 5 + 5 + 5);  // delay and time offset lengths
     }
 
-    std::string asString() const { return H264Stream::ppsAsString(parsed); }
+    // E.1.1
+    void readVUI(BitReader& b)
+    {
+        if (b.read_flag())  // aspect_ratio_info_present_flag
+        {
+            if (b.read_bits(8) == 255) b.skip_bits(16 + 16);  // Extended_SAR: sar_width, sar_height
+        }
+        if (b.read_flag()) b.skip_bits(1);  // overscan_info_present_flag, overscan_appropriate_flag
+        if (b.read_flag())                  // video_signal_type_present_flag
+        {
+            b.skip_bits(3 + 1);                     // video_format, video_full_range_flag
+            if (b.read_flag()) b.skip_bits(8 * 3);  // colour_description_present_flag
+        }
+        if (b.read_flag())  // chroma_loc_info_present_flag
+        {
+            b.read_ue();
+            b.read_ue();
+        }
+        if (b.read_flag()) b.skip_bits(32 + 32 + 1);  // timing_info_present_flag
+        const bool nal_hrd = b.read_flag();
+        if (nal_hrd) skipHRD(b);
+        const bool vcl_hrd = b.read_flag();
+        if (vcl_hrd) skipHRD(b);
+        if (nal_hrd || vcl_hrd) b.skip_bits(1);  // low_delay_hrd_flag
+        b.skip_bits(1);                          // pic_struct_present_flag
+        bitstream_restriction_position = b.position();
+        bitstream_restriction_flag     = b.read_flag();
+        if (bitstream_restriction_flag)
+        {
+            motion_vectors_over_pic_boundaries_flag = b.read_flag();
+            max_bytes_per_pic_denom                 = b.read_ue();
+            max_bits_per_mb_denom                   = b.read_ue();
+            log2_max_mv_length_horizontal           = b.read_ue();
+            log2_max_mv_length_vertical             = b.read_ue();
+            max_num_reorder_frames                  = b.read_ue();
+            max_dec_frame_buffering                 = b.read_ue();
+        }
+    }
+
+  public:
+    // unescaped payload after the unit header
+    std::vector<uint8_t> rbsp;
 };
 
 class Slice
 {
   public:
-    nal_unit_header_t nal_header;
-    slice_header_t    parsed;
+    nal_unit_header_t nal_header{};
+
+    uint32_t first_mb_in_slice    = 0;
+    uint32_t slice_type           = 0;
+    uint32_t pic_parameter_set_id = 0;
 
   public:
     // data buffer= NALU data with prefix
     Slice(const uint8_t* nalu_data, size_t data_len)
     {
-        memcpy(&nal_header, &nalu_data[4], 1);
-        assert(nal_header.forbidden_zero_bit == 0);
-        assert(
-            nal_header.nal_unit_type == NAL_UNIT_TYPE_CODED_SLICE_IDR ||
-            nal_header.nal_unit_type == NAL_UNIT_TYPE_CODED_SLICE_NON_IDR);
-        auto      rbsp_buf = RBSPHelper::unescapeRbsp(&nalu_data[5], data_len - 5);
-        BitStream b(rbsp_buf);
-        // parsing
-        parsed.first_mb_in_slice    = b.read_ue();
-        parsed.slice_type           = b.read_ue();
-        parsed.pic_parameter_set_id = b.read_ue();
-        parsed.frame_num            = b.read_ue();
+        const std::size_t prefix = RBSPHelper::prefixSize(nalu_data);
+        memcpy(&nal_header, &nalu_data[prefix], 1);
+        // the slice header is at the start, no need to unescape the whole slice
+        const auto rbsp = RBSPHelper::unescapeRbsp(&nalu_data[prefix + 1], std::min<size_t>(data_len - prefix - 1, 32));
+        BitReader  b(rbsp);
+        first_mb_in_slice    = b.read_ue();
+        slice_type           = b.read_ue();
+        pic_parameter_set_id = b.read_ue();
     }
 
     std::string asString() const
     {
         std::stringstream ss;
-        ss << "[first_mb_in_slice=" << parsed.first_mb_in_slice << ",slice_type=" << parsed.slice_type
-           << ",pic_parameter_set_id=" << parsed.pic_parameter_set_id << "frame_num=" << parsed.frame_num << "]";
+        ss << "[first_mb_in_slice=" << first_mb_in_slice << ",slice_type=" << slice_type
+           << ",pic_parameter_set_id=" << pic_parameter_set_id << "]";
         return ss.str();
     }
 };
 
-/*class SEI{
-public:
-    nal_unit_header_t nal_header;
-    slice_header_t parsed;
-public:
-    // data buffer= NALU data with prefix
-    Slice(const uint8_t* nalu_data,size_t data_len){
-        memcpy(&nal_header,&nalu_data[4],1);
-        assert(nal_header.forbidden_zero_bit==0);
-        assert(nal_header.nal_unit_type==NAL_UNIT_TYPE_CODED_SLICE_IDR ||
-nal_header.nal_unit_type==NAL_UNIT_TYPE_CODED_SLICE_NON_IDR); auto rbsp_buf= RBSPHelper::unescapeRbsp(&nalu_data[5],
-data_len-5); BitStream b(rbsp_buf);
-        // parsing
-        parsed.first_mb_in_slice=b.read_ue();
-        parsed.slice_type=b.read_ue();
-        parsed.pic_parameter_set_id=b.read_ue();
-        parsed.frame_num=b.read_ue();
-    }
-    std::string asString()const{
-        std::stringstream ss;
-        return ss.str();
-    }
-};*/
-
 // this is the data for an h264 AUD unit
 static std::array<uint8_t, 6>   EXAMPLE_AUD = {0, 0, 0, 1, 9, 48};
 static std::array<uint8_t, 687> EXAMPLE_SEI = {
@@ -330,6 +523,205 @@ typedef struct nal_unit_header
 } __attribute__((packed)) nal_unit_header_t;
 static_assert(sizeof(nal_unit_header_t) == 2);
 
+// profile_tier_level() (7.3.3) with profilePresentFlag = 1
+struct ProfileTierLevel
+{
+    uint32_t general_profile_space = 0;
+    bool     general_tier_flag     = false;
+    uint32_t general_profile_idc   = 0;
+    uint32_t general_level_idc     = 0;
+
+    void read(BitReader& b, uint32_t max_sub_layers_minus1)
+    {
+        general_profile_space = b.read_bits(2);
+        general_tier_flag     = b.read_flag();
+        general_profile_idc   = b.read_bits(5);
+        b.skip_bits(32);      // general_profile_compatibility_flag[32]
+        b.skip_bits(4 + 44);  // progressive / interlaced / non packed / frame only, 43 reserved bits + 1
+        general_level_idc = b.read_bits(8);
+        bool sub_layer_profile_present[8] = {};
+        bool sub_layer_level_present[8]   = {};
+        for (uint32_t i = 0; i < max_sub_layers_minus1; i++)
+        {
+            sub_layer_profile_present[i] = b.read_flag();
+            sub_layer_level_present[i]   = b.read_flag();
+        }
+        if (max_sub_layers_minus1 > 0)
+        {
+            b.skip_bits(2 * (8 - max_sub_layers_minus1));  // reserved_zero_2bits
+        }
+        for (uint32_t i = 0; i < max_sub_layers_minus1; i++)
+        {
+            if (sub_layer_profile_present[i]) b.skip_bits(88);
+            if (sub_layer_level_present[i]) b.skip_bits(8);
+        }
+    }
+};
+
+// Video parameter set (7.3.2.1), only the part in front of the extension data
+class VPS
+{
+  public:
+    bool             valid                     = false;
+    uint32_t         vps_video_parameter_set_id = 0;
+    uint32_t         vps_max_sub_layers_minus1  = 0;
+    ProfileTierLevel profile_tier_level;
+
+  public:
+    // data buffer= NALU data with prefix
+    VPS(const uint8_t* nalu_data, size_t data_len)
+    {
+        const std::size_t prefix = RBSPHelper::prefixSize(nalu_data);
+        if (data_len <= prefix + 2) return;
+        if (((nalu_data[prefix] & 0x7E) >> 1) != NALUnitType::H265::NAL_UNIT_VPS) return;
+        const auto rbsp = RBSPHelper::unescapeRbsp(&nalu_data[prefix + 2], data_len - prefix - 2);
+        BitReader  b(rbsp);
+        vps_video_parameter_set_id = b.read_bits(4);
+        b.skip_bits(1 + 1 + 6);  // base layer internal / available, vps_max_layers_minus1
+        vps_max_sub_layers_minus1 = b.read_bits(3);
+        b.skip_bits(1 + 16);  // vps_temporal_id_nesting_flag, vps_reserved_0xffff_16bits
+        if (vps_max_sub_layers_minus1 > 6) return;
+        profile_tier_level.read(b, vps_max_sub_layers_minus1);
+        valid = !b.overrun();
+    }
+};
+
+// Sequence parameter set (7.3.2.2), parsed up to and including the sub layer ordering info
+class SPS
+{
+  public:
+    bool             valid                      = false;
+    uint32_t         sps_video_parameter_set_id = 0;
+    uint32_t         sps_max_sub_layers_minus1  = 0;
+    ProfileTierLevel profile_tier_level;
+    uint32_t         sps_seq_parameter_set_id   = 0;
+    uint32_t         chroma_format_idc          = 1;
+    bool             separate_colour_plane_flag = false;
+    uint32_t         pic_width_in_luma_samples  = 0;
+    uint32_t         pic_height_in_luma_samples = 0;
+    uint32_t         conf_win_left_offset       = 0;
+    uint32_t         conf_win_right_offset      = 0;
+    uint32_t         conf_win_top_offset        = 0;
+    uint32_t         conf_win_bottom_offset     = 0;
+    uint32_t         bit_depth_luma_minus8      = 0;
+    uint32_t         bit_depth_chroma_minus8    = 0;
+    // of the highest sub layer
+    uint32_t sps_max_dec_pic_buffering_minus1 = 0;
+    uint32_t sps_max_num_reorder_pics         = 0;
+    uint32_t sps_max_latency_increase_plus1   = 0;
+    // bit positions of sps_sub_layer_ordering_info_present_flag and of what follows the ordering info in the RBSP
+    std::size_t ordering_info_position     = 0;
+    std::size_t ordering_info_end_position = 0;
+
+  public:
+    // data buffer= NALU data with prefix
+    SPS(const uint8_t* nalu_data, size_t data_len)
+    {
+        const std::size_t prefix = RBSPHelper::prefixSize(nalu_data);
+        if (data_len <= prefix + 2) return;
+        if (((nalu_data[prefix] & 0x7E) >> 1) != NALUnitType::H265::NAL_UNIT_SPS) return;
+        memcpy(header, &nalu_data[prefix], 2);
+        rbsp = RBSPHelper::unescapeRbsp(&nalu_data[prefix + 2], data_len - prefix - 2);
+        BitReader b(rbsp);
+        sps_video_parameter_set_id = b.read_bits(4);
+        sps_max_sub_layers_minus1  = b.read_bits(3);
+        b.skip_bits(1);  // sps_temporal_id_nesting_flag
+        if (sps_max_sub_layers_minus1 > 6) return;
+        profile_tier_level.read(b, sps_max_sub_layers_minus1);
+        sps_seq_parameter_set_id = b.read_ue();
+        chroma_format_idc        = b.read_ue();
+        if (chroma_format_idc == 3) separate_colour_plane_flag = b.read_flag();
+        pic_width_in_luma_samples  = b.read_ue();
+        pic_height_in_luma_samples = b.read_ue();
+        if (b.read_flag())  // conformance_window_flag
+        {
+            conf_win_left_offset   = b.read_ue();
+            conf_win_right_offset  = b.read_ue();
+            conf_win_top_offset    = b.read_ue();
+            conf_win_bottom_offset = b.read_ue();
+        }
+        bit_depth_luma_minus8   = b.read_ue();
+        bit_depth_chroma_minus8 = b.read_ue();
+        b.read_ue();  // log2_max_pic_order_cnt_lsb_minus4
+        ordering_info_position                     = b.position();
+        const bool sub_layer_ordering_info_present = b.read_flag();
+        for (uint32_t i = sub_layer_ordering_info_present ? 0 : sps_max_sub_layers_minus1;
+             i <= sps_max_sub_layers_minus1;
+             i++)
+        {
+            sps_max_dec_pic_buffering_minus1 = b.read_ue();
+            sps_max_num_reorder_pics         = b.read_ue();
+            sps_max_latency_increase_plus1   = b.read_ue();
+        }
+        ordering_info_end_position = b.position();
+        valid = !b.overrun() && RBSPHelper::stopBitPosition(rbsp) >= ordering_info_end_position;
+    }
+
+    // True if the decoder may output every picture as soon as it is decoded. The reorder depth of the highest sub
+    // layer is the largest one.
+    bool isLowLatency() const { return sps_max_num_reorder_pics == 0; }
+
+    // This SPS with sps_max_num_reorder_pics = 0, as NALU with a 4 byte prefix. The ordering info is written once for
+    // all sub layers (the values of the highest one), everything else is copied.
+    std::vector<uint8_t> asLowLatencyNALU() const
+    {
+        assert(valid);
+        BitWriter w;
+        w.copy_bits(rbsp.data(), 0, ordering_info_position);
+        w.write_flag(false);  // sps_sub_layer_ordering_info_present_flag
+        w.write_ue(sps_max_dec_pic_buffering_minus1);
+        w.write_ue(0);  // sps_max_num_reorder_pics
+        w.write_ue(sps_max_latency_increase_plus1);
+        w.copy_bits(rbsp.data(), ordering_info_end_position, RBSPHelper::stopBitPosition(rbsp));
+        w.write_trailing_bits();
+        return RBSPHelper::asNALU(header, 2, w.data());
+    }
+
+    std::array<int, 2> getWidthHeightPx() const
+    {
+        // 7.4.3.2.1, the conformance window offsets are in units of chroma samples
+        const int chroma    = separate_colour_plane_flag ? 0 : (int) chroma_format_idc;
+        const int subWidth  = (chroma == 1 || chroma == 2) ? 2 : 1;
+        const int subHeight = chroma == 1 ? 2 : 1;
+        const int width     = (int) pic_width_in_luma_samples -
+                          subWidth * (int) (conf_win_left_offset + conf_win_right_offset);
+        const int height = (int) pic_height_in_luma_samples -
+                           subHeight * (int) (conf_win_top_offset + conf_win_bottom_offset);
+        return {width, height};
+    }
+
+    VideoFormat getVideoFormat() const
+    {
+        const auto  wh = getWidthHeightPx();
+        VideoFormat ret;
+        ret.width        = wh[0];
+        ret.height       = wh[1];
+        ret.profile      = (int) profile_tier_level.general_profile_idc;
+        ret.level        = (int) profile_tier_level.general_level_idc;
+        ret.highTier     = profile_tier_level.general_tier_flag;
+        ret.chromaFormat = (int) chroma_format_idc;
+        ret.bitDepth     = 8 + (int) bit_depth_luma_minus8;
+        return ret;
+    }
+
+    std::string asString() const
+    {
+        std::stringstream ss;
+        ss << "[general_profile_idc=" << profile_tier_level.general_profile_idc
+           << ",general_level_idc=" << profile_tier_level.general_level_idc
+           << ",chroma_format_idc=" << chroma_format_idc << ",pic_width_in_luma_samples=" << pic_width_in_luma_samples
+           << ",pic_height_in_luma_samples=" << pic_height_in_luma_samples
+           << ",sps_max_dec_pic_buffering_minus1=" << sps_max_dec_pic_buffering_minus1
+           << ",sps_max_num_reorder_pics=" << sps_max_num_reorder_pics << "]";
+        return ss.str();
+    }
+    // unescaped payload after the unit header
+    std::vector<uint8_t> rbsp;
+
+  private:
+    uint8_t header[2] = {};
+};
+
 }  // namespace H265
 
 #endif  // FPVUE_H264_H
@@ -79,9 +79,13 @@ class KeyFrameFinder
 
     static void appendNaluData(std::vector<uint8_t>& buff, const NALU& nalu)
     {
-        buff.insert(buff.begin(), nalu.getData(), nalu.getData() + nalu.getSize());
+        buff.insert(buff.begin(), nalu.getSize(), 0);
+        nalu.copyTo(buff.data());
     }
 
+    // The PPS has to be sent again after a SPS change
+    void resetPPS() { PPS = nullptr; }
+
     void reset()
     {
         SPS = nullptr;
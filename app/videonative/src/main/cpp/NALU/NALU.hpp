@@ -12,6 +12,7 @@
 #include <chrono>
 #include <cstdint>  // for uint8_t
 #include <cstring>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -21,6 +22,9 @@
 #include <variant>
 #include <vector>
 
+#include "../helper/AndroidLogger.hpp"
+#include "FragmentedNALU.hpp"
+#include "H26X.hpp"
 #include "NALUnitType.hpp"
 
 // dependency could be easily removed again
@@ -35,6 +39,8 @@
  * store a NALU. Since H264 and H265 are that similar, we use this class for both (make sure to not call methds only
  * supported on h265 with a h264 nalu,though) The constructor of the NALU does some really basic validation - make sure
  * the parser never produces a NALU where this validation would fail
+ * A NALU may also view a FragmentedNALU (still scattered over its RTP packets). Then only the first
+ * FragmentedNALU::HEAD_SIZE bytes are available via getData(), use copyTo() to get the whole NALU.
  */
 class NALU
 {
@@ -51,6 +57,21 @@ class NALU
         m_nalu_prefix_size = get_nalu_prefix_size();
     }
 
+    NALU(
+        const FragmentedNALU&                       fragments,
+        const bool                                  IS_H265_PACKET1 = false,
+        const std::chrono::steady_clock::time_point creationTime    = std::chrono::steady_clock::now())
+        : m_data(fragments.head()),
+          m_data_len(fragments.size()),
+          m_fragments(&fragments),
+          IS_H265_PACKET(IS_H265_PACKET1),
+          creationTime{creationTime}
+    {
+        assert(hasValidPrefix());
+        assert(getSize() >= getMinimumNaluSize(IS_H265_PACKET1));
+        m_nalu_prefix_size = get_nalu_prefix_size();
+    }
+
     ~NALU() = default;
 
     // test video white iceland: Max 1024*117. Video might not be decodable if its NALU buffers size exceed the limit
@@ -60,9 +81,13 @@ class NALU
     using NALU_BUFFER = std::array<uint8_t, NALU_MAXLEN>;
 
   private:
-    const uint8_t* m_data;
-    const size_t   m_data_len;
-    int            m_nalu_prefix_size;
+    const uint8_t*        m_data;
+    const size_t          m_data_len;
+    const FragmentedNALU* m_fragments = nullptr;
+    int                   m_nalu_prefix_size;
+    bool                  m_end_of_access_unit = false;
+    bool                  m_corrupted          = false;
+    uint32_t              m_frame_id           = 0;
 
   public:
     const bool IS_H265_PACKET;
@@ -91,9 +116,26 @@ class NALU
     }
 
   public:
-    // pointer to the NALU data with 0001 prefix
+    // pointer to the NALU data with 0001 prefix. Only the first FragmentedNALU::HEAD_SIZE bytes if !isContiguous()
     const uint8_t* getData() const { return m_data; }
 
+    // false if the NALU is still scattered over its RTP packets
+    bool isContiguous() const { return m_fragments == nullptr; }
+
+    // The packet segments if !isContiguous(), nullptr otherwise
+    const FragmentedNALU* getFragments() const { return m_fragments; }
+
+    // Write the whole NALU data with 0001 prefix to @param dst, which must hold getSize() bytes
+    void copyTo(uint8_t* dst) const
+    {
+        if (m_fragments != nullptr)
+        {
+            m_fragments->gather(dst);
+            return;
+        }
+        std::memcpy(dst, m_data, m_data_len);
+    }
+
     // size of the NALU data with 0001 prefix
     size_t getSize() const { return m_data_len; }
 
@@ -179,13 +221,65 @@ class NALU
 
     bool is_config() { return isSPS() || isPPS() || (IS_H265_PACKET && isVPS()); }
 
-    // keyframe / IDR frame
+    // coded slice (VCL NAL unit)
+    bool is_vcl() const
+    {
+        const auto nut = get_nal_unit_type();
+        if (IS_H265_PACKET) return nut <= NALUnitType::H265::NAL_UNIT_RESERVED_VCL31;
+        return nut >= NALUnitType::H264::NAL_UNIT_TYPE_CODED_SLICE_NON_IDR &&
+               nut <= NALUnitType::H264::NAL_UNIT_TYPE_CODED_SLICE_IDR;
+    }
+
+    // For a VCL NALU: the first slice of a picture (first_mb_in_slice == 0 / first_slice_segment_in_pic_flag)
+    bool is_first_slice_of_picture() const
+    {
+        // Both are the first bit after the NAL unit header, first_mb_in_slice is ue(v) and 0 is coded as a single 1
+        const int header_size = IS_H265_PACKET ? 2 : 1;
+        if (getDataSizeWithoutPrefix() <= header_size) return false;
+        return (getDataWithoutPrefix()[header_size] & 0x80) != 0;
+    }
+
+    // NAL unit types that, following a VCL NAL unit, start the next access unit (H.264 7.4.1.2.3, H.265 7.4.2.4.4)
+    bool starts_access_unit_after_vcl() const
+    {
+        const auto nut = get_nal_unit_type();
+        if (IS_H265_PACKET)
+        {
+            return (nut >= NALUnitType::H265::NAL_UNIT_VPS &&
+                    nut <= NALUnitType::H265::NAL_UNIT_ACCESS_UNIT_DELIMITER) ||
+                   nut == NALUnitType::H265::NAL_UNIT_PREFIX_SEI ||
+                   (nut >= NALUnitType::H265::NAL_UNIT_RESERVED_NVCL41 &&
+                    nut <= NALUnitType::H265::NAL_UNIT_RESERVED_NVCL44) ||
+                   (nut >= NALUnitType::H265::NAL_UNIT_UNSPECIFIED_48 &&
+                    nut <= NALUnitType::H265::NAL_UNIT_UNSPECIFIED_55);
+        }
+        return (nut >= NALUnitType::H264::NAL_UNIT_TYPE_SEI && nut <= NALUnitType::H264::NAL_UNIT_TYPE_AUD) ||
+               (nut >= NALUnitType::H264::NAL_UNIT_TYPE_PREFIX_NAL && nut <= 18);
+    }
+
+    // Set by the RTP parser if the NALU ended in a packet with the marker bit, i.e. it is the last of its access unit
+    bool isEndOfAccessUnit() const { return m_end_of_access_unit; }
+
+    void setEndOfAccessUnit(bool end_of_access_unit) { m_end_of_access_unit = end_of_access_unit; }
+
+    // Set by the RTP parser if packets of the NALU were lost and it was forwarded anyway (zero filled or truncated)
+    bool isCorrupted() const { return m_corrupted; }
+
+    void setCorrupted(bool corrupted) { m_corrupted = corrupted; }
+
+    // Set by the RTP parser: the RTP timestamp, the same for all NALUs of a frame. Identifies the frame in FrameTrace.
+    uint32_t getFrameId() const { return m_frame_id; }
+
+    void setFrameId(uint32_t frame_id) { m_frame_id = frame_id; }
+
+    // keyframe / IDR frame. For H265 any IRAP picture (BLA, IDR, CRA), decoding can start at each of them.
     bool is_keyframe() const
     {
         const auto nut = get_nal_unit_type();
         if (IS_H265_PACKET)
         {
-            return false;
+            return nut >= NALUnitType::H265::NAL_UNIT_CODED_SLICE_BLA_W_LP &&
+                   nut <= NALUnitType::H265::NAL_UNIT_RESERVED_IRAP_VCL23;
         }
         if (nut == NALUnitType::H264::NAL_UNIT_TYPE_CODED_SLICE_IDR)
         {
@@ -197,19 +291,32 @@ class NALU
     bool is_frame_but_not_keyframe() const
     {
         const auto nut = get_nal_unit_type();
-        if (IS_H265_PACKET) return false;
+        if (IS_H265_PACKET) return is_vcl() && !is_keyframe();
         return (nut == NALUnitType::H264::NAL_UNIT_TYPE_CODED_SLICE_NON_IDR);
     }
+
+    // A slice of a picture no other picture refers to, it can be skipped without breaking the ones after it.
+    // H264: nal_ref_idc 0. H265: the sub-layer non-reference types (TRAIL_N, TSA_N, ..., RSV_VCL_N14), which no
+    // picture of the same temporal sub-layer refers to (without temporal scalability there is only one).
+    bool is_non_reference() const
+    {
+        if (!is_vcl()) return false;
+        const auto nut = get_nal_unit_type();
+        if (IS_H265_PACKET) return nut <= NALUnitType::H265::NAL_UNIT_RESERVED_VCL_N14 && nut % 2 == 0;
+        return (getDataWithoutPrefix()[0] & 0x60) == 0;
+    }
     // XXX -----------
 
     std::string getDataAsHexString() const
     {
+        std::vector<uint8_t> data(getSize());
+        copyTo(data.data());
         std::stringstream ss;
         ss << std::hex << std::setfill('0');
 
-        for (size_t i = 0; i < getSize(); ++i)
+        for (size_t i = 0; i < data.size(); ++i)
         {
-            ss << std::setw(2) << static_cast<int>(getData()[i]);
+            ss << std::setw(2) << static_cast<int>(data[i]);
         }
 
         return ss.str();
@@ -280,27 +387,59 @@ class NALU
 
     // Returns video width and height if the NALU is an SPS
     std::array<int, 2> getVideoWidthHeightSPS() const
+    {
+        const auto format = getVideoFormatSPS();
+        if (format.has_value()) return {format->width, format->height};
+        MLOGE << "Couldn't parse " << (IS_H265_PACKET ? "h265" : "h264") << " sps";
+        return IS_H265_PACKET ? std::array<int, 2>{1280, 720} : std::array<int, 2>{640, 480};
+    }
+
+    // Geometry, profile and level if the NALU is a valid SPS
+    std::optional<VideoFormat> getVideoFormatSPS() const
     {
         assert(isSPS());
+        std::vector<uint8_t> gathered;
+        const uint8_t*       data = getContiguousData(gathered);
         if (IS_H265_PACKET)
         {
-            return {1280, 720};
-            //            auto sps=h265nal::H265SpsParser::ParseSps(&getData()[6],getSize()-6);
-            //            if(sps!=absl::nullopt){
-            //                std::array<int,2>
-            //                ret={(int)sps->pic_width_in_luma_samples,(int)sps->pic_height_in_luma_samples}; return
-            //                ret;
-            //            }
-            //            MLOGE<<"Couldn't parse h265 sps";
-            //            return {640,480};
+            const H265::SPS sps(data, getSize());
+            if (!sps.valid) return std::nullopt;
+            return sps.getVideoFormat();
         }
-        else
+        const H264::SPS sps(data, getSize());
+        if (!sps.valid) return std::nullopt;
+        return sps.getVideoFormat();
+    }
+
+    // This SPS rewritten to announce that no picture is reordered, so the decoder outputs every frame as soon as it is
+    // decoded. Empty if the SPS already says so or can't be parsed.
+    std::vector<uint8_t> getLowLatencySPS() const
+    {
+        assert(isSPS());
+        std::vector<uint8_t> gathered;
+        const uint8_t*       data = getContiguousData(gathered);
+        if (IS_H265_PACKET)
         {
-            // const auto sps=H264::SPS(getData(),getSize());
-            // return sps.getWidthHeightPx();
-            return {640, 480};
+            const H265::SPS sps(data, getSize());
+            if (!sps.valid || sps.isLowLatency()) return {};
+            return sps.asLowLatencyNALU();
         }
+        const H264::SPS sps(data, getSize());
+        if (!sps.valid || sps.isLowLatency()) return {};
+        return sps.asLowLatencyNALU();
     }
+
+  private:
+    // getData() if the NALU is in one piece, else the NALU gathered into @param storage
+    const uint8_t* getContiguousData(std::vector<uint8_t>& storage) const
+    {
+        if (isContiguous()) return getData();
+        storage.resize(getSize());
+        copyTo(storage.data());
+        return storage.data();
+    }
+
+  public:
     //
     // XXX -----------
 };
@@ -319,8 +458,12 @@ class NALUBuffer
 
     NALUBuffer(const NALU& nalu)
     {
-        m_data = std::make_shared<std::vector<uint8_t>>(nalu.getData(), nalu.getData() + nalu.getSize());
+        m_data = std::make_shared<std::vector<uint8_t>>(nalu.getSize());
+        nalu.copyTo(m_data->data());
         m_nalu = std::make_unique<NALU>(m_data->data(), m_data->size(), nalu.IS_H265_PACKET, nalu.creationTime);
+        m_nalu->setCorrupted(nalu.isCorrupted());
+        m_nalu->setEndOfAccessUnit(nalu.isEndOfAccessUnit());
+        m_nalu->setFrameId(nalu.getFrameId());
     }
 
     NALUBuffer(const NALUBuffer&) = delete;
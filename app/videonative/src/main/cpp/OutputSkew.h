@@ -0,0 +1,114 @@
+//
+// OutputSkew.h
+// VR mode: how far apart in time the left (0) and the right (1) codec output the same frame. Both codecs get the
+// same NALUs, each input buffer is labelled with the sequence number of the NALU it was submitted for. The output
+// side finds the label through the presentation time of the buffer and pairs the two outputs with the same label.
+// Outputs that lost their partner (a codec dropped or failed a buffer) are not counted.
+//
+
+#ifndef FPVUE_OUTPUTSKEW_H
+#define FPVUE_OUTPUTSKEW_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+
+class OutputSkew
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // What is kept per codec for pairing, older entries are given up
+    static constexpr size_t MAX_PENDING = 64;
+
+    struct Stats
+    {
+        long nPairs = 0;
+        // right - left, the right eye is late if > 0
+        int64_t sumSkewUs    = 0;
+        int64_t sumAbsSkewUs = 0;
+        int64_t maxAbsSkewUs = 0;
+
+        float avgAbsSkew_ms() const { return nPairs == 0 ? 0 : (float) sumAbsSkewUs / (float) nPairs / 1000.0f; }
+
+        float avgSkew_ms() const { return nPairs == 0 ? 0 : (float) sumSkewUs / (float) nPairs / 1000.0f; }
+    };
+
+    // Codec @param idx got an input buffer with @param presentationTimeUs for NALU @param seq
+    void onQueued(int idx, int64_t presentationTimeUs, uint64_t seq)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::deque<Queued>&         queued = mQueued[idx];
+        if (queued.size() == MAX_PENDING) queued.pop_front();
+        queued.push_back({presentationTimeUs, seq});
+    }
+
+    // Codec @param idx output the buffer queued with @param presentationTimeUs at @param now
+    void onOutput(int idx, int64_t presentationTimeUs, Clock::time_point now)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        // outputs come in queue order, what is in front of the buffer will not come out any more
+        std::deque<Queued>& queued = mQueued[idx];
+        while (!queued.empty() && queued.front().presentationTimeUs != presentationTimeUs) queued.pop_front();
+        if (queued.empty()) return;
+        const uint64_t seq = queued.front().seq;
+        queued.pop_front();
+        std::deque<Output>& other = mOutputs[1 - idx];
+        while (!other.empty() && other.front().seq < seq) other.pop_front();
+        if (other.empty() || other.front().seq != seq)
+        {
+            // the other codec has not output this frame yet
+            std::deque<Output>& own = mOutputs[idx];
+            if (own.size() == MAX_PENDING) own.pop_front();
+            own.push_back({seq, now});
+            return;
+        }
+        const auto skew = std::chrono::duration_cast<std::chrono::microseconds>(
+                              idx == 1 ? now - other.front().time : other.front().time - now)
+                              .count();
+        other.pop_front();
+        mStats.nPairs++;
+        mStats.sumSkewUs += skew;
+        mStats.sumAbsSkewUs += std::abs(skew);
+        if (std::abs(skew) > mStats.maxAbsSkewUs) mStats.maxAbsSkewUs = std::abs(skew);
+    }
+
+    Stats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (int idx = 0; idx < 2; idx++)
+        {
+            mQueued[idx].clear();
+            mOutputs[idx].clear();
+        }
+        mStats = {};
+    }
+
+  private:
+    struct Queued
+    {
+        int64_t  presentationTimeUs;
+        uint64_t seq;
+    };
+
+    struct Output
+    {
+        uint64_t          seq;
+        Clock::time_point time;
+    };
+
+    mutable std::mutex mMutex;
+    std::deque<Queued> mQueued[2];
+    std::deque<Output> mOutputs[2];
+    Stats              mStats;
+};
+
+#endif  // FPVUE_OUTPUTSKEW_H
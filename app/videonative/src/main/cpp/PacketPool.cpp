@@ -0,0 +1,107 @@
+//
+// PacketPool.cpp
+//
+
+#include "PacketPool.h"
+
+#include <cstring>
+
+void PacketRef::reset()
+{
+    if (mBuffer == nullptr) return;
+    if (mBuffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        if (mBuffer->pool != nullptr)
+        {
+            mBuffer->pool->release(mBuffer);
+        }
+        else
+        {
+            delete[] mBuffer->data;
+            delete mBuffer;
+        }
+    }
+    mBuffer = nullptr;
+}
+
+std::shared_ptr<PacketPool> PacketPool::create(size_t bufferSize, size_t nBuffers)
+{
+    // the constructor is private, so no make_shared
+    return std::shared_ptr<PacketPool>(new PacketPool(bufferSize, nBuffers));
+}
+
+PacketPool::PacketPool(size_t bufferSize, size_t nBuffers)
+    : mBufferSize(bufferSize),
+      mNBuffers(nBuffers),
+      mSlab(new uint8_t[bufferSize * nBuffers]),
+      mHeaders(new PacketBuffer[nBuffers])
+{
+    mFree.reserve(nBuffers);
+    // hand out the lowest addresses first
+    for (size_t i = nBuffers; i-- > 0;)
+    {
+        PacketBuffer& buffer = mHeaders[i];
+        buffer.pool          = this;
+        buffer.data          = &mSlab[i * bufferSize];
+        buffer.capacity      = bufferSize;
+        buffer.length        = 0;
+        buffer.refs          = 0;
+        mFree.push_back(&buffer);
+    }
+}
+
+PacketPool::~PacketPool() = default;
+
+PacketRef PacketPool::acquire()
+{
+    PacketBuffer* buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mFree.empty())
+        {
+            buffer = mFree.back();
+            mFree.pop_back();
+            const size_t nInUse = mNInUse.load(std::memory_order_relaxed) + 1;
+            mNInUse.store(nInUse, std::memory_order_relaxed);
+            if (nInUse > mHighWaterMark.load(std::memory_order_relaxed))
+            {
+                mHighWaterMark.store(nInUse, std::memory_order_relaxed);
+            }
+            if (nInUse == 1)
+            {
+                mSelf = shared_from_this();
+            }
+        }
+    }
+    if (buffer == nullptr)
+    {
+        mNExhausted.fetch_add(1, std::memory_order_relaxed);
+        buffer = new PacketBuffer{nullptr, new uint8_t[mBufferSize], mBufferSize, 0, {}, {}};
+    }
+    buffer->length    = 0;
+    buffer->timestamp = {};
+    buffer->refs.store(1, std::memory_order_relaxed);
+    return PacketRef(buffer);
+}
+
+PacketRef PacketPool::copyOf(const uint8_t* data, size_t length)
+{
+    auto* buffer = new PacketBuffer{nullptr, new uint8_t[length], length, length, {}, {}};
+    std::memcpy(buffer->data, data, length);
+    buffer->refs.store(1, std::memory_order_relaxed);
+    return PacketRef(buffer);
+}
+
+void PacketPool::release(PacketBuffer* buffer)
+{
+    // Destroyed after the lock is gone, this may be the last reference to the pool itself
+    std::shared_ptr<PacketPool> self;
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFree.push_back(buffer);
+    const size_t nInUse = mNInUse.load(std::memory_order_relaxed) - 1;
+    mNInUse.store(nInUse, std::memory_order_relaxed);
+    if (nInUse == 0)
+    {
+        self = std::move(mSelf);
+    }
+}
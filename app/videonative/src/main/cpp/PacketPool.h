@@ -0,0 +1,145 @@
+//
+// PacketPool.h
+// Fixed size pool of packet buffers the receivers fill directly. Buffers are handed around as ref-counted PacketRef
+// handles, so buffering / reordering a packet moves a pointer instead of allocating and copying.
+//
+
+#ifndef FPVUE_PACKETPOOL_H
+#define FPVUE_PACKETPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class PacketPool;
+
+// Header of one buffer. Owned by its pool, or by the heap if pool == nullptr.
+struct PacketBuffer
+{
+    PacketPool*           pool;
+    uint8_t*              data;
+    size_t                capacity;
+    size_t                length;
+    std::atomic<uint32_t> refs;
+    // When the datagram reached the host (kernel receive timestamp if the socket provides one), default if unknown
+    std::chrono::steady_clock::time_point timestamp;
+};
+
+/**
+ * Ref-counted handle to a PacketBuffer. Copying bumps the ref count, moving transfers it, the last handle returns
+ * the buffer to its pool. Handles may be released on any thread.
+ */
+class PacketRef
+{
+  public:
+    PacketRef() = default;
+
+    PacketRef(const PacketRef& other) : mBuffer(other.mBuffer)
+    {
+        if (mBuffer != nullptr) mBuffer->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    PacketRef(PacketRef&& other) noexcept : mBuffer(other.mBuffer) { other.mBuffer = nullptr; }
+
+    PacketRef& operator=(PacketRef other) noexcept
+    {
+        std::swap(mBuffer, other.mBuffer);
+        return *this;
+    }
+
+    ~PacketRef() { reset(); }
+
+    void reset();
+
+    explicit operator bool() const { return mBuffer != nullptr; }
+
+    uint8_t* data() const { return mBuffer->data; }
+
+    size_t size() const { return mBuffer->length; }
+
+    size_t capacity() const { return mBuffer->capacity; }
+
+    // Set the number of valid bytes, e.g. after the kernel wrote a datagram into the buffer
+    void setSize(size_t length) { mBuffer->length = length; }
+
+    std::chrono::steady_clock::time_point timestamp() const { return mBuffer->timestamp; }
+
+    void setTimestamp(std::chrono::steady_clock::time_point timestamp) { mBuffer->timestamp = timestamp; }
+
+    // True if the buffer came from a pool (not from a heap fallback)
+    bool isPooled() const { return mBuffer->pool != nullptr; }
+
+  private:
+    friend class PacketPool;
+
+    explicit PacketRef(PacketBuffer* buffer) : mBuffer(buffer) {}
+
+    PacketBuffer* mBuffer = nullptr;
+};
+
+class PacketPool : public std::enable_shared_from_this<PacketPool>
+{
+  public:
+    // Covers the wfb-ng RTP payloads (~1.4k) and the UDS path (3700)
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 4096;
+    // Receive slots of one engine + both reorder windows + one batch still held by the consumer, with headroom
+    static constexpr size_t DEFAULT_N_BUFFERS = 256;
+
+    /**
+     * The pool keeps itself alive while any of its buffers is still referenced, so handles may outlive the last
+     * shared_ptr to it.
+     */
+    static std::shared_ptr<PacketPool> create(
+        size_t bufferSize = DEFAULT_BUFFER_SIZE, size_t nBuffers = DEFAULT_N_BUFFERS);
+
+    ~PacketPool();
+
+    PacketPool(const PacketPool&)            = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    /**
+     * Take a free buffer (length 0). If all buffers are in use, a heap buffer of the same capacity is returned
+     * instead and the exhaustion counter is incremented - dropping video data is worse than one allocation.
+     */
+    PacketRef acquire();
+
+    // Unpooled buffer holding a copy of @param data, for callers that do not own a pooled buffer
+    static PacketRef copyOf(const uint8_t* data, size_t length);
+
+    size_t getBufferSize() const { return mBufferSize; }
+
+    size_t getNBuffers() const { return mNBuffers; }
+
+    size_t getNInUse() const { return mNInUse.load(std::memory_order_relaxed); }
+
+    // Max n of buffers that were in use at the same time
+    size_t getHighWaterMark() const { return mHighWaterMark.load(std::memory_order_relaxed); }
+
+    // n of acquire() calls that found the pool empty and fell back to the heap
+    long getNExhausted() const { return mNExhausted.load(std::memory_order_relaxed); }
+
+  private:
+    friend class PacketRef;
+
+    PacketPool(size_t bufferSize, size_t nBuffers);
+
+    void release(PacketBuffer* buffer);
+
+    const size_t                    mBufferSize;
+    const size_t                    mNBuffers;
+    std::unique_ptr<uint8_t[]>      mSlab;
+    std::unique_ptr<PacketBuffer[]> mHeaders;
+    std::mutex                      mMutex;
+    std::vector<PacketBuffer*>      mFree;
+    // Set while at least one buffer is in use, see create()
+    std::shared_ptr<PacketPool> mSelf;
+    std::atomic<size_t>         mNInUse        = 0;
+    std::atomic<size_t>         mHighWaterMark = 0;
+    std::atomic<long>           mNExhausted    = 0;
+};
+
+#endif  // FPVUE_PACKETPOOL_H
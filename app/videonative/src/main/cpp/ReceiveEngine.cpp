@@ -0,0 +1,415 @@
+//
+// ReceiveEngine.cpp
+//
+
+#include "ReceiveEngine.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#include "helper/AndroidLogger.hpp"
+
+#if defined(VIDEONATIVE_ENABLE_IO_URING) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define RECEIVE_ENGINE_HAS_IO_URING 1
+#else
+#define RECEIVE_ENGINE_HAS_IO_URING 0
+#endif
+
+#if RECEIVE_ENGINE_HAS_IO_URING
+// Bare syscall io_uring (no liburing in the NDK). One RECVMSG is kept in flight per batch slot, completed slots are
+// re-armed at the beginning of the next receive() call, after the caller is done with their data.
+struct ReceiveEngine::IoUring
+{
+    // user_data with this bit set belongs to an ASYNC_CANCEL sqe, not to a slot
+    static constexpr uint64_t CANCEL_TAG = 1ull << 63;
+
+    int                 fd         = -1;
+    void*               sqRing     = MAP_FAILED;
+    void*               cqRing     = MAP_FAILED;
+    size_t              sqRingSize = 0;
+    size_t              cqRingSize = 0;
+    io_uring_sqe*       sqes       = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t              sqesSize   = 0;
+    unsigned*           sqHead     = nullptr;
+    unsigned*           sqTail     = nullptr;
+    unsigned*           sqMask     = nullptr;
+    unsigned*           sqArray    = nullptr;
+    unsigned*           cqHead     = nullptr;
+    unsigned*           cqTail     = nullptr;
+    unsigned*           cqMask     = nullptr;
+    io_uring_cqe*       cqes       = nullptr;
+    std::vector<msghdr> msgs;
+    // slots that completed during the last receive() and have to be re-armed
+    std::vector<size_t> toRearm;
+    unsigned            nToSubmit = 0;
+    size_t              nInFlight = 0;
+
+    bool setup(unsigned entries)
+    {
+        io_uring_params params{};
+        fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0)
+        {
+            MLOGD << "io_uring_setup failed: " << strerror(errno);
+            return false;
+        }
+        // Without FAST_POLL every pending RECVMSG would park an io-wq worker thread
+        if (!(params.features & IORING_FEAT_FAST_POLL))
+        {
+            MLOGD << "io_uring: kernel lacks IORING_FEAT_FAST_POLL";
+            return false;
+        }
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) return false;
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            cqRing = sqRing;
+        }
+        else
+        {
+            cqRing =
+                mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) return false;
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes     = static_cast<io_uring_sqe*>(
+            mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) return false;
+
+        auto* sq = static_cast<uint8_t*>(sqRing);
+        sqHead   = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail   = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask   = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray  = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto* cq = static_cast<uint8_t*>(cqRing);
+        cqHead   = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail   = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask   = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    io_uring_sqe* nextSqe()
+    {
+        const unsigned tail  = *sqTail;
+        const unsigned index = tail & *sqMask;
+        io_uring_sqe*  sqe   = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        nToSubmit++;
+        return sqe;
+    }
+
+    void armRecvmsg(int socketFd, size_t slot)
+    {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode       = IORING_OP_RECVMSG;
+        sqe->fd           = socketFd;
+        sqe->addr         = reinterpret_cast<uint64_t>(&msgs[slot]);
+        sqe->len          = 1;
+        sqe->user_data    = slot;
+        nInFlight++;
+    }
+
+    // submit everything queued and wait for at least minComplete completions
+    int enter(unsigned minComplete)
+    {
+        const int ret =
+            (int) syscall(__NR_io_uring_enter, fd, nToSubmit, minComplete, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret >= 0) nToSubmit -= std::min<unsigned>(nToSubmit, (unsigned) ret);
+        return ret;
+    }
+
+    // Nothing may still write into the receive slots once the engine is gone
+    void cancelAndDrain()
+    {
+        if (nInFlight == 0) return;
+        for (size_t i = 0; i < msgs.size(); i++)
+        {
+            io_uring_sqe* sqe = nextSqe();
+            sqe->opcode       = IORING_OP_ASYNC_CANCEL;
+            sqe->addr         = i;
+            sqe->user_data    = CANCEL_TAG | i;
+        }
+        while (nInFlight > 0)
+        {
+            if (enter(1) < 0 && errno != EINTR) break;
+            unsigned       head = *cqHead;
+            const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++)
+            {
+                if (!(cqes[head & *cqMask].user_data & CANCEL_TAG)) nInFlight--;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    ~IoUring()
+    {
+        if (fd >= 0) cancelAndDrain();
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (fd >= 0) close(fd);
+    }
+};
+#else
+struct ReceiveEngine::IoUring
+{
+};
+#endif
+
+ReceiveEngine::ReceiveEngine(int socketFd, size_t maxDatagramSize, Backend wanted, size_t batchSize)
+    : mSocket(socketFd),
+      mMaxDatagramSize(maxDatagramSize),
+      mBatchSize(wanted == Backend::RECVFROM ? 1 : batchSize),
+      mBackend(wanted),
+      mBuffer(new uint8_t[mBatchSize * maxDatagramSize]),
+      mMsgs(mBatchSize),
+      mIovecs(mBatchSize),
+      mSources(mBatchSize),
+      mControls(mBatchSize)
+{
+    init();
+}
+
+ReceiveEngine::ReceiveEngine(int socketFd, std::shared_ptr<PacketPool> pool, Backend wanted, size_t batchSize)
+    : mSocket(socketFd),
+      mMaxDatagramSize(pool->getBufferSize()),
+      mBatchSize(wanted == Backend::RECVFROM ? 1 : batchSize),
+      mBackend(wanted),
+      mPool(std::move(pool)),
+      mSlots(mBatchSize),
+      mMsgs(mBatchSize),
+      mIovecs(mBatchSize),
+      mSources(mBatchSize),
+      mControls(mBatchSize)
+{
+    for (PacketRef& packet : mSlots) packet = mPool->acquire();
+    init();
+}
+
+void ReceiveEngine::init()
+{
+    for (size_t i = 0; i < mBatchSize; i++)
+    {
+        mIovecs[i]                   = {slot(i), mMaxDatagramSize};
+        mMsgs[i].msg_hdr             = {};
+        mMsgs[i].msg_hdr.msg_name    = &mSources[i];
+        mMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        mMsgs[i].msg_hdr.msg_iov     = &mIovecs[i];
+        mMsgs[i].msg_hdr.msg_iovlen  = 1;
+        mMsgs[i].msg_hdr.msg_control = mControls[i].data;
+    }
+    // The time the datagram spent in the socket queue is latency too, so ask the kernel when it arrived
+    const int enable = 1;
+    if (setsockopt(mSocket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) != 0)
+    {
+        MLOGD << "SO_TIMESTAMPNS not available: " << strerror(errno);
+    }
+    if (mBackend == Backend::IO_URING)
+    {
+#if RECEIVE_ENGINE_HAS_IO_URING
+        mUring = std::make_unique<IoUring>();
+        mUring->msgs.resize(mBatchSize);
+        for (size_t i = 0; i < mBatchSize; i++)
+        {
+            mUring->msgs[i] = mMsgs[i].msg_hdr;
+            mUring->toRearm.push_back(i);
+        }
+        if (!mUring->setup((unsigned) mBatchSize * 2))
+        {
+            mUring.reset();
+            mBackend = Backend::RECVMMSG;
+        }
+#else
+        mBackend = Backend::RECVMMSG;
+#endif
+    }
+    MLOGD << "Receive backend " << backendName(mBackend) << " batch " << mBatchSize << (mPool ? " pooled" : "");
+}
+
+ReceiveEngine::ClockPair ReceiveEngine::ClockPair::now()
+{
+    timespec realtime{};
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    return {std::chrono::steady_clock::now(), (int64_t) realtime.tv_sec * 1000000000 + realtime.tv_nsec};
+}
+
+std::chrono::steady_clock::time_point ReceiveEngine::arrivalOf(msghdr& hdr, const ClockPair& clocks)
+{
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPNS) continue;
+        timespec stamp{};
+        std::memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+        mNKernelTimestamps++;
+        // a realtime clock step could make this negative
+        const int64_t delayNs = clocks.realtimeNs - ((int64_t) stamp.tv_sec * 1000000000 + stamp.tv_nsec);
+        return clocks.steady - std::chrono::nanoseconds(std::max<int64_t>(delayNs, 0));
+    }
+    return clocks.steady;
+}
+
+void ReceiveEngine::take(
+    DatagramBatch&                        batch,
+    size_t                                i,
+    size_t                                length,
+    socklen_t                             sourceLength,
+    std::chrono::steady_clock::time_point arrival)
+{
+    if (!mPool)
+    {
+        batch.add(slot(i), length, PacketRef(), mSources[i], sourceLength, arrival);
+        return;
+    }
+    PacketRef      packet = std::move(mSlots[i]);
+    const uint8_t* data   = packet.data();
+    packet.setSize(length);
+    packet.setTimestamp(arrival);
+    batch.add(data, length, std::move(packet), mSources[i], sourceLength, arrival);
+    mSlots[i]           = mPool->acquire();
+    mIovecs[i].iov_base = mSlots[i].data();
+}
+
+ReceiveEngine::~ReceiveEngine() = default;
+
+const char* ReceiveEngine::backendName(Backend backend)
+{
+    switch (backend)
+    {
+        case Backend::RECVFROM:
+            return "recvfrom";
+        case Backend::RECVMMSG:
+            return "recvmmsg";
+        case Backend::IO_URING:
+            return "io_uring";
+    }
+    return "unknown";
+}
+
+int ReceiveEngine::receive(DatagramBatch& batch)
+{
+    if (batch.mDatagrams.size() < mBatchSize)
+    {
+        batch.mDatagrams.resize(mBatchSize);
+    }
+    batch.clear();
+    switch (mBackend)
+    {
+        case Backend::RECVFROM:
+            return receiveRecvfrom(batch);
+        case Backend::RECVMMSG:
+            return receiveRecvmmsg(batch);
+        case Backend::IO_URING:
+            return receiveIoUring(batch);
+    }
+    return -1;
+}
+
+int ReceiveEngine::receiveRecvfrom(DatagramBatch& batch)
+{
+    socklen_t     sourceLen = sizeof(sockaddr_storage);
+    const ssize_t n =
+        // MSG_TRUNC makes recvfrom return the real datagram length, so truncation can be detected like for recvmmsg
+        recvfrom(mSocket, slot(0), mMaxDatagramSize, MSG_TRUNC, reinterpret_cast<sockaddr*>(&mSources[0]), &sourceLen);
+    mNSyscalls++;
+    if (n < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    if ((size_t) n > mMaxDatagramSize) mNTruncated++;
+    if (n > 0)
+    {
+        // plain recvfrom() gets no control messages
+        take(batch, 0, std::min((size_t) n, mMaxDatagramSize), sourceLen, std::chrono::steady_clock::now());
+        mNDatagrams++;
+    }
+    return (int) batch.size();
+}
+
+int ReceiveEngine::receiveRecvmmsg(DatagramBatch& batch)
+{
+    for (size_t i = 0; i < mBatchSize; i++)
+    {
+        // in/out parameters, reset on every call
+        mMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        mMsgs[i].msg_hdr.msg_flags      = 0;
+        mMsgs[i].msg_hdr.msg_controllen = sizeof(ControlBuffer);
+    }
+    const int n = recvmmsg(mSocket, mMsgs.data(), (unsigned) mBatchSize, MSG_WAITFORONE, nullptr);
+    mNSyscalls++;
+    if (n < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    const ClockPair clocks = ClockPair::now();
+    for (int i = 0; i < n; i++)
+    {
+        auto& hdr = mMsgs[i].msg_hdr;
+        if (hdr.msg_flags & MSG_TRUNC) mNTruncated++;
+        // zero length "datagrams" are what a shutdown() socket returns
+        if (mMsgs[i].msg_len == 0) continue;
+        take(batch, i, mMsgs[i].msg_len, hdr.msg_namelen, arrivalOf(hdr, clocks));
+    }
+    mNDatagrams += (long) batch.size();
+    return (int) batch.size();
+}
+
+int ReceiveEngine::receiveIoUring(DatagramBatch& batch)
+{
+#if RECEIVE_ENGINE_HAS_IO_URING
+    IoUring& ring = *mUring;
+    for (const size_t i : ring.toRearm)
+    {
+        ring.msgs[i].msg_namelen = sizeof(sockaddr_storage);
+        ring.msgs[i].msg_flags      = 0;
+        ring.msgs[i].msg_controllen = sizeof(ControlBuffer);
+        ring.armRecvmsg(mSocket, i);
+    }
+    ring.toRearm.clear();
+    const int ret = ring.enter(1);
+    mNSyscalls++;
+    if (ret < 0)
+    {
+        return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+    }
+    const ClockPair clocks = ClockPair::now();
+    unsigned        head = *ring.cqHead;
+    const unsigned  tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+        const io_uring_cqe& cqe = ring.cqes[head & *ring.cqMask];
+        const size_t        i   = (size_t) cqe.user_data;
+        ring.nInFlight--;
+        ring.toRearm.push_back(i);
+        if (ring.msgs[i].msg_flags & MSG_TRUNC) mNTruncated++;
+        if (cqe.res <= 0)
+        {
+            if (cqe.res < 0 && cqe.res != -EAGAIN && cqe.res != -EINTR)
+            {
+                MLOGE << "io_uring recvmsg error " << strerror(-cqe.res);
+            }
+            continue;
+        }
+        take(batch, i, (size_t) cqe.res, ring.msgs[i].msg_namelen, arrivalOf(ring.msgs[i], clocks));
+    }
+    __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    mNDatagrams += (long) batch.size();
+    return (int) batch.size();
+#else
+    return -1;
+#endif
+}
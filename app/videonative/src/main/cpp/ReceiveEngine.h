@@ -0,0 +1,212 @@
+//
+// ReceiveEngine.h
+// Drains a datagram socket in batches instead of issuing one recvfrom() per packet.
+// Shared by UDPReceiver and UDSReceiver.
+//
+
+#ifndef FPVUE_RECEIVEENGINE_H
+#define FPVUE_RECEIVEENGINE_H
+
+#include <sys/socket.h>
+#include <time.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "PacketPool.h"
+
+// One datagram inside a DatagramBatch. The memory is owned by the ReceiveEngine and only valid until the next
+// call to ReceiveEngine::receive(), unless the engine receives into a PacketPool - then a copy of @ref packet keeps
+// the data alive for as long as the consumer needs it.
+struct Datagram
+{
+    const uint8_t* data;
+    size_t         length;
+    // empty if the engine has no PacketPool
+    PacketRef packet;
+    // When the kernel received the datagram (SO_TIMESTAMPNS) mapped onto steady_clock, or when receive() returned it
+    // if the socket does not provide timestamps. Also stored in @ref packet.
+    std::chrono::steady_clock::time_point arrival;
+};
+
+// All datagrams returned by one ReceiveEngine::receive() call, in the order the kernel handed them out
+class DatagramBatch
+{
+  public:
+    const Datagram* begin() const { return mDatagrams.data(); }
+
+    const Datagram* end() const { return mDatagrams.data() + mCount; }
+
+    const Datagram& operator[](size_t i) const { return mDatagrams[i]; }
+
+    size_t size() const { return mCount; }
+
+    bool empty() const { return mCount == 0; }
+
+    // sum of all datagram lengths in this batch
+    size_t totalBytes() const { return mTotalBytes; }
+
+    // Address of the sender of the last datagram in this batch.
+    // The sender is tracked once per batch, not once per packet.
+    const sockaddr_storage& lastSource() const { return mLastSource; }
+
+    socklen_t lastSourceLength() const { return mLastSourceLength; }
+
+  private:
+    friend class ReceiveEngine;
+
+    void clear()
+    {
+        // give the buffers back to the pool before the engine asks for new ones
+        for (size_t i = 0; i < mCount; i++) mDatagrams[i].packet.reset();
+        mCount            = 0;
+        mTotalBytes       = 0;
+        mLastSourceLength = 0;
+    }
+
+    void add(
+        const uint8_t*                        data,
+        size_t                                length,
+        PacketRef                             packet,
+        const sockaddr_storage&               source,
+        socklen_t                             sourceLength,
+        std::chrono::steady_clock::time_point arrival)
+    {
+        mDatagrams[mCount++] = {data, length, std::move(packet), arrival};
+        mTotalBytes += length;
+        mLastSource       = source;
+        mLastSourceLength = sourceLength;
+    }
+
+    std::vector<Datagram> mDatagrams;
+    size_t                mCount            = 0;
+    size_t                mTotalBytes       = 0;
+    sockaddr_storage      mLastSource       = {};
+    socklen_t             mLastSourceLength = 0;
+};
+
+class ReceiveEngine
+{
+  public:
+    enum class Backend
+    {
+        // one recvfrom() per datagram, the pre-batching behaviour
+        RECVFROM,
+        // recvmmsg(MSG_WAITFORONE): block for the first datagram, then take whatever is queued
+        RECVMMSG,
+        // io_uring with one RECVMSG in flight per batch slot. Only compiled with VIDEONATIVE_ENABLE_IO_URING and
+        // only used if the running kernel (and seccomp policy) allows io_uring_setup, else falls back to RECVMMSG.
+        IO_URING
+    };
+
+    static constexpr size_t DEFAULT_BATCH_SIZE = 32;
+
+    /**
+     * @param socketFd bound datagram socket. Not owned, the caller closes it after the engine has been destroyed.
+     * @param maxDatagramSize size of each receive slot. Larger datagrams are truncated (and counted).
+     * @param wanted backend to use, falls back to the next simpler one if not available.
+     * @param batchSize max n of datagrams returned per receive() call.
+     */
+    ReceiveEngine(
+        int     socketFd,
+        size_t  maxDatagramSize,
+        Backend wanted    = Backend::RECVMMSG,
+        size_t  batchSize = DEFAULT_BATCH_SIZE);
+
+    /**
+     * Same as above, but the kernel writes straight into buffers of @param pool (one per batch slot, replaced as soon
+     * as a datagram was taken out). The datagram size is limited to the pool's buffer size.
+     */
+    ReceiveEngine(
+        int                         socketFd,
+        std::shared_ptr<PacketPool> pool,
+        Backend                     wanted    = Backend::RECVMMSG,
+        size_t                      batchSize = DEFAULT_BATCH_SIZE);
+
+    ~ReceiveEngine();
+
+    ReceiveEngine(const ReceiveEngine&)            = delete;
+    ReceiveEngine& operator=(const ReceiveEngine&) = delete;
+
+    /**
+     * Blocks until at least one datagram has arrived, then drains everything that is already queued (up to the batch
+     * size) without blocking again. The datagrams stay valid until the next call.
+     * @return number of datagrams in @param batch, 0 if interrupted (timeout, signal, shutdown()), -1 on error.
+     */
+    int receive(DatagramBatch& batch);
+
+    Backend getBackend() const { return mBackend; }
+
+    static const char* backendName(Backend backend);
+
+    // n of receive syscalls issued so far. nSyscalls / nDatagrams is the batching efficiency.
+    long getNSyscalls() const { return mNSyscalls; }
+
+    long getNDatagrams() const { return mNDatagrams; }
+
+    long getNTruncated() const { return mNTruncated; }
+
+    // n of datagrams that came with a kernel receive timestamp
+    long getNKernelTimestamps() const { return mNKernelTimestamps; }
+
+  private:
+    // Room for one SCM_TIMESTAMPNS control message
+    struct alignas(cmsghdr) ControlBuffer
+    {
+        uint8_t data[CMSG_SPACE(sizeof(timespec))];
+    };
+
+    // Clock readings taken once per batch, to map kernel (CLOCK_REALTIME) timestamps onto steady_clock
+    struct ClockPair
+    {
+        std::chrono::steady_clock::time_point steady;
+        int64_t                               realtimeNs;
+
+        static ClockPair now();
+    };
+
+    void init();
+
+    int receiveRecvfrom(DatagramBatch& batch);
+
+    int receiveRecvmmsg(DatagramBatch& batch);
+
+    int receiveIoUring(DatagramBatch& batch);
+
+    uint8_t* slot(size_t i) const { return mPool ? mSlots[i].data() : &mBuffer[i * mMaxDatagramSize]; }
+
+    // Move the datagram in slot @param i into @param batch. With a pool the slot gets a fresh buffer.
+    void take(
+        DatagramBatch&                        batch,
+        size_t                                i,
+        size_t                                length,
+        socklen_t                             sourceLength,
+        std::chrono::steady_clock::time_point arrival);
+
+    // Arrival time of the datagram received with @param hdr, from its SCM_TIMESTAMPNS if there is one
+    std::chrono::steady_clock::time_point arrivalOf(msghdr& hdr, const ClockPair& clocks);
+
+    const int    mSocket;
+    const size_t mMaxDatagramSize;
+    const size_t mBatchSize;
+    Backend      mBackend;
+    // One receive slot per batch entry, either one pooled buffer each or parts of mBuffer.
+    // mBuffer is not value-initialized on purpose, pages we never write stay uncommitted.
+    const std::shared_ptr<PacketPool> mPool;
+    std::vector<PacketRef>            mSlots;
+    std::unique_ptr<uint8_t[]>        mBuffer;
+    std::vector<mmsghdr>              mMsgs;
+    std::vector<iovec>                mIovecs;
+    std::vector<sockaddr_storage>     mSources;
+    std::vector<ControlBuffer>        mControls;
+    long                              mNSyscalls         = 0;
+    long                              mNDatagrams        = 0;
+    long                              mNTruncated        = 0;
+    long                              mNKernelTimestamps = 0;
+
+    struct IoUring;
+    std::unique_ptr<IoUring> mUring;
+};
+
+#endif  // FPVUE_RECEIVEENGINE_H
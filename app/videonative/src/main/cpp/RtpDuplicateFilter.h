@@ -0,0 +1,86 @@
+//
+// RtpDuplicateFilter.h
+// Drops RTP packets whose sequence number was already seen, e.g. when the same stream arrives on two inputs.
+//
+
+#ifndef FPVUE_RTPDUPLICATEFILTER_H
+#define FPVUE_RTPDUPLICATEFILTER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+class RtpDuplicateFilter
+{
+  public:
+    // Sequence numbers remembered behind the newest one
+    static constexpr size_t WINDOW_SIZE = 512;
+
+    /**
+     * Marks @param seq as seen.
+     * @return true if it was already seen within the last WINDOW_SIZE sequence numbers.
+     * Packets older than the window are never reported as duplicates, the reorder queue deals with them.
+     */
+    bool isDuplicate(uint16_t seq)
+    {
+        if (!mInitialized)
+        {
+            mInitialized = true;
+            mNewest      = seq;
+            mark(seq);
+            return false;
+        }
+        const auto ahead = static_cast<int16_t>(seq - mNewest);
+        if (ahead > 0)
+        {
+            // slide the window, forgetting the sequence numbers it passes over
+            if (static_cast<size_t>(ahead) >= WINDOW_SIZE)
+            {
+                mSeen.fill(0);
+            }
+            else
+            {
+                for (uint16_t s = mNewest + 1; s != seq; s++) clear(s);
+            }
+            mNewest = seq;
+            mark(seq);
+            return false;
+        }
+        if (static_cast<size_t>(-ahead) >= WINDOW_SIZE)
+        {
+            return false;
+        }
+        if (isMarked(seq))
+        {
+            mNDuplicates++;
+            return true;
+        }
+        mark(seq);
+        return false;
+    }
+
+    long getNDuplicates() const { return mNDuplicates; }
+
+    void reset()
+    {
+        mInitialized = false;
+        mSeen.fill(0);
+    }
+
+  private:
+    static constexpr size_t MASK = WINDOW_SIZE - 1;
+    static_assert((WINDOW_SIZE & MASK) == 0, "WINDOW_SIZE must be a power of two");
+
+    void mark(uint16_t seq) { mSeen[(seq & MASK) / 64] |= uint64_t{1} << (seq & 63); }
+
+    void clear(uint16_t seq) { mSeen[(seq & MASK) / 64] &= ~(uint64_t{1} << (seq & 63)); }
+
+    bool isMarked(uint16_t seq) const { return mSeen[(seq & MASK) / 64] >> (seq & 63) & 1; }
+
+    bool                                   mInitialized = false;
+    uint16_t                               mNewest      = 0;
+    std::array<uint64_t, WINDOW_SIZE / 64> mSeen{};
+    long                                   mNDuplicates = 0;
+};
+
+#endif  // FPVUE_RTPDUPLICATEFILTER_H
@@ -0,0 +1,64 @@
+//
+// RtpJitterEstimator.h
+// RFC 3550 (6.4.1, A.8) interarrival jitter of one RTP stream: the smoothed variation of the transit time between the
+// sender's RTP timestamps and our receive timestamps. Independent of clock offset and of the reorder queue.
+//
+
+#ifndef FPVUE_RTPJITTERESTIMATOR_H
+#define FPVUE_RTPJITTERESTIMATOR_H
+
+#include <chrono>
+#include <cstdint>
+
+class RtpJitterEstimator
+{
+  public:
+    // H.264 / H.265 over RTP always use a 90 kHz clock
+    static constexpr uint32_t VIDEO_CLOCK_RATE = 90000;
+
+    explicit RtpJitterEstimator(uint32_t clockRate = VIDEO_CLOCK_RATE) : mClockRate(clockRate) {}
+
+    /**
+     * Feed one packet, in the order the packets were received.
+     * @param rtpTimestamp timestamp from the RTP header (host byte order).
+     * @param arrival when the packet was received, ideally the kernel timestamp.
+     */
+    void add(uint32_t rtpTimestamp, std::chrono::steady_clock::time_point arrival)
+    {
+        const auto arrivalUs = std::chrono::duration_cast<std::chrono::microseconds>(arrival.time_since_epoch());
+        // arrival in RTP timestamp units, the transit time only has to be right modulo 2^32
+        const auto arrivalTs = static_cast<uint32_t>(static_cast<uint64_t>(arrivalUs.count()) * mClockRate / 1000000);
+        const auto transit   = static_cast<uint32_t>(arrivalTs - rtpTimestamp);
+        if (mHasTransit)
+        {
+            int32_t d = static_cast<int32_t>(transit - mLastTransit);
+            if (d < 0) d = -d;
+            // J += (|D| - J) / 16, kept scaled by 16 as in RFC 3550 A.8
+            mJitterQ4 += d - ((mJitterQ4 + 8) >> 4);
+        }
+        mLastTransit = transit;
+        mHasTransit  = true;
+    }
+
+    // Current jitter in RTP timestamp units
+    uint32_t getJitter() const { return static_cast<uint32_t>(mJitterQ4 >> 4); }
+
+    std::chrono::microseconds getJitterTime() const
+    {
+        return std::chrono::microseconds(static_cast<int64_t>(mJitterQ4 >> 4) * 1000000 / mClockRate);
+    }
+
+    void reset()
+    {
+        mHasTransit = false;
+        mJitterQ4   = 0;
+    }
+
+  private:
+    const uint32_t mClockRate;
+    bool           mHasTransit  = false;
+    uint32_t       mLastTransit = 0;
+    int64_t        mJitterQ4    = 0;
+};
+
+#endif  // FPVUE_RTPJITTERESTIMATOR_H
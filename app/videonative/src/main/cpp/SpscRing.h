@@ -0,0 +1,82 @@
+//
+// SpscRing.h
+// Bounded lock-free ring between exactly one producer and one consumer thread. The slots are constructed once and
+// reused, so a T that owns a buffer (e.g. a std::vector) keeps its capacity and the steady state does not allocate.
+//
+
+#ifndef FPVUE_SPSCRING_H
+#define FPVUE_SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+template <typename T>
+class SpscRing
+{
+  public:
+    // @param capacity rounded up to a power of two
+    explicit SpscRing(size_t capacity)
+    {
+        while (mCapacity < capacity) mCapacity *= 2;
+        mMask  = mCapacity - 1;
+        mSlots = std::make_unique<T[]>(mCapacity);
+    }
+
+    SpscRing(const SpscRing&)            = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /**
+     * Producer: the slot to fill next, nullptr if the ring is full. The slot still holds whatever was written to it
+     * one lap ago. Nothing is visible to the consumer until publish().
+     */
+    T* writeSlot()
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHeadCache == mCapacity)
+        {
+            mHeadCache = mHead.load(std::memory_order_acquire);
+            if (tail - mHeadCache == mCapacity) return nullptr;
+        }
+        return &mSlots[tail & mMask];
+    }
+
+    // Producer: hand the slot returned by writeSlot() to the consumer
+    void publish() { mTail.store(mTail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer: the oldest published slot, nullptr if the ring is empty
+    T* readSlot()
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTailCache)
+        {
+            mTailCache = mTail.load(std::memory_order_acquire);
+            if (head == mTailCache) return nullptr;
+        }
+        return &mSlots[head & mMask];
+    }
+
+    // Consumer: done with the slot returned by readSlot(), the producer may reuse it
+    void release() { mHead.store(mHead.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Number of published, not yet released slots. Exact on either side, a snapshot from any other thread.
+    size_t size() const { return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire); }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const { return mCapacity; }
+
+  private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    size_t               mCapacity = 1;
+    size_t               mMask     = 0;
+    std::unique_ptr<T[]> mSlots;
+    // Each index and the other side's cached copy of it live on their own cache line
+    alignas(CACHE_LINE) std::atomic<size_t> mHead{0};
+    size_t mTailCache = 0;
+    alignas(CACHE_LINE) std::atomic<size_t> mTail{0};
+    size_t mHeadCache = 0;
+};
+
+#endif  // FPVUE_SPSCRING_H
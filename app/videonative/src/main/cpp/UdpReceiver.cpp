@@ -4,7 +4,6 @@
 
 #include "UdpReceiver.h"
 #include <arpa/inet.h>
-#include <array>
 #include <sstream>
 #include <utility>
 #include <vector>
@@ -30,6 +29,25 @@ UDPReceiver::UDPReceiver(
 {
 }
 
+UDPReceiver::UDPReceiver(
+    JavaVM*                javaVm,
+    int                    port,
+    std::string            name,
+    int                    CPUPriority,
+    BATCH_DATA_CALLBACK    onBatchReceivedCallback,
+    size_t                 WANTED_RCVBUF_SIZE,
+    ReceiveEngine::Backend backend)
+    : mPort(port),
+      mName(std::move(name)),
+      WANTED_RCVBUF_SIZE(WANTED_RCVBUF_SIZE),
+      mCPUPriority(CPUPriority),
+      onBatchReceivedCallback(std::move(onBatchReceivedCallback)),
+      mBackend(backend),
+      mPool(PacketPool::create()),
+      javaVm(javaVm)
+{
+}
+
 void UDPReceiver::registerOnSourceIPFound(SOURCE_IP_CALLBACK onSourceIP1)
 {
     this->onSourceIP = std::move(onSourceIP1);
@@ -42,7 +60,23 @@ long UDPReceiver::getNReceivedBytes() const
 
 std::string UDPReceiver::getSourceIPAddress() const
 {
-    return senderIP;
+    in_addr addr{};
+    addr.s_addr = senderAddr;
+    char buff[INET_ADDRSTRLEN];
+    return inet_ntop(AF_INET, &addr, buff, sizeof(buff)) ? std::string(buff) : std::string("0.0.0.0");
+}
+
+void UDPReceiver::updateSenderIP(const DatagramBatch& batch)
+{
+    if (batch.lastSourceLength() < sizeof(sockaddr_in) || batch.lastSource().ss_family != AF_INET)
+    {
+        return;
+    }
+    const uint32_t addr = reinterpret_cast<const sockaddr_in&>(batch.lastSource()).sin_addr.s_addr;
+    if (senderAddr.exchange(addr) != addr && onSourceIP != nullptr)
+    {
+        onSourceIP(getSourceIPAddress());
+    }
 }
 
 void UDPReceiver::startReceiving()
@@ -66,95 +100,106 @@ void UDPReceiver::stopReceiving()
     mUDPReceiverThread.reset();
 }
 
-void UDPReceiver::receiveFromUDPLoop()
+int UDPReceiver::openSocket(int port, size_t wantedRcvbufSize)
 {
-    mSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (mSocket == -1)
+    const int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd == -1)
     {
         MLOGD << "Error creating socket";
-        return;
+        return -1;
     }
     int enable = 1;
-    if (setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int)) < 0)
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int)) < 0)
     {
         MLOGD << "Error setting reuse";
     }
     int       recvBufferSize = 0;
     socklen_t len            = sizeof(recvBufferSize);
-    getsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, &recvBufferSize, &len);
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &recvBufferSize, &len);
     MLOGD << "Default socket recv buffer is " << StringHelper::memorySizeReadable(recvBufferSize);
 
-    if (WANTED_RCVBUF_SIZE > recvBufferSize)
+    if (wantedRcvbufSize > recvBufferSize)
     {
-        recvBufferSize = WANTED_RCVBUF_SIZE;
-        if (setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, &WANTED_RCVBUF_SIZE, len))
+        recvBufferSize = wantedRcvbufSize;
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &wantedRcvbufSize, len))
         {
-            MLOGD << "Cannot increase buffer size to " << StringHelper::memorySizeReadable(WANTED_RCVBUF_SIZE);
+            MLOGD << "Cannot increase buffer size to " << StringHelper::memorySizeReadable(wantedRcvbufSize);
         }
-        getsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, &recvBufferSize, &len);
-        MLOGD << "Wanted " << StringHelper::memorySizeReadable(WANTED_RCVBUF_SIZE) << " Set "
+        getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &recvBufferSize, &len);
+        MLOGD << "Wanted " << StringHelper::memorySizeReadable(wantedRcvbufSize) << " Set "
               << StringHelper::memorySizeReadable(recvBufferSize);
     }
+    struct sockaddr_in myaddr;
+    memset((uint8_t*) &myaddr, 0, sizeof(myaddr));
+    myaddr.sin_family      = AF_INET;
+    myaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    myaddr.sin_port        = htons(port);
+    if (bind(fd, (struct sockaddr*) &myaddr, sizeof(myaddr)) == -1)
+    {
+        MLOGE << "Error binding Port; " << port;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void UDPReceiver::receiveFromUDPLoop()
+{
     if (javaVm != nullptr)
     {
 #ifdef __ANDROID__
         NDKThreadHelper::setProcessThreadPriorityAttachDetach(javaVm, mCPUPriority, mName.c_str());
 #endif
     }
-    struct sockaddr_in myaddr;
-    memset((uint8_t*) &myaddr, 0, sizeof(myaddr));
-    myaddr.sin_family      = AF_INET;
-    myaddr.sin_addr.s_addr = htonl(INADDR_ANY);
-    myaddr.sin_port        = htons(mPort);
-    if (bind(mSocket, (struct sockaddr*) &myaddr, sizeof(myaddr)) == -1)
+    mSocket = openSocket(mPort, WANTED_RCVBUF_SIZE);
+    if (mSocket == -1)
     {
-        MLOGE << "Error binding Port; " << mPort;
         return;
     }
-    // wrap into unique pointer to avoid running out of stack
-    const auto buff = std::make_unique<std::array<uint8_t, UDP_PACKET_MAX_SIZE>>();
-
-    MLOGD << "Listening on " << INADDR_ANY << ":" << mPort;
+    // The engine owns the receive slots (one per batch entry)
+    auto engine = mPool ? std::make_unique<ReceiveEngine>(mSocket, mPool, mBackend)
+                        : std::make_unique<ReceiveEngine>(mSocket, UDP_PACKET_MAX_SIZE, mBackend);
+    DatagramBatch batch;
 
-    sockaddr_in source;
-    socklen_t   sourceLen = sizeof(sockaddr_in);
+    MLOGD << "Listening on " << INADDR_ANY << ":" << mPort << " using "
+          << ReceiveEngine::backendName(engine->getBackend());
 
     while (receiving)
     {
-        // TODO investigate: does a big buffer size create latency with MSG_WAITALL ?
-        // I do not think so. recvfrom should return as soon as new data arrived,not when the buffer is full
-        // But with a bigger buffer we do not loose packets when the receiver thread cannot keep up for a short amount
-        // of time
-        //  MSG_WAITALL does not wait until we have __n data, but a new UDP packet (that can be smaller than __n)
-        const ssize_t message_length =
-            recvfrom(mSocket, buff->data(), UDP_PACKET_MAX_SIZE, 0, (sockaddr*) &source, &sourceLen);
-        // ssize_t message_length = recv(mSocket, buff, (size_t) mBuffsize, MSG_WAITALL);
-        if (message_length > 0)
-        {  // else -1 was returned;timeout/No data received
-            onDataReceivedCallback(buff->data(), (size_t) message_length);
-
-            nReceivedBytes += message_length;
-            // The source ip stuff
-            const char* p  = inet_ntoa(source.sin_addr);
-            std::string s1 = std::string(p);
-            // MLOGE << "received " << message_length <<  " bytes from " << s1;
-            if (senderIP != s1)
+        // The engine blocks until at least one datagram arrived, then takes everything that is already queued.
+        // With a bigger socket buffer we do not loose packets when the receiver thread cannot keep up for a short
+        // amount of time, and catching up after such a stall costs one syscall per batch instead of one per packet.
+        const int n = engine->receive(batch);
+        if (n > 0)
+        {
+            if (onBatchReceivedCallback != nullptr)
             {
-                senderIP = s1;
+                onBatchReceivedCallback(batch);
             }
-            if (onSourceIP != nullptr)
+            else
             {
-                onSourceIP(p);
+                for (const Datagram& datagram : batch)
+                {
+                    onDataReceivedCallback(datagram.data, datagram.length);
+                }
             }
+            nReceivedBytes += (long) batch.totalBytes();
+            mMetricPackets.add(n);
+            mMetricBytes.add((int64_t) batch.totalBytes());
+            updateSenderIP(batch);
         }
-        else
+        else if (n < 0)
         {
-            if (errno != EWOULDBLOCK)
-            {
-                MLOGE << "Error on recvfrom. errno=" << errno << " " << strerror(errno);
-            }
+            MLOGE << "Error on receive. errno=" << errno << " " << strerror(errno);
         }
     }
+    if (mPool)
+    {
+        MLOGD << "Packet pool: high water " << mPool->getHighWaterMark() << "/" << mPool->getNBuffers()
+              << " exhausted " << mPool->getNExhausted() << " truncated " << engine->getNTruncated();
+    }
+    // release the receive slots before the socket goes away
+    engine.reset();
     close(mSocket);
 }
 
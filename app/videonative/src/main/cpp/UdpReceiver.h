@@ -13,13 +13,17 @@
 #include <cstdio>
 #include <iostream>
 #include <thread>
+#include "Metrics.h"
+#include "ReceiveEngine.h"
 // Starts a new thread that continuously checks for new data on UDP port
 
 class UDPReceiver
 {
   public:
     typedef std::function<void(const uint8_t[], size_t)> DATA_CALLBACK;
-    typedef std::function<void(const std::string)>       SOURCE_IP_CALLBACK;
+    // Called once per drained batch instead of once per datagram
+    typedef std::function<void(const DatagramBatch&)> BATCH_DATA_CALLBACK;
+    typedef std::function<void(const std::string)>    SOURCE_IP_CALLBACK;
 
   public:
     /**
@@ -43,7 +47,23 @@ class UDPReceiver
         size_t        WANTED_RCVBUF_SIZE = 0);
 
     /**
-     * Register a callback that is called once and contains the IP address of the first received packet's sender
+     * Same as above, but @param onBatchReceivedCallback is called with every batch of datagrams drained from the
+     * socket in one go. @param backend selects how the socket is drained (see ReceiveEngine)
+     * The datagrams are received straight into PacketPool buffers (max PacketPool::DEFAULT_BUFFER_SIZE bytes each),
+     * so the consumer can keep them (Datagram::packet) without copying.
+     */
+    UDPReceiver(
+        JavaVM*                javaVm,
+        int                    port,
+        std::string            name,
+        int                    CPUPriority,
+        BATCH_DATA_CALLBACK    onBatchReceivedCallback,
+        size_t                 WANTED_RCVBUF_SIZE = 0,
+        ReceiveEngine::Backend backend            = ReceiveEngine::Backend::RECVMMSG);
+
+    /**
+     * Register a callback that is called every time the sender IP address changes (so at least once, with the IP
+     * address of the first received packet's sender)
      */
     void registerOnSourceIPFound(SOURCE_IP_CALLBACK onSourceIP1);
 
@@ -64,21 +84,40 @@ class UDPReceiver
 
     int getPort() const;
 
+    /**
+     * Create a UDP socket bound to INADDR_ANY:@param port, with the receive buffer raised to @param wantedRcvbufSize
+     * if possible (0 leaves it untouched). Also used by IngestReactor.
+     * @return the socket, -1 on error
+     */
+    static int openSocket(int port, size_t wantedRcvbufSize);
+
+    // nullptr for the DATA_CALLBACK variant
+    std::shared_ptr<const PacketPool> getPacketPool() const { return mPool; }
+
   private:
     void receiveFromUDPLoop();
 
-    const DATA_CALLBACK onDataReceivedCallback = nullptr;
-    SOURCE_IP_CALLBACK  onSourceIP             = nullptr;
-    const int           mPort;
-    const int           mCPUPriority;
+    // Tracks the sender once per batch, only formats a string if the address changed
+    void updateSenderIP(const DatagramBatch& batch);
+
+    const DATA_CALLBACK               onDataReceivedCallback  = nullptr;
+    const BATCH_DATA_CALLBACK         onBatchReceivedCallback = nullptr;
+    SOURCE_IP_CALLBACK                onSourceIP              = nullptr;
+    const ReceiveEngine::Backend      mBackend                = ReceiveEngine::Backend::RECVMMSG;
+    const std::shared_ptr<PacketPool> mPool;
+    const int                         mPort;
+    const int                         mCPUPriority;
     // Hmm....
     const size_t      WANTED_RCVBUF_SIZE;
     const std::string mName;
     /// We need this reference to stop the receiving thread
     int                          mSocket        = 0;
-    std::string                  senderIP       = "0.0.0.0";
+    // IPv4 address of the last sender in network byte order, 0 == none yet
+    std::atomic<uint32_t>        senderAddr     = 0;
     std::atomic<bool>            receiving      = false;
     std::atomic<long>            nReceivedBytes = 0;
+    Metrics::Counter&            mMetricPackets = Metrics::global().counter("net_received_packets");
+    Metrics::Counter&            mMetricBytes   = Metrics::global().counter("net_received_bytes");
     std::unique_ptr<std::thread> mUDPReceiverThread;
     // https://en.wikipedia.org/wiki/User_Datagram_Protocol
     // 65,507 bytes (65,535 − 8 byte UDP header − 20 byte IP header).
@@ -1,6 +1,5 @@
 #include "UdsReceiver.h"
 
-#include <array>
 #include <cstring>
 #include "helper/AndroidLogger.hpp"
 #include "helper/NDKThreadHelper.hpp"
@@ -21,6 +20,43 @@ UDSReceiver::UDSReceiver(JavaVM* jvm, std::string path, std::string name, int pr
 {
 }
 
+UDSReceiver::UDSReceiver(
+    JavaVM*                jvm,
+    std::string            path,
+    std::string            name,
+    int                    prio,
+    BATCH_DATA_CALLBACK    cb,
+    size_t                 wanted,
+    ReceiveEngine::Backend backend)
+    : mSocketPath(std::move(path)),
+      mName(std::move(name)),
+      WANTED_RCVBUF_SIZE(wanted),
+      mCPUPriority(prio),
+      onBatch(std::move(cb)),
+      mBackend(backend),
+      mPool(PacketPool::create()),
+      javaVm(jvm)
+{
+}
+
+void UDSReceiver::updateSenderPath(const DatagramBatch& batch)
+{
+    const auto& peer = reinterpret_cast<const sockaddr_un&>(batch.lastSource());
+    if (batch.lastSourceLength() <= offsetof(sockaddr_un, sun_path) || peer.sun_path[0] == '\0')
+    {
+        // unnamed or abstract peer
+        return;
+    }
+    const size_t maxLen = batch.lastSourceLength() - offsetof(sockaddr_un, sun_path);
+    const size_t len    = strnlen(peer.sun_path, maxLen);
+    if (senderPath.size() == len && senderPath.compare(0, len, peer.sun_path, len) == 0)
+    {
+        return;
+    }
+    senderPath.assign(peer.sun_path, len);
+    if (onSource) onSource(senderPath.c_str());
+}
+
 void UDSReceiver::startReceiving()
 {
     receiving = true;
@@ -38,23 +74,23 @@ void UDSReceiver::stopReceiving()
     mThread.reset();
 }
 
-void UDSReceiver::receiveLoop()
+int UDSReceiver::openSocket(const std::string& socketPath, size_t wantedRcvbufSize)
 {
-    mSocket = socket(AF_UNIX, SOCK_DGRAM, 0);
-    if (mSocket == -1)
+    const int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd == -1)
     {
         MLOGE << "socket(AF_UNIX) failed: " << strerror(errno);
-        return;
+        return -1;
     }
 
     // upscale recv buf (same logic as UDP)
     int       cur = 0;
     socklen_t len = sizeof(cur);
-    getsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, &cur, &len);
-    if (WANTED_RCVBUF_SIZE > static_cast<size_t>(cur))
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &cur, &len);
+    if (wantedRcvbufSize > static_cast<size_t>(cur))
     {
-        setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, &WANTED_RCVBUF_SIZE, len);
-        getsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, &cur, &len);
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &wantedRcvbufSize, len);
+        getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &cur, &len);
         MLOGD << "UDS recvbuf set to " << StringHelper::memorySizeReadable(cur);
     }
 
@@ -63,28 +99,37 @@ void UDSReceiver::receiveLoop()
     addr.sun_family = AF_UNIX;
     socklen_t addrlen;
 
-    if (!mSocketPath.empty() && mSocketPath[0] == '\0')
+    if (!socketPath.empty() && socketPath[0] == '\0')
     {
         // abstract namespace: copy full blob (leading '\0' + name)
-        memcpy(addr.sun_path, mSocketPath.data(), mSocketPath.size());
+        memcpy(addr.sun_path, socketPath.data(), socketPath.size());
         // length = offsetof + full name length
-        addrlen = offsetof(sockaddr_un, sun_path) + static_cast<socklen_t>(mSocketPath.size());
+        addrlen = offsetof(sockaddr_un, sun_path) + static_cast<socklen_t>(socketPath.size());
     }
     else
     {
         // filesystem socket: unlink old, strncpy, bind whole struct
-        std::strncpy(addr.sun_path, mSocketPath.c_str(), sizeof(addr.sun_path) - 1);
-        unlink(mSocketPath.c_str());
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(socketPath.c_str());
         addrlen = sizeof(addr);
     }
 
-    if (bind(mSocket, reinterpret_cast<sockaddr*>(&addr), addrlen) == -1)
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), addrlen) == -1)
     {
         // show "@abstract:name" if abstract, else full path
-        std::string what = (mSocketPath[0] == '\0') ? "@abstract:" + mSocketPath.substr(1) : mSocketPath;
+        std::string what = (socketPath[0] == '\0') ? "@abstract:" + socketPath.substr(1) : socketPath;
         MLOGE << "bind(" << what << ") failed: " << strerror(errno);
-        close(mSocket);
-        mSocket = -1;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void UDSReceiver::receiveLoop()
+{
+    mSocket = openSocket(mSocketPath, WANTED_RCVBUF_SIZE);
+    if (mSocket == -1)
+    {
         return;
     }
 
@@ -92,36 +137,41 @@ void UDSReceiver::receiveLoop()
     if (javaVm) NDKThreadHelper::setProcessThreadPriorityAttachDetach(javaVm, mCPUPriority, mName.c_str());
 #endif
 
-    const auto buf = std::make_unique<std::array<uint8_t, MAX_PKT>>();
-    MLOGD << "UDS listening on '" << mSocketPath << '\'';
-
-    sockaddr_un peer{};
-    socklen_t   peerLen = sizeof(peer);
+    auto engine = mPool ? std::make_unique<ReceiveEngine>(mSocket, mPool, mBackend)
+                        : std::make_unique<ReceiveEngine>(mSocket, MAX_PKT, mBackend);
+    DatagramBatch batch;
+    MLOGD << "UDS listening on '" << mSocketPath << "' using " << ReceiveEngine::backendName(engine->getBackend());
 
     while (receiving)
     {
-        ssize_t n = recvfrom(mSocket, buf->data(), buf->size(), 0, reinterpret_cast<sockaddr*>(&peer), &peerLen);
+        const int n = engine->receive(batch);
         if (n > 0)
         {
-            onData(buf->data(), static_cast<size_t>(n));
-            nReceivedBytes += n;
-
-            if (peer.sun_path[0] != '\0')
+            if (onBatch)
             {
-                std::string p(peer.sun_path);
-                if (p != senderPath)
-                {
-                    senderPath = p;
-                    if (onSource) onSource(senderPath.c_str());
-                }
+                onBatch(batch);
             }
+            else
+            {
+                for (const Datagram& datagram : batch) onData(datagram.data, datagram.length);
+            }
+            nReceivedBytes += (long) batch.totalBytes();
+            mMetricPackets.add(n);
+            mMetricBytes.add((int64_t) batch.totalBytes());
+            updateSenderPath(batch);
         }
-        else if (n == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+        else if (n == -1)
         {
-            MLOGE << "recvfrom error: " << strerror(errno);
+            MLOGE << "receive error: " << strerror(errno);
         }
     }
 
+    if (mPool)
+    {
+        MLOGD << "UDS packet pool: high water " << mPool->getHighWaterMark() << "/" << mPool->getNBuffers()
+              << " exhausted " << mPool->getNExhausted() << " truncated " << engine->getNTruncated();
+    }
+    engine.reset();
     close(mSocket);
     unlink(mSocketPath.c_str());
     mSocket = -1;
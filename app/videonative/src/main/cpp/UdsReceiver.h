@@ -20,11 +20,15 @@
 #include <string>
 #include <thread>
 
+#include "Metrics.h"
+#include "ReceiveEngine.h"
+
 class UDSReceiver
 {
   public:
-    using DATA_CALLBACK   = std::function<void(const uint8_t*, size_t)>;
-    using SOURCE_CALLBACK = std::function<void(const char* /*peerPath*/)>;
+    using DATA_CALLBACK       = std::function<void(const uint8_t*, size_t)>;
+    using BATCH_DATA_CALLBACK = std::function<void(const DatagramBatch&)>;
+    using SOURCE_CALLBACK     = std::function<void(const char* /*peerPath*/)>;
 
     UDSReceiver(
         JavaVM*       javaVm,
@@ -34,6 +38,17 @@ class UDSReceiver
         DATA_CALLBACK onData,
         size_t        wantedRcvbufSize = 256 * 1024);
 
+    // batch-aware variant, onBatch is called once per drained batch of datagrams. The datagrams are received straight
+    // into PacketPool buffers, so the consumer can keep them (Datagram::packet) without copying.
+    UDSReceiver(
+        JavaVM*                javaVm,
+        std::string            socketPath,
+        std::string            name,
+        int                    CPUPriority,
+        BATCH_DATA_CALLBACK    onBatch,
+        size_t                 wantedRcvbufSize = 256 * 1024,
+        ReceiveEngine::Backend backend          = ReceiveEngine::Backend::RECVMMSG);
+
     // non‑copyable / movable
     UDSReceiver(const UDSReceiver&)            = delete;
     UDSReceiver& operator=(const UDSReceiver&) = delete;
@@ -46,29 +61,46 @@ class UDSReceiver
     void startReceiving();
     void stopReceiving();
 
+    /**
+     * Create a datagram socket bound to @param socketPath (abstract namespace if it starts with '\0'), with the
+     * receive buffer raised to @param wantedRcvbufSize if possible. Also used by IngestReactor.
+     * @return the socket, -1 on error
+     */
+    static int openSocket(const std::string& socketPath, size_t wantedRcvbufSize);
+
     // callbacks
     void registerOnSourceFound(SOURCE_CALLBACK cb) { onSource = std::move(cb); }
 
     // stats / info
     [[nodiscard]] long        getNReceivedBytes() const { return nReceivedBytes; }
     [[nodiscard]] std::string getSourcePath() const { return senderPath; }
+    // nullptr for the DATA_CALLBACK variant
+    [[nodiscard]] std::shared_ptr<const PacketPool> getPacketPool() const { return mPool; }
 
   private:
     void receiveLoop();
 
+    // per batch, only builds a string if the peer changed
+    void updateSenderPath(const DatagramBatch& batch);
+
     // ctor constants
-    const std::string   mSocketPath;
-    const std::string   mName;
-    const size_t        WANTED_RCVBUF_SIZE;
-    const int           mCPUPriority;
-    const DATA_CALLBACK onData;
-    JavaVM* const       javaVm;
+    const std::string                 mSocketPath;
+    const std::string                 mName;
+    const size_t                      WANTED_RCVBUF_SIZE;
+    const int                         mCPUPriority;
+    const DATA_CALLBACK               onData;
+    const BATCH_DATA_CALLBACK         onBatch;
+    const ReceiveEngine::Backend      mBackend = ReceiveEngine::Backend::RECVMMSG;
+    const std::shared_ptr<PacketPool> mPool;
+    JavaVM* const                     javaVm;
 
     // runtime
     int                          mSocket = -1;
     std::unique_ptr<std::thread> mThread;
     std::atomic<bool>            receiving{false};
     std::atomic<long>            nReceivedBytes{0};
+    Metrics::Counter&            mMetricPackets = Metrics::global().counter("net_received_packets");
+    Metrics::Counter&            mMetricBytes   = Metrics::global().counter("net_received_bytes");
     std::string                  senderPath;
     SOURCE_CALLBACK              onSource;
 };
@@ -4,68 +4,184 @@
 
 #include "VideoDecoder.h"
 #include <unistd.h>
+#include <cassert>
 #include <sstream>
 #include "AndroidThreadPrioValues.hpp"
-#include "helper/AndroidMediaFormatHelper.h"
-#include "helper/NDKThreadHelper.hpp"
 
 #include <vector>
 
-#include <android/native_window_jni.h>
-#include <media/NdkMediaCodec.h>
+#ifdef __ANDROID__
+#include "MediaCodecBackend.h"
+#include "helper/NDKThreadHelper.hpp"
+#endif
 
 using namespace std::chrono;
 
-VideoDecoder::VideoDecoder(JNIEnv* env)
+static_assert(AccessUnitAssembler::FLAG_CODEC_CONFIG == IDecoderBackend::FLAG_CODEC_CONFIG);
+static_assert(AccessUnitAssembler::FLAG_PARTIAL_FRAME == IDecoderBackend::FLAG_PARTIAL_FRAME);
+
+VideoDecoder::VideoDecoder(JavaVM* javaVm) : javaVm(javaVm)
 {
-    env->GetJavaVM(&javaVm);
     resetStatistics();
+    for (int idx = 0; idx < 2; idx++)
+    {
+        mCodecInput[idx].self     = this;
+        mCodecInput[idx].idx      = idx;
+        mAsyncCallbacks[idx].self = this;
+        mAsyncCallbacks[idx].idx  = idx;
+    }
+    mFeedThread = std::thread(&VideoDecoder::feedLoop, this);
+#ifdef __ANDROID__
+    NDKThreadHelper::setName(mFeedThread.native_handle(), "LLDFeed");
+#endif
+}
+
+#ifdef __ANDROID__
+static JavaVM* getJavaVM(JNIEnv* env)
+{
+    JavaVM* javaVm = nullptr;
+    env->GetJavaVM(&javaVm);
+    return javaVm;
+}
+
+VideoDecoder::VideoDecoder(JNIEnv* env) : VideoDecoder(getJavaVM(env)) {}
+#endif
+
+VideoDecoder::~VideoDecoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mFeedMutex);
+        mFeedThreadStop = true;
+    }
+    mFeedCondition.notify_one();
+    mFeedThread.join();
+    for (Feeder& feeder : mFeeders)
+    {
+        if (!feeder.thread.joinable()) continue;
+        {
+            std::lock_guard<std::mutex> lock(feeder.mutex);
+            mFeedersStop = true;
+        }
+        feeder.condition.notify_one();
+        feeder.thread.join();
+    }
+    // stops the codecs and their output threads, if the surfaces were not released before
+    setBackend(nullptr, 0);
+    setBackend(nullptr, 1);
 }
 
+#ifdef __ANDROID__
 void VideoDecoder::setOutputSurface(JNIEnv* env, jobject surface, jint idx)
 {
     if (surface == nullptr)
     {
         MLOGD << "Set output null surface idx: " << idx;
-        // assert(decoder.window!=nullptr);
-        if (decoder.window[idx] == nullptr && decoder.codec[idx] == nullptr)
+        detachSurface(idx);
+        return;
+    }
+    MLOGD << "Set output non-null surface idx :" << idx;
+    attachSurface(MediaCodecBackend::fromSurface(env, surface, USE_SW_DECODER_INSTEAD), idx);
+}
+#endif
+
+void VideoDecoder::setBackend(std::unique_ptr<IDecoderBackend> backend, int idx)
+{
+    std::lock_guard<std::mutex> lock(mMutexInputPipe);
+    // VR mode: the feeder of this codec may be in the middle of a NALU
+    std::lock_guard<std::mutex> codecLock(mFeeders[idx].codecMutex);
+    if (backend == nullptr)
+    {
+        releaseBackend(idx);
+    }
+    else
+    {
+        MLOGD << "Set decoder backend " << backend->name() << " idx: " << idx;
+        // a parked codec makes room for the new one
+        if (decoder.parked[idx]) releaseBackend(idx);
+        // Throw warning if the surface is set without clearing it first
+        assert(decoder.backend[idx] == nullptr);
+        decoder.backend[idx] = std::move(backend);
+        // open the input pipe - now the decoder will start as soon as enough data is available
+        inputPipeClosed = false;
+    }
+}
+
+void VideoDecoder::releaseBackend(int idx)
+{
+    if (decoder.backend[idx] == nullptr)
+    {
+        // MLOGD<<"Decoder backend is already null";
+        return;
+    }
+    // VR mode: the other codec keeps going
+    inputPipeClosed = decoder.backend[1 - idx] == nullptr;
+    // an input buffer being filled belongs to the codec that is released now
+    mAssembler[idx].reset();
+    mCodecInput[idx].index        = -1;
+    mCodecInput[idx].partialFrame = false;
+    if (decoder.configured[idx])
+    {
+        stopCodec(idx);
+        decoder.backend[idx]->release();
+        decoder.async[idx] = false;
+        mWatchdog.onRelease(idx);
+        MLOGD << "Released codec idx: " << idx;
+        // the parameter sets stay, the next codec is configured with them right away
+        mReconfigurePending     = false;
+        decoder.configured[idx] = false;
+    }
+    decoder.parked[idx] = false;
+    // releases the output surface
+    decoder.backend[idx].reset();
+    MLOGD << "Set decoder backend null idx: " << idx;
+    resetStatistics();
+}
+
+void VideoDecoder::detachSurface(int idx)
+{
+    std::lock_guard<std::mutex> lock(mMutexInputPipe);
+    std::lock_guard<std::mutex> codecLock(mFeeders[idx].codecMutex);
+    if (decoder.backend[idx] == nullptr || decoder.parked[idx]) return;
+    if (decoder.configured[idx])
+    {
+        // nothing is rendered from here on, the old surface may be gone as soon as we return
+        decoder.parked[idx] = true;
+        if (decoder.backend[idx]->setOutputSurface(nullptr))
         {
-            // MLOGD<<"Decoder window is already null";
+            decoder.parkedSince[idx] = steady_clock::now();
+            MLOGD << "Parked codec idx: " << idx;
             return;
         }
+        decoder.parked[idx] = false;
+        MLOGD << "Cannot park codec idx: " << idx;
+    }
+    releaseBackend(idx);
+}
+
+void VideoDecoder::attachSurface(std::unique_ptr<IDecoderBackend> surface, int idx)
+{
+    if (surface == nullptr)
+    {
+        detachSurface(idx);
+        return;
+    }
+    {
         std::lock_guard<std::mutex> lock(mMutexInputPipe);
-        inputPipeClosed = true;
-        if (decoder.configured[idx])
-        {
-            AMediaCodec_stop(decoder.codec[idx]);
-            AMediaCodec_delete(decoder.codec[idx]);
-            decoder.codec[idx] = nullptr;
-            MLOGD << "Set decoder.codec null idx: " << idx;
-            mKeyFrameFinder.reset();
-            decoder.configured[idx] = false;
-            if (mCheckOutputThread[idx]->joinable())
+        std::lock_guard<std::mutex> codecLock(mFeeders[idx].codecMutex);
+        if (decoder.parked[idx])
+        {
+            if (decoder.backend[idx]->setOutputSurface(surface.get()))
             {
-                mCheckOutputThread[idx]->join();
-                mCheckOutputThread[idx].reset();
+                decoder.parked[idx] = false;
+                MLOGD << "Codec idx: " << idx << " moved to the new surface, parked for "
+                      << MyTimeHelper::R(steady_clock::now() - decoder.parkedSince[idx]);
+                return;
             }
+            // start over on the new surface, with the parameter sets we have
+            releaseBackend(idx);
         }
-        if (decoder.window[idx])
-        {
-            ANativeWindow_release(decoder.window[idx]);
-            decoder.window[idx] = nullptr;
-            MLOGD << "Set decoder.window null idx: " << idx;
-        }
-        resetStatistics();
-    }
-    else
-    {
-        MLOGD << "Set output non-null surface idx :" << idx;
-        // Throw warning if the surface is set without clearing it first
-        assert(decoder.window[idx] == nullptr);
-        decoder.window[idx] = ANativeWindow_fromSurface(env, surface);
-        // open the input pipe - now the decoder will start as soon as enough data is available
-        inputPipeClosed = false;
     }
+    setBackend(std::move(surface), idx);
 }
 
 void VideoDecoder::registerOnDecoderRatioChangedCallback(DECODER_RATIO_CHANGED decoderRatioChangedC)
@@ -79,18 +195,236 @@ void VideoDecoder::registerOnDecodingInfoChangedCallback(DECODING_INFO_CHANGED_C
 }
 
 void VideoDecoder::interpretNALU(const NALU& nalu)
+{
+    const bool isKeyFrameOrConfig =
+        nalu.is_keyframe() || nalu.isSPS() || nalu.isPPS() || (nalu.IS_H265_PACKET && nalu.isVPS());
+    if (mDropUntilKeyFrame && !isKeyFrameOrConfig)
+    {
+        Metrics::increment(mNDroppedUntilKeyFrame);
+        mMetricDropped.add();
+        return;
+    }
+    QueuedNALU* slot = mNaluQueue.writeSlot();
+    if (slot == nullptr)
+    {
+        // Never block the network thread behind the codec
+        if (!mDropUntilKeyFrame) MLOGE << "Decoder feed queue full, dropping until the next key frame";
+        Metrics::increment(mNDroppedFull);
+        mMetricDropped.add();
+        mDropUntilKeyFrame = true;
+        return;
+    }
+    if (nalu.is_keyframe()) mDropUntilKeyFrame = false;
+    if (nalu.isContiguous())
+    {
+        slot->data.assign(nalu.getData(), nalu.getData() + nalu.getSize());
+        slot->fragments.clear();
+    }
+    else
+    {
+        // Takes references to the packets, the payload is first copied by feedDecoder()
+        slot->data.clear();
+        slot->fragments = *nalu.getFragments();
+    }
+    slot->isH265          = nalu.IS_H265_PACKET;
+    slot->endOfAccessUnit = nalu.isEndOfAccessUnit();
+    slot->frameId         = nalu.getFrameId();
+    slot->creationTime    = nalu.creationTime;
+    mNaluQueue.publish();
+    Metrics::increment(mNQueued);
+    const size_t size = mNaluQueue.size();
+    mMetricQueueDepth.set((int64_t) size);
+    if (size > mQueueHighWaterMark.load(std::memory_order_relaxed))
+    {
+        mQueueHighWaterMark.store(size, std::memory_order_relaxed);
+    }
+    // Pairs with the fence in feedLoop(): either the feed thread sees the NALU or we see it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mFeedThreadSleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(mFeedMutex);
+        mFeedCondition.notify_one();
+    }
+}
+
+VideoDecoder::FeedQueueStats VideoDecoder::getFeedQueueStats() const
+{
+    FeedQueueStats stats;
+    stats.nQueued               = mNQueued.load(std::memory_order_relaxed);
+    stats.nDroppedFull          = mNDroppedFull.load(std::memory_order_relaxed);
+    stats.nDroppedUntilKeyFrame = mNDroppedUntilKeyFrame.load(std::memory_order_relaxed);
+    stats.highWaterMark         = mQueueHighWaterMark.load(std::memory_order_relaxed);
+    stats.capacity              = mNaluQueue.capacity();
+    stats.nInputBuffers         = mNInputBuffers.load(std::memory_order_relaxed);
+    stats.nDecodedFrames        = mNDecodedFrames.load(std::memory_order_relaxed);
+    stats.nDroppedFeeder        = mNDroppedFeeder.load(std::memory_order_relaxed);
+    stats.nCatchUps             = mCatchUp.getNEvents();
+    stats.nSkippedFramesCatchUp = mCatchUp.getNSkippedFrames();
+    stats.gopCacheBytes         = mGopCache.getBytes();
+    stats.nPrimedNALUs          = mNPrimedNALUs.load(std::memory_order_relaxed);
+    stats.nWatchdogFlushes      = mWatchdog.getNFlushed();
+    stats.nWatchdogRecreates    = mWatchdog.getNRecreated();
+    stats.lastRecoveryUs        = duration_cast<microseconds>(mWatchdog.getLastRecovery()).count();
+    return stats;
+}
+
+void VideoDecoder::feedLoop()
+{
+#ifdef __ANDROID__
+    if (javaVm) NDKThreadHelper::setProcessThreadPriorityAttachDetach(javaVm, -16, "DecoderFeed");
+#endif
+    while (true)
+    {
+        QueuedNALU* queued = mNaluQueue.readSlot();
+        if (queued == nullptr)
+        {
+            // in VR mode the feeders own the assemblers and flush them themselves
+            bool auPending = false;
+            if (mAccessUnitModeActive && !mParallelFeed.load(std::memory_order_relaxed))
+            {
+                for (int idx = 0; idx < 2; idx++)
+                {
+                    std::lock_guard<std::mutex> lock(mFeeders[idx].codecMutex);
+                    auPending = auPending || mAssembler[idx].pending();
+                }
+            }
+            std::unique_lock<std::mutex> lock(mFeedMutex);
+            mFeedThreadSleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const auto wake     = [this] { return mFeedThreadStop || !mNaluQueue.empty(); };
+            bool       timedOut = false;
+            if (auPending)
+            {
+                timedOut = !mFeedCondition.wait_for(lock, ACCESS_UNIT_TIMEOUT, wake);
+            }
+            else
+            {
+                // bounded, so the host build does not need the libstdc++ of GCC 12 for the untimed wait
+                mFeedCondition.wait_for(lock, FEED_IDLE_TIMEOUT, wake);
+            }
+            mFeedThreadSleeping.store(false, std::memory_order_relaxed);
+            if (mFeedThreadStop) break;
+            lock.unlock();
+            if (timedOut)
+            {
+                // the rest of the access unit is late or lost, do not hold back what we have
+                flushAccessUnits();
+            }
+            continue;
+        }
+        if (queued->fragments.empty())
+        {
+            NALU nalu(queued->data.data(), queued->data.size(), queued->isH265, queued->creationTime);
+            nalu.setEndOfAccessUnit(queued->endOfAccessUnit);
+            nalu.setFrameId(queued->frameId);
+            processNALU(lowLatencySPS(nalu));
+        }
+        else
+        {
+            NALU nalu(queued->fragments, queued->isH265, queued->creationTime);
+            nalu.setEndOfAccessUnit(queued->endOfAccessUnit);
+            nalu.setFrameId(queued->frameId);
+            processNALU(lowLatencySPS(nalu));
+            // give the packet buffers back to the pool now, not when the slot is reused
+            queued->fragments.clear();
+        }
+        mNaluQueue.release();
+    }
+}
+
+const NALU& VideoDecoder::lowLatencySPS(const NALU& nalu)
+{
+    if (!nalu.isSPS()) return nalu;
+    if (!mLowLatencySPS.load(std::memory_order_relaxed))
+    {
+        mSPSRewritten = false;
+        return nalu;
+    }
+    mSPSScratch.resize(nalu.getSize());
+    nalu.copyTo(mSPSScratch.data());
+    if (mSPSScratch != mOriginalSPS)
+    {
+        mOriginalSPS.swap(mSPSScratch);
+        mRewrittenSPS = nalu.getLowLatencySPS();
+        MLOGD << (mRewrittenSPS.empty() ? "SPS announces zero reorder already" : "SPS rewritten to zero reorder");
+    }
+    mSPSRewritten = !mRewrittenSPS.empty();
+    if (!mSPSRewritten) return nalu;
+    mRewrittenSPSNALU.emplace(mRewrittenSPS.data(), mRewrittenSPS.size(), nalu.IS_H265_PACKET, nalu.creationTime);
+    mRewrittenSPSNALU->setEndOfAccessUnit(nalu.isEndOfAccessUnit());
+    mRewrittenSPSNALU->setFrameId(nalu.getFrameId());
+    return *mRewrittenSPSNALU;
+}
+
+void VideoDecoder::processNALU(const NALU& nalu)
 {
     // TODO: RN switching between h264 / h265 requires re-setting the surface
     IS_H265             = nalu.IS_H265_PACKET;
     decodingInfo.nCodec = IS_H265;
     // we need this lock, since the receiving/parsing/feeding does not run on the same thread who sets the input surface
     std::lock_guard<std::mutex> lock(mMutexInputPipe);
+    for (int idx = 0; idx < 2; idx++)
+    {
+        if (decoder.parked[idx] && steady_clock::now() - decoder.parkedSince[idx] > MAX_PARKED)
+        {
+            MLOGD << "Codec idx: " << idx << " parked for too long";
+            std::lock_guard<std::mutex> codecLock(mFeeders[idx].codecMutex);
+            releaseBackend(idx);
+        }
+    }
+    // VR mode: each codec gets the NALUs from its own feeder
+    const bool parallelFeed = codec(0) != nullptr && codec(1) != nullptr;
+    if (parallelFeed != mParallelFeed.load(std::memory_order_relaxed))
+    {
+        // what the feeders still have goes to the codecs before anything the feed thread feeds itself
+        waitForFeeders();
+        mParallelFeed = parallelFeed;
+        MLOGD << "Parallel feeding " << parallelFeed;
+    }
+    // Slice streaming without partial frame support is the per NALU mode
+    const bool sliceStreamingWanted = mSliceStreaming.load(std::memory_order_relaxed);
+    const bool sliceStreaming       = sliceStreamingWanted && (IS_H265 ? mPartialFramesH265 : mPartialFramesH264);
+    const bool accessUnitMode =
+        sliceStreaming || (!sliceStreamingWanted && mAccessUnitMode.load(std::memory_order_relaxed));
+    if (accessUnitMode != mAccessUnitModeActive || sliceStreaming != mSliceStreamingActive)
+    {
+        waitForFeeders();
+        for (int idx = 0; idx < 2; idx++)
+        {
+            std::lock_guard<std::mutex> codecLock(mFeeders[idx].codecMutex);
+            if (codec(idx)) mAssembler[idx].flush(mCodecInput[idx]);
+            mAssembler[idx].setSliceStreaming(sliceStreaming);
+        }
+        mAccessUnitModeActive = accessUnitMode;
+        mSliceStreamingActive = sliceStreaming;
+        MLOGD << "Access unit mode " << accessUnitMode << " slice streaming " << sliceStreaming;
+    }
     decodingInfo.nNALU++;
     if (nalu.getSize() <= 4)
     {
         // No data in NALU (e.g at the beginning of a stream)
         return;
     }
+    // what interpretNALU() dropped leaves a hole in the GOP
+    const long nDropped = mNDroppedFull.load(std::memory_order_relaxed) +
+                          mNDroppedUntilKeyFrame.load(std::memory_order_relaxed);
+    if (nDropped != mNDroppedSeen)
+    {
+        mNDroppedSeen = nDropped;
+        mGopCache.invalidate();
+    }
+    // before the catch-up mode, a codec fed from the cache needs the frames the others skip
+    const GopCache::Entry cached = mGopCache.add(nalu);
+    if (nalu.is_vcl() && nalu.is_first_slice_of_picture()) mWatchdog.onPicture(nalu.creationTime);
+    const CatchUpController::Mode catchUpMode = mCatchUp.getMode();
+    const steady_clock::duration  lastInputWait(mLastInputWait.load(std::memory_order_relaxed));
+    const bool                    skip = mCatchUp.skip(nalu, steady_clock::now(), lastInputWait);
+    if (mCatchUp.getMode() != catchUpMode)
+    {
+        MLOGD << "Catch-up mode " << (int) mCatchUp.getMode() << " (skipped " << mCatchUp.getNSkippedFrames()
+              << " frames so far)";
+    }
+    if (skip) return;
     nNALUBytesFed.add(nalu.getSize());
     if (inputPipeClosed)
     {
@@ -100,10 +434,54 @@ void VideoDecoder::interpretNALU(const NALU& nalu)
         mKeyFrameFinder.saveIfKeyFrame(nalu);
         return;
     }
-    if (decoder.configured[0] || decoder.configured[1])
+    const bool configured = decoder.configured[0] || decoder.configured[1];
+    if (configured && !mReconfigurePending && nalu.isSPS())
+    {
+        const auto format = nalu.getVideoFormatSPS();
+        const bool rewriteChanged = mSPSRewritten != mConfiguredRewrittenSPS.load(std::memory_order_relaxed);
+        if (format.has_value() && (*format != mConfiguredFormat || IS_H265 != mConfiguredH265 || rewriteChanged))
+        {
+            MLOGD << "SPS changed " << mConfiguredFormat.asString() << " -> " << format->asString()
+                  << (rewriteChanged ? (mSPSRewritten ? " (rewritten)" : " (as sent)") : "");
+            // collect the PPS that belongs to the new SPS, then reconfigure
+            mReconfigurePending = true;
+            mKeyFrameFinder.resetPPS();
+        }
+    }
+    if (configured && !mReconfigurePending)
     {
-        feedDecoder(nalu, 0);
-        feedDecoder(nalu, 1);
+        // keep the parameter sets current for a reconfigure, a H265 VPS comes before the SPS
+        mKeyFrameFinder.saveIfKeyFrame(nalu);
+        // VR mode: a codec that came later starts right away, the cache includes this NALU
+        bool primed[2] = {false, false};
+        for (int idx = 0; idx < 2; idx++)
+        {
+            if (decoder.backend[idx] == nullptr || decoder.configured[idx]) continue;
+            std::lock_guard<std::mutex> codecLock(mFeeders[idx].codecMutex);
+            configureStartDecoder(idx);
+            primed[idx] = decoder.configured[idx] && primeDecoder(idx);
+        }
+        // a wedged codec starts over, from the cache as well
+        const auto now = steady_clock::now();
+        for (int idx = 0; idx < 2; idx++)
+        {
+            if (!decoder.configured[idx] || primed[idx] || !mWatchdog.isWedged(idx, now)) continue;
+            std::lock_guard<std::mutex> codecLock(mFeeders[idx].codecMutex);
+            primed[idx] = resetCodec(idx);
+        }
+        if (parallelFeed)
+        {
+            dispatchNALU(nalu, cached, primed);
+        }
+        else
+        {
+            for (int idx = 0; idx < 2; idx++)
+            {
+                if (primed[idx]) continue;
+                std::lock_guard<std::mutex> codecLock(mFeeders[idx].codecMutex);
+                feedCodec(nalu, idx, mAccessUnitModeActive);
+            }
+        }
         decodingInfo.nNALUSFeeded++;
         // manually feeding AUDs doesn't seem to change anything for high latency streams
         // Only for the x264 sw encoded example stream it might improve latency slightly
@@ -119,204 +497,518 @@ void VideoDecoder::interpretNALU(const NALU& nalu)
         mKeyFrameFinder.saveIfKeyFrame(nalu);
         if (mKeyFrameFinder.allKeyFramesAvailable(IS_H265))
         {
-            MLOGD << "Configuring decoder...";
-            configureStartDecoder(0);
-            configureStartDecoder(1);
+            if (mReconfigurePending)
+            {
+                MLOGD << "Reconfiguring decoder...";
+                mReconfigurePending = false;
+                const bool newCodec = IS_H265 != mConfiguredH265;
+                // the NALUs before the new parameter sets still go to the codecs as they are configured now
+                waitForFeeders();
+                for (int idx = 0; idx < 2; idx++)
+                {
+                    std::lock_guard<std::mutex> codecLock(mFeeders[idx].codecMutex);
+                    reconfigureDecoder(idx, newCodec);
+                }
+            }
+            else
+            {
+                MLOGD << "Configuring decoder...";
+                for (int idx = 0; idx < 2; idx++)
+                {
+                    std::lock_guard<std::mutex> codecLock(mFeeders[idx].codecMutex);
+                    configureStartDecoder(idx);
+                    // in the middle of a GOP: from its key frame up to this NALU
+                    if (decoder.configured[idx]) primeDecoder(idx);
+                }
+            }
         }
     }
 }
 
-void VideoDecoder::configureStartDecoder(int idx)
+DecoderConfig VideoDecoder::createConfig()
 {
-    if (decoder.window[idx] == nullptr) return;
-    const std::string MIME = IS_H265 ? "video/hevc" : "video/avc";
-    decoder.codec[idx]     = AMediaCodec_createDecoderByType(MIME.c_str());
+    DecoderConfig config = DecoderConfig::fromKeyFrames(mKeyFrameFinder, IS_H265);
+    mConfiguredFormat    = config.format;
+    mConfiguredH265      = IS_H265;
+    mConfiguredRewrittenSPS.store(mSPSRewritten, std::memory_order_relaxed);
+    return config;
+}
 
-    AMediaFormat* format = AMediaFormat_new();
-    AMediaFormat_setString(format, AMEDIAFORMAT_KEY_MIME, MIME.c_str());
+IDecoderBackend* VideoDecoder::codec(int idx) const
+{
+    IDecoderBackend* backend = decoder.backend[idx].get();
+    return backend != nullptr && backend->isCreated() ? backend : nullptr;
+}
 
-    // AMediaFormat_setInt32(format, "low-latency", 1);
-    // AMediaFormat_setInt32(format, "vendor.low-latency.enable", 1);
-    // AMediaFormat_setInt32(format, "vendor.qti-ext-dec-low-latency.enable", 1);
-    // AMediaFormat_setInt32(format, "vendor.hisi-ext-low-latency-video-dec.video-scene-for-low-latency-req", 1);
-    // AMediaFormat_setInt32(format, "vendor.rtc-ext-dec-low-latency.enable", 1);
+void VideoDecoder::configureStartDecoder(int idx)
+{
+    IDecoderBackend* backend = decoder.backend[idx].get();
+    if (backend == nullptr) return;
+    if (!backend->create(IS_H265))
+    {
+        MLOGD << "Cannot create decoder";
+        // set csd-0 and csd-1 back to 0, maybe they were just faulty but we have better luck with the next ones
+        // mKeyFrameFinder.reset();
+        return;
+    }
+    decoder.async[idx] = enableAsync(idx);
+    backend->configure(createConfig());
+    startCodec(idx);
+    mWatchdog.onStart(idx);
+    decoder.configured[idx] = true;
+}
 
-    // MediaCodec supports two priorities: 0 - realtime, 1 - best effort
-    // AMediaFormat_setInt32(format, "priority", 0);
+bool VideoDecoder::resetCodec(int idx)
+{
+    IDecoderBackend* backend = decoder.backend[idx].get();
+    const auto       start   = steady_clock::now();
+    // a pending input buffer is gone with the flush
+    mAssembler[idx].reset();
+    mCodecInput[idx].index        = -1;
+    mCodecInput[idx].partialFrame = false;
+    // flushed before and still nothing, or a fatal error: the codec instance is broken. A recoverable error needs a
+    // stop and configure, a flush does not help there either.
+    const bool failed      = mWatchdog.hasFailed(idx);
+    bool       recreate    = mWatchdog.isRecovering(idx) || (failed && mAsyncCallbacks[idx].fatalError);
+    const bool reconfigure = !recreate && failed;
+    if (reconfigure)
+    {
+        stopCodec(idx);
+        recreate = !backend->configure(createConfig());
+        if (!recreate)
+        {
+            startCodec(idx);
+            mWatchdog.onStart(idx);
+        }
+    }
+    else if (!recreate)
+    {
+        recreate = !backend->flush();
+        // the indices handed out before the flush are invalid, in async mode start() hands the buffers out again
+        mAsyncCallbacks[idx].input.clear();
+        if (!recreate && decoder.async[idx]) recreate = !backend->start();
+    }
+    if (recreate)
+    {
+        stopCodec(idx);
+        backend->release();
+        decoder.async[idx]      = false;
+        decoder.configured[idx] = false;
+        // with the parameter sets we have, a failure is tried again with the next NALU
+        configureStartDecoder(idx);
+    }
+    mWatchdog.onReset(idx, start, recreate);
+    MLOGE << "Codec " << idx << " wedged, "
+          << (recreate ? "created again" : reconfigure ? "configured again" : "flushed") << " in "
+          << MyTimeHelper::R(steady_clock::now() - start);
+    if (!decoder.configured[idx]) return false;
+    if (!primeDecoder(idx)) return false;
+    // VR mode: what the feeder has not fed yet is in the cache, the codec is current after the priming
+    Feeder& feeder           = mFeeders[idx];
+    feeder.resumeSeq         = mNextSeq;
+    feeder.dropUntilKeyFrame = false;
+    return true;
+}
 
-    if (IS_H265)
+bool VideoDecoder::primeDecoder(int idx)
+{
+    const std::vector<GopCache::Entry>& entries = mGopCache.entries();
+    if (entries.empty()) return false;
+    const auto  start = steady_clock::now();
+    CodecInput& input = mCodecInput[idx];
+    // nothing of it is shown, it is older than what the stream is at
+    mPrimedUntilUs[idx].store(INT64_MAX, std::memory_order_relaxed);
+    input.priming = true;
+    for (const GopCache::Entry& entry : entries)
     {
-        h265_configureAMediaFormat(mKeyFrameFinder, format);
+        // a codec that is still wedged is not waited for with each NALU
+        if (mWatchdog.isWedged(idx, steady_clock::now())) break;
+        feedCodec(entry->get_nal(), idx, mAccessUnitModeActive);
     }
-    else
+    input.priming = false;
+    // an access unit the assembler has not submitted yet continues with the stream, it is shown
+    mPrimedUntilUs[idx].store(input.lastPtsUs, std::memory_order_relaxed);
+    Metrics::increment(mNPrimedNALUs, (long) entries.size());
+    mMetricPrimed.add((int64_t) entries.size());
+    MLOGD << "Primed codec " << idx << " with " << entries.size() << " NALUs (" << mGopCache.getBytes()
+          << " bytes) in " << MyTimeHelper::R(steady_clock::now() - start);
+    return true;
+}
+
+void VideoDecoder::startCodec(int idx)
+{
+    // what the codec reported before is handled by this start
+    mAsyncCallbacks[idx].fatalError = false;
+    decoder.backend[idx]->start();
+    if (decoder.async[idx]) return;
+    mCheckOutputThread[idx] = std::make_unique<std::thread>(&VideoDecoder::checkOutputLoop, this, idx);
+#ifdef __ANDROID__
+    NDKThreadHelper::setName(mCheckOutputThread[idx]->native_handle(), "LLDCheckOutput");
+#endif
+}
+
+void VideoDecoder::stopCodec(int idx)
+{
+    decoder.backend[idx]->stop();
+    if (mCheckOutputThread[idx] && mCheckOutputThread[idx]->joinable())
     {
-        h264_configureAMediaFormat(mKeyFrameFinder, format);
+        mCheckOutputThread[idx]->join();
+        mCheckOutputThread[idx].reset();
     }
+    // no callbacks after the stop, the indices the codec handed out are invalid now
+    mAsyncCallbacks[idx].input.clear();
+}
 
-    MLOGD << "Configuring decoder:" << AMediaFormat_toString(format);
+bool VideoDecoder::enableAsync(int idx)
+{
+    if (codec(idx) == nullptr || !mAsyncMode.load(std::memory_order_relaxed)) return false;
+    const bool enabled = decoder.backend[idx]->setAsyncListener(&mAsyncCallbacks[idx]);
+    MLOGD << "Async codec mode " << idx << (enabled ? " enabled" : " failed");
+    return enabled;
+}
 
-    auto status = AMediaCodec_configure(decoder.codec[idx], format, decoder.window[idx], nullptr, 0);
-    AMediaFormat_delete(format);
+void VideoDecoder::reconfigureDecoder(int idx, bool newCodec)
+{
+    if (!decoder.configured[idx]) return;
+    IDecoderBackend* backend = decoder.backend[idx].get();
+    const auto       start   = steady_clock::now();
+    // a pending input buffer is gone with the stop
+    mAssembler[idx].reset();
+    mCodecInput[idx].index        = -1;
+    mCodecInput[idx].partialFrame = false;
+    stopCodec(idx);
+    if (newCodec)
+    {
+        // another mime type needs another codec, the surface stays
+        backend->create(IS_H265);
+        decoder.async[idx] = enableAsync(idx);
+    }
+    if (!backend->isCreated() || !backend->configure(createConfig()))
+    {
+        // start from scratch with the next parameter sets
+        MLOGE << "Reconfigure failed";
+        backend->release();
+        decoder.async[idx]      = false;
+        decoder.configured[idx] = false;
+        return;
+    }
+    startCodec(idx);
+    mWatchdog.onStart(idx);
+    MLOGD << "Reconfigured decoder " << idx << " in " << MyTimeHelper::R(steady_clock::now() - start);
+}
 
-    switch (status)
+void VideoDecoder::feedCodec(const NALU& nalu, int idx, bool accessUnitMode)
+{
+    if (codec(idx) == nullptr) return;
+    if (nalu.is_keyframe()) mWatchdog.onKeyFrame(idx);
+    // whether or not the codec takes it
+    mWatchdog.onInput(idx, steady_clock::now());
+    if (accessUnitMode)
     {
-        case AMEDIA_OK:
+        mCodecInput[idx].frameId = nalu.getFrameId();
+        mAssembler[idx].add(nalu, mCodecInput[idx]);
+    }
+    else
+    {
+        feedDecoder(nalu, idx);
+    }
+}
+
+void VideoDecoder::dispatchNALU(const NALU& nalu, const GopCache::Entry& cached, const bool primed[2])
+{
+    const bool isKeyFrameOrConfig =
+        nalu.is_keyframe() || nalu.isSPS() || nalu.isPPS() || (nalu.IS_H265_PACKET && nalu.isVPS());
+    // one copy for both codecs, the feeder that is done last frees it
+    std::shared_ptr<SharedNALU> shared;
+    for (int idx = 0; idx < 2; idx++)
+    {
+        if (primed[idx]) continue;
+        Feeder& feeder = mFeeders[idx];
+        if (feeder.dropUntilKeyFrame && !isKeyFrameOrConfig)
         {
-            MLOGD << "AMediaCodec_configure: OK";
-            break;
+            Metrics::increment(mNDroppedFeeder);
+            mMetricDropped.add();
+            continue;
         }
-        case AMEDIA_ERROR_UNKNOWN:
+        std::shared_ptr<SharedNALU>* slot = feeder.queue.writeSlot();
+        if (slot == nullptr)
         {
-            MLOGD << "AMediaCodec_configure: AMEDIA_ERROR_UNKNOWN";
-            break;
+            // the other codec keeps going, this one continues with the next key frame
+            if (!feeder.dropUntilKeyFrame)
+            {
+                MLOGE << "Feeder " << idx << " queue full, dropping until the next key frame";
+            }
+            Metrics::increment(mNDroppedFeeder);
+            mMetricDropped.add();
+            feeder.dropUntilKeyFrame = true;
+            continue;
         }
-        case AMEDIA_ERROR_MALFORMED:
+        if (nalu.is_keyframe()) feeder.dropUntilKeyFrame = false;
+        if (shared == nullptr)
         {
-            MLOGD << "AMediaCodec_configure: AMEDIA_ERROR_MALFORMED";
-            break;
+            GopCache::Entry buffer = cached != nullptr ? cached : std::make_shared<NALUBuffer>(nalu);
+            shared                 = std::make_shared<SharedNALU>(std::move(buffer), mNextSeq++, mAccessUnitModeActive);
         }
-        case AMEDIA_ERROR_UNSUPPORTED:
+        *slot = shared;
+        feeder.queue.publish();
+        feeder.nDispatched++;
+        if (!feeder.thread.joinable())
         {
-            MLOGD << "AMediaCodec_configure: AMEDIA_ERROR_UNSUPPORTED";
-            break;
+            feeder.thread = std::thread(&VideoDecoder::feederLoop, this, idx);
+#ifdef __ANDROID__
+            NDKThreadHelper::setName(feeder.thread.native_handle(), idx == 0 ? "LLDFeed0" : "LLDFeed1");
+#endif
         }
-        case AMEDIA_ERROR_INVALID_OBJECT:
+        // Pairs with the fence in feederLoop(), as in interpretNALU()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (feeder.sleeping.load(std::memory_order_relaxed))
         {
-            MLOGD << "AMediaCodec_configure: AMEDIA_ERROR_INVALID_OBJECT";
-            break;
+            std::lock_guard<std::mutex> lock(feeder.mutex);
+            feeder.condition.notify_one();
         }
-        case AMEDIA_ERROR_INVALID_PARAMETER:
+    }
+}
+
+void VideoDecoder::feederLoop(int idx)
+{
+#ifdef __ANDROID__
+    if (javaVm) NDKThreadHelper::setProcessThreadPriorityAttachDetach(javaVm, -16, "DecoderFeeder");
+#endif
+    Feeder& feeder = mFeeders[idx];
+    while (true)
+    {
+        std::shared_ptr<SharedNALU>* slot = feeder.queue.readSlot();
+        if (slot == nullptr)
         {
-            MLOGD << "AMediaCodec_configure: AMEDIA_ERROR_INVALID_PARAMETER";
-            break;
+            bool auPending = false;
+            {
+                std::lock_guard<std::mutex> lock(feeder.codecMutex);
+                auPending = mParallelFeed.load(std::memory_order_relaxed) && mAssembler[idx].pending();
+            }
+            std::unique_lock<std::mutex> lock(feeder.mutex);
+            feeder.sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const auto wake = [this, &feeder] { return mFeedersStop || !feeder.queue.empty(); };
+            const bool timedOut =
+                !feeder.condition.wait_for(lock, auPending ? ACCESS_UNIT_TIMEOUT : FEED_IDLE_TIMEOUT, wake);
+            feeder.sleeping.store(false, std::memory_order_relaxed);
+            if (mFeedersStop) break;
+            lock.unlock();
+            if (timedOut && auPending) flushAccessUnit(idx);
+            continue;
         }
-        default:
+        // our reference is gone as soon as this NALU is fed, not when the slot is reused
+        const std::shared_ptr<SharedNALU> shared = std::move(*slot);
+        feeder.queue.release();
         {
-            break;
+            std::lock_guard<std::mutex> lock(feeder.codecMutex);
+            // else resetCodec() fed it already
+            if (shared->seq >= feeder.resumeSeq)
+            {
+                mCodecInput[idx].seq = shared->seq;
+                feedCodec(shared->buffer->get_nal(), idx, shared->accessUnitMode);
+            }
         }
+        feeder.nDone.store(feeder.nDone.load(std::memory_order_relaxed) + 1, std::memory_order_release);
     }
+}
 
-    if (decoder.codec[idx] == nullptr)
+void VideoDecoder::waitForFeeders()
+{
+    for (Feeder& feeder : mFeeders)
     {
-        MLOGD << "Cannot configure decoder";
-        // set csd-0 and csd-1 back to 0, maybe they were just faulty but we have better luck with the next ones
-        // mKeyFrameFinder.reset();
-        return;
+        // at most a queue of NALUs, each one input buffer wait
+        while (feeder.nDone.load(std::memory_order_acquire) != feeder.nDispatched)
+        {
+            std::this_thread::sleep_for(microseconds(100));
+        }
     }
-    AMediaCodec_start(decoder.codec[idx]);
-    mCheckOutputThread[idx] = std::make_unique<std::thread>(&VideoDecoder::checkOutputLoop, this, idx);
-    NDKThreadHelper::setName(mCheckOutputThread[idx]->native_handle(), "LLDCheckOutput");
-    decoder.configured[idx] = true;
 }
 
 void VideoDecoder::feedDecoder(const NALU& nalu, int idx)
 {
-    if (!decoder.codec[idx]) return;
+    IDecoderBackend* backend = codec(idx);
+    if (backend == nullptr) return;
     const auto now          = std::chrono::steady_clock::now();
     const auto deltaParsing = now - nalu.creationTime;
+    const auto index        = dequeueInputBuffer(idx);
+    if (index < 0) return;
+    size_t   inputBufferSize;
+    uint8_t* buf = backend->getInputBuffer((size_t) index, inputBufferSize);
+    // I have not seen any case where the input buffer returned by MediaCodec is too small to hold the NALU
+    // But better be safe than crashing with a memory exception
+    if (nalu.getSize() > inputBufferSize)
+    {
+        MLOGD << "Nalu too big" << nalu.getSize();
+        return;
+    }
+
+    const uint32_t flag =
+        (IS_H265 && (nalu.isSPS() || nalu.isPPS() || nalu.isVPS())) ? IDecoderBackend::FLAG_CODEC_CONFIG : 0;
+    nalu.copyTo(buf);
+    const uint64_t presentationTimeUS =
+        (uint64_t) duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    backend->queueInputBuffer((size_t) index, (size_t) nalu.getSize(), presentationTimeUS, flag);
+    CodecInput& input = mCodecInput[idx];
+    input.lastPtsUs   = (int64_t) presentationTimeUS;
+    if (input.priming) return;
+    if (mParallelFeed.load(std::memory_order_relaxed))
+    {
+        mOutputSkew.onQueued(idx, (int64_t) presentationTimeUS, input.seq);
+    }
+    // the latencies are those of the first codec, in VR mode the second one is fed from another thread
+    if (idx != 0) return;
+    if (mFrameTrace)
+    {
+        mFrameTrace->record(FrameTrace::Stage::CODEC_QUEUE, nalu.getFrameId(), steady_clock::now(), presentationTimeUS);
+    }
+    const auto waitForInput = steady_clock::now() - now;
+    mLastInputWait.store(waitForInput.count(), std::memory_order_relaxed);
+    waitForInputB.add(waitForInput);
+    parsingTime.add(deltaParsing);
+    mMetricWaitInput.record(waitForInput);
+    mMetricFeed.record(deltaParsing);
+    Metrics::increment(mNInputBuffers);
+    mMetricInputs.add();
+}
+
+ssize_t VideoDecoder::dequeueInputBuffer(int idx)
+{
+    const auto now = std::chrono::steady_clock::now();
+    // a wedged codec is not waited for, the watchdog resets it with the next NALU
+    const auto deadline = std::min(now + std::chrono::seconds(1), mWatchdog.getDeadline(idx));
+    if (decoder.async[idx])
+    {
+        // woken up by the codec as soon as a buffer is free, no polling
+        const auto timeout = duration_cast<microseconds>(std::max(deadline - now, steady_clock::duration::zero()));
+        const auto index   = mAsyncCallbacks[idx].input.pop(timeout);
+        if (index < 0) MLOGE << "No input buffer from the async codec for " << MyTimeHelper::R(timeout) << ", return.";
+        return index;
+    }
     while (true)
     {
-        const auto index = AMediaCodec_dequeueInputBuffer(decoder.codec[idx], BUFFER_TIMEOUT_US);
+        const auto index = decoder.backend[idx]->dequeueInputBuffer(BUFFER_TIMEOUT_US);
         if (index >= 0)
         {
-            size_t   inputBufferSize;
-            uint8_t* buf = AMediaCodec_getInputBuffer(decoder.codec[idx], (size_t) index, &inputBufferSize);
-            // I have not seen any case where the input buffer returned by MediaCodec is too small to hold the NALU
-            // But better be safe than crashing with a memory exception
-            if (nalu.getSize() > inputBufferSize)
-            {
-                MLOGD << "Nalu too big" << nalu.getSize();
-                return;
-            }
-
-            int flag =
-                (IS_H265 && (nalu.isSPS() || nalu.isPPS() || nalu.isVPS())) ? AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG : 0;
-            std::memcpy(buf, nalu.getData(), (size_t) nalu.getSize());
-            const uint64_t presentationTimeUS =
-                (uint64_t) duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
-            AMediaCodec_queueInputBuffer(
-                decoder.codec[idx], (size_t) index, 0, (size_t) nalu.getSize(), presentationTimeUS, flag);
-            waitForInputB.add(steady_clock::now() - now);
-            parsingTime.add(deltaParsing);
-            return;
+            return index;
         }
-        else if (index == AMEDIACODEC_INFO_TRY_AGAIN_LATER)
+        else if (index == IDecoderBackend::INFO_TRY_AGAIN_LATER)
         {
-            // just try again. But if we had no success in the last 1 second,log a warning and return.
+            // just try again. But if we had no success in the last 1 second (or the codec is wedged), log a warning
+            // and return.
             const auto elapsedTimeTryingForBuffer = std::chrono::steady_clock::now() - now;
-            if (elapsedTimeTryingForBuffer > std::chrono::seconds(1))
+            if (std::chrono::steady_clock::now() >= deadline)
             {
                 // Since OpenHD provides a lossy link it is really unlikely, but possible that we somehow 'break' the
-                // codec by feeding corrupt data. It will probably recover itself as soon as we feed enough valid data
-                // though;
-                MLOGE << "AMEDIACODEC_INFO_TRY_AGAIN_LATER for more than 1 second "
-                      << MyTimeHelper::R(elapsedTimeTryingForBuffer) << "return.";
-                return;
+                // codec by feeding corrupt data. Then the watchdog resets it (see CodecWatchdog).
+                MLOGE << "AMEDIACODEC_INFO_TRY_AGAIN_LATER for " << MyTimeHelper::R(elapsedTimeTryingForBuffer)
+                      << " return.";
+                return -1;
             }
         }
         else
         {
             // Something went wrong. But we will feed the next NALU soon anyways
             MLOGD << "dequeueInputBuffer idx " << (int) index << "return.";
-            return;
+            return -1;
         }
     }
 }
 
+void VideoDecoder::flushAccessUnits()
+{
+    std::lock_guard<std::mutex> lock(mMutexInputPipe);
+    for (int idx = 0; idx < 2; idx++) flushAccessUnit(idx);
+}
+
+void VideoDecoder::flushAccessUnit(int idx)
+{
+    std::lock_guard<std::mutex> lock(mFeeders[idx].codecMutex);
+    if (codec(idx)) mAssembler[idx].flush(mCodecInput[idx]);
+}
+
+bool VideoDecoder::CodecInput::acquire(uint8_t*& data, size_t& capacity)
+{
+    const auto now = steady_clock::now();
+    index          = self->dequeueInputBuffer(idx);
+    if (index < 0) return false;
+    data = self->decoder.backend[idx]->getInputBuffer((size_t) index, capacity);
+    if (idx == 0 && !priming)
+    {
+        const auto waitForInput = steady_clock::now() - now;
+        self->mLastInputWait.store(waitForInput.count(), std::memory_order_relaxed);
+        self->waitForInputB.add(waitForInput);
+        self->mMetricWaitInput.record(waitForInput);
+    }
+    return data != nullptr;
+}
+
+void VideoDecoder::CodecInput::submit(size_t size, uint32_t flags, steady_clock::time_point creationTime)
+{
+    const auto     now                = steady_clock::now();
+    const uint64_t presentationTimeUS = (uint64_t) duration_cast<microseconds>(now.time_since_epoch()).count();
+    self->decoder.backend[idx]->queueInputBuffer((size_t) index, size, presentationTimeUS, flags);
+    index     = -1;
+    lastPtsUs = (int64_t) presentationTimeUS;
+    if (priming) return;
+    if (self->mParallelFeed.load(std::memory_order_relaxed))
+    {
+        self->mOutputSkew.onQueued(idx, (int64_t) presentationTimeUS, seq);
+    }
+    if (idx != 0) return;
+    if (self->mFrameTrace) self->mFrameTrace->record(FrameTrace::Stage::CODEC_QUEUE, frameId, now, presentationTimeUS);
+    // first NALU of the buffer -> the buffer reached the codec
+    self->parsingTime.add(now - creationTime);
+    self->mMetricFeed.record(now - creationTime);
+    Metrics::increment(self->mNInputBuffers);
+    self->mMetricInputs.add();
+    if ((flags & AccessUnitAssembler::FLAG_PARTIAL_FRAME) != 0)
+    {
+        if (!partialFrame) firstPartial = now;
+        partialFrame = true;
+    }
+    else if (partialFrame)
+    {
+        self->sliceLeadTime.add(now - firstPartial);
+        partialFrame = false;
+    }
+}
+
 void VideoDecoder::checkOutputLoop(int idx)
 {
-    NDKThreadHelper::setProcessThreadPriorityAttachDetach(javaVm, -16, "DecoderCheckOutput");
-    AMediaCodecBufferInfo info;
-    bool                  decoderSawEOS          = false;
-    bool                  decoderProducedUnknown = false;
+#ifdef __ANDROID__
+    if (javaVm) NDKThreadHelper::setProcessThreadPriorityAttachDetach(javaVm, -16, "DecoderCheckOutput");
+#endif
+    IDecoderBackend*            backend = decoder.backend[idx].get();
+    IDecoderBackend::OutputInfo info;
+    bool                        decoderSawEOS          = false;
+    bool                        decoderProducedUnknown = false;
     while (!decoderSawEOS && !decoderProducedUnknown)
     {
-        if (!decoder.codec[idx]) break;
-        const ssize_t index = AMediaCodec_dequeueOutputBuffer(decoder.codec[idx], &info, BUFFER_TIMEOUT_US);
+        const ssize_t index = backend->dequeueOutputBuffer(info, BUFFER_TIMEOUT_US);
         if (index >= 0)
         {
-            const auto    now   = steady_clock::now();
-            const int64_t nowUS = (int64_t) duration_cast<microseconds>(now.time_since_epoch()).count();
-            // the timestamp for releasing the buffer is in NS, just release as fast as possible (e.g. now)
-            // https://android.googlesource.com/platform/frameworks/av/+/master/media/ndk/NdkMediaCodec.cpp
-            //-> renderOutputBufferAndRelease which is in
-            // https://android.googlesource.com/platform/frameworks/av/+/3fdb405/media/libstagefright/MediaCodec.cpp
-            //-> Message kWhatReleaseOutputBuffer -> onReleaseOutputBuffer
-            //  also https://android.googlesource.com/platform/frameworks/native/+/5c1139f/libs/gui/SurfaceTexture.cpp
-            if (!decoder.codec[idx]) break;
-            AMediaCodec_releaseOutputBuffer(decoder.codec[idx], (size_t) index, true);
-            // but the presentationTime is in US
-            if (idx == 0)
-            {
-                decodingTime.add(std::chrono::microseconds(nowUS - info.presentationTimeUs));
-                nDecodedFrames.add(1);
-            }
-            if (info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM)
+            releaseOutputBuffer(idx, (size_t) index, info.presentationTimeUs);
+            onFrameDecoded(idx, info.presentationTimeUs);
+            if (info.flags & IDecoderBackend::FLAG_END_OF_STREAM)
             {
                 MLOGD << "Decoder saw EOS";
                 decoderSawEOS = true;
                 continue;
             }
         }
-        else if (index == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED)
+        else if (index == IDecoderBackend::INFO_OUTPUT_FORMAT_CHANGED)
         {
-            auto format = AMediaCodec_getOutputFormat(decoder.codec[idx]);
-            int  width = 0, height = 0;
-            AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_WIDTH, &width);
-            AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_HEIGHT, &height);
+            int32_t width = 0, height = 0;
+            backend->getOutputSize(width, height);
             MLOGD << "Actual Width and Height in output " << width << "," << height;
-            if (idx == 0 && onDecoderRatioChangedCallback != nullptr && width != 0 && height != 0)
-            {
-                onDecoderRatioChangedCallback({width, height});
-            }
-            MLOGD << "AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED " << width << " " << height << " "
-                  << AMediaFormat_toString(format);
+            onOutputFormatChanged(idx, width, height);
         }
-        else if (index == AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED)
+        else if (index == IDecoderBackend::INFO_OUTPUT_BUFFERS_CHANGED)
         {
             MLOGD << "AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED";
         }
-        else if (index == AMEDIACODEC_INFO_TRY_AGAIN_LATER)
+        else if (index == IDecoderBackend::INFO_TRY_AGAIN_LATER)
         {
             // MLOGD<<"AMEDIACODEC_INFO_TRY_AGAIN_LATER";
         }
@@ -327,32 +1019,123 @@ void VideoDecoder::checkOutputLoop(int idx)
             decoderProducedUnknown = true;
             continue;
         }
-        // every 2 seconds recalculate the current fps and bitrate
-        const auto now   = steady_clock::now();
-        const auto delta = now - decodingInfo.lastCalculation;
-        if (idx == 0 && delta > DECODING_INFO_RECALCULATION_INTERVAL)
-        {
-            decodingInfo.lastCalculation = steady_clock::now();
-            decodingInfo.currentFPS =
-                (float) nDecodedFrames.getDeltaSinceLastCall() / (float) duration_cast<seconds>(delta).count();
-            decodingInfo.currentKiloBitsPerSecond =
-                ((float) nNALUBytesFed.getDeltaSinceLastCall() / duration_cast<seconds>(delta).count()) / 1024.0f *
-                8.0f;
-            // and recalculate the avg latencies. If needed,also print the log.
-            decodingInfo.avgDecodingTime_ms      = decodingTime.getAvg_ms();
-            decodingInfo.avgParsingTime_ms       = parsingTime.getAvg_ms();
-            decodingInfo.avgWaitForInputBTime_ms = waitForInputB.getAvg_ms();
-            decodingInfo.nDecodedFrames          = nDecodedFrames.getAbsolute();
-            printAvgLog();
-            if (onDecodingInfoChangedCallback != nullptr)
-            {
-                onDecodingInfoChangedCallback(decodingInfo);
-            }
-        }
+        if (idx == 0) updateDecodingInfo();
     }
     MLOGD << "Exit CheckOutputLoop";
 }
 
+void VideoDecoder::releaseOutputBuffer(int idx, size_t index, int64_t presentationTimeUs)
+{
+    const bool primed = isPrimed(idx, presentationTimeUs);
+    mWatchdog.onOutput(idx, steady_clock::now(), !primed);
+    if (primed)
+    {
+        decoder.backend[idx]->releaseOutputBuffer(index, false);
+        return;
+    }
+    FrameTrace* trace = idx == 0 ? mFrameTrace : nullptr;
+    if (trace) trace->record(FrameTrace::Stage::CODEC_OUTPUT, 0, steady_clock::now(), presentationTimeUs);
+    decoder.backend[idx]->releaseOutputBuffer(index, !decoder.parked[idx]);
+    if (trace) trace->record(FrameTrace::Stage::RENDER_RELEASE, 0, steady_clock::now(), presentationTimeUs);
+}
+
+void VideoDecoder::onFrameDecoded(int idx, int64_t presentationTimeUs)
+{
+    // catching up with the stream, not decoding it
+    if (isPrimed(idx, presentationTimeUs)) return;
+    if (mParallelFeed.load(std::memory_order_relaxed))
+    {
+        mOutputSkew.onOutput(idx, presentationTimeUs, steady_clock::now());
+    }
+    if (idx != 0) return;
+    // the presentationTime is in US
+    const int64_t nowUS   = (int64_t) duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    const auto    latency = std::chrono::microseconds(nowUS - presentationTimeUs);
+    decodingTime.add(latency);
+    mMetricDecode.record(latency);
+    if (mConfiguredRewrittenSPS.load(std::memory_order_relaxed))
+    {
+        decodingTimeLowLatencySPS.add(latency);
+    }
+    else
+    {
+        decodingTimeOriginalSPS.add(latency);
+    }
+    nDecodedFrames.add(1);
+    Metrics::increment(mNDecodedFrames);
+    mMetricDecoded.add();
+}
+
+void VideoDecoder::onOutputFormatChanged(int idx, int32_t width, int32_t height)
+{
+    if (idx == 0 && onDecoderRatioChangedCallback != nullptr && width != 0 && height != 0)
+    {
+        onDecoderRatioChangedCallback({width, height});
+    }
+}
+
+void VideoDecoder::updateDecodingInfo()
+{
+    // every 2 seconds recalculate the current fps and bitrate
+    const auto now   = steady_clock::now();
+    const auto delta = now - decodingInfo.lastCalculation;
+    if (delta <= DECODING_INFO_RECALCULATION_INTERVAL) return;
+    decodingInfo.lastCalculation = steady_clock::now();
+    decodingInfo.currentFPS =
+        (float) nDecodedFrames.getDeltaSinceLastCall() / (float) duration_cast<seconds>(delta).count();
+    decodingInfo.currentKiloBitsPerSecond =
+        ((float) nNALUBytesFed.getDeltaSinceLastCall() / duration_cast<seconds>(delta).count()) / 1024.0f * 8.0f;
+    // and recalculate the avg latencies. If needed,also print the log.
+    decodingInfo.avgDecodingTime_ms              = decodingTime.getAvg_ms();
+    decodingInfo.avgParsingTime_ms               = parsingTime.getAvg_ms();
+    decodingInfo.avgWaitForInputBTime_ms         = waitForInputB.getAvg_ms();
+    decodingInfo.avgSliceLeadTime_ms             = sliceLeadTime.getAvg_ms();
+    decodingInfo.avgDecodingTimeOriginalSPS_ms   = decodingTimeOriginalSPS.getAvg_ms();
+    decodingInfo.avgDecodingTimeLowLatencySPS_ms = decodingTimeLowLatencySPS.getAvg_ms();
+    decodingInfo.avgStereoSkew_ms                = mOutputSkew.getStats().avgAbsSkew_ms();
+    decodingInfo.nDecodedFrames                  = nDecodedFrames.getAbsolute();
+    printAvgLog();
+    if (onDecodingInfoChangedCallback != nullptr)
+    {
+        onDecodingInfoChangedCallback(decodingInfo);
+    }
+}
+
+void VideoDecoder::AsyncCallbacks::onInputAvailable(int32_t index)
+{
+    if (!input.push(index)) MLOGE << "Async codec " << idx << " has more input buffers than expected";
+}
+
+void VideoDecoder::AsyncCallbacks::onOutputAvailable(int32_t index, int64_t presentationTimeUs, uint32_t flags)
+{
+    // released in the callback, no output thread
+    self->releaseOutputBuffer(idx, (size_t) index, presentationTimeUs);
+    self->onFrameDecoded(idx, presentationTimeUs);
+    if (flags & IDecoderBackend::FLAG_END_OF_STREAM) MLOGD << "Decoder saw EOS";
+    if (idx == 0) self->updateDecodingInfo();
+}
+
+void VideoDecoder::AsyncCallbacks::onFormatChanged(int32_t width, int32_t height)
+{
+    self->onOutputFormatChanged(idx, width, height);
+}
+
+void VideoDecoder::AsyncCallbacks::onError(int32_t error, int32_t actionCode)
+{
+    if (actionCode == ACTION_TRANSIENT)
+    {
+        MLOGD << "Codec " << idx << " transient error " << error;
+        return;
+    }
+    // the watchdog resets it with the next NALU, the feeder does not wait for an input buffer of it until then
+    const bool recoverable = actionCode == ACTION_RECOVERABLE;
+    MLOGE << "Codec " << idx << " error " << error << " action " << actionCode << ", "
+          << (recoverable ? "configuring" : "creating") << " it again";
+    if (!recoverable) fatalError = true;
+    self->mWatchdog.onError(idx);
+    input.interrupt();
+}
+
 void VideoDecoder::printAvgLog()
 {
     if (PRINT_DEBUG_INFO)
@@ -369,7 +1152,12 @@ void VideoDecoder::printAvgLog()
                      << "\nParsing:" << decodingInfo.avgParsingTime_ms
                      << " | WaitInputBuffer:" << decodingInfo.avgWaitForInputBTime_ms
                      << " | Decoding:" << decodingInfo.avgDecodingTime_ms
-                     << " | Decoding Latency Sum:" << avgDecodingLatencySum << "\nN NALUS:" << decodingInfo.nNALU
+                     << " | Decoding Latency Sum:" << avgDecodingLatencySum
+                     << " | Slice lead:" << decodingInfo.avgSliceLeadTime_ms
+                     << "\nDecoding with SPS as sent:" << decodingInfo.avgDecodingTimeOriginalSPS_ms
+                     << " | rewritten:" << decodingInfo.avgDecodingTimeLowLatencySPS_ms
+                     << " | Stereo skew:" << decodingInfo.avgStereoSkew_ms
+                     << "\nN NALUS:" << decodingInfo.nNALU
                      << " | N NALUES feeded:" << decodingInfo.nNALUSFeeded
                      << " | N Decoded Frames:" << nDecodedFrames.getAbsolute() << "\nFPS:" << decodingInfo.currentFPS
                      << " | Codec:" << (decodingInfo.nCodec ? "H265" : "H264");
@@ -385,5 +1173,9 @@ void VideoDecoder::resetStatistics()
     parsingTime.reset();
     waitForInputB.reset();
     decodingTime.reset();
+    sliceLeadTime.reset();
+    decodingTimeOriginalSPS.reset();
+    decodingTimeLowLatencySPS.reset();
+    mOutputSkew.reset();
     decodingInfo = {};
 }
@@ -6,14 +6,27 @@
 #define FPVUE_VIDEODECODER_H
 
 #include <android/log.h>
-#include <android/native_window.h>
 #include <jni.h>
-#include <media/NdkMediaCodec.h>
 #include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <thread>
+#include <vector>
+#include "AccessUnitAssembler.h"
+#include "AsyncCodec.h"
+#include "CatchUpController.h"
+#include "CodecWatchdog.h"
+#include "DecoderBackend.h"
+#include "FrameTrace.h"
+#include "GopCache.h"
+#include "Metrics.h"
 #include "NALU/KeyFrameFinder.hpp"
 #include "NALU/NALU.hpp"
+#include "OutputSkew.h"
+#include "SpscRing.h"
 #include "helper/TimeHelper.hpp"
 
 struct DecodingInfo
@@ -28,12 +41,32 @@ struct DecodingInfo
     float                                 avgParsingTime_ms        = 0;
     float                                 avgWaitForInputBTime_ms  = 0;
     float                                 avgDecodingTime_ms       = 0;
+    // Filled in by the VideoPlayer: RFC 3550 interarrival jitter of the video stream and the avg time a datagram
+    // spent in the socket queue (kernel receive timestamp -> read by us). avgParsingTime_ms includes the latter.
+    float rtpJitter_ms            = 0;
+    float avgKernelToUserDelay_ms = 0;
+    // Slice streaming: how much earlier the first slice of a frame reached the codec than the complete frame, i.e.
+    // the latency saved against submitting whole frames
+    float avgSliceLeadTime_ms = 0;
+    // Decoding time (as avgDecodingTime_ms) while the decoder ran with the SPS as sent and with the SPS rewritten to
+    // zero reorder (VideoDecoder::setLowLatencySPS), what the rewrite gains on this device
+    float avgDecodingTimeOriginalSPS_ms   = 0;
+    float avgDecodingTimeLowLatencySPS_ms = 0;
+    // Filled in by the VideoPlayer: time from a gap in the stream to the next complete key frame
+    float avgKeyFrameRecovery_ms = 0;
+    // VR mode: avg time between the left and the right codec outputting the same frame
+    float avgStereoSkew_ms = 0;
 
     bool operator==(const DecodingInfo& d2) const
     {
         return nNALU == d2.nNALU && nNALUSFeeded == d2.nNALUSFeeded && currentFPS == d2.currentFPS &&
                currentKiloBitsPerSecond == d2.currentKiloBitsPerSecond && avgParsingTime_ms == d2.avgParsingTime_ms &&
-               avgWaitForInputBTime_ms == d2.avgWaitForInputBTime_ms && avgDecodingTime_ms == d2.avgDecodingTime_ms;
+               avgWaitForInputBTime_ms == d2.avgWaitForInputBTime_ms && avgDecodingTime_ms == d2.avgDecodingTime_ms &&
+               rtpJitter_ms == d2.rtpJitter_ms && avgKernelToUserDelay_ms == d2.avgKernelToUserDelay_ms &&
+               avgSliceLeadTime_ms == d2.avgSliceLeadTime_ms &&
+               avgDecodingTimeOriginalSPS_ms == d2.avgDecodingTimeOriginalSPS_ms &&
+               avgDecodingTimeLowLatencySPS_ms == d2.avgDecodingTimeLowLatencySPS_ms &&
+               avgKeyFrameRecovery_ms == d2.avgKeyFrameRecovery_ms && avgStereoSkew_ms == d2.avgStereoSkew_ms;
     }
 
     bool operator!=(const DecodingInfo& d2) const { return !(*this == d2); }
@@ -50,21 +83,26 @@ struct VideoRatio
 };
 
 // Handles decoding of .h264 and .h265 video
-// with low latency. Uses the AMediaCodec api
+// with low latency. Uses the AMediaCodec api (MediaCodecBackend), or any other IDecoderBackend
 class VideoDecoder
 {
   private:
     struct Decoder
     {
-        bool           configured[2] = {false, false};
-        AMediaCodec*   codec[2]      = {nullptr, nullptr};
-        ANativeWindow* window[2]     = {nullptr, nullptr};
+        bool configured[2] = {false, false};
+        // codec and output surface, nullptr while there is no surface
+        std::unique_ptr<IDecoderBackend> backend[2];
+        // running with AMediaCodec_setAsyncNotifyCallback, there is no output thread
+        bool async[2] = {false, false};
+        // detachSurface(): running without a surface, nothing is rendered (read by the output thread)
+        std::atomic<bool>                     parked[2] = {false, false};
+        std::chrono::steady_clock::time_point parkedSince[2];
     };
 
   public:
     // Make sure to do no heavy lifting on this callback, since it is called from the low-latency mCheckOutputThread
-    // thread (best to copy values and leave processing to another thread) The decoding info callback is called every
-    // DECODING_INFO_RECALCULATION_INTERVAL_MS
+    // thread or, in async mode, the codec's callback thread (best to copy values and leave processing to another
+    // thread) The decoding info callback is called every DECODING_INFO_RECALCULATION_INTERVAL_MS
     typedef std::function<void(const DecodingInfo)> DECODING_INFO_CHANGED_CALLBACK;
     // The decoder ratio callback is called every time the output format changes
     typedef std::function<void(const VideoRatio)> DECODER_RATIO_CHANGED;
@@ -73,43 +111,243 @@ class VideoDecoder
     // We cannot initialize the Decoder until we have SPS and PPS data -
     // when streaming this data will be available at some point in future
     // Therefore we don't allocate the MediaCodec resources here
+    // @param javaVm to raise the priority of our threads, may be nullptr (host)
+    explicit VideoDecoder(JavaVM* javaVm);
+
+#ifdef __ANDROID__
     VideoDecoder(JNIEnv* env);
+#endif
+
+    ~VideoDecoder();
 
+#ifdef __ANDROID__
     // This call acquires or releases the output surface
     // After acquiring the surface, the decoder will be started as soon as enough configuration data was passed to it
-    // When releasing the surface, the decoder will be stopped if running and any resources will be freed
+    // When releasing the surface, a running decoder is parked until the next surface, see detachSurface()
     // After releasing the surface it is safe for the android os to delete it
     void setOutputSurface(JNIEnv* env, jobject surface, jint idx);
+#endif
+
+    // With the codec and its output behind @param backend. nullptr stops and releases the backend of output
+    // @param idx, the parameter sets are kept for the next one.
+    void setBackend(std::unique_ptr<IDecoderBackend> backend, int idx);
+
+    /**
+     * The surface of output @param idx goes away (app in the background, VR toggle). A running codec is parked: it is
+     * moved to a placeholder surface and keeps decoding without rendering, so that it shows the next frame as soon as
+     * attachSurface() hands it a new surface, instead of waiting for the next key frame. Where the codec cannot
+     * switch surfaces, and after MAX_PARKED, it is released as with setBackend(nullptr).
+     */
+    void detachSurface(int idx);
+
+    // The surface of @param surface (a backend without a codec) for output @param idx. A parked codec moves over to
+    // it, else @param surface becomes the backend of the output as with setBackend().
+    void attachSurface(std::unique_ptr<IDecoderBackend> surface, int idx);
 
     // register the specified callbacks. Only one can be registered at a time
     void registerOnDecoderRatioChangedCallback(DECODER_RATIO_CHANGED decoderRatioChangedC);
 
     void registerOnDecodingInfoChangedCallback(DECODING_INFO_CHANGED_CALLBACK decodingInfoChangedCallback);
 
-    // If the decoder has been configured, feed NALU. Else search for configuration data and
-    // configure as soon as possible
-    //  If the input pipe was closed (surface has been removed or is not set yet), only buffer key frames
+    // Copies the NALU into the feed queue and returns without waiting for the codec. Must always be called from the
+    // same thread. If the feed thread is NALU_QUEUE_SIZE NALUs behind, the NALU is dropped, and so is everything
+    // after it up to the next key frame (config NALUs still pass), since the frames in between could not be decoded.
     void interpretNALU(const NALU& nalu);
 
+    struct FeedQueueStats
+    {
+        long   nQueued               = 0;
+        long   nDroppedFull          = 0;
+        long   nDroppedUntilKeyFrame = 0;
+        size_t highWaterMark         = 0;
+        size_t capacity              = 0;
+        // input buffers queued to / frames decoded by the (first) codec
+        long nInputBuffers  = 0;
+        long nDecodedFrames = 0;
+        // VR mode: NALUs dropped because the feeder of one codec was NALU_QUEUE_SIZE NALUs behind
+        long nDroppedFeeder = 0;
+        // see setCatchUpBudget()
+        long nCatchUps             = 0;
+        long nSkippedFramesCatchUp = 0;
+        // see setGopCacheLimit(): what the cache holds, NALUs fed from it to new codecs
+        size_t gopCacheBytes = 0;
+        long   nPrimedNALUs  = 0;
+        // see setCodecWatchdog(): wedged codecs flushed / created again, from the last reset to the next frame shown
+        long    nWatchdogFlushes   = 0;
+        long    nWatchdogRecreates = 0;
+        int64_t lastRecoveryUs     = 0;
+    };
+
+    FeedQueueStats getFeedQueueStats() const;
+
+    // VR mode: left / right output skew since the last reset of the statistics
+    OutputSkew::Stats getOutputSkew() const { return mOutputSkew.getStats(); }
+
+    /**
+     * false (default): every NALU is queued to the codec in its own input buffer.
+     * true: the NALUs of one access unit (frame) are collected in one input buffer, see AccessUnitAssembler. Takes
+     * effect on the feed thread with the next NALU.
+     */
+    void setAccessUnitMode(bool enabled) { mAccessUnitMode = enabled; }
+
+    /**
+     * Slice streaming: submit every slice as soon as it is complete, as a partial frame. Only done for a codec
+     * that supports partial frames, see @param partialFramesH264 / partialFramesH265 (decided by the java side with
+     * MediaCodecInfo). Without that support each slice goes to the codec in its own buffer, as in the default mode.
+     * Takes precedence over setAccessUnitMode().
+     */
+    void setSliceStreaming(bool enabled, bool partialFramesH264, bool partialFramesH265)
+    {
+        mPartialFramesH264 = partialFramesH264;
+        mPartialFramesH265 = partialFramesH265;
+        mSliceStreaming    = enabled;
+    }
+
+    /**
+     * true: rewrite the SPS to announce zero reordered frames (H.264 VUI bitstream_restriction, H.265
+     * sps_max_num_reorder_pics) before it goes to the decoder, as csd-0 and in-band. Without that many decoders hold
+     * back several frames. Changing it reconfigures the decoder with the next SPS.
+     */
+    void setLowLatencySPS(bool enabled) { mLowLatencySPS = enabled; }
+
+    /**
+     * true: run the codec(s) in asynchronous mode (Android 9+). MediaCodec reports free input buffers and decoded
+     * frames from its own thread instead of us polling for them with a timeout, and there is no output thread. Takes
+     * effect when a codec is created next, where async mode is not available the codec runs as before.
+     */
+    void setAsyncMode(bool enabled) { mAsyncMode = enabled; }
+
+    /**
+     * Latency budget of the catch-up mode, 0 (default) disables it. When a picture reaches the codec input later than
+     * that after its first packet was received, pictures are skipped until the backlog is gone, see CatchUpController.
+     */
+    void setCatchUpBudget(std::chrono::milliseconds budget) { mCatchUp.setBudget(budget); }
+
+    /**
+     * Most memory for the NALUs of the current GOP (default GopCache::DEFAULT_LIMIT), 0 disables the cache. A codec
+     * configured in the middle of a GOP is fed the cached NALUs as fast as it takes them, without showing them, and
+     * shows the next frame of the stream instead of waiting for the next key frame. A GOP that does not fit is not
+     * cached.
+     */
+    void setGopCacheLimit(size_t bytes) { mGopCache.setLimit(bytes); }
+
+    /**
+     * Codec watchdog: a codec that outputs nothing for @param frameIntervals frame intervals (at least
+     * CodecWatchdog::MIN_TIMEOUT) while the stream keeps coming is flushed, or created again if the flush did not
+     * help, and primed from the GOP cache, instead of staying frozen until the surface is set again. 0 disables it,
+     * the default is CodecWatchdog::DEFAULT_FRAME_INTERVALS.
+     */
+    void setCodecWatchdog(int frameIntervals) { mWatchdog.setFrameIntervals(frameIntervals); }
+
+    // Where the codec stages of the first codec are traced, nullptr for none. Set before the first NALU,
+    // @param trace has to outlive the decoder.
+    void setFrameTrace(FrameTrace* trace) { mFrameTrace = trace; }
+
   private:
+    // Runs on mFeedThread: if the decoder has been configured, feed NALU. Else search for configuration data and
+    // configure as soon as possible
+    //  If the input pipe was closed (surface has been removed or is not set yet), only buffer key frames
+    void processNALU(const NALU& nalu);
+
+    // With setLowLatencySPS() and @param nalu a SPS that needs it, the rewritten SPS (valid until the next call).
+    // Else @param nalu itself.
+    const NALU& lowLatencySPS(const NALU& nalu);
+
+    // Takes the NALUs out of mNaluQueue and processes them until the decoder is destroyed
+    void feedLoop();
+
     // Initialize decoder with SPS / PPS data from KeyFrameFinder
     // Set Decoder.configured to true on success
     void configureStartDecoder(int idx);
 
+    // Feed the newly configured codec @param idx with the GOP cache, its output is not shown. Called with
+    // mFeeders[idx].codecMutex held. @return false if there was nothing cached.
+    bool primeDecoder(int idx);
+
+    // Output @param presentationTimeUs of codec @param idx was fed by primeDecoder()
+    bool isPrimed(int idx, int64_t presentationTimeUs) const
+    {
+        return presentationTimeUs <= mPrimedUntilUs[idx].load(std::memory_order_relaxed);
+    }
+
+    // The watchdog found codec @param idx wedged: flush it, or create it again if the last reset did not help, and
+    // prime it. Called with mFeeders[idx].codecMutex held. @return true if it was primed, up to the current NALU.
+    bool resetCodec(int idx);
+
+    // Config for the current parameter sets in mKeyFrameFinder, updates mConfiguredFormat
+    DecoderConfig createConfig();
+
+    // The backend of output @param idx if it has a codec instance
+    IDecoderBackend* codec(int idx) const;
+
+    // setBackend(nullptr, @param idx), with mMutexInputPipe and mFeeders[idx].codecMutex held
+    void releaseBackend(int idx);
+
+    // The stream format changed: stop the codec and configure it again with the new parameter sets. Keeps the codec
+    // instance and the surface, so this is much faster than a surface reset. @param newCodec the mime type changed,
+    // a new codec instance is needed.
+    void reconfigureDecoder(int idx, bool newCodec);
+
+    // Feed @param nalu to codec @param idx, in its own input buffer or through its assembler. Called with
+    // mFeeders[idx].codecMutex held.
+    void feedCodec(const NALU& nalu, int idx, bool accessUnitMode);
+
     // Wait for input buffer to become available before feeding NALU
     void feedDecoder(const NALU& nalu, int idx);
 
+    // VR mode: hand @param nalu to the feeders of both codecs but those in @param primed (they got it from the GOP
+    // cache), @param cached is its copy in the cache if any
+    void dispatchNALU(const NALU& nalu, const GopCache::Entry& cached, const bool primed[2]);
+
+    // Runs on mFeeders[idx].thread: feeds codec idx with the NALUs dispatchNALU() queued for it
+    void feederLoop(int idx);
+
+    // Until all NALUs dispatched so far went to the codecs. The feed thread does this before it touches a codec or
+    // an assembler itself again.
+    void waitForFeeders();
+
+    // Index of an empty input buffer of codec @param idx, -1 if none became available
+    ssize_t dequeueInputBuffer(int idx);
+
+    // Access unit mode: submit what has been collected so far. Takes mMutexInputPipe.
+    void flushAccessUnits();
+
+    // Access unit mode: submit what codec @param idx has collected so far. Takes mFeeders[idx].codecMutex.
+    void flushAccessUnit(int idx);
+
     // Runs until EOS arrives at output buffer or decoder is stopped
     void checkOutputLoop(int idx);
 
+    // Starts codec @param idx and, unless it runs in async mode, its output thread
+    void startCodec(int idx);
+
+    // Stops codec @param idx and its output thread. Its input buffers are gone, the codec itself stays.
+    void stopCodec(int idx);
+
+    // With setAsyncMode(): register the callbacks of codec @param idx, before it is configured. false: the codec runs
+    // synchronously (not wanted or not available).
+    bool enableAsync(int idx);
+
+    // Renders output buffer @param index of codec @param idx
+    void releaseOutputBuffer(int idx, size_t index, int64_t presentationTimeUs);
+
+    // Codec @param idx rendered a frame queued at @param presentationTimeUs
+    void onFrameDecoded(int idx, int64_t presentationTimeUs);
+
+    void onOutputFormatChanged(int idx, int32_t width, int32_t height);
+
+    // Every DECODING_INFO_RECALCULATION_INTERVAL: recalculate decodingInfo and call the callback
+    void updateDecodingInfo();
+
     // Debug log
     void printAvgLog();
 
     void resetStatistics();
 
-    std::unique_ptr<std::thread> mCheckOutputThread[2]  = {nullptr, nullptr};
-    bool                         USE_SW_DECODER_INSTEAD = false;
-    // Holds the AMediaCodec instance, as well as the state (configured or not configured)
+    std::unique_ptr<std::thread> mCheckOutputThread[2] = {nullptr, nullptr};
+    // setOutputSurface(): the platform software decoder instead of the default (hardware) one
+    bool USE_SW_DECODER_INSTEAD = false;
+    // Holds the codec backends, as well as the state (configured or not configured)
     Decoder      decoder{};
     DecodingInfo decodingInfo;
     // The input pipe is closed until we set a valid surface
@@ -125,14 +363,188 @@ class VideoDecoder
     AvgCalculator                         parsingTime;
     AvgCalculator                         waitForInputB;
     AvgCalculator                         decodingTime;
+    AvgCalculator                         sliceLeadTime;
+    AvgCalculator                         decodingTimeOriginalSPS;
+    AvgCalculator                         decodingTimeLowLatencySPS;
+    // In the global registry as well, where the latencies get percentiles
+    Metrics::Histogram& mMetricFeed       = Metrics::global().histogram("decoder_feed_us");
+    Metrics::Histogram& mMetricWaitInput  = Metrics::global().histogram("decoder_wait_input_us");
+    Metrics::Histogram& mMetricDecode     = Metrics::global().histogram("decoder_decode_us");
+    Metrics::Counter&   mMetricInputs     = Metrics::global().counter("decoder_input_buffers");
+    Metrics::Counter&   mMetricDecoded    = Metrics::global().counter("decoder_decoded_frames");
+    Metrics::Counter&   mMetricDropped    = Metrics::global().counter("decoder_dropped_nalus");
+    Metrics::Gauge&     mMetricQueueDepth = Metrics::global().gauge("decoder_feed_queue_depth");
     // Every n ms re-calculate the Decoding info
     static const constexpr auto DECODING_INFO_RECALCULATION_INTERVAL = std::chrono::milliseconds(1000);
     static constexpr const bool PRINT_DEBUG_INFO                     = true;
     static constexpr auto       TIME_BETWEEN_LOGS                    = std::chrono::seconds(5);
     static constexpr int64_t    BUFFER_TIMEOUT_US = 17 * 1000;  // 17ms (a little bit more than 17 ms (==60 fps))
+    // A parked codec is released after this long, the hardware decoders are shared with the other apps
+    static constexpr auto MAX_PARKED = std::chrono::seconds(10);
   private:
     KeyFrameFinder mKeyFrameFinder;
     bool           IS_H265 = false;
+    // What the codec(s) were configured with
+    VideoFormat mConfiguredFormat;
+    bool        mConfiguredH265 = false;
+    // A SPS with another format arrived, reconfigure once the parameter sets are complete
+    bool mReconfigurePending = false;
+
+    std::atomic<bool> mLowLatencySPS = false;
+    // The last SPS from the stream and its rewrite (empty if it needs none), the SPS repeats with every key frame
+    std::vector<uint8_t> mOriginalSPS;
+    std::vector<uint8_t> mRewrittenSPS;
+    std::vector<uint8_t> mSPSScratch;
+    std::optional<NALU>  mRewrittenSPSNALU;
+    // The last SPS seen by processNALU() was rewritten / the codec runs with a rewritten SPS (read by the output
+    // thread for the decoding time split)
+    bool              mSPSRewritten           = false;
+    std::atomic<bool> mConfiguredRewrittenSPS = false;
+
+    // Hand-off between the thread that parses the network data and mFeedThread, which may block in
+    // dequeueInputBuffer. The slots keep their buffers, after a few key frames the queue no longer allocates.
+    // A NALU that still references its RTP packets is queued as such and only copied into the codec input buffer.
+    struct QueuedNALU
+    {
+        std::vector<uint8_t>                  data;
+        FragmentedNALU                        fragments;
+        bool                                  isH265          = false;
+        bool                                  endOfAccessUnit = false;
+        uint32_t                              frameId         = 0;
+        std::chrono::steady_clock::time_point creationTime;
+    };
+
+    static constexpr size_t NALU_QUEUE_SIZE = 64;
+    SpscRing<QueuedNALU>    mNaluQueue{NALU_QUEUE_SIZE};
+    // only touched by the producer
+    bool mDropUntilKeyFrame = false;
+    // producer written counters
+    std::atomic<long>   mNQueued               = 0;
+    std::atomic<long>   mNDroppedFull          = 0;
+    std::atomic<long>   mNDroppedUntilKeyFrame = 0;
+    std::atomic<size_t> mQueueHighWaterMark    = 0;
+    // the feed thread sleeps on mFeedCondition while the queue is empty
+    std::atomic<bool>       mFeedThreadSleeping = false;
+    std::atomic<bool>       mFeedThreadStop     = false;
+    std::mutex              mFeedMutex;
+    std::condition_variable mFeedCondition;
+    std::thread             mFeedThread;
+
+    // Access unit mode, the sink of mAssembler[idx]: the input buffer of codec idx that is being filled
+    struct CodecInput
+    {
+        VideoDecoder* self  = nullptr;
+        int           idx   = 0;
+        ssize_t       index = -1;
+        // submit time of the first partial buffer of the current frame
+        std::chrono::steady_clock::time_point firstPartial;
+        bool                                  partialFrame = false;
+        // VR mode: the NALU being fed, labels the input buffers for mOutputSkew
+        uint64_t seq = 0;
+        // frame of the NALU being fed, for mFrameTrace
+        uint32_t frameId = 0;
+        // primeDecoder() is feeding, not the stream: no statistics. And the timestamp of the last input buffer.
+        bool    priming   = false;
+        int64_t lastPtsUs = 0;
+
+        bool acquire(uint8_t*& data, size_t& capacity);
+
+        void submit(size_t size, uint32_t flags, std::chrono::steady_clock::time_point creationTime);
+    };
+
+    // An access unit whose end was not seen is submitted once no NALU arrived for this long
+    static constexpr auto ACCESS_UNIT_TIMEOUT = std::chrono::milliseconds(2);
+    // Without NALUs the feed thread looks again after this long (and goes back to sleep)
+    static constexpr auto FEED_IDLE_TIMEOUT = std::chrono::seconds(1);
+    std::atomic<bool>     mAccessUnitMode     = false;
+    std::atomic<bool>     mSliceStreaming     = false;
+    std::atomic<bool>     mPartialFramesH264  = false;
+    std::atomic<bool>     mPartialFramesH265  = false;
+    // mAccessUnitMode / mSliceStreaming as seen by the feed thread
+    bool                mAccessUnitModeActive = false;
+    bool                mSliceStreamingActive = false;
+    CodecInput          mCodecInput[2];
+    AccessUnitAssembler mAssembler[2];
+    std::atomic<long>   mNInputBuffers  = 0;
+    std::atomic<long>   mNDecodedFrames = 0;
+
+    // VR mode (a codec on both outputs): each codec is fed by its own thread from one ref-counted copy of the NALU,
+    // so a codec waiting for an input buffer holds back neither the other codec nor the feed thread. With a single
+    // codec the feed thread feeds it directly, there is no extra hop.
+    struct SharedNALU
+    {
+        // the copy in the GOP cache if the NALU is cached
+        GopCache::Entry buffer;
+        uint64_t        seq            = 0;
+        bool            accessUnitMode = false;
+
+        SharedNALU(GopCache::Entry buffer, uint64_t seq, bool accessUnitMode)
+            : buffer(std::move(buffer)), seq(seq), accessUnitMode(accessUnitMode)
+        {
+        }
+    };
+
+    struct Feeder
+    {
+        SpscRing<std::shared_ptr<SharedNALU>> queue{NALU_QUEUE_SIZE};
+        // The input side of codec idx: feeding it, its assembler / CodecInput, stopping and configuring it
+        std::mutex codecMutex;
+        // NALUs fed (or given up), feed thread written count of NALUs dispatched
+        std::atomic<long> nDone       = 0;
+        long              nDispatched = 0;
+        // only touched by the feed thread, as mDropUntilKeyFrame
+        bool dropUntilKeyFrame = false;
+        // resetCodec() primed the codec with the NALUs dispatched before this one, they are skipped (under codecMutex)
+        uint64_t resumeSeq = 0;
+        // the feeder sleeps on condition while its queue is empty
+        std::atomic<bool>       sleeping = false;
+        std::mutex              mutex;
+        std::condition_variable condition;
+        std::thread             thread;
+    };
+
+    Feeder            mFeeders[2];
+    std::atomic<bool> mFeedersStop    = false;
+    std::atomic<bool> mParallelFeed   = false;
+    uint64_t          mNextSeq        = 0;
+    std::atomic<long> mNDroppedFeeder = 0;
+    OutputSkew        mOutputSkew;
+
+    FrameTrace* mFrameTrace = nullptr;
+
+    GopCache mGopCache;
+    // the NALUs interpretNALU() dropped so far, as the feed thread saw them
+    long mNDroppedSeen = 0;
+    // Output of codec idx up to this presentation time was fed by primeDecoder() (read by the output thread)
+    std::atomic<int64_t> mPrimedUntilUs[2] = {0, 0};
+    std::atomic<long>    mNPrimedNALUs     = 0;
+    Metrics::Counter&    mMetricPrimed     = Metrics::global().counter("decoder_primed_nalus");
+
+    CatchUpController mCatchUp;
+    CodecWatchdog     mWatchdog;
+    // The last wait for an input buffer of the first codec, part of the backlog the catch-up mode looks at
+    std::atomic<std::chrono::steady_clock::rep> mLastInputWait{0};
+
+    // Async mode: what codec idx reports, on the codec's callback thread. Output buffers are released right there.
+    struct AsyncCallbacks : AsyncCodecListener
+    {
+        VideoDecoder*     self = nullptr;
+        int               idx  = 0;
+        AsyncInputBuffers input;
+        // An error since the last start needs a new codec, not only a stop and configure
+        std::atomic<bool> fatalError = false;
+
+        void onInputAvailable(int32_t index) override;
+
+        void onOutputAvailable(int32_t index, int64_t presentationTimeUs, uint32_t flags) override;
+
+        void onFormatChanged(int32_t width, int32_t height) override;
+
+        void onError(int32_t error, int32_t actionCode) override;
+    };
+
+    std::atomic<bool> mAsyncMode = false;
+    AsyncCallbacks    mAsyncCallbacks[2];
 };
 
 #endif  // FPVUE_VIDEODECODER_H
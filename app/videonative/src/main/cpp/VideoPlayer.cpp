@@ -12,9 +12,10 @@
 #define TAG "pixelpilot"
 
 VideoPlayer::VideoPlayer(JNIEnv* env, jobject context)
-    : mParser{std::bind(&VideoPlayer::onNewNALU, this, std::placeholders::_1)}, videoDecoder(env)
+    : mParserH264{NALUToPlayer{this}}, mParserH265{NALUToPlayer{this}}, videoDecoder(env)
 {
     env->GetJavaVM(&javaVm);
+    videoDecoder.setFrameTrace(&mFrameTrace);
     videoDecoder.registerOnDecoderRatioChangedCallback(
         [this](const VideoRatio ratio)
         {
@@ -23,8 +24,27 @@ VideoPlayer::VideoPlayer(JNIEnv* env, jobject context)
             latestVideoRatioChanged = changed;
         });
     videoDecoder.registerOnDecodingInfoChangedCallback(
-        [this](const DecodingInfo info)
+        [this](DecodingInfo info)
         {
+            const long sumUs    = mKernelDelaySumUs.load(std::memory_order_relaxed);
+            const long nSamples = mNKernelDelaySamples.load(std::memory_order_relaxed);
+            if (nSamples > mNKernelDelaySamplesAtLastInfo)
+            {
+                info.avgKernelToUserDelay_ms = (float) (sumUs - mKernelDelaySumUsAtLastInfo) /
+                                               (float) (nSamples - mNKernelDelaySamplesAtLastInfo) / 1000.0f;
+            }
+            mKernelDelaySumUsAtLastInfo    = sumUs;
+            mNKernelDelaySamplesAtLastInfo = nSamples;
+            const long recoverySumUs       = mKeyFrameRequester.getRecoverySumUs();
+            const long nRecoveries         = mKeyFrameRequester.getNRecoveries();
+            if (nRecoveries > mNRecoveriesAtLastInfo)
+            {
+                info.avgKeyFrameRecovery_ms = (float) (recoverySumUs - mRecoverySumUsAtLastInfo) /
+                                              (float) (nRecoveries - mNRecoveriesAtLastInfo) / 1000.0f;
+            }
+            mRecoverySumUsAtLastInfo  = recoverySumUs;
+            mNRecoveriesAtLastInfo    = nRecoveries;
+            info.rtpJitter_ms         = (float) mRtpJitterUs.load(std::memory_order_relaxed) / 1000.0f;
             const bool changed        = info != this->latestDecodingInfo;
             this->latestDecodingInfo  = info;
             latestDecodingInfoChanged = changed;
@@ -61,7 +81,8 @@ void VideoPlayer::processQueue()
         }
         if (!naluQueue.empty())
         {
-            NALU nalu = naluQueue.front();
+            const std::shared_ptr<NALUBuffer> buffer = naluQueue.front();
+            const NALU&                       nalu   = buffer->get_nal();
             if (framerate == 0)
             {
                 if (latestDecodingInfo.currentFPS <= 0)
@@ -107,48 +128,168 @@ void VideoPlayer::processQueue()
 }
 
 // Not yet parsed bit stream (e.g. raw h264 or rtp data)
-void VideoPlayer::onNewRTPData(const uint8_t* data, const std::size_t data_length)
+void VideoPlayer::onNewRTPData(const uint8_t* data, const std::size_t data_length, PacketRef packet)
 {
+    applyJitterBufferMode();
+
     // Parse the RTP packet
     const RTP::RTPPacket rtpPacket(data, data_length);
     uint16_t             idx = rtpPacket.header.getSequence();
 
-    // Define the callback based on payload type
-    auto callback = [&](const uint8_t* packet_data, std::size_t packet_length)
+    // The same stream may arrive on more than one input
+    RtpDuplicateFilter& duplicateFilter =
+        rtpPacket.header.payload == RTP_PAYLOAD_TYPE_AUDIO ? mDuplicateFilterAudio : mDuplicateFilterVideo;
+    if (duplicateFilter.isDuplicate(idx))
+    {
+        mMetricDuplicates.add();
+        return;
+    }
+
+    if (rtpPacket.header.payload != RTP_PAYLOAD_TYPE_AUDIO)
+    {
+        // in receive order, before the reorder queue
+        const auto arrival = packet && packet.timestamp() != std::chrono::steady_clock::time_point{}
+                                 ? packet.timestamp()
+                                 : std::chrono::steady_clock::now();
+        mJitterEstimatorVideo.add(rtpPacket.header.getTimestamp(), arrival);
+        mRtpJitterUs.store((long) mJitterEstimatorVideo.getJitterTime().count(), std::memory_order_relaxed);
+        mMetricJitter.set((int64_t) mJitterEstimatorVideo.getJitterTime().count());
+        if (rtpPacket.header.getTimestamp() != mLastReceivedFrameId)
+        {
+            mLastReceivedFrameId = rtpPacket.header.getTimestamp();
+            mFrameTrace.record(FrameTrace::Stage::RECEIVE, mLastReceivedFrameId, arrival);
+        }
+    }
+
+    // Define the callback based on payload type. @param queued is the packet handed out (with its receive timestamp),
+    // which is not the one just received if the queue releases buffered packets. The parser references the video
+    // packets instead of copying their payload.
+    auto callback = [&](const PacketRef& queued)
     {
         if (rtpPacket.header.payload == RTP_PAYLOAD_TYPE_AUDIO)
         {
-            audioDecoder.enqueueAudio(packet_data, packet_length);
+            audioDecoder.enqueueAudio(queued.data(), queued.size());
         }
         else
         {
-            mParser.parse_rtp_stream(packet_data, packet_length);
+            const uint8_t payloadType = mParserH264.payloadType(queued.data(), queued.size());
+            if (mFrameTrace.isEnabled() && payloadType != 0)
+            {
+                // the last packet of a frame
+                const auto& header = *reinterpret_cast<const rtp_header_t*>(queued.data());
+                if (header.marker)
+                {
+                    mFrameTrace.record(
+                        FrameTrace::Stage::REORDER_RELEASE, header.getTimestamp(), std::chrono::steady_clock::now());
+                }
+            }
+            // A packet after a gap means data the reorder queue gave up on, ask for a key frame right away
+            const int nGaps = mParserH264.nGaps() + mParserH265.nGaps();
+            if (payloadType == mParserH264.PAYLOAD_TYPE)
+            {
+                mParserH264.setLossPolicy(mLossPolicyH264.load(std::memory_order_relaxed));
+                mParserH264.parse(queued);
+            }
+            else if (payloadType == mParserH265.PAYLOAD_TYPE)
+            {
+                mParserH265.setLossPolicy(mLossPolicyH265.load(std::memory_order_relaxed));
+                mParserH265.parse(queued);
+            }
+            if (mParserH264.nGaps() + mParserH265.nGaps() != nGaps)
+            {
+                mKeyFrameRequester.onGap(std::chrono::steady_clock::now());
+            }
         }
     };
 
-    // Process the packet using the queue
-    if (rtpPacket.header.payload == RTP_PAYLOAD_TYPE_AUDIO)
+    // Process the packet using the queue. An owned packet is buffered by moving the handle, else by copying.
+    BufferedPacketQueue& queue =
+        rtpPacket.header.payload == RTP_PAYLOAD_TYPE_AUDIO ? mBufferedPacketQueueAudio : mBufferedPacketQueueVideo;
+    if (packet)
     {
-        mBufferedPacketQueueAudio.processPacket(idx, data, data_length, callback);
+        queue.processPacket(idx, std::move(packet), callback);
     }
     else
     {
-        mBufferedPacketQueueVideo.processPacket(idx, data, data_length, callback);
+        queue.processPacket(idx, data, data_length, callback);
+    }
+}
+
+void VideoPlayer::setJitterBufferDeadline(int maxWaitUs)
+{
+    mWantedJitterDeadlineUs = std::max(maxWaitUs, 0);
+}
+
+void VideoPlayer::applyJitterBufferMode()
+{
+    const int wanted = mWantedJitterDeadlineUs.load(std::memory_order_relaxed);
+    if (wanted == mJitterDeadlineUs)
+    {
+        return;
+    }
+    mJitterDeadlineUs = wanted;
+    for (BufferedPacketQueue* queue : {&mBufferedPacketQueueVideo, &mBufferedPacketQueueAudio})
+    {
+        if (wanted > 0)
+        {
+            BufferedPacketQueue::DeadlineConfig config;
+            config.maxWait = std::chrono::microseconds(wanted);
+            config.minWait = std::min(config.minWait, config.maxWait);
+            queue->enableDeadlineMode(config);
+        }
+        else
+        {
+            queue->disableDeadlineMode();
+        }
     }
+    __android_log_print(ANDROID_LOG_DEBUG, TAG, "jitter buffer deadline %d us", wanted);
+}
+
+void VideoPlayer::onNewRTPBatch(const DatagramBatch& batch)
+{
+    // How long the datagrams waited in the socket before we read them
+    const auto now     = std::chrono::steady_clock::now();
+    long       delayUs = 0;
+    for (const Datagram& datagram : batch)
+    {
+        const auto datagramDelayUs = std::chrono::duration_cast<std::chrono::microseconds>(now - datagram.arrival);
+        delayUs += (long) datagramDelayUs.count();
+        mMetricKernelDelay.record(datagramDelayUs);
+    }
+    Metrics::increment(mKernelDelaySumUs, delayUs);
+    Metrics::increment(mNKernelDelaySamples, (long) batch.size());
+
+    for (const Datagram& datagram : batch)
+    {
+        onNewRTPData(datagram.data, datagram.length, datagram.packet);
+    }
+}
+
+bool VideoPlayer::setMetricsEndpoint(int port)
+{
+    mMetricsEndpoint.reset();
+    if (port <= 0 || port > UINT16_MAX) return port == 0;
+    mMetricsEndpoint = std::make_unique<MetricsEndpoint>(Metrics::global(), (uint16_t) port);
+    return mMetricsEndpoint->isListening();
 }
 
 void VideoPlayer::onNewNALU(const NALU& nalu)
 {
+    if (nalu.isEndOfAccessUnit() && mFrameTrace.isEnabled())
+    {
+        mFrameTrace.record(FrameTrace::Stage::NALU_COMPLETE, nalu.getFrameId(), std::chrono::steady_clock::now());
+    }
+    if (nalu.is_keyframe() && !nalu.isCorrupted())
+    {
+        mKeyFrameRequester.onKeyFrame(std::chrono::steady_clock::now());
+    }
     videoDecoder.interpretNALU(nalu);
     if (dvr_fd <= 0 || latestDecodingInfo.currentFPS <= 0)
     {
         return;
     }
-    // Copy data to write if from a different thread.
-    uint8_t* m_data_copy = new uint8_t[nalu.getSize()];
-    memcpy(m_data_copy, nalu.getData(), nalu.getSize());
-    NALU nalu_(m_data_copy, nalu.getSize(), nalu.IS_H265_PACKET);
-    enqueueNALU(nalu_);
+    // Copy data to write if from a different thread. The one copy of the payload for the DVR.
+    enqueueNALU(std::make_shared<NALUBuffer>(nalu));
 }
 
 void VideoPlayer::setVideoSurface(JNIEnv* env, jobject surface, jint i)
@@ -164,44 +305,35 @@ void VideoPlayer::start(JNIEnv* env, jobject androidContext)
     AAssetManager* assetManager = NDKHelper::getAssetManagerFromContext2(env, androidContext);
     // mParser.setLimitFPS(-1); //Default: Real time !
     const int VS_PORT = 5600;
-    mUDPReceiver.release();
-    mUDPReceiver = std::make_unique<UDPReceiver>(
-        javaVm,
-        VS_PORT,
-        "UdpReceiver",
-        -16,
-        [this](const uint8_t* data, size_t data_length) { onNewRTPData(data, data_length); },
-        WANTED_UDP_RCVBUF_SIZE);
-    mUDPReceiver->startReceiving();
-
-    mUDSReceiver.release();
     // build the abstract socket name ("\0my_socket")
-    auto udsName = std::string("\0my_socket", sizeof("\0my_socket") - 1);
+    const auto udsName = std::string("\0my_socket", sizeof("\0my_socket") - 1);
 
-    // now construct your receiver with that
-    mUDSReceiver = std::make_unique<UDSReceiver>(
+    // One thread owns both inputs, so the parser and the reorder queues are only ever touched from it
+    mIngest = std::make_unique<IngestReactor>(
         javaVm,
-        udsName,   // abstract socket name
-        "UDS‑Rx",  // thread name
-        -16,       // Android priority
-        [this](const uint8_t* data, size_t data_length) { onNewRTPData(data, data_length); },
-        WANTED_UDP_RCVBUF_SIZE  // your desired recv‑buffer size
-    );
-
-    mUDSReceiver->startReceiving();
+        "IngestReactor",
+        -16,
+        [this](size_t, const DatagramBatch& batch) { onNewRTPBatch(batch); });
+    mIngest->addSource(
+        "udp port " + std::to_string(VS_PORT),
+        UDPReceiver::openSocket(VS_PORT, WANTED_UDP_RCVBUF_SIZE),
+        PacketPool::create(PacketPool::DEFAULT_BUFFER_SIZE, N_PACKET_BUFFERS));
+    mIngest->addSource(
+        "socket @my_socket",
+        UDSReceiver::openSocket(udsName, WANTED_UDP_RCVBUF_SIZE),
+        PacketPool::create(PacketPool::DEFAULT_BUFFER_SIZE, N_PACKET_BUFFERS));
+    mDuplicateFilterVideo.reset();
+    mDuplicateFilterAudio.reset();
+    mJitterEstimatorVideo.reset();
+    mIngest->start();
 }
 
 void VideoPlayer::stop(JNIEnv* env, jobject androidContext)
 {
-    if (mUDPReceiver)
-    {
-        mUDPReceiver->stopReceiving();
-        mUDPReceiver.reset();
-    }
-    if (mUDSReceiver)
+    if (mIngest)
     {
-        mUDSReceiver->stopReceiving();
-        mUDSReceiver.reset();
+        mIngest->stop();
+        mIngest.reset();
     }
 
     audioDecoder.stopAudio();
@@ -210,24 +342,50 @@ void VideoPlayer::stop(JNIEnv* env, jobject androidContext)
 std::string VideoPlayer::getInfoString() const
 {
     std::stringstream ss;
-    if (mUDPReceiver)
-    {
-        ss << "Listening for video on port " << mUDPReceiver->getPort();
-        ss << "\nReceived: " << mUDPReceiver->getNReceivedBytes() << "B"
-           << " | parsed frames: ";
-        // << mParser.nParsedNALUs << " | key frames: " << mParser.nParsedKonfigurationFrames;
-    }
-    else if (mUDSReceiver)
+    if (mIngest && mIngest->getNSources() > 0)
     {
-        ss << "Listening for video on socket " << mUDSReceiver->getSourcePath();
-        ss << "\nReceived: " << mUDSReceiver->getNReceivedBytes() << "B"
-           << " | parsed frames: ";
+        for (size_t i = 0; i < mIngest->getNSources(); i++)
+        {
+            ss << (i == 0 ? "Listening for video on " : " | ") << mIngest->getSourceName(i) << ": "
+               << mIngest->getNReceivedBytes(i) << "B";
+        }
+        ss << "\nDuplicates dropped: " << mMetricDuplicates.value() << " | parsed frames: ";
         // << mParser.nParsedNALUs << " | key frames: " << mParser.nParsedKonfigurationFrames;
     }
     else
     {
         ss << "Not receiving udp raw / rtp / rtsp";
     }
+    const auto feed = videoDecoder.getFeedQueueStats();
+    ss << "\nDecoder feed queue: " << feed.nQueued << " NALUs, max " << feed.highWaterMark << "/" << feed.capacity
+       << " queued | dropped full " << feed.nDroppedFull << " until key frame " << feed.nDroppedUntilKeyFrame;
+    ss << "\nCatch-up: " << feed.nCatchUps << " times behind, " << feed.nSkippedFramesCatchUp << " frames skipped";
+    ss << "\nGOP cache: " << feed.gopCacheBytes / 1024 << "KB | " << feed.nPrimedNALUs << " NALUs fed to new codecs";
+    ss << "\nWedged codecs: " << feed.nWatchdogFlushes << " flushed | " << feed.nWatchdogRecreates
+       << " created again | last recovery " << feed.lastRecoveryUs / 1000.0 << "ms";
+    ss << "\nParser gaps: " << mKeyFrameRequester.getNGaps() << " | key frames requested "
+       << mKeyFrameRequester.getNRequests() << " rate limited " << mKeyFrameRequester.getNRateLimited()
+       << (mKeyFrameRequester.hasTarget() ? "" : " (no link to request from)");
+    ss << "\nCodec input buffers: " << feed.nInputBuffers;
+    if (feed.nDecodedFrames > 0)
+    {
+        ss << " (" << (double) feed.nInputBuffers / feed.nDecodedFrames << " per frame)";
+    }
+    const auto skew = videoDecoder.getOutputSkew();
+    if (skew.nPairs > 0)
+    {
+        ss << "\nStereo output skew: avg " << skew.avgAbsSkew_ms() << "ms (right - left " << skew.avgSkew_ms()
+           << "ms) max " << skew.maxAbsSkewUs / 1000.0 << "ms over " << skew.nPairs << " frames | feeder drops "
+           << feed.nDroppedFeeder;
+    }
+    if (mWantedJitterDeadlineUs > 0)
+    {
+        const auto stats = mBufferedPacketQueueVideo.getJitterStats();
+        ss << "\nJitter buffer: deadline " << stats.deadline.count() << "us | gaps filled " << stats.nGapsFilled
+           << " skipped " << stats.nGapsSkipped << " (" << stats.nPacketsSkipped << " pkts) filled late "
+           << stats.nGapsFilledLate << " | avg added latency "
+           << (stats.nHeldPackets > 0 ? stats.addedLatency.count() / stats.nHeldPackets : 0) << "us";
+    }
     return ss.str();
 }
 
@@ -314,13 +472,9 @@ extern "C"
 
         bool ret{false};
 
-        if (p->mUDPReceiver != nullptr)
-        {
-            ret |= (p->mUDPReceiver->getNReceivedBytes() > 0);
-        }
-        if (p->mUDSReceiver != nullptr)
+        if (p->mIngest != nullptr)
         {
-            ret |= (p->mUDSReceiver->getNReceivedBytes() > 0);
+            ret |= (p->mIngest->getNReceivedBytes() > 0);
         }
 
         return (jboolean) ret;
@@ -369,7 +523,7 @@ extern "C"
             {
                 jclass jcDecodingInfo = env->FindClass("com/openipc/videonative/DecodingInfo");
                 assert(jcDecodingInfo != nullptr);
-                jmethodID jcDecodingInfoConstructor = env->GetMethodID(jcDecodingInfo, "<init>", "(FFFFFIIII)V");
+                jmethodID jcDecodingInfoConstructor = env->GetMethodID(jcDecodingInfo, "<init>", "(FFFFFFFFFFFFIIII)V");
                 assert(jcDecodingInfoConstructor != nullptr);
                 const auto info         = p->latestDecodingInfo;
                 auto       decodingInfo = env->NewObject(
@@ -380,6 +534,13 @@ extern "C"
                     (jfloat) info.avgParsingTime_ms,
                     (jfloat) info.avgWaitForInputBTime_ms,
                     (jfloat) info.avgDecodingTime_ms,
+                    (jfloat) info.rtpJitter_ms,
+                    (jfloat) info.avgKernelToUserDelay_ms,
+                    (jfloat) info.avgSliceLeadTime_ms,
+                    (jfloat) info.avgDecodingTimeOriginalSPS_ms,
+                    (jfloat) info.avgDecodingTimeLowLatencySPS_ms,
+                    (jfloat) info.avgKeyFrameRecovery_ms,
+                    (jfloat) info.avgStereoSkew_ms,
                     (jint) info.nNALU,
                     (jint) info.nNALUSFeeded,
                     (jint) info.nDecodedFrames,
@@ -429,3 +590,91 @@ Java_com_openipc_videonative_VideoPlayer_nativeStopAudio(JNIEnv* env, jclass cla
 {
     native(native_instance)->audioDecoder.stopAudioProcessing();
 }
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetJitterBufferDeadline(
+    JNIEnv* env, jclass clazz, jlong native_instance, jint max_wait_us)
+{
+    native(native_instance)->setJitterBufferDeadline(max_wait_us);
+}
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetAccessUnitMode(
+    JNIEnv* env, jclass clazz, jlong native_instance, jboolean enabled)
+{
+    native(native_instance)->setAccessUnitMode(enabled);
+}
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetSliceStreaming(
+    JNIEnv*  env,
+    jclass   clazz,
+    jlong    native_instance,
+    jboolean enabled,
+    jboolean partial_frames_h264,
+    jboolean partial_frames_h265)
+{
+    native(native_instance)->setSliceStreaming(enabled, partial_frames_h264, partial_frames_h265);
+}
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetLowLatencySPS(
+    JNIEnv* env, jclass clazz, jlong native_instance, jboolean enabled)
+{
+    native(native_instance)->setLowLatencySPS(enabled);
+}
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetAsyncDecoder(
+    JNIEnv* env, jclass clazz, jlong native_instance, jboolean enabled)
+{
+    native(native_instance)->setAsyncDecoder(enabled);
+}
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetCatchUpBudget(
+    JNIEnv* env, jclass clazz, jlong native_instance, jint budgetMs)
+{
+    native(native_instance)->setCatchUpBudget(budgetMs);
+}
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetGopCacheLimit(
+    JNIEnv* env, jclass clazz, jlong native_instance, jint limitKb)
+{
+    native(native_instance)->setGopCacheLimit(limitKb);
+}
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetCodecWatchdog(
+    JNIEnv* env, jclass clazz, jlong native_instance, jint frameIntervals)
+{
+    native(native_instance)->setCodecWatchdog(frameIntervals);
+}
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetLossPolicy(
+    JNIEnv* env, jclass clazz, jlong native_instance, jboolean h265, jint policy)
+{
+    if (policy < (jint) RTPLossPolicy::DROP || policy > (jint) RTPLossPolicy::TRUNCATE)
+    {
+        return;
+    }
+    native(native_instance)->setLossPolicy(h265, (RTPLossPolicy) policy);
+}
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetLatencyTrace(
+    JNIEnv* env, jclass clazz, jlong native_instance, jboolean enabled)
+{
+    native(native_instance)->setLatencyTrace(enabled);
+}
+extern "C" JNIEXPORT jboolean JNICALL Java_com_openipc_videonative_VideoPlayer_nativeDumpLatencyTrace(
+    JNIEnv* env, jclass clazz, jlong native_instance, jstring path, jint seconds)
+{
+    const char* chars = env->GetStringUTFChars(path, nullptr);
+    if (chars == nullptr)
+    {
+        return false;
+    }
+    const std::string file(chars);
+    env->ReleaseStringUTFChars(path, chars);
+    return native(native_instance)->dumpLatencyTrace(file, seconds);
+}
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_openipc_videonative_VideoPlayer_nativeGetMetrics(JNIEnv* env, jclass clazz, jlong native_instance)
+{
+    return env->NewStringUTF(native(native_instance)->getMetrics().c_str());
+}
+extern "C" JNIEXPORT jboolean JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetMetricsEndpoint(
+    JNIEnv* env, jclass clazz, jlong native_instance, jint port)
+{
+    return native(native_instance)->setMetricsEndpoint(port);
+}
+extern "C" JNIEXPORT void JNICALL Java_com_openipc_videonative_VideoPlayer_nativeSetKeyFrameRequester(
+    JNIEnv* env, jclass clazz, jlong native_instance, jlong function, jlong context)
+{
+    native(native_instance)
+        ->setKeyFrameRequester(
+            reinterpret_cast<KeyFrameRequester::RequestFunction>(function), reinterpret_cast<void*>(context));
+}
@@ -7,15 +7,22 @@
 #include <fcntl.h>
 #include <jni.h>
 #include <stdio.h>
+#include <algorithm>
 #include <fstream>
 #include <queue>
 #include "AudioDecoder.h"
 #include "BufferedPacketQueue.h"
+#include "FrameTrace.h"
+#include "IngestReactor.h"
+#include "KeyFrameRequester.h"
+#include "Metrics.h"
+#include "RtpDuplicateFilter.h"
+#include "RtpJitterEstimator.h"
 #include "UdpReceiver.h"
 #include "UdsReceiver.h"
 #include "VideoDecoder.h"
 #include "minimp4.h"
-#include "parser/H26XParser.h"
+#include "parser/StaticH26XParser.h"
 #include "time_util.h"
 
 class VideoPlayer
@@ -23,7 +30,11 @@ class VideoPlayer
   public:
     VideoPlayer(JNIEnv* env, jobject context);
 
-    void onNewRTPData(const uint8_t* data, const std::size_t data_length);
+    // @param packet optional owning handle to @param data, lets the reorder queue keep the packet without a copy
+    void onNewRTPData(const uint8_t* data, const std::size_t data_length, PacketRef packet = {});
+
+    // All datagrams one receiver drained from its socket in one go
+    void onNewRTPBatch(const DatagramBatch& batch);
 
     /*
      * Set the surface the decoder can be configured with. When @param surface==nullptr
@@ -46,6 +57,66 @@ class VideoPlayer
      */
     std::string getInfoString() const;
 
+    /**
+     * Select how the reorder queues release packets held back by a gap. @param maxWaitUs > 0 enables the deadline
+     * mode (wait at most that long for a missing packet, less if the measured reorder delay is shorter), 0 restores
+     * the packet count heuristics. Takes effect on the receiver thread with the next packet.
+     */
+    void setJitterBufferDeadline(int maxWaitUs);
+
+    /**
+     * true: queue each access unit (frame) to MediaCodec in one input buffer instead of one buffer per NALU.
+     */
+    void setAccessUnitMode(bool enabled) { videoDecoder.setAccessUnitMode(enabled); }
+
+    // See VideoDecoder::setSliceStreaming()
+    void setSliceStreaming(bool enabled, bool partialFramesH264, bool partialFramesH265)
+    {
+        videoDecoder.setSliceStreaming(enabled, partialFramesH264, partialFramesH265);
+    }
+
+    // See VideoDecoder::setLowLatencySPS()
+    void setLowLatencySPS(bool enabled) { videoDecoder.setLowLatencySPS(enabled); }
+
+    // See VideoDecoder::setAsyncMode()
+    void setAsyncDecoder(bool enabled) { videoDecoder.setAsyncMode(enabled); }
+
+    // See VideoDecoder::setCatchUpBudget()
+    void setCatchUpBudget(int budgetMs) { videoDecoder.setCatchUpBudget(std::chrono::milliseconds(budgetMs)); }
+
+    // See VideoDecoder::setGopCacheLimit()
+    void setGopCacheLimit(int limitKb) { videoDecoder.setGopCacheLimit((size_t) std::max(limitKb, 0) * 1024); }
+
+    // See VideoDecoder::setCodecWatchdog()
+    void setCodecWatchdog(int frameIntervals) { videoDecoder.setCodecWatchdog(frameIntervals); }
+
+    // How the parser handles NALUs with lost fragments, see RTPLossPolicy. Takes effect with the next packet.
+    void setLossPolicy(bool h265, RTPLossPolicy policy) { (h265 ? mLossPolicyH265 : mLossPolicyH264) = policy; }
+
+    /**
+     * Called with @param context each time the parser hits a gap (rate limited), to make the sender start a new GOP
+     * right away. @param function==nullptr disables it. @param context has to outlive the VideoPlayer or the next call.
+     */
+    void setKeyFrameRequester(KeyFrameRequester::RequestFunction function, void* context)
+    {
+        mKeyFrameRequester.setTarget(function, context);
+    }
+
+    // Per-frame latency trace of the video, see FrameTrace. Off by default.
+    void setLatencyTrace(bool enabled) { mFrameTrace.setEnabled(enabled); }
+
+    // The frames of the last @param seconds as Chrome trace JSON into the file at @param path
+    bool dumpLatencyTrace(const std::string& path, int seconds) const
+    {
+        return mFrameTrace.writeChromeJSON(path, std::chrono::seconds(seconds));
+    }
+
+    // All pipeline metrics, see Metrics::Snapshot::toText()
+    std::string getMetrics() const { return Metrics::global().snapshot().toText(); }
+
+    // Serve getMetrics() on 127.0.0.1:@param port, 0 stops it. False if the port could not be bound.
+    bool setMetricsEndpoint(int port);
+
     void startDvr(JNIEnv* env, jint fd, jint fmp4_enabled);
 
     void stopDvr();
@@ -55,9 +126,14 @@ class VideoPlayer
   private:
     void onNewNALU(const NALU& nalu);
 
+    // Applies a changed setJitterBufferDeadline() value, called on the receiver thread
+    void applyJitterBufferMode();
+
     // Assumptions: Max bitrate: 40 MBit/s, Max time to buffer: 500ms
     // 25 MB should be plenty !
     static constexpr const size_t WANTED_UDP_RCVBUF_SIZE = 1024 * 1024 * 25;
+    // NALUs waiting for the decoder keep referencing their packets: a few key frames worth of 4 KiB buffers
+    static constexpr const size_t N_PACKET_BUFFERS = 1024;
     // Retrieve settings from shared preferences
     enum SOURCE_TYPE_OPTIONS
     {
@@ -69,24 +145,57 @@ class VideoPlayer
     };
     const std::string   GROUND_RECORDING_DIRECTORY;
     JavaVM*             javaVm = nullptr;
-    H26XParser          mParser;
+    // Both parsers call onNewNALU() directly, no std::function on the way from the packet to the decoder
+    struct NALUToPlayer
+    {
+        VideoPlayer* player;
+
+        void operator()(const NALU& nalu) const { player->onNewNALU(nalu); }
+    };
+    StaticH26XParser<false, NALUToPlayer> mParserH264;
+    StaticH26XParser<true, NALUToPlayer>  mParserH265;
+    std::atomic<RTPLossPolicy>            mLossPolicyH264 = RTPLossPolicy::DROP;
+    std::atomic<RTPLossPolicy>            mLossPolicyH265 = RTPLossPolicy::DROP;
+    KeyFrameRequester                     mKeyFrameRequester;
+    // Outlives videoDecoder, which records into it
+    FrameTrace mFrameTrace;
+    // RTP timestamp of the last video packet received, the next one with another timestamp starts a frame
+    uint32_t mLastReceivedFrameId = 0;
     BufferedPacketQueue mBufferedPacketQueueVideo, mBufferedPacketQueueAudio;
+    std::atomic<int>    mWantedJitterDeadlineUs = 0;
+    int                 mJitterDeadlineUs       = 0;
+    RtpDuplicateFilter  mDuplicateFilterVideo, mDuplicateFilterAudio;
+    Metrics::Counter&   mMetricDuplicates = Metrics::global().counter("rtp_duplicates");
+    // Receive side latency, written by the ingest thread and reported in DecodingInfo
+    RtpJitterEstimator  mJitterEstimatorVideo;
+    std::atomic<long>   mRtpJitterUs         = 0;
+    std::atomic<long>   mKernelDelaySumUs    = 0;
+    std::atomic<long>   mNKernelDelaySamples = 0;
+    Metrics::Gauge&     mMetricJitter        = Metrics::global().gauge("rtp_jitter_us");
+    Metrics::Histogram& mMetricKernelDelay   = Metrics::global().histogram("net_kernel_delay_us");
+    // Only used by the DecodingInfo callback, to average over the interval since the last one
+    long mKernelDelaySumUsAtLastInfo    = 0;
+    long mNKernelDelaySamplesAtLastInfo = 0;
+    long mRecoverySumUsAtLastInfo       = 0;
+    long mNRecoveriesAtLastInfo         = 0;
+    // See setMetricsEndpoint()
+    std::unique_ptr<MetricsEndpoint> mMetricsEndpoint;
 
     // DVR attributes
-    int                     dvr_fd;
-    std::queue<NALU>        naluQueue;
-    std::mutex              mtx;
-    std::condition_variable cv;
-    bool                    stopFlag = false;
-    std::thread             processingThread;
-    int                     dvr_mp4_fragmentation = 0;
-    uint64_t                last_dvr_write        = 0;
-
-    void enqueueNALU(const NALU& nalu)
+    int                                     dvr_fd;
+    std::queue<std::shared_ptr<NALUBuffer>> naluQueue;
+    std::mutex                              mtx;
+    std::condition_variable                 cv;
+    bool                                    stopFlag = false;
+    std::thread                             processingThread;
+    int                                     dvr_mp4_fragmentation = 0;
+    uint64_t                                last_dvr_write        = 0;
+
+    void enqueueNALU(std::shared_ptr<NALUBuffer> nalu)
     {
         {
             std::lock_guard<std::mutex> lock(mtx);
-            naluQueue.push(nalu);
+            naluQueue.push(std::move(nalu));
         }
         cv.notify_one();
     }
@@ -113,11 +222,10 @@ class VideoPlayer
     void processQueue();
 
   public:
-    AudioDecoder                 audioDecoder;
-    VideoDecoder                 videoDecoder;
-    std::unique_ptr<UDPReceiver> mUDPReceiver;
-    std::unique_ptr<UDSReceiver> mUDSReceiver;
-    long                         nNALUsAtLastCall = 0;
+    AudioDecoder                   audioDecoder;
+    VideoDecoder                   videoDecoder;
+    std::unique_ptr<IngestReactor> mIngest;
+    long                           nNALUsAtLastCall = 0;
 
   public:
     DecodingInfo      latestDecodingInfo{};
@@ -3,7 +3,7 @@
 #define FPVUE_ANDROIDMEDIAFORMATHELPER_H
 
 #include <media/NdkMediaFormat.h>
-#include "../NALU/KeyFrameFinder.hpp"
+#include "../DecoderBackend.h"
 
 // Some of these params are only supported on the latest Android versions
 // However,writing them has no negative affect on devices with older Android versions
@@ -27,16 +27,23 @@ void writeAndroidPerformanceParams(AMediaFormat* format)
     // AMediaFormat_setInt32(format,AMEDIAFORMAT_KEY_OPERATING_RATE,0);
 }
 
-static void h264_configureAMediaFormat(KeyFrameFinder& kff, AMediaFormat* format)
+// Geometry and input buffer size from the SPS. Without them MediaCodec guesses, changes the output format after the
+// first frame and may have to reallocate its buffers. Without a parsed SPS only the size is set, as before.
+static void writeVideoFormat(const DecoderConfig& config, AMediaFormat* format)
 {
-    const auto sps     = kff.getCSD0();
-    const auto pps     = kff.getCSD1();
-    const auto videoWH = sps.getVideoWidthHeightSPS();
-    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_WIDTH, videoWH[0]);
-    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_HEIGHT, videoWH[1]);
-    AMediaFormat_setBuffer(format, "csd-0", sps.getData(), (size_t) sps.getSize());
-    AMediaFormat_setBuffer(format, "csd-1", pps.getData(), (size_t) pps.getSize());
-    MLOGD << "Video WH:" << videoWH[0] << " H:" << videoWH[1];
+    if (config.formatParsed)
+    {
+        AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_MAX_INPUT_SIZE, config.format.maxInputSize());
+    }
+    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_WIDTH, config.format.width);
+    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_HEIGHT, config.format.height);
+}
+
+static void h264_configureAMediaFormat(const DecoderConfig& config, AMediaFormat* format)
+{
+    writeVideoFormat(config, format);
+    AMediaFormat_setBuffer(format, "csd-0", config.csd0.data(), config.csd0.size());
+    AMediaFormat_setBuffer(format, "csd-1", config.csd1.data(), config.csd1.size());
     // AMediaFormat_setInt32(format,AMEDIAFORMAT_KEY_BIT_RATE,5*1024*1024);
     // AMediaFormat_setInt32(format,AMEDIAFORMAT_KEY_FRAME_RATE,60);
     // AVCProfileBaseline==1
@@ -45,21 +52,11 @@ static void h264_configureAMediaFormat(KeyFrameFinder& kff, AMediaFormat* format
     // writeAndroidPerformanceParams(format);
 }
 
-static void h265_configureAMediaFormat(KeyFrameFinder& kff, AMediaFormat* format)
+static void h265_configureAMediaFormat(const DecoderConfig& config, AMediaFormat* format)
 {
-    std::vector<uint8_t> buff = {};
-    const auto           sps  = kff.getCSD0();
-    const auto           pps  = kff.getCSD1();
-    const auto           vps  = kff.getVPS();
-    buff.reserve(sps.getSize() + pps.getSize() + vps.getSize());
-    KeyFrameFinder::appendNaluData(buff, vps);
-    KeyFrameFinder::appendNaluData(buff, sps);
-    KeyFrameFinder::appendNaluData(buff, pps);
-    const auto videoWH = sps.getVideoWidthHeightSPS();
-    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_WIDTH, videoWH[0]);
-    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_HEIGHT, videoWH[1]);
-    AMediaFormat_setBuffer(format, "csd-0", buff.data(), buff.size());
-    MLOGD << "Video WH:" << videoWH[0] << " H:" << videoWH[1];
+    // VPS, SPS and PPS all go into csd-0
+    writeVideoFormat(config, format);
+    AMediaFormat_setBuffer(format, "csd-0", config.csd0.data(), config.csd0.size());
     // writeAndroidPerformanceParams(format);
 }
 
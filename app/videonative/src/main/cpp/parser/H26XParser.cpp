@@ -15,7 +15,10 @@ H26XParser::H26XParser(NALU_DATA_CALLBACK onNewNALU)
           this,
           std::placeholders::_1,
           std::placeholders::_2,
-          std::placeholders::_3))
+          std::placeholders::_3),
+          false,
+          std::bind(
+              &H26XParser::onNewFragmentedNaluExtracted, this, std::placeholders::_1, std::placeholders::_2))
 {
 }
 
@@ -26,18 +29,34 @@ void H26XParser::reset()
     nParsedKonfigurationFrames = 0;
 }
 
-void H26XParser::parse_rtp_stream(const uint8_t* rtp_data, const size_t data_length)
+void H26XParser::parse_rtp_stream(
+    const uint8_t* rtp_data, const size_t data_length, std::chrono::steady_clock::time_point arrival)
 {
     const RTP::RTPPacket rtpPacket(rtp_data, data_length);
     if (rtpPacket.header.payload == RTP_PAYLOAD_TYPE_H264)
     {
         IS_H265 = false;
-        mDecodeRTP.parseRTPH264toNALU(rtp_data, data_length);
+        mDecodeRTP.parseRTPH264toNALU(rtp_data, data_length, arrival);
     }
     else if (rtpPacket.header.payload == RTP_PAYLOAD_TYPE_H265)
     {
         IS_H265 = true;
-        mDecodeRTP.parseRTPH265toNALU(rtp_data, data_length);
+        mDecodeRTP.parseRTPH265toNALU(rtp_data, data_length, arrival);
+    }
+}
+
+void H26XParser::parse_rtp_stream(const PacketRef& packet)
+{
+    const RTP::RTPPacket rtpPacket(packet.data(), packet.size());
+    if (rtpPacket.header.payload == RTP_PAYLOAD_TYPE_H264)
+    {
+        IS_H265 = false;
+        mDecodeRTP.parseRTPH264toNALU(packet);
+    }
+    else if (rtpPacket.header.payload == RTP_PAYLOAD_TYPE_H265)
+    {
+        IS_H265 = true;
+        mDecodeRTP.parseRTPH265toNALU(packet);
     }
 }
 
@@ -45,6 +64,19 @@ void H26XParser::onNewNaluDataExtracted(
     const std::chrono::steady_clock::time_point creation_time, const uint8_t* nalu_data, const int nalu_data_size)
 {
     NALU nalu(nalu_data, nalu_data_size, IS_H265, creation_time);
+    nalu.setEndOfAccessUnit(mDecodeRTP.isEndOfAccessUnit());
+    nalu.setCorrupted(mDecodeRTP.isCorrupted());
+    nalu.setFrameId(mDecodeRTP.rtpTimestamp());
+    newNaluExtracted(nalu);
+}
+
+void H26XParser::onNewFragmentedNaluExtracted(
+    const std::chrono::steady_clock::time_point creation_time, const FragmentedNALU& fragments)
+{
+    NALU nalu(fragments, IS_H265, creation_time);
+    nalu.setEndOfAccessUnit(mDecodeRTP.isEndOfAccessUnit());
+    nalu.setCorrupted(mDecodeRTP.isCorrupted());
+    nalu.setFrameId(mDecodeRTP.rtpTimestamp());
     newNaluExtracted(nalu);
 }
 
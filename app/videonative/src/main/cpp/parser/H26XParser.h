@@ -30,10 +30,19 @@ class H26XParser
   public:
     H26XParser(NALU_DATA_CALLBACK onNewNALU);
 
-    void parse_rtp_stream(const uint8_t* rtp_data, const size_t data_len);
+    // @param arrival receive timestamp of the packet, becomes the creationTime of the NALUs it starts
+    void parse_rtp_stream(
+        const uint8_t* rtp_data, const size_t data_len, std::chrono::steady_clock::time_point arrival = {});
+
+    // Same as above for a packet in a ref-counted buffer. The NALUs passed to onNewNALU reference the packets
+    // (NALU::isContiguous() is false) and are only valid during the callback.
+    void parse_rtp_stream(const PacketRef& packet);
 
     void reset();
 
+    // How NALUs with lost fragments are handled, per codec
+    void setLossPolicy(bool isH265, RTPLossPolicy policy) { mDecodeRTP.setLossPolicy(isH265, policy); }
+
   public:
     long nParsedNALUs               = 0;
     long nParsedKonfigurationFrames = 0;
@@ -47,6 +56,9 @@ class H26XParser
     void onNewNaluDataExtracted(
         const std::chrono::steady_clock::time_point creation_time, const uint8_t* nalu_data, const int nalu_data_size);
 
+    void onNewFragmentedNaluExtracted(
+        const std::chrono::steady_clock::time_point creation_time, const FragmentedNALU& fragments);
+
     const NALU_DATA_CALLBACK              onNewNALU;
     std::chrono::steady_clock::time_point lastFrameLimitFPS       = std::chrono::steady_clock::now();
     std::chrono::steady_clock::time_point lastTimeOnNewNALUCalled = std::chrono::steady_clock::now();
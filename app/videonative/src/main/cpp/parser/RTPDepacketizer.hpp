@@ -0,0 +1,794 @@
+//
+// RTPDepacketizer.hpp
+// The RTP h264 / h265 depacketizer with its output as a template parameter. RTPDecoder (ParseRTP.h) is the instance
+// with std::function callbacks, StaticH26XParser one whose sink is known at compile time, so the NALU hand-off
+// inlines.
+//
+
+#ifndef FPVUE_RTPDEPACKETIZER_HPP
+#define FPVUE_RTPDEPACKETIZER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include "../NALU/FragmentedNALU.hpp"
+#include "../Metrics.h"
+#include "../helper/AndroidLogger.hpp"
+#include "RTP.hpp"
+
+// Enough for pretty much any resolution/framerate we handle in OpenHD
+static constexpr const auto NALU_MAXLEN = 1024 * 1024;
+
+// What happens to a fragmented NALU when packets in the middle of it were lost. Without its first fragment (the
+// NALU header) a NALU is always dropped.
+enum class RTPLossPolicy
+{
+    // Discard the NALU
+    DROP,
+    // Replace each lost fragment by zeros, assuming it had the size of the first one. A NALU whose end was lost is
+    // forwarded as it is.
+    ZERO_FILL,
+    // Forward the NALU up to the first lost fragment
+    TRUNCATE
+};
+
+// With ZERO_FILL and TRUNCATE a gap can swallow the end of one fragmented NALU and the start of the next, whose
+// remaining fragments must not be appended. A fragment after a gap ends the NALU (as if its end was lost) if it is of
+// another frame (RTP timestamp) or more packets than this went missing.
+static constexpr int RTP_FU_MAX_GAP = 32;
+
+/*********************************************
+ ** Parses a stream of rtp h264 / h265 data into NALUs.
+ ** No rtp jitterbuffer or similar - this decreases latency, but removes any rtp packet re-ordering capabilities.
+ ** Aka this decoder can deal with lost packets (incomplete rtp fragments are dropped) but requires received packets to
+ ** be in order.
+ ** No special dependencies other than std library.
+ ** R.n Supports single, aggregated and fragmented rtp packets for both h264 and h265.
+ ** Data is forwarded directly to the sink for no thread scheduling overhead
+ ** Packets handed over as PacketRef are not copied: the NALU is forwarded as a FragmentedNALU that references them.
+ **
+ ** Sink has
+ **   void onNALU(std::chrono::steady_clock::time_point creation_time, const uint8_t* nalu_data, int nalu_data_size)
+ **   void onFragmentedNALU(std::chrono::steady_clock::time_point creation_time, const FragmentedNALU& nalu)
+ **   bool acceptsFragments() const: false to get NALUs from PacketRef packets copied into one buffer as well
+ ** Each call passes exactly one NALU prefixed with the 0,0,0,1 start code. The FragmentedNALU and the packets it
+ ** references are only valid during the call.
+ **********************************************/
+template <typename Sink>
+class RTPDepacketizer
+{
+  public:
+    explicit RTPDepacketizer(Sink sink, bool feed_incomplete_frames = false);
+
+    // check if a packet is missing by using the rtp sequence number and
+    // if the payload is dynamic (h264 or h265)
+    // Returns false if payload is wrong
+    // sets the 'missing packet' flag to true if packet got lost
+    bool validateRTPPacket(const rtp_header_t& rtpHeader);
+
+    // parse rtp h264 packet to NALU
+    // @param arrival when the packet was received (kernel timestamp), now if default
+    void parseRTPH264toNALU(
+        const uint8_t* rtp_data, const size_t data_length, std::chrono::steady_clock::time_point arrival = {});
+
+    // parse rtp h265 packet to NALU
+    void parseRTPH265toNALU(
+        const uint8_t* rtp_data, const size_t data_length, std::chrono::steady_clock::time_point arrival = {});
+
+    // Same as above for a packet in a ref-counted buffer, the payload is referenced instead of copied
+    void parseRTPH264toNALU(const PacketRef& packet);
+
+    void parseRTPH265toNALU(const PacketRef& packet);
+
+    // exp
+    void parse_rtp_mjpeg(const uint8_t* rtp_data, const size_t data_length);
+
+    // reset to defaults
+    void reset();
+
+    // Only valid in the callback: the NALU ended in a packet with the RTP marker bit, it is the last NALU of its
+    // access unit (frame)
+    bool isEndOfAccessUnit() const { return m_packet_marker && m_last_nalu_of_packet; }
+
+    // Only valid in the callback: RTP timestamp of the packet, the same for all NALUs of an access unit
+    uint32_t rtpTimestamp() const { return m_packet_timestamp; }
+
+    // Only valid in the callback: fragments of the NALU were lost and it was forwarded anyway, see RTPLossPolicy
+    bool isCorrupted() const { return m_corrupted; }
+
+    // How NALUs with lost fragments are handled, per codec. Both default to RTPLossPolicy::DROP.
+    void setLossPolicy(bool isH265, RTPLossPolicy policy)
+    {
+        (isH265 ? m_loss_policy_h265 : m_loss_policy_h264) = policy;
+    }
+
+    RTPLossPolicy getLossPolicy(bool isH265) const { return isH265 ? m_loss_policy_h265 : m_loss_policy_h264; }
+
+    Sink& sink() { return m_sink; }
+
+  private:
+    // Write 0,0,0,1 (or 0,0,1) into the start of the NALU buffer and set the length to 4 / 3
+    void write_h264_h265_nalu_start(bool use_4_bytes = true);
+
+    // copy data_len bytes into the data buffer at the current position
+    // and increase its size by data_len
+    void append_nalu_data(const uint8_t* data, size_t data_len);
+
+    // like append_nalu_data, but for one byte
+    void append_nalu_data_byte(uint8_t byte);
+
+    // append data_len zeros, false if they do not fit
+    bool append_empty(size_t data_len);
+
+    // Arrival time of the packet currently parsed, or now if the caller did not provide one
+    std::chrono::steady_clock::time_point packetArrival() const;
+
+    // Properly calls the sink
+    // Resets the m_nalu_data_length to 0
+    void forwardNALU(const bool isH265 = false);
+
+    // Resets the m_nalu_data_length to 0 and releases the packets the current NALU references
+    void clear_nalu_data();
+
+    // Middle or end fragment of the fragmented NALU in progress, applies the loss policy if packets went missing
+    void append_fu_fragment(const uint8_t* data, size_t data_len, bool end, bool isH265);
+
+    // A packet that starts a new NALU arrived while a fragmented one was in progress, so its end was lost
+    void finish_incomplete_fu(bool isH265);
+
+    Sink m_sink;
+    // std::shared_ptr<std::array<uint8_t,NALU_MAXLEN>> m_curr_nalu{};
+    std::array<uint8_t, NALU_MAXLEN> m_curr_nalu;
+    size_t                           m_nalu_data_length = 0;
+    // The current NALU is assembled in m_fragments instead of m_curr_nalu
+    bool                             m_scatter = false;
+    FragmentedNALU                   m_fragments;
+    const PacketRef*                 m_packet = nullptr;
+    bool                             m_feed_incomplete_frames;
+    int                              m_total_n_fragments_for_current_fu = 0;
+    // The fragmented NALU in progress: its start was received, the size of its first fragment, its RTP timestamp
+    bool                             m_fu_active        = false;
+    size_t                           m_fu_fragment_size = 0;
+    uint32_t                         m_fu_timestamp     = 0;
+    // TRUNCATE: fragments after the first gap are not appended
+    bool                             m_fu_truncated = false;
+    bool                             m_corrupted    = false;
+    RTPLossPolicy                    m_loss_policy_h264 = RTPLossPolicy::DROP;
+    RTPLossPolicy                    m_loss_policy_h265 = RTPLossPolicy::DROP;
+
+  private:
+    int lastSequenceNumber = -1;
+    // n of packets lost right before the current one
+    int m_n_missing = 0;
+
+  public:
+    // each time there is a "gap" between packets, this counter is increased
+    int m_n_gaps         = 0;
+    int m_n_lost_packets = 0;
+    Metrics::Counter& m_metric_gaps         = Metrics::global().counter("rtp_gaps");
+    Metrics::Counter& m_metric_lost_packets = Metrics::global().counter("rtp_lost_packets");
+    // This time point is as 'early as possible' to debug the parsing time as accurately as possible.
+    // E.g for a fu-a NALU the time point when the start fu-a was received, not when its end is received.
+    // With kernel receive timestamps this is when the first fragment reached the host, not when we read it.
+    std::chrono::steady_clock::time_point timePointStartOfReceivingNALU;
+
+  private:
+    std::chrono::steady_clock::time_point m_packet_arrival;
+    bool                                  m_packet_marker    = false;
+    uint32_t                              m_packet_timestamp = 0;
+    // false while forwarding all but the last NALU of an aggregation packet
+    bool m_last_nalu_of_packet = true;
+
+  private:
+    // reconstruct and forward a single nalu, either from a "single" or "aggregated" rtp packet (not from a fragmented
+    // packet) data should point to the nalu_header_t, size includes the nalu_header_t size and the following bytes that
+    // make up the nalu
+    void h264_reconstruct_and_forward_one_nalu(const uint8_t* data, int data_size);
+
+    // forward a single nalu, either froma a "single" or "aggregated" rtp packet (not from a fragmented packet)
+    // ( In contrast to h264 we don't need the stupid reconstruction with h265)
+    // data should point to "just" the rtp payload
+    void h265_forward_one_nalu(const uint8_t* data, int data_size, bool write_4_bytes_for_start_code = true);
+
+    // wtf
+    static bool check_has_valid_prefix(const uint8_t* nalu_data, int nalu_data_len, bool use_4_bytes_start_code);
+
+    bool check_curr_nalu_has_valid_prefix(bool use_4_bytes_start_code);
+
+    // we can clear the missing packet flag when we either receive the first packet of a fragmented rtp packet or
+    // a non-fragmented rtp packet
+    // void clear_missing_packet_flag();
+    int curr_packet_diff = 0;
+
+  private:
+    std::chrono::steady_clock::time_point m_last_log_wrong_rtp_payload_time = std::chrono::steady_clock::now();
+};
+
+
+inline int rtp_diff_between_packets(int last_packet, int curr_packet)
+{
+    if (last_packet == curr_packet)
+    {
+        MLOGD << "Duplicate?!";
+    }
+    if (curr_packet < last_packet)
+    {
+        // This is not neccessarily an error, the rtp seq nr is of type uint16_t and therefore loops around in regular
+        // intervals
+        // MLOGD<<"Assuming overflow";
+        // We probably have overflown the uin16_t range of rtp
+        const auto diff = curr_packet + UINT16_MAX + 1 - last_packet;
+        // MLOGD<<"last:"<<last_packet<<" curr:"<<curr_packet<<" diff:"<<diff;
+        return diff;
+    }
+    else
+    {
+        return curr_packet - last_packet;
+    }
+}
+
+template <typename Sink>
+RTPDepacketizer<Sink>::RTPDepacketizer(Sink sink, bool feed_incomplete_frames)
+    : m_sink(std::move(sink)), m_feed_incomplete_frames(feed_incomplete_frames)
+{
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::reset()
+{
+    clear_nalu_data();
+    lastSequenceNumber = -1;
+    m_n_missing        = 0;
+    m_n_gaps           = 0;
+    // nalu_data.reserve(NALU::NALU_MAXLEN);
+}
+
+template <typename Sink>
+bool RTPDepacketizer<Sink>::validateRTPPacket(const rtp_header_t& rtp_header)
+{
+    // Testing regarding sequence numbers.This stuff can be removed without issues
+    const int seqNr = rtp_header.getSequence();
+    // MLOGD<<"Sequence:"<<seqNr<<" gaps:"<<m_n_gaps;
+    if (seqNr == lastSequenceNumber)
+    {
+        // duplicate. This should never happen for 'normal' rtp streams, but can be usefully when testing bitrates
+        // (Since you can send the same packet multiple times to emulate a higher bitrate)
+        MLOGD << "Same seqNr";
+        return false;
+    }
+    m_n_missing = 0;
+    if (lastSequenceNumber != -1)
+    {
+        curr_packet_diff = rtp_diff_between_packets(lastSequenceNumber, seqNr);
+        if (curr_packet_diff != 1)
+        {
+            // MLOGD<<"X diff:"<<diff_between_packets(lastSequenceNumber,seqNr);
+        }
+        // Don't forget that the sequence number loops every UINT16_MAX packets
+        // if(seqNr != ((lastSequenceNumber+1) % UINT16_MAX)){
+        if (seqNr != ((lastSequenceNumber + 1) % (UINT16_MAX + 1)))
+        {
+            // We are missing a Packet !
+            // MLOGD<<"missing a packet. Last:"<<lastSequenceNumber<<" Curr:"<<seqNr<<"
+            // Diff:"<<(seqNr-(int)lastSequenceNumber)<<" total:"<<m_n_gaps;
+            m_n_missing = curr_packet_diff - 1;
+            m_n_gaps++;
+            const auto gap_size = seqNr - (int) lastSequenceNumber;
+            m_n_lost_packets += gap_size;
+            m_metric_gaps.add();
+            m_metric_lost_packets.add(m_n_missing);
+            // Feed it anyways (buggy / hacky)
+            if (m_feed_incomplete_frames)
+            {
+                MLOGD << "Ignoring missing packet flag";
+                m_n_missing = 0;
+            }
+        }
+    }
+    lastSequenceNumber = seqNr;
+    return true;
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::h264_reconstruct_and_forward_one_nalu(const uint8_t* data, const int data_size)
+{
+    assert(data_size > sizeof(nalu_header_t));
+    const nalu_header_t& nalu_header = *(const nalu_header_t*) &data[0];
+    timePointStartOfReceivingNALU    = packetArrival();
+    write_h264_h265_nalu_start();
+    const uint8_t h264_nal_header = (uint8_t) (nalu_header.type & 0x1f) | (nalu_header.nri << 5) | (nalu_header.f << 7);
+    // write the reconstructed NAL header (the h264 "type")
+    append_nalu_data_byte(h264_nal_header);
+    // write the rest of the data
+    append_nalu_data(&data[1], (size_t) data_size - 1);
+    // forward via callback
+    forwardNALU();
+    // reset length after forwarding
+    clear_nalu_data();
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::parseRTPH264toNALU(const PacketRef& packet)
+{
+    m_packet = &packet;
+    parseRTPH264toNALU(packet.data(), packet.size(), packet.timestamp());
+    m_packet = nullptr;
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::parseRTPH265toNALU(const PacketRef& packet)
+{
+    m_packet = &packet;
+    parseRTPH265toNALU(packet.data(), packet.size(), packet.timestamp());
+    m_packet = nullptr;
+}
+
+template <typename Sink>
+std::chrono::steady_clock::time_point RTPDepacketizer<Sink>::packetArrival() const
+{
+    return m_packet_arrival != std::chrono::steady_clock::time_point{} ? m_packet_arrival
+                                                                        : std::chrono::steady_clock::now();
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::parseRTPH264toNALU(
+    const uint8_t* rtp_data, const size_t data_length, std::chrono::steady_clock::time_point arrival)
+{
+    m_packet_arrival = arrival;
+    // 12 rtp header bytes and 1 nalu_header_t type byte
+    if (data_length <= sizeof(rtp_header_t) + sizeof(nalu_header_t))
+    {
+        MLOGD << "Not enough rtp data";
+        return;
+    }
+    // MLOGD<<"Got h264 rtp data";
+    const RTP::RTPPacketH264 rtpPacket(rtp_data, data_length);
+
+    if (rtpPacket.rtpPayloadSize == 0)
+    {
+        MLOGD << "RTP packet is empty";
+        return;
+    }
+
+    // MLOGD<<"RTP Header: "<<rtp_header->asString();
+    if (!validateRTPPacket(rtpPacket.header))
+    {
+        return;
+    }
+    m_packet_marker         = rtpPacket.header.marker;
+    m_packet_timestamp      = rtpPacket.header.getTimestamp();
+    const auto& nalu_header = rtpPacket.getNALUHeaderH264();
+    if (nalu_header.type != 28 || rtpPacket.getFuHeader().s == 1)
+    {
+        finish_incomplete_fu(false);
+    }
+    if (nalu_header.type == 28)
+    { /* FU-A */
+        // MLOGD<<"Got RTP H264 type 28 (fragmented) payload size:"<<rtpPacket.rtpPayloadSize;
+        const auto& fu_header       = rtpPacket.getFuHeader();
+        const auto  fu_payload      = rtpPacket.getFuPayload();
+        const auto  fu_payload_size = rtpPacket.getFuPayloadSize();
+        if (fu_header.e == 1)
+        {
+            // MLOGD<<"End of fu-a";
+            //  end of fu-a
+            // To better measure latency we can actually use the timestamp from when the first bytes for this packet
+            // were received
+            append_fu_fragment(fu_payload, fu_payload_size, true, false);
+            m_total_n_fragments_for_current_fu++;
+            // MLOGD<<"N fragments for this fu:"<<m_total_n_fragments_for_current_fu;
+            m_total_n_fragments_for_current_fu = 0;
+        }
+        else if (fu_header.s == 1)
+        {
+            // MLOGD<<"Start of fu-a";
+            timePointStartOfReceivingNALU      = packetArrival();
+            m_total_n_fragments_for_current_fu = 0;
+            // start of fu-a
+            write_h264_h265_nalu_start();
+            const uint8_t h264_nal_header =
+                (uint8_t) (fu_header.type & 0x1f) | (nalu_header.nri << 5) | (nalu_header.f << 7);
+            append_nalu_data_byte(h264_nal_header);
+            append_nalu_data(fu_payload, fu_payload_size);
+            m_fu_active        = true;
+            m_fu_fragment_size = fu_payload_size;
+            m_fu_timestamp     = m_packet_timestamp;
+        }
+        else
+        {
+            // MLOGD<<"Middle of fu-a";
+            //  middle of fu-a
+            append_fu_fragment(fu_payload, fu_payload_size, false, false);
+            m_total_n_fragments_for_current_fu++;
+        }
+    }
+    else if (nalu_header.type > 0 && nalu_header.type < 24)
+    {
+        // MLOGD<<"Got RTP H264 type [1..23] (single) payload size:"<<rtpPacket.rtpPayloadSize;
+        h264_reconstruct_and_forward_one_nalu(rtpPacket.rtpPayload, rtpPacket.rtpPayloadSize);
+    }
+    else if (nalu_header.type == 24)
+    {
+        // MLOGD<<"Got RTP H264 type 24 (aggregated NALUs) payload size:"<<rtpPacket.rtpPayloadSize;
+        const uint8_t* rtp_payload      = rtpPacket.rtpPayload;
+        const auto     rtp_payload_size = rtpPacket.rtpPayloadSize;
+        int            offset           = 0;
+        while (true)
+        {
+            // the size of the (n-th) nalu starts at offset+1 (1 byte STAP-A NAL HDR )
+            const uint16_t* nalu_size_network = (const uint16_t*) &rtp_payload[offset + 1];
+            // replaced htons to htohs -- seemingly there was a bug in the original code, but I can't test it to make
+            // sure.
+            const uint16_t nalu_size = ntohs(*nalu_size_network);
+            // While the NALU HDR of the (n-th) nalu starts at offset+3 (1 byte STAP-A NAL HDR, 2 bytes nalu size)
+            const uint8_t* actual_nalu_data_p = &rtp_payload[offset + 1 + 2];
+            const auto     actual_nalu_size   = nalu_size;
+            // MLOGD<<"XNALU of size:"<<(int)actual_nalu_size;
+            m_last_nalu_of_packet = !(rtp_payload_size > offset + 2 + actual_nalu_size + 3);
+            h264_reconstruct_and_forward_one_nalu(actual_nalu_data_p, actual_nalu_size);
+            offset += 2 + actual_nalu_size;
+            if (!(rtp_payload_size > offset + 3))
+            {
+                break;
+            }
+        }
+        m_last_nalu_of_packet = true;
+    }
+    else
+    {
+        MLOGD << "Got unsupported H264 RTP packet. NALU type:" << (int) nalu_header.type;
+    }
+}
+
+// https://github.com/ireader/media-server/blob/master/librtp/payload/rtp-h265-unpack.c
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::h265_forward_one_nalu(const uint8_t* data, int data_size, bool write_4_bytes_for_start_code)
+{
+    timePointStartOfReceivingNALU = packetArrival();
+    write_h264_h265_nalu_start(write_4_bytes_for_start_code);
+    // I do not know what about the 'DONL' field but it seems to be never present
+    // copy the NALU header and NALU data, other than h264 here nothing has to be 'reconstructed'
+    append_nalu_data(data, data_size);
+    forwardNALU(true);
+    clear_nalu_data();
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::parseRTPH265toNALU(
+    const uint8_t* rtp_data, const size_t data_length, std::chrono::steady_clock::time_point arrival)
+{
+    m_packet_arrival = arrival;
+    // 12 rtp header bytes and 1 nalu_header_t type byte
+    if (data_length <= sizeof(rtp_header_t) + sizeof(nal_unit_header_h265_t))
+    {
+        MLOGD << "Not enough rtp data";
+        return;
+    }
+    // MLOGD<<"Got h265 rtp data";
+    const RTP::RTPPacketH265 rtpPacket(rtp_data, data_length);
+    // MLOGD<<"RTP Header: "<<rtp_header->asString();
+    if (!validateRTPPacket(rtpPacket.header))
+    {
+        MLOGD << "Invalid rtp packet";
+        return;
+    }
+    m_packet_marker                  = rtpPacket.header.marker;
+    m_packet_timestamp               = rtpPacket.header.getTimestamp();
+    const auto& nal_unit_header_h265 = rtpPacket.getNALUHeaderH265();
+    if (nal_unit_header_h265.type > 50)
+    {
+        MLOGD << "Unsupported (HEVC) NAL type " << (int) nal_unit_header_h265.type;
+        return;
+    }
+    if (nal_unit_header_h265.type != 49 || rtpPacket.getFuHeader().s)
+    {
+        finish_incomplete_fu(true);
+    }
+    if (nal_unit_header_h265.type == 48)
+    {
+        // MLOGD<<"Got RTP H265 type 48 (aggregated) payload size:"<<rtpPacket.rtpPayloadSize;
+        const uint8_t* rtp_payload      = rtpPacket.rtpPayload;
+        const auto     rtp_payload_size = rtpPacket.rtpPayloadSize;
+        int            offset           = 0;
+        while (true)
+        {
+            // the size of the (n-th) nalu starts at offset+1 (1 byte STAP-A NAL HDR )
+            // WTF DOND ?!
+            const int       don_offset        = 1;
+            const uint16_t* nalu_size_network = (const uint16_t*) &rtp_payload[offset + don_offset + 1];
+            // replaced htons to htohs -- seemingly there was a bug in the original code, but I can't test it to make
+            // sure.
+            const uint16_t nalu_size = ntohs(*nalu_size_network);
+            // While the NALU HDR of the (n-th) nalu starts at offset+3 (1 byte STAP-A NAL HDR, 2 bytes nalu size)
+            const uint8_t* actual_nalu_data_p = &rtp_payload[offset + don_offset + 1 + 2];
+            const auto     actual_nalu_size   = nalu_size;
+            // MLOGD<<"XNALU of size:"<<(int)actual_nalu_size;
+            m_last_nalu_of_packet = !(rtp_payload_size > offset + 2 + actual_nalu_size + 3);
+            h265_forward_one_nalu(actual_nalu_data_p, actual_nalu_size);
+            offset += 2 + actual_nalu_size;
+            if (!(rtp_payload_size > offset + 3))
+            {
+                break;
+            }
+        }
+        m_last_nalu_of_packet = true;
+        return;
+    }
+    else if (nal_unit_header_h265.type == 49)
+    {
+        // FU-X packet
+        // MLOGD<<"Got RTP H265 type 49 (fragmented) payload size:"<<rtpPacket.rtpPayloadSize;
+        const auto& fu_header       = rtpPacket.getFuHeader();
+        const auto  fu_payload      = rtpPacket.getFuPayload();
+        const auto  fu_payload_size = rtpPacket.getFuPayloadSize();
+        if (fu_header.e)
+        {
+            // MLOGD<<"end of fu packetization";
+            append_fu_fragment(fu_payload, fu_payload_size, true, true);
+        }
+        else if (fu_header.s)
+        {
+            // MLOGD<<"start of fu packetization";
+            // MLOGD<<"Bytes "<<StringHelper::vectorAsString(std::vector<uint8_t>(rtp_data,rtp_data+data_length));
+            timePointStartOfReceivingNALU = packetArrival();
+            write_h264_h265_nalu_start();
+            // copy header and reconstruct ?!!!
+            const uint8_t* ptr            = &rtp_data[sizeof(rtp_header_t)];
+            uint8_t        variableNoIdea = rtp_data[sizeof(rtp_header_t) + sizeof(nal_unit_header_h265_t)];
+            // replace NAL Unit Type Bits - I have no idea how that works, but this manipulation works :)
+            const uint8_t tmp_unknown = ((variableNoIdea & 0x3F) << 1) | (ptr[0] & 0x81);
+            append_nalu_data_byte(tmp_unknown);
+            append_nalu_data_byte(ptr[1]);
+            // copy the rest of the data
+            append_nalu_data(fu_payload, fu_payload_size);
+            m_fu_active        = true;
+            m_fu_fragment_size = fu_payload_size;
+            m_fu_timestamp     = m_packet_timestamp;
+        }
+        else
+        {
+            // MLOGD<<"middle of fu packetization";
+            append_fu_fragment(fu_payload, fu_payload_size, false, true);
+        }
+    }
+    else
+    {
+        // single NAL unit
+        // MLOGD<<"Got RTP H265 type any (single) payload size:"<<rtpPacket.rtpPayloadSize;
+        // h265_forward_one_nalu(rtpPacket.rtpPayload,rtpPacket.rtpPayloadSize,false);
+        h265_forward_one_nalu(rtpPacket.rtpPayload, rtpPacket.rtpPayloadSize, true);
+    }
+}
+
+// MJPEG
+template <typename Sink>
+void RTPDepacketizer<Sink>::parse_rtp_mjpeg(const uint8_t* rtp_data, const size_t data_length)
+{
+    // 12 rtp header bytes and 8 main header bytes
+    if (data_length <= sizeof(rtp_header_t) + 8)
+    {
+        MLOGD << "Not enough rtp mjpeg data";
+        return;
+    }
+    // MLOGD<<"Got rtp mjpeg data";
+    const RTP::RTPPacket      rtpPacket(rtp_data, data_length);
+    const jpeg_main_header_t& jpeg_main_header = *(jpeg_main_header_t*) rtpPacket.rtpPayload;
+    // MLOGD<<"X:"<<jpeg_main_header.type;
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::forwardNALU(const bool isH265)
+{
+    // if either the rtp encoder is buggy or the premise of increasing sequence numbers is not given, this
+    // callback might be called with grabage data. Try and catch that as early as possible.
+    if (!check_curr_nalu_has_valid_prefix(true))
+    {
+        return;
+    }
+    if (m_scatter)
+    {
+        m_sink.onFragmentedNALU(timePointStartOfReceivingNALU, m_fragments);
+    }
+    else
+    {
+        m_sink.onNALU(timePointStartOfReceivingNALU, &m_curr_nalu[0], (int) m_nalu_data_length);
+    }
+    clear_nalu_data();
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::clear_nalu_data()
+{
+    m_nalu_data_length = 0;
+    m_fragments.clear();
+    m_fu_active    = false;
+    m_fu_truncated = false;
+    m_corrupted    = false;
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::append_fu_fragment(const uint8_t* data, size_t data_len, bool end, bool isH265)
+{
+    if (!m_fu_active)
+    {
+        // the start of this NALU was lost, without its header there is nothing to forward
+        clear_nalu_data();
+        return;
+    }
+    if (m_n_missing > 0)
+    {
+        if (m_packet_timestamp != m_fu_timestamp || m_n_missing > RTP_FU_MAX_GAP)
+        {
+            // the start of the NALU this fragment belongs to was lost as well as the end of the one in progress
+            finish_incomplete_fu(isH265);
+            return;
+        }
+        m_corrupted = true;
+        switch (getLossPolicy(isH265))
+        {
+            case RTPLossPolicy::DROP:
+                clear_nalu_data();
+                return;
+            case RTPLossPolicy::ZERO_FILL:
+                if (!m_fu_truncated && !append_empty((size_t) m_n_missing * m_fu_fragment_size))
+                {
+                    clear_nalu_data();
+                    return;
+                }
+                break;
+            case RTPLossPolicy::TRUNCATE:
+                m_fu_truncated = true;
+                break;
+        }
+    }
+    if (!m_fu_truncated)
+    {
+        append_nalu_data(data, data_len);
+    }
+    if (end)
+    {
+        forwardNALU(isH265);
+        clear_nalu_data();
+    }
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::finish_incomplete_fu(bool isH265)
+{
+    if (!m_fu_active)
+    {
+        return;
+    }
+    if (getLossPolicy(isH265) != RTPLossPolicy::DROP)
+    {
+        // The NALU belongs to the access unit before the one of the current packet
+        m_corrupted                    = true;
+        const bool last_nalu_of_packet = m_last_nalu_of_packet;
+        m_last_nalu_of_packet          = false;
+        forwardNALU(isH265);
+        m_last_nalu_of_packet = last_nalu_of_packet;
+    }
+    clear_nalu_data();
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::append_nalu_data(const uint8_t* data, size_t data_len)
+{
+    if (m_nalu_data_length + data_len > m_curr_nalu.size())
+    {
+        MLOGD << "Weird - not enough space to write NALU. curr_size:" << m_nalu_data_length << " append:" << data_len;
+        return;
+    }
+    if (m_scatter)
+    {
+        // Payload of the packet being parsed is referenced, everything else (start code, headers) copied
+        if (m_packet != nullptr && data >= m_packet->data() && data + data_len <= m_packet->data() + m_packet->size())
+        {
+            m_fragments.appendRef(*m_packet, data, data_len);
+        }
+        else
+        {
+            m_fragments.appendCopy(data, data_len);
+        }
+        m_nalu_data_length += data_len;
+        return;
+    }
+    uint8_t* p = &m_curr_nalu.at(m_nalu_data_length);
+    memcpy(p, data, data_len);
+    m_nalu_data_length += data_len;
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::append_nalu_data_byte(uint8_t byte)
+{
+    append_nalu_data(&byte, 1);
+}
+
+template <typename Sink>
+bool RTPDepacketizer<Sink>::append_empty(size_t data_len)
+{
+    if (m_nalu_data_length + data_len > m_curr_nalu.size())
+    {
+        MLOGD << "Weird - not enugh space to write NALU. curr_size:" << m_nalu_data_length << " append:" << data_len;
+        return false;
+    }
+    if (m_scatter)
+    {
+        static constexpr uint8_t ZEROS[256] = {};
+        for (size_t done = 0; done < data_len; done += sizeof(ZEROS))
+        {
+            m_fragments.appendCopy(ZEROS, std::min(sizeof(ZEROS), data_len - done));
+        }
+        m_nalu_data_length += data_len;
+        return true;
+    }
+    uint8_t* p = &m_curr_nalu.at(m_nalu_data_length);
+    std::memset(p, 0, data_len);
+    m_nalu_data_length += data_len;
+    return true;
+}
+
+template <typename Sink>
+void RTPDepacketizer<Sink>::write_h264_h265_nalu_start(const bool use_4_bytes)
+{
+    // m_curr_nalu=std::make_shared<std::array<uint8_t,NALU_MAXLEN>>();
+    clear_nalu_data();
+    // Reference the packets instead of copying if we were handed an owned packet and somebody takes the result
+    m_scatter = m_packet != nullptr && m_sink.acceptsFragments();
+    if (use_4_bytes)
+    {
+        append_nalu_data_byte(0);
+        append_nalu_data_byte(0);
+        append_nalu_data_byte(0);
+        append_nalu_data_byte(1);
+        assert(m_nalu_data_length == 4);
+    }
+    else
+    {
+        append_nalu_data_byte(0);
+        append_nalu_data_byte(0);
+        append_nalu_data_byte(1);
+        assert(m_nalu_data_length == 3);
+    }
+}
+
+template <typename Sink>
+bool RTPDepacketizer<Sink>::check_has_valid_prefix(const uint8_t* nalu_data, int nalu_data_len, bool use_4_bytes_start_code)
+{
+    if (nalu_data_len < 5)
+    {
+        MLOGD << "Not a valid nalu - less than 5 bytes";
+        return false;
+    }
+    if (use_4_bytes_start_code)
+    {
+        const bool valid = nalu_data[0] == 0 && nalu_data[1] == 0 && nalu_data[2] == 0 && nalu_data[3] == 1;
+        if (!valid)
+        {
+            MLOGD << "Not a valid nalu - missing start code (4 bytes)";
+        }
+        return valid;
+    }
+    else
+    {
+        const bool valid = nalu_data[0] == 0 && nalu_data[1] == 0 && nalu_data[2] == 1;
+        if (!valid)
+        {
+            MLOGD << "Not a valid nalu - missing start code (3 bytes)";
+        }
+        return valid;
+    }
+}
+
+template <typename Sink>
+bool RTPDepacketizer<Sink>::check_curr_nalu_has_valid_prefix(bool use_4_bytes_start_code)
+{
+    const uint8_t* p = m_scatter ? m_fragments.head() : &m_curr_nalu.at(0);
+    return check_has_valid_prefix(p, m_nalu_data_length, use_4_bytes_start_code);
+}
+
+#endif  // FPVUE_RTPDEPACKETIZER_HPP
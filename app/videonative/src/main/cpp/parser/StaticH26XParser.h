@@ -0,0 +1,116 @@
+//
+// StaticH26XParser.h
+// H26XParser with the codec and the NALU sink as template parameters. The depacketizer calls back into the parser and
+// the parser into the sink directly, so the packet -> NALU path compiles into one inlined call chain instead of
+// going through a std::function per hop. H26XParser stays for callers that pick the sink at runtime.
+//
+
+#ifndef FPVUE_STATICH26XPARSER_H
+#define FPVUE_STATICH26XPARSER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "../NALU/NALU.hpp"
+#include "RTPDepacketizer.hpp"
+
+/**
+ * Input: rtp packets of one codec, the caller routes by payload type (see payloadType()).
+ * Output: NAL units, NaluSink is called as sink(const NALU&) for each. Like with H26XParser, NALUs of packets passed
+ * as PacketRef reference the packets and are only valid during the call.
+ */
+template <bool IS_H265, typename NaluSink>
+class StaticH26XParser
+{
+  public:
+    static constexpr uint8_t PAYLOAD_TYPE = IS_H265 ? RTP_PAYLOAD_TYPE_H265 : RTP_PAYLOAD_TYPE_H264;
+
+    explicit StaticH26XParser(NaluSink sink) : mDepacketizer(Forward{this}), mSink(std::move(sink)) {}
+
+    // The depacketizer calls back into this instance, a copy would forward to the original
+    StaticH26XParser(const StaticH26XParser&)            = delete;
+    StaticH26XParser& operator=(const StaticH26XParser&) = delete;
+    StaticH26XParser(StaticH26XParser&&)                 = delete;
+    StaticH26XParser& operator=(StaticH26XParser&&)      = delete;
+
+    // Payload type of an rtp packet, without parsing the rest of the header
+    static uint8_t payloadType(const uint8_t* rtp_data, size_t data_len)
+    {
+        return data_len < sizeof(rtp_header_t) ? 0 : (uint8_t) (rtp_data[1] & 0x7F);
+    }
+
+    // @param arrival receive timestamp of the packet, becomes the creationTime of the NALUs it starts
+    void parse(const uint8_t* rtp_data, size_t data_len, std::chrono::steady_clock::time_point arrival = {})
+    {
+        if constexpr (IS_H265)
+        {
+            mDepacketizer.parseRTPH265toNALU(rtp_data, data_len, arrival);
+        }
+        else
+        {
+            mDepacketizer.parseRTPH264toNALU(rtp_data, data_len, arrival);
+        }
+    }
+
+    void parse(const PacketRef& packet)
+    {
+        if constexpr (IS_H265)
+        {
+            mDepacketizer.parseRTPH265toNALU(packet);
+        }
+        else
+        {
+            mDepacketizer.parseRTPH264toNALU(packet);
+        }
+    }
+
+    // How NALUs with lost fragments are handled
+    void setLossPolicy(RTPLossPolicy policy) { mDepacketizer.setLossPolicy(IS_H265, policy); }
+
+    // Sequence gaps seen so far, a packet that changes it came after lost packets
+    int nGaps() const { return mDepacketizer.m_n_gaps; }
+
+    void reset()
+    {
+        mDepacketizer.reset();
+        nParsedNALUs = 0;
+    }
+
+  public:
+    long nParsedNALUs = 0;
+
+  private:
+    // The RTPDepacketizer sink, turns the NALU data into a NALU for the parser's sink
+    struct Forward
+    {
+        StaticH26XParser* parser;
+
+        void onNALU(std::chrono::steady_clock::time_point creation_time, const uint8_t* nalu_data, int nalu_data_size)
+        {
+            NALU nalu(nalu_data, nalu_data_size, IS_H265, creation_time);
+            parser->forward(nalu);
+        }
+
+        void onFragmentedNALU(std::chrono::steady_clock::time_point creation_time, const FragmentedNALU& fragments)
+        {
+            NALU nalu(fragments, IS_H265, creation_time);
+            parser->forward(nalu);
+        }
+
+        bool acceptsFragments() const { return true; }
+    };
+
+    void forward(NALU& nalu)
+    {
+        nalu.setEndOfAccessUnit(mDepacketizer.isEndOfAccessUnit());
+        nalu.setCorrupted(mDepacketizer.isCorrupted());
+        nalu.setFrameId(mDepacketizer.rtpTimestamp());
+        mSink(nalu);
+        nParsedNALUs++;
+    }
+
+    RTPDepacketizer<Forward> mDepacketizer;
+    NaluSink                 mSink;
+};
+
+#endif  // FPVUE_STATICH26XPARSER_H
@@ -0,0 +1,212 @@
+#include "AccessUnitAssembler.h"  // the class under test
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "parser/H26XParser.h"
+
+namespace
+{
+// Stands in for MediaCodec: hands out input buffers of a fixed capacity and records what was queued
+struct FakeCodecInput
+{
+    struct Queued
+    {
+        std::vector<uint8_t> data;
+        uint32_t             flags;
+    };
+
+    size_t               capacity  = 4096;
+    int                  nAcquired = 0;
+    bool                 exhausted = false;
+    std::vector<uint8_t> buffer;
+    std::vector<Queued>  queued;
+
+    bool acquire(uint8_t*& data, size_t& cap)
+    {
+        if (exhausted) return false;
+        nAcquired++;
+        buffer.assign(capacity, 0);
+        data = buffer.data();
+        cap  = capacity;
+        return true;
+    }
+
+    void submit(size_t size, uint32_t flags, std::chrono::steady_clock::time_point)
+    {
+        queued.push_back({{buffer.begin(), buffer.begin() + (long) size}, flags});
+    }
+};
+
+// H.264 NALU with a 4 byte start code. For slices @param firstSlice sets first_mb_in_slice == 0.
+std::vector<uint8_t> h264(uint8_t header, size_t payloadSize = 20, bool firstSlice = true)
+{
+    std::vector<uint8_t> nalu = {0, 0, 0, 1, header, (uint8_t) (firstSlice ? 0x88 : 0x08)};
+    nalu.resize(5 + payloadSize, (uint8_t) (header + 1));
+    return nalu;
+}
+
+struct Stream
+{
+    AccessUnitAssembler               assembler;
+    FakeCodecInput                    codec;
+    std::vector<std::vector<uint8_t>> added;
+
+    void add(std::vector<uint8_t> bytes, bool endOfAccessUnit = false)
+    {
+        added.push_back(std::move(bytes));
+        NALU nalu(added.back().data(), added.back().size());
+        nalu.setEndOfAccessUnit(endOfAccessUnit);
+        assembler.add(nalu, codec);
+    }
+
+    std::vector<uint8_t> concat(std::initializer_list<size_t> indices) const
+    {
+        std::vector<uint8_t> ret;
+        for (size_t i : indices) ret.insert(ret.end(), added[i].begin(), added[i].end());
+        return ret;
+    }
+};
+}  // namespace
+
+TEST(AccessUnitAssemblerTest, MarkerBitSubmitsOneBufferPerFrame)
+{
+    Stream s;
+    s.add(h264(0x67));
+    s.add(h264(0x68));
+    s.add(h264(0x65, 200));
+    s.add(h264(0x65, 200, false), true);
+    ASSERT_EQ(s.codec.queued.size(), 1u);
+    EXPECT_EQ(s.codec.queued[0].data, s.concat({0, 1, 2, 3}));
+    EXPECT_EQ(s.codec.queued[0].flags, AccessUnitAssembler::FLAG_KEY_FRAME);
+    EXPECT_FALSE(s.assembler.pending());
+
+    s.add(h264(0x41, 100), true);
+    ASSERT_EQ(s.codec.queued.size(), 2u);
+    EXPECT_EQ(s.codec.queued[1].data, s.concat({4}));
+    EXPECT_EQ(s.codec.queued[1].flags, 0u);
+    EXPECT_EQ(s.codec.nAcquired, 2);
+    EXPECT_EQ(s.assembler.getNSubmitted(), 2);
+}
+
+TEST(AccessUnitAssemblerTest, LostMarkerIsInferredFromTheNextAccessUnit)
+{
+    Stream s;
+    // two slices, the marker of the frame is lost, then AUD
+    s.add(h264(0x41, 50));
+    s.add(h264(0x41, 50, false));
+    EXPECT_TRUE(s.assembler.pending());
+    s.add(h264(0x09, 1));
+    ASSERT_EQ(s.codec.queued.size(), 1u);
+    EXPECT_EQ(s.codec.queued[0].data, s.concat({0, 1}));
+
+    // first slice of the next picture without a delimiter
+    s.add(h264(0x41, 50));
+    ASSERT_EQ(s.codec.queued.size(), 1u);
+    s.add(h264(0x41, 50));
+    ASSERT_EQ(s.codec.queued.size(), 2u);
+    EXPECT_EQ(s.codec.queued[1].data, s.concat({2, 3}));
+
+    // SPS after a slice
+    s.add(h264(0x67));
+    ASSERT_EQ(s.codec.queued.size(), 3u);
+    EXPECT_EQ(s.codec.queued[2].data, s.concat({4}));
+    s.assembler.flush(s.codec);
+    ASSERT_EQ(s.codec.queued.size(), 4u);
+    EXPECT_EQ(s.codec.queued[3].data, s.concat({5}));
+}
+
+TEST(AccessUnitAssemblerTest, ParameterSetsWithoutPictureAreCodecConfig)
+{
+    Stream s;
+    s.add(h264(0x67));
+    s.add(h264(0x68), true);
+    ASSERT_EQ(s.codec.queued.size(), 1u);
+    EXPECT_EQ(s.codec.queued[0].flags, AccessUnitAssembler::FLAG_CODEC_CONFIG);
+}
+
+TEST(AccessUnitAssemblerTest, AccessUnitLargerThanTheBufferIsSplit)
+{
+    Stream s;
+    s.codec.capacity = 300;
+    s.add(h264(0x65, 200));
+    s.add(h264(0x65, 200, false), true);
+    ASSERT_EQ(s.codec.queued.size(), 2u);
+    EXPECT_EQ(s.codec.queued[0].data, s.concat({0}));
+    EXPECT_EQ(s.codec.queued[1].data, s.concat({1}));
+
+    // a NALU that fits in no buffer is dropped
+    s.add(h264(0x41, 400), true);
+    EXPECT_EQ(s.codec.queued.size(), 2u);
+    EXPECT_EQ(s.assembler.getNDropped(), 1);
+}
+
+TEST(AccessUnitAssemblerTest, NoInputBufferDropsTheNALU)
+{
+    Stream s;
+    s.codec.exhausted = true;
+    s.add(h264(0x41), true);
+    EXPECT_EQ(s.assembler.getNDropped(), 1);
+    EXPECT_FALSE(s.assembler.pending());
+    s.codec.exhausted = false;
+    s.add(h264(0x41), true);
+    ASSERT_EQ(s.codec.queued.size(), 1u);
+    EXPECT_EQ(s.codec.queued[0].data, s.concat({1}));
+}
+
+TEST(AccessUnitAssemblerTest, SliceStreamingSubmitsEverySliceAsPartialFrame)
+{
+    constexpr uint32_t PARTIAL_KEY = AccessUnitAssembler::FLAG_PARTIAL_FRAME | AccessUnitAssembler::FLAG_KEY_FRAME;
+    Stream             s;
+    s.assembler.setSliceStreaming(true);
+    s.add(h264(0x67));
+    s.add(h264(0x68));
+    s.add(h264(0x65, 200));
+    ASSERT_EQ(s.codec.queued.size(), 1u);
+    EXPECT_EQ(s.codec.queued[0].data, s.concat({0, 1, 2}));
+    EXPECT_EQ(s.codec.queued[0].flags, PARTIAL_KEY);
+    EXPECT_TRUE(s.assembler.pending());
+    s.add(h264(0x65, 200, false));
+    s.add(h264(0x65, 200, false), true);
+    ASSERT_EQ(s.codec.queued.size(), 3u);
+    EXPECT_EQ(s.codec.queued[1].flags, PARTIAL_KEY);
+    // the last slice completes the frame
+    EXPECT_EQ(s.codec.queued[2].data, s.concat({4}));
+    EXPECT_EQ(s.codec.queued[2].flags, AccessUnitAssembler::FLAG_KEY_FRAME);
+    EXPECT_FALSE(s.assembler.pending());
+
+    // marker lost: an empty buffer without the flag completes the frame before the next one starts
+    s.add(h264(0x41, 50));
+    s.add(h264(0x41, 50));
+    ASSERT_EQ(s.codec.queued.size(), 6u);
+    EXPECT_EQ(s.codec.queued[3].flags, AccessUnitAssembler::FLAG_PARTIAL_FRAME);
+    EXPECT_TRUE(s.codec.queued[4].data.empty());
+    EXPECT_EQ(s.codec.queued[4].flags, 0u);
+    EXPECT_EQ(s.codec.queued[5].data, s.concat({6}));
+    EXPECT_EQ(s.codec.queued[5].flags, AccessUnitAssembler::FLAG_PARTIAL_FRAME);
+    s.assembler.flush(s.codec);
+    ASSERT_EQ(s.codec.queued.size(), 7u);
+    EXPECT_TRUE(s.codec.queued[6].data.empty());
+    EXPECT_FALSE(s.assembler.pending());
+}
+
+TEST(AccessUnitAssemblerTest, ParserMarksTheLastNALUOfTheMarkerPacket)
+{
+    std::vector<bool> ends;
+    H26XParser        parser([&](const NALU& nalu) { ends.push_back(nalu.isEndOfAccessUnit()); });
+    // STAP-A with SPS + PPS, then a slice in a packet with the marker bit
+    std::vector<uint8_t> stap = {
+        0x80, 96, 0, 1, 0, 0, 0, 1, 0, 0, 0, 2, 0x18, 0, 5, 0x67, 1, 2, 3, 4, 0, 5, 0x68, 1, 2, 3, 4};
+    std::vector<uint8_t> slice = {0x80, 0x80 | 96, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0x65, 0x88};
+    slice.resize(slice.size() + 40, 0x11);
+    parser.parse_rtp_stream(stap.data(), stap.size());
+    parser.parse_rtp_stream(slice.data(), slice.size());
+    EXPECT_EQ(ends, (std::vector<bool>{false, false, true}));
+
+    // marker on a STAP-A: only its last NALU ends the access unit
+    ends.clear();
+    stap[1] = 0x80 | 96;
+    stap[3] = 3;
+    parser.parse_rtp_stream(stap.data(), stap.size());
+    EXPECT_EQ(ends, (std::vector<bool>{false, true}));
+}
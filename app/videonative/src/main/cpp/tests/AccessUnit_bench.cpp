@@ -0,0 +1,232 @@
+//
+// AccessUnit_bench.cpp
+// Per-NALU vs access unit vs slice streaming input to the decoder. A synthetic 60 fps H.264 stream (SPS / PPS / SEI with every IDR, SEI
+// and several slices per picture, the RTP marker bit on the last packet of a frame) is replayed in real time through
+// H26XParser into a simulated codec whose dequeueInputBuffer / queueInputBuffer each cost a fixed time, like the
+// binder round-trip of MediaCodec. Reports codec calls per frame and the latency from the last packet of a frame
+// until the whole frame was queued to the codec. For slice streaming also how much earlier the first slice of a frame
+// was at the codec (the lead over submitting whole frames).
+//
+// Usage: access_unit_bench [--seconds N] [--call-us N] [--slices N]
+//   --seconds N   length of the stream (default 5)
+//   --call-us N   cost of one codec call in us (default 80)
+//   --slices N    slices per picture (default 4)
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AccessUnitAssembler.h"
+#include "RtpStream.h"
+#include "parser/H26XParser.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Packet
+{
+    // send time, relative to the first packet
+    int64_t              timeUs;
+    std::vector<uint8_t> data;
+};
+
+// 60 fps, roughly 8 MBit/s, an IDR every second. FU-A fragments of 1400 bytes, the packets of one frame are spread
+// over a few ms like on the radio link.
+std::vector<Packet> synthesize(int seconds, int nSlices, size_t& nFrames)
+{
+    constexpr size_t          FPS = 60, GOP = 60;
+    std::vector<Packet>       packets;
+    RtpStream::H264Packetizer packetizer;
+
+    // the first payload byte sets first_mb_in_slice == 0 for the first slice of a picture
+    auto addNalu = [&](uint8_t header, size_t size, bool firstSlice, uint32_t ts, bool last, int64_t timeUs)
+    {
+        for (auto& data : packetizer.packetize(header, size, ts, last, firstSlice ? 0x88 : 0x08))
+        {
+            packets.push_back({timeUs, std::move(data)});
+        }
+    };
+    nFrames = seconds * FPS;
+    for (size_t frame = 0; frame < nFrames; frame++)
+    {
+        const auto     timeUs = (int64_t) (frame * 1000000 / FPS);
+        const uint32_t ts     = (uint32_t) (frame * 90000 / FPS);
+        const bool     idr    = frame % GOP == 0;
+        if (idr)
+        {
+            addNalu(0x67, 24, false, ts, false, timeUs);
+            addNalu(0x68, 4, false, ts, false, timeUs);
+        }
+        addNalu(0x06, 16, false, ts, false, timeUs);
+        const size_t frameSize = idr ? 120000 : 16000;
+        for (int slice = 0; slice < nSlices; slice++)
+        {
+            addNalu(idr ? 0x65 : 0x41, frameSize / nSlices, slice == 0, ts, slice == nSlices - 1, timeUs);
+        }
+    }
+    for (size_t i = 1; i < packets.size(); i++)
+    {
+        packets[i].timeUs = std::max(packets[i].timeUs, packets[i - 1].timeUs + 150);
+    }
+    return packets;
+}
+
+void spin(std::chrono::microseconds duration)
+{
+    const auto end = Clock::now() + duration;
+    while (Clock::now() < end)
+    {
+    }
+}
+
+// dequeueInputBuffer / queueInputBuffer of a codec that always has an input buffer, but each call takes a while
+struct SimulatedCodec
+{
+    std::chrono::microseconds callCost;
+    std::vector<uint8_t>      buffer = std::vector<uint8_t>(1024 * 1024);
+    long                      nCalls = 0;
+    // submit time of the first partial buffer of the current frame
+    Clock::time_point         firstPartial{};
+    bool                      partialFrame = false;
+    std::vector<int64_t>      leadsUs{};
+
+    bool acquire(uint8_t*& data, size_t& capacity)
+    {
+        spin(callCost);
+        nCalls++;
+        data     = buffer.data();
+        capacity = buffer.size();
+        return true;
+    }
+
+    void submit(size_t, uint32_t flags, Clock::time_point)
+    {
+        spin(callCost);
+        nCalls++;
+        const auto now = Clock::now();
+        if ((flags & AccessUnitAssembler::FLAG_PARTIAL_FRAME) != 0)
+        {
+            if (!partialFrame) firstPartial = now;
+            partialFrame = true;
+        }
+        else if (partialFrame)
+        {
+            leadsUs.push_back(std::chrono::duration_cast<std::chrono::microseconds>(now - firstPartial).count());
+            partialFrame = false;
+        }
+    }
+};
+
+int64_t percentile(std::vector<int64_t> values, double p)
+{
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t) (p * (double) values.size()))];
+}
+
+enum class Mode
+{
+    PER_NALU,
+    ACCESS_UNIT,
+    SLICE_STREAMING
+};
+
+void run(const std::vector<Packet>& packets, size_t nFrames, Mode mode, std::chrono::microseconds callCost)
+{
+    SimulatedCodec       codec{callCost};
+    AccessUnitAssembler  assembler;
+    assembler.setSliceStreaming(mode == Mode::SLICE_STREAMING);
+    std::vector<int64_t> latenciesUs;
+    Clock::time_point    packetTime;
+    long                 nNALUs = 0;
+
+    H26XParser parser(
+        [&](const NALU& nalu)
+        {
+            nNALUs++;
+            if (mode != Mode::PER_NALU)
+            {
+                assembler.add(nalu, codec);
+            }
+            else
+            {
+                // VideoDecoder::feedDecoder()
+                uint8_t* data;
+                size_t   capacity;
+                codec.acquire(data, capacity);
+                nalu.copyTo(data);
+                codec.submit(nalu.getSize(), 0, nalu.creationTime);
+            }
+            if (nalu.isEndOfAccessUnit())
+            {
+                latenciesUs.push_back(
+                    std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - packetTime).count());
+            }
+        });
+
+    const auto start = Clock::now();
+    for (const Packet& packet : packets)
+    {
+        packetTime = start + std::chrono::microseconds(packet.timeUs);
+        if (Clock::now() < packetTime)
+        {
+            std::this_thread::sleep_until(packetTime);
+        }
+        parser.parse_rtp_stream(packet.data.data(), packet.data.size(), packetTime);
+    }
+    std::printf(
+        "%-16s %6.2f NALUs/frame %6.2f codec calls/frame | frame queued after last packet p50 %6lld us  p99 %6lld us"
+        "  max %6lld us",
+        mode == Mode::PER_NALU ? "per NALU" : mode == Mode::ACCESS_UNIT ? "access unit" : "slice streaming",
+        (double) nNALUs / nFrames, (double) codec.nCalls / nFrames, (long long) percentile(latenciesUs, 0.5),
+        (long long) percentile(latenciesUs, 0.99), (long long) percentile(latenciesUs, 1.0));
+    if (!codec.leadsUs.empty())
+    {
+        std::printf(" | first slice lead p50 %6lld us", (long long) percentile(codec.leadsUs, 0.5));
+    }
+    std::printf("\n");
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    int seconds = 5, callUs = 80, nSlices = 4;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string arg = argv[i];
+        const int         val = std::atoi(argv[i + 1]);
+        if (arg == "--seconds")
+        {
+            seconds = val;
+        }
+        else if (arg == "--call-us")
+        {
+            callUs = val;
+        }
+        else if (arg == "--slices")
+        {
+            nSlices = std::max(val, 1);
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--seconds N] [--call-us N] [--slices N]\n", argv[0]);
+            return 1;
+        }
+    }
+    size_t     nFrames = 0;
+    const auto packets = synthesize(seconds, nSlices, nFrames);
+    std::printf(
+        "%zu packets, %zu frames, %d slices per picture, %d us per codec call\n", packets.size(), nFrames, nSlices,
+        callUs);
+    for (Mode mode : {Mode::PER_NALU, Mode::ACCESS_UNIT, Mode::SLICE_STREAMING})
+    {
+        run(packets, nFrames, mode, std::chrono::microseconds(callUs));
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include "AsyncCodec.h"  // the class under test
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace
+{
+/**
+ * Stands in for MediaCodec in async mode: hands out its input buffers, "decodes" each queued buffer after
+ * @param latency and reports the input buffer free and the frame decoded, all on its own callback thread.
+ */
+class FakeAsyncCodec
+{
+  public:
+    FakeAsyncCodec(AsyncCodecListener& listener, int nInputBuffers, microseconds latency)
+        : mListener(listener), mLatency(latency)
+    {
+        for (int32_t i = 0; i < nInputBuffers; i++) mEvents.push_back({steady_clock::now(), i, -1, 0});
+        mThread = std::thread(&FakeAsyncCodec::loop, this);
+    }
+
+    ~FakeAsyncCodec()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mCondition.notify_one();
+        mThread.join();
+    }
+
+    void queueInputBuffer(int32_t index, int64_t presentationTimeUs)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mEvents.push_back({steady_clock::now() + mLatency, index, mNextOutput++, presentationTimeUs});
+        }
+        mCondition.notify_one();
+    }
+
+  private:
+    struct Event
+    {
+        steady_clock::time_point due;
+        int32_t                  input;
+        int32_t                  output;  // -1: only the input buffer becomes free
+        int64_t                  presentationTimeUs;
+    };
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mStop)
+        {
+            if (mEvents.empty() || mEvents.front().due > steady_clock::now())
+            {
+                const auto until = mEvents.empty() ? steady_clock::now() + milliseconds(100) : mEvents.front().due;
+                mCondition.wait_until(lock, until);
+                continue;
+            }
+            const Event event = mEvents.front();
+            mEvents.pop_front();
+            lock.unlock();
+            if (event.output >= 0) mListener.onOutputAvailable(event.output, event.presentationTimeUs, 0);
+            mListener.onInputAvailable(event.input);
+            lock.lock();
+        }
+    }
+
+    AsyncCodecListener&     mListener;
+    const microseconds      mLatency;
+    std::deque<Event>       mEvents;
+    int32_t                 mNextOutput = 0;
+    bool                    mStop       = false;
+    std::mutex              mMutex;
+    std::condition_variable mCondition;
+    std::thread             mThread;
+};
+
+// What VideoDecoder does with the callbacks: queue the free inputs for the feeder, release outputs right away
+struct DecoderSide : AsyncCodecListener
+{
+    AsyncInputBuffers input;
+    std::atomic<int>  nOutputs = 0;
+
+    void onInputAvailable(int32_t index) override { ASSERT_TRUE(input.push(index)); }
+
+    void onOutputAvailable(int32_t, int64_t, uint32_t) override { nOutputs++; }
+
+    void onFormatChanged(int32_t, int32_t) override {}
+
+    void onError(int32_t, int32_t) override {}
+};
+}  // namespace
+
+TEST(AsyncInputBuffersTest, PopTimesOutWithoutBuffers)
+{
+    AsyncInputBuffers input;
+    const auto        start = steady_clock::now();
+    EXPECT_EQ(input.pop(milliseconds(5)), -1);
+    EXPECT_GE(steady_clock::now() - start, milliseconds(5));
+}
+
+TEST(AsyncInputBuffersTest, IndicesArriveInOrder)
+{
+    AsyncInputBuffers input;
+    for (int32_t i : {3, 1, 2}) EXPECT_TRUE(input.push(i));
+    EXPECT_EQ(input.size(), 3u);
+    for (int32_t i : {3, 1, 2}) EXPECT_EQ(input.pop(microseconds(0)), i);
+    EXPECT_EQ(input.pop(microseconds(0)), -1);
+}
+
+TEST(AsyncInputBuffersTest, WaitingFeederWakesOnPush)
+{
+    AsyncInputBuffers      input;
+    ssize_t                popped = -2;
+    steady_clock::duration waited{};
+    std::thread            feeder(
+        [&]
+        {
+            const auto start = steady_clock::now();
+            popped           = input.pop(seconds(5));
+            waited           = steady_clock::now() - start;
+        });
+    std::this_thread::sleep_for(milliseconds(20));
+    input.push(7);
+    feeder.join();
+    EXPECT_EQ(popped, 7);
+    // woken by the push, not by the timeout
+    EXPECT_LT(waited, seconds(2));
+}
+
+TEST(AsyncInputBuffersTest, InterruptEndsTheWaitOfTheFeeder)
+{
+    AsyncInputBuffers      input;
+    ssize_t                popped = -2;
+    steady_clock::duration waited{};
+    std::thread            feeder(
+        [&]
+        {
+            const auto start = steady_clock::now();
+            popped           = input.pop(seconds(5));
+            waited           = steady_clock::now() - start;
+        });
+    std::this_thread::sleep_for(milliseconds(20));
+    input.interrupt();
+    feeder.join();
+    EXPECT_EQ(popped, -1);
+    EXPECT_LT(waited, seconds(2));
+    // only the one wait
+    input.push(4);
+    EXPECT_EQ(input.pop(microseconds(0)), 4);
+    EXPECT_EQ(input.pop(milliseconds(5)), -1);
+}
+
+TEST(AsyncInputBuffersTest, ClearDropsStaleIndices)
+{
+    AsyncInputBuffers input;
+    for (int32_t i = 0; i < 4; i++) input.push(i);
+    input.clear();
+    EXPECT_EQ(input.size(), 0u);
+    input.push(9);
+    EXPECT_EQ(input.pop(microseconds(0)), 9);
+}
+
+TEST(AsyncInputBuffersTest, PushFailsBeyondTheMaxBufferCount)
+{
+    AsyncInputBuffers input;
+    for (size_t i = 0; i < AsyncInputBuffers::MAX_INPUT_BUFFERS; i++) EXPECT_TRUE(input.push((int32_t) i));
+    EXPECT_FALSE(input.push(0));
+}
+
+TEST(AsyncInputBuffersTest, FeedsAFakeCodecWithoutPolling)
+{
+    constexpr int  N_FRAMES = 300;
+    DecoderSide    decoder;
+    FakeAsyncCodec codec(decoder, 4, microseconds(500));
+    for (int i = 0; i < N_FRAMES; i++)
+    {
+        const ssize_t index = decoder.input.pop(seconds(1));
+        ASSERT_GE(index, 0);
+        codec.queueInputBuffer(
+            (int32_t) index, duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+    }
+    const auto deadline = steady_clock::now() + seconds(5);
+    // until all frames are decoded and all input buffers came back
+    while ((decoder.nOutputs < N_FRAMES || decoder.input.size() < 4) && steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    EXPECT_EQ(decoder.nOutputs, N_FRAMES);
+    EXPECT_EQ(decoder.input.size(), 4u);
+}
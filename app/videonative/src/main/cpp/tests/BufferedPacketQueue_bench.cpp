@@ -0,0 +1,100 @@
+//
+// BufferedPacketQueue_bench.cpp
+// Cost per packet of the reorder window for in-order, randomly reordered and burst-loss sequence patterns.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "BufferedPacketQueue.h"
+
+namespace
+{
+constexpr size_t PACKET_SIZE = 1400;
+
+// Sequence numbers as they arrive, starting close to the 16 bit wrap-around
+std::vector<SeqType> inOrder(size_t n)
+{
+    std::vector<SeqType> seqs(n);
+    for (size_t i = 0; i < n; i++) seqs[i] = static_cast<SeqType>(65000 + i);
+    return seqs;
+}
+
+// Every packet is displaced by up to @param depth positions
+std::vector<SeqType> randomReorder(size_t n, size_t depth)
+{
+    std::vector<SeqType> seqs = inOrder(n);
+    std::mt19937         rng(42);
+    for (size_t i = 0; i + depth < n; i += depth)
+    {
+        std::shuffle(seqs.begin() + i, seqs.begin() + i + depth, rng);
+    }
+    return seqs;
+}
+
+// Bursts of @param burst lost packets every @param every packets
+std::vector<SeqType> burstLoss(size_t n, size_t burst, size_t every)
+{
+    std::vector<SeqType> seqs;
+    for (SeqType seq : inOrder(n))
+    {
+        if (static_cast<SeqType>(seq - 65000) % every >= burst) seqs.push_back(seq);
+    }
+    return seqs;
+}
+
+template <bool POOLED>
+void run(const char* name, const std::vector<SeqType>& seqs)
+{
+    auto                 pool = PacketPool::create(PacketPool::DEFAULT_BUFFER_SIZE, 256);
+    std::vector<uint8_t> payload(PACKET_SIZE, 0x42);
+    BufferedPacketQueue  queue;
+    size_t               nDelivered = 0;
+    auto                 callback   = [&](const uint8_t* data, std::size_t length) { nDelivered += data[0] + length; };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (SeqType seq : seqs)
+    {
+        if constexpr (POOLED)
+        {
+            // what the receivers hand over: the kernel already wrote into a pool buffer
+            PacketRef packet = pool->acquire();
+            packet.setSize(PACKET_SIZE);
+            queue.processPacket(seq, std::move(packet), callback);
+        }
+        else
+        {
+            queue.processPacket(seq, payload.data(), payload.size(), callback);
+        }
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::printf(
+        "%-22s %-6s %8zu packets  %7.1f ns/packet  pool exhausted %ld\n",
+        name,
+        POOLED ? "pooled" : "copy",
+        seqs.size(),
+        ns / seqs.size(),
+        pool->getNExhausted());
+    if (nDelivered == 0) std::abort();
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    const size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+    const std::pair<const char*, std::vector<SeqType>> patterns[] = {
+        {"in order", inOrder(n)},
+        {"reorder depth 4", randomReorder(n, 4)},
+        {"reorder depth 12", randomReorder(n, 12)},
+        {"burst loss 5/200", burstLoss(n, 5, 200)},
+        {"burst loss 20/200", burstLoss(n, 20, 200)},
+    };
+    for (const auto& [name, seqs] : patterns)
+    {
+        run<true>(name, seqs);
+        run<false>(name, seqs);
+    }
+    return 0;
+}
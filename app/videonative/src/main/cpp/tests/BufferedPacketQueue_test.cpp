@@ -57,6 +57,184 @@ TEST_F(BufferedPacketQueueTest, ReorderedDeliversInOrder)
     ASSERT_EQ(delivered, expected) << "Overflow flush should deliver the entire block in one shot";
 }
 
+TEST_F(BufferedPacketQueueTest, OverflowFlushKeepsSequenceOrderAcrossWrap)
+{
+    feed(65530);
+    // 65531 is lost, the next MAX_BUFFER_SIZE packets straddle the wrap-around
+    for (uint16_t s = 65532; s != 11; ++s) feed(s);
+
+    std::vector<uint16_t> expected = {65530};
+    for (uint16_t s = 65532; s != 11; ++s) expected.push_back(s);
+
+    ASSERT_EQ(delivered, expected);
+    feed(11);
+    ASSERT_EQ(delivered.back(), 11);
+}
+
+TEST_F(BufferedPacketQueueTest, DuplicateIsDeliveredOnce)
+{
+    feed(1);
+    feed(3);
+    feed(3);
+    feed(2);
+    ASSERT_EQ(delivered, (std::vector<uint16_t>{1, 2, 3}));
+    ASSERT_EQ(q.getNBufferedPackets(), 0u);
+}
+
+TEST_F(BufferedPacketQueueTest, ReceiveTimestampsFollowTheirPackets)
+{
+    using Clock = BufferedPacketQueue::Clock;
+    std::vector<std::pair<uint16_t, Clock::time_point>> out;
+    auto cb = [&](const uint8_t* data, std::size_t, Clock::time_point timestamp)
+    { out.emplace_back(*(const uint16_t*) data, timestamp); };
+    auto pool = PacketPool::create(16, 8);
+    auto feedAt = [&](uint16_t seq, int ms)
+    {
+        PacketRef packet = pool->acquire();
+        std::memcpy(packet.data(), &seq, sizeof(seq));
+        packet.setSize(sizeof(seq));
+        packet.setTimestamp(Clock::time_point(std::chrono::milliseconds(ms)));
+        q.processPacket(seq, std::move(packet), cb);
+    };
+    feedAt(10, 1);
+    feedAt(12, 2);
+    feedAt(11, 3);
+
+    ASSERT_EQ(out.size(), 3u);
+    EXPECT_EQ(out[0], std::make_pair(uint16_t{10}, Clock::time_point(std::chrono::milliseconds(1))));
+    EXPECT_EQ(out[1], std::make_pair(uint16_t{11}, Clock::time_point(std::chrono::milliseconds(3))));
+    EXPECT_EQ(out[2], std::make_pair(uint16_t{12}, Clock::time_point(std::chrono::milliseconds(2))));
+}
+
+TEST_F(BufferedPacketQueueTest, PacketRefCallbackKeepsTheBuffers)
+{
+    std::vector<PacketRef> out;
+    auto                   cb   = [&](const PacketRef& packet) { out.push_back(packet); };
+    auto                   pool = PacketPool::create(16, 8);
+    std::vector<uint8_t*>  buffers;
+    for (uint16_t seq : {20, 22, 21})
+    {
+        PacketRef packet = pool->acquire();
+        std::memcpy(packet.data(), &seq, sizeof(seq));
+        packet.setSize(sizeof(seq));
+        buffers.push_back(packet.data());
+        q.processPacket(seq, std::move(packet), cb);
+    }
+    // handed out in order, owned packets are the original buffers
+    ASSERT_EQ(out.size(), 3u);
+    EXPECT_EQ(out[0].data(), buffers[0]);
+    EXPECT_EQ(out[1].data(), buffers[2]);
+    EXPECT_EQ(out[2].data(), buffers[1]);
+    EXPECT_EQ(pool->getNInUse(), 3u);
+
+    // raw data is copied into a buffer the callback may keep
+    const uint16_t seq = 23;
+    q.processPacket(seq, (const uint8_t*) &seq, sizeof(seq), cb);
+    ASSERT_EQ(out.size(), 4u);
+    EXPECT_EQ(*(const uint16_t*) out[3].data(), seq);
+    EXPECT_EQ(out[3].size(), sizeof(seq));
+}
+
+TEST_F(BufferedPacketQueueTest, JumpOutsideWindowRestarts)
+{
+    feed(100);
+    feed(102);
+    feed(5000);
+    feed(5001);
+    ASSERT_EQ(delivered, (std::vector<uint16_t>{100, 102, 5000, 5001}));
+}
+
+// ---------- Deadline mode --------------------------------------------------
+namespace
+{
+BufferedPacketQueue::Clock::time_point fakeNow;
+
+BufferedPacketQueue::Clock::time_point getFakeNow()
+{
+    return fakeNow;
+}
+}  // namespace
+
+class BufferedPacketQueueDeadlineTest : public BufferedPacketQueueTest
+{
+  protected:
+    void SetUp() override
+    {
+        BufferedPacketQueueTest::SetUp();
+        fakeNow = {};
+        q.setClock(&getFakeNow);
+        BufferedPacketQueue::DeadlineConfig config;
+        config.maxWait = std::chrono::milliseconds(3);
+        config.minWait = std::chrono::microseconds(500);
+        q.enableDeadlineMode(config);
+    }
+
+    void feedAt(uint16_t seq, std::chrono::microseconds t)
+    {
+        fakeNow = BufferedPacketQueue::Clock::time_point(t);
+        feed(seq);
+    }
+};
+
+TEST_F(BufferedPacketQueueDeadlineTest, SkipsGapOnceDeadlineExpired)
+{
+    using std::chrono::microseconds;
+    feedAt(1, microseconds(0));
+    feedAt(3, microseconds(0));
+    feedAt(4, microseconds(1000));
+    ASSERT_EQ(delivered, (std::vector<uint16_t>{1}));
+
+    feedAt(5, microseconds(3100));
+    ASSERT_EQ(delivered, (std::vector<uint16_t>{1, 3, 4, 5}));
+
+    auto stats = q.getJitterStats();
+    EXPECT_EQ(stats.nGapsSkipped, 1);
+    EXPECT_EQ(stats.nPacketsSkipped, 1);
+    EXPECT_EQ(stats.nHeldPackets, 2);
+    EXPECT_EQ(stats.addedLatency, microseconds(3100 + 2100));
+
+    // the missing packet shows up after all, it is dropped and counted
+    feedAt(2, microseconds(3500));
+    ASSERT_EQ(delivered.size(), 4u);
+    stats = q.getJitterStats();
+    EXPECT_EQ(stats.nGapsFilledLate, 1);
+    EXPECT_EQ(stats.deadline, microseconds(3000));
+}
+
+TEST_F(BufferedPacketQueueDeadlineTest, FilledGapsShortenTheDeadline)
+{
+    using std::chrono::microseconds;
+    feedAt(1, microseconds(0));
+    feedAt(3, microseconds(0));
+    feedAt(2, microseconds(200));
+    ASSERT_EQ(delivered, (std::vector<uint16_t>{1, 2, 3}));
+
+    const auto stats = q.getJitterStats();
+    EXPECT_EQ(stats.nGapsFilled, 1);
+    EXPECT_EQ(stats.nGapsSkipped, 0);
+    // 2 x the measured 200us, clamped to minWait
+    EXPECT_EQ(stats.deadline, microseconds(500));
+
+    // the shorter deadline now applies
+    feedAt(5, microseconds(1000));
+    feedAt(6, microseconds(1600));
+    ASSERT_EQ(delivered, (std::vector<uint16_t>{1, 2, 3, 5, 6}));
+}
+
+TEST_F(BufferedPacketQueueDeadlineTest, FlushExpiredWithoutNewPackets)
+{
+    using std::chrono::microseconds;
+    feedAt(1, microseconds(0));
+    feedAt(3, microseconds(0));
+    fakeNow = BufferedPacketQueue::Clock::time_point(microseconds(2000));
+    auto cb = [this](const uint8_t* seq, std::size_t) { delivered.push_back(*(uint16_t*) seq); };
+    q.flushExpired(cb);
+    ASSERT_EQ(delivered, (std::vector<uint16_t>{1}));
+    fakeNow = BufferedPacketQueue::Clock::time_point(microseconds(3000));
+    q.flushExpired(cb);
+    ASSERT_EQ(delivered, (std::vector<uint16_t>{1, 3}));
+}
+
 // ---------- gtest boilerplate main -----------------------------------------
 int main(int argc, char** argv)
 {
@@ -0,0 +1,143 @@
+#include "CatchUpController.h"  // the class under test
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "FakeDecoderBackend.h"
+#include "VideoDecoder.h"
+
+using namespace std::chrono;
+using Clock = CatchUpController::Clock;
+using Mode  = CatchUpController::Mode;
+
+namespace
+{
+const Clock::time_point T0 = Clock::time_point(seconds(100));
+
+// H.264 slices, first_mb_in_slice 0 unless @param firstSlice is false
+const std::vector<uint8_t> IDR      = {0, 0, 0, 1, 0x65, 0x88};
+const std::vector<uint8_t> P        = {0, 0, 0, 1, 0x41, 0x9A};
+const std::vector<uint8_t> P_SLICE2 = {0, 0, 0, 1, 0x41, 0x40};
+const std::vector<uint8_t> B        = {0, 0, 0, 1, 0x01, 0x9E};
+const std::vector<uint8_t> SEI      = {0, 0, 0, 1, 0x06, 0x05};
+
+class CatchUpTest : public ::testing::Test
+{
+  protected:
+    // The NALU was received at @param received and reaches the codec at mNow
+    bool skip(const std::vector<uint8_t>& data, Clock::time_point received, bool h265 = false)
+    {
+        const NALU nalu(data.data(), data.size(), h265, received);
+        return mCatchUp.skip(nalu, mNow, Clock::duration::zero());
+    }
+
+    // A picture @param late behind
+    bool skipLate(const std::vector<uint8_t>& data, Clock::duration late, bool h265 = false)
+    {
+        mNow += milliseconds(10);
+        return skip(data, mNow - late, h265);
+    }
+
+    CatchUpController mCatchUp;
+    Clock::time_point mNow = T0;
+};
+}  // namespace
+
+TEST_F(CatchUpTest, OffWithoutBudget)
+{
+    EXPECT_FALSE(skipLate(B, seconds(5)));
+    EXPECT_FALSE(skipLate(P, seconds(5)));
+    EXPECT_EQ(mCatchUp.getNEvents(), 0);
+}
+
+TEST_F(CatchUpTest, SkipsNonReferencePicturesUntilBackWithinBudget)
+{
+    mCatchUp.setBudget(milliseconds(100));
+    EXPECT_FALSE(skipLate(B, milliseconds(90)));
+    EXPECT_EQ(mCatchUp.getMode(), Mode::OFF);
+    // behind, but less than twice the budget
+    EXPECT_FALSE(skipLate(P, milliseconds(150)));
+    EXPECT_EQ(mCatchUp.getMode(), Mode::DROP_NON_REFERENCE);
+    EXPECT_TRUE(skipLate(B, milliseconds(120)));
+    EXPECT_FALSE(skipLate(SEI, milliseconds(120)));
+    EXPECT_FALSE(skipLate(P, milliseconds(80)));
+    EXPECT_EQ(mCatchUp.getMode(), Mode::DROP_NON_REFERENCE);
+    // below half the budget
+    EXPECT_FALSE(skipLate(B, milliseconds(40)));
+    EXPECT_EQ(mCatchUp.getMode(), Mode::OFF);
+    EXPECT_EQ(mCatchUp.getNEvents(), 1);
+    EXPECT_EQ(mCatchUp.getNSkippedFrames(), 1);
+}
+
+TEST_F(CatchUpTest, SkipsToTheNextKeyFrameWhenStillBehind)
+{
+    mCatchUp.setBudget(milliseconds(100));
+    EXPECT_FALSE(skipLate(P, milliseconds(150)));
+    // all reference pictures, skipping the non-reference ones does not help
+    for (int i = 0; i < 10; i++) EXPECT_FALSE(skipLate(P, milliseconds(150)));
+    EXPECT_TRUE(skipLate(P, milliseconds(150)));
+    EXPECT_EQ(mCatchUp.getMode(), Mode::DROP_UNTIL_KEY_FRAME);
+    // all slices of a skipped picture, but not what is not a slice
+    EXPECT_TRUE(skip(P_SLICE2, mNow));
+    EXPECT_FALSE(skip(SEI, mNow));
+    EXPECT_TRUE(skipLate(P, milliseconds(20)));
+    EXPECT_FALSE(skipLate(IDR, milliseconds(20)));
+    EXPECT_EQ(mCatchUp.getMode(), Mode::OFF);
+    EXPECT_FALSE(skip(P_SLICE2, mNow));
+    EXPECT_EQ(mCatchUp.getNEvents(), 1);
+    EXPECT_EQ(mCatchUp.getNSkippedFrames(), 2);
+}
+
+TEST_F(CatchUpTest, FarBehindSkipsToTheNextIRAPRightAway)
+{
+    mCatchUp.setBudget(milliseconds(100));
+    // H.265: TRAIL_R, then CRA
+    const std::vector<uint8_t> trail = {0, 0, 0, 1, 0x02, 0x01, 0x80};
+    const std::vector<uint8_t> cra   = {0, 0, 0, 1, 0x2A, 0x01, 0x80};
+    EXPECT_TRUE(skipLate(trail, milliseconds(500), true));
+    EXPECT_TRUE(skipLate(trail, milliseconds(400), true));
+    // the key frame is late as well, the non-reference pictures after it still go
+    EXPECT_FALSE(skipLate(cra, milliseconds(300), true));
+    EXPECT_EQ(mCatchUp.getMode(), Mode::DROP_NON_REFERENCE);
+    EXPECT_EQ(mCatchUp.getNSkippedFrames(), 2);
+}
+
+TEST(CatchUpDecoderTest, LateFramesAreNotDecoded)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setCatchUpBudget(milliseconds(100));
+    auto                fake    = std::make_unique<FakeDecoderBackend>(FakeDecoderBackend::Script{});
+    FakeDecoderBackend* backend = fake.get();
+    decoder.setBackend(std::move(fake), 0);
+    const std::vector<uint8_t> sps = {0,    0,    0,    1,    0x67, 0x64, 0x00, 0x1F, 0xAC, 0xD9,
+                                      0x40, 0x50, 0x05, 0xBB, 0x01, 0x10, 0x00, 0x00, 0x03, 0x00,
+                                      0x10, 0x00, 0x00, 0x03, 0x03, 0xC0, 0xF1, 0x83, 0x19, 0x60};
+    const std::vector<uint8_t> pps = {0, 0, 0, 1, 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0};
+    const auto feed = [&decoder](const std::vector<uint8_t>& data, Clock::duration late)
+    {
+        std::vector<uint8_t> padded = data;
+        padded.resize(std::max<size_t>(data.size(), 100), 0x5A);
+        NALU nalu(padded.data(), padded.size(), false, Clock::now() - late);
+        nalu.setEndOfAccessUnit(true);
+        decoder.interpretNALU(nalu);
+    };
+    feed(sps, milliseconds(0));
+    feed(pps, milliseconds(0));
+    feed(IDR, milliseconds(0));
+    for (int i = 0; i < 4; i++) feed(P, milliseconds(0));
+    // a backlog of half a second, up to the next key frame
+    for (int i = 0; i < 10; i++) feed(P, milliseconds(500));
+    feed(IDR, milliseconds(0));
+    for (int i = 0; i < 4; i++) feed(P, milliseconds(0));
+    const auto deadline = Clock::now() + seconds(5);
+    while (decoder.getFeedQueueStats().nDecodedFrames < 10 && Clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    const auto stats = decoder.getFeedQueueStats();
+    EXPECT_EQ(stats.nDecodedFrames, 10);
+    EXPECT_EQ(stats.nCatchUps, 1);
+    EXPECT_EQ(stats.nSkippedFramesCatchUp, 10);
+    EXPECT_EQ(backend->getStats().nQueuedBuffers, 10);
+}
@@ -0,0 +1,113 @@
+#include "CodecWatchdog.h"  // the class under test
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace std::chrono;
+using Clock = CodecWatchdog::Clock;
+
+namespace
+{
+const Clock::time_point T0 = Clock::time_point(seconds(100));
+
+// A stream of @param n pictures @param interval apart from @param start on, @return the time of the last one
+Clock::time_point stream(CodecWatchdog& watchdog, Clock::time_point start, int n, Clock::duration interval)
+{
+    for (int i = 0; i < n; i++) watchdog.onPicture(start + i * interval);
+    return start + (n - 1) * interval;
+}
+}  // namespace
+
+TEST(CodecWatchdogTest, TimeoutIsFrameIntervalsOfTheStream)
+{
+    CodecWatchdog watchdog;
+    stream(watchdog, T0, 100, milliseconds(40));
+    EXPECT_NEAR(duration_cast<milliseconds>(watchdog.getTimeout()).count(), 30 * 40, 10);
+    watchdog.setFrameIntervals(10);
+    EXPECT_NEAR(duration_cast<milliseconds>(watchdog.getTimeout()).count(), 10 * 40, 5);
+    // a fast stream does not go below the minimum
+    stream(watchdog, T0 + seconds(10), 100, milliseconds(2));
+    EXPECT_EQ(watchdog.getTimeout(), CodecWatchdog::MIN_TIMEOUT);
+    watchdog.setFrameIntervals(0);
+    EXPECT_EQ(watchdog.getTimeout(), Clock::duration::zero());
+}
+
+TEST(CodecWatchdogTest, WedgedWithoutOutputOnceItGotAKeyFrame)
+{
+    CodecWatchdog watchdog;
+    watchdog.setFrameIntervals(10);
+    const auto now = stream(watchdog, T0, 50, milliseconds(50));
+    watchdog.onStart(0);
+    // waiting for a key frame
+    watchdog.onInput(0, now);
+    EXPECT_EQ(watchdog.getDeadline(0), Clock::time_point::max());
+    watchdog.onKeyFrame(0);
+    watchdog.onInput(0, now + milliseconds(10));
+    // the later input does not move the deadline
+    watchdog.onInput(0, now + milliseconds(60));
+    const auto deadline = watchdog.getDeadline(0);
+    EXPECT_NEAR(duration_cast<milliseconds>(deadline - now).count(), 10 + 500, 10);
+    EXPECT_FALSE(watchdog.isWedged(0, deadline - milliseconds(1)));
+    EXPECT_TRUE(watchdog.isWedged(0, deadline));
+    // the other codec is not waiting for anything
+    EXPECT_FALSE(watchdog.isWedged(1, deadline));
+    watchdog.onOutput(0, now + milliseconds(100), true);
+    EXPECT_FALSE(watchdog.isWedged(0, deadline));
+    EXPECT_FALSE(watchdog.isRecovering(0));
+}
+
+TEST(CodecWatchdogTest, PauseOfTheStreamIsNoWedge)
+{
+    CodecWatchdog watchdog;
+    auto          now = stream(watchdog, T0, 50, milliseconds(20));
+    watchdog.onKeyFrame(0);
+    watchdog.onInput(0, now);
+    // the codec holds the last frame until the next one comes, a second later
+    now += seconds(1);
+    EXPECT_TRUE(watchdog.isWedged(0, now));
+    watchdog.onPicture(now);
+    EXPECT_FALSE(watchdog.isWedged(0, now));
+    watchdog.onInput(0, now);
+    EXPECT_FALSE(watchdog.isWedged(0, now + milliseconds(500)));
+    EXPECT_TRUE(watchdog.isWedged(0, now + milliseconds(700)));
+}
+
+TEST(CodecWatchdogTest, RecoveryIsFromTheFirstResetToTheNextFrameShown)
+{
+    CodecWatchdog watchdog;
+    watchdog.onReset(0, T0, false);
+    EXPECT_TRUE(watchdog.isRecovering(0));
+    // the frames the codec is primed with are not shown
+    watchdog.onOutput(0, T0 + milliseconds(10), false);
+    EXPECT_TRUE(watchdog.isRecovering(0));
+    // the flush did not help
+    watchdog.onReset(0, T0 + milliseconds(300), true);
+    watchdog.onOutput(0, T0 + milliseconds(400), true);
+    EXPECT_FALSE(watchdog.isRecovering(0));
+    EXPECT_EQ(watchdog.getLastRecovery(), milliseconds(400));
+    EXPECT_EQ(watchdog.getNFlushed(), 1);
+    EXPECT_EQ(watchdog.getNRecreated(), 1);
+    // a codec that is released gives the recovery up
+    watchdog.onReset(1, T0 + seconds(1), false);
+    watchdog.onRelease(1);
+    EXPECT_FALSE(watchdog.isRecovering(1));
+    EXPECT_EQ(watchdog.getLastRecovery(), milliseconds(400));
+}
+
+TEST(CodecWatchdogTest, CodecThatFailedIsWedgedRightAway)
+{
+    CodecWatchdog watchdog;
+    const auto    now = stream(watchdog, T0, 50, milliseconds(20));
+    watchdog.onStart(0);
+    watchdog.onError(0);
+    // no key frame and no input needed
+    EXPECT_TRUE(watchdog.hasFailed(0));
+    EXPECT_TRUE(watchdog.isWedged(0, now));
+    EXPECT_FALSE(watchdog.isWedged(1, now));
+    watchdog.onReset(0, now, true);
+    EXPECT_FALSE(watchdog.hasFailed(0));
+    EXPECT_FALSE(watchdog.isWedged(0, now));
+    // a disabled watchdog leaves it alone
+    watchdog.onError(0);
+    watchdog.setFrameIntervals(0);
+    EXPECT_FALSE(watchdog.isWedged(0, now));
+}
@@ -0,0 +1,379 @@
+//
+// DecoderFeed_bench.cpp
+// Throughput and latency of the VideoDecoder feed path (feed queue -> input buffers -> output handling) against
+// FakeDecoderBackend, polling (sync) and with the codec callbacks (async):
+//   throughput: frames per second through the decoder when it is fed as fast as it takes them
+//   paced:      a stream at a fixed frame rate, the avg time from the NALU to the codec input, the part of it spent
+//               waiting for an input buffer and the time in the codec, as the decoding info reports them
+//   stall:      the paced stream while the codec hangs once, how much the feed queue drops until the next key frame
+//   vr:         the paced stream into two codecs (VR mode) while the right one hangs once, the left / right output
+//               skew and what the left codec decoded meanwhile
+//   resume:     the paced stream loses its surface for half a second (app in the background, VR toggle), the time
+//               from the new surface to the first frame shown with the codec parked meanwhile and with a codec that
+//               has to be created again, started from the GOP cache or (no cache) with the next key frame
+//
+// Usage: decoder_feed_bench [--frames N] [--fps N] [--latency-us N] [--buffers N] [--stall-ms N]
+//   --frames N      frames for the throughput run (default 3000)
+//   --fps N         frame rate of the paced runs, 3 seconds each (default 120)
+//   --latency-us N  decoding time of the fake codec (default 2000)
+//   --buffers N     input buffers of the fake codec (default 4)
+//   --stall-ms N    length of the stall (default 200)
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FakeDecoderBackend.h"
+#include "VideoDecoder.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// x264, 1280x720 High profile
+const std::vector<uint8_t> H264_SPS = {0,    0,    0,    1,    0x67, 0x64, 0x00, 0x1F, 0xAC, 0xD9,
+                                       0x40, 0x50, 0x05, 0xBB, 0x01, 0x10, 0x00, 0x00, 0x03, 0x00,
+                                       0x10, 0x00, 0x00, 0x03, 0x03, 0xC0, 0xF1, 0x83, 0x19, 0x60};
+const std::vector<uint8_t> H264_PPS = {0, 0, 0, 1, 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0};
+
+struct Options
+{
+    int  frames    = 3000;
+    int  fps       = 120;
+    long latencyUs = 2000;
+    int  buffers   = 4;
+    int  stallMs   = 200;
+};
+
+// One slice per frame, a key frame every 60 frames
+class Stream
+{
+  public:
+    Stream() : mIDR(slice(0x65, 40000)), mP(slice(0x41, 8000)) {}
+
+    void feedParameterSets(VideoDecoder& decoder)
+    {
+        feed(decoder, H264_SPS);
+        feed(decoder, H264_PPS);
+    }
+
+    void feedFrame(VideoDecoder& decoder, int frame) { feed(decoder, frame % 60 == 0 ? mIDR : mP); }
+
+  private:
+    static std::vector<uint8_t> slice(uint8_t header, size_t size)
+    {
+        std::vector<uint8_t> data = {0, 0, 0, 1, header, 0x88};
+        data.resize(size, 0x5A);
+        return data;
+    }
+
+    static void feed(VideoDecoder& decoder, const std::vector<uint8_t>& data)
+    {
+        NALU nalu(data.data(), data.size());
+        nalu.setEndOfAccessUnit(true);
+        decoder.interpretNALU(nalu);
+    }
+
+    const std::vector<uint8_t> mIDR;
+    const std::vector<uint8_t> mP;
+};
+
+FakeDecoderBackend::Script script(const Options& options)
+{
+    FakeDecoderBackend::Script script;
+    script.nInputBuffers = options.buffers;
+    script.latency       = std::chrono::microseconds(options.latencyUs);
+    return script;
+}
+
+bool waitForDecoded(VideoDecoder& decoder, long nFrames)
+{
+    const auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (decoder.getFeedQueueStats().nDecodedFrames < nFrames)
+    {
+        if (Clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    return true;
+}
+
+void throughput(const Options& options, bool async)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAsyncMode(async);
+    decoder.setBackend(std::make_unique<FakeDecoderBackend>(script(options)), 0);
+    Stream stream;
+    stream.feedParameterSets(decoder);
+    // as many frames in flight as the feed queue holds without dropping
+    const long inFlight = (long) decoder.getFeedQueueStats().capacity / 2;
+    const auto start    = Clock::now();
+    for (int frame = 0; frame < options.frames; frame++)
+    {
+        while (frame - decoder.getFeedQueueStats().nDecodedFrames >= inFlight) std::this_thread::yield();
+        stream.feedFrame(decoder, frame);
+    }
+    const bool   complete = waitForDecoded(decoder, options.frames);
+    const double elapsed  = std::chrono::duration<double>(Clock::now() - start).count();
+    std::printf(
+        "%-5s throughput %8.0f frames/s (%6.2f x the codec limit)%s\n",
+        async ? "async" : "sync",
+        options.frames / elapsed,
+        options.frames / elapsed / (options.buffers * 1e6 / options.latencyUs),
+        complete ? "" : " (frames lost!)");
+}
+
+void paced(const Options& options, bool async, bool stall)
+{
+    VideoDecoder decoder(nullptr);
+    std::mutex   mutex;
+    DecodingInfo last;
+    decoder.registerOnDecodingInfoChangedCallback(
+        [&](const DecodingInfo info)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            last = info;
+        });
+    decoder.setAsyncMode(async);
+    FakeDecoderBackend::Script fakeScript = script(options);
+    if (stall) fakeScript.stalls = {{options.fps, std::chrono::milliseconds(options.stallMs)}};
+    decoder.setBackend(std::make_unique<FakeDecoderBackend>(fakeScript), 0);
+    Stream stream;
+    stream.feedParameterSets(decoder);
+    const int  nFrames = options.fps * 3;
+    const auto period  = std::chrono::nanoseconds(1000000000 / options.fps);
+    const auto start   = Clock::now();
+    for (int frame = 0; frame < nFrames; frame++)
+    {
+        std::this_thread::sleep_until(start + frame * period);
+        stream.feedFrame(decoder, frame);
+    }
+    // the last stats update comes with the first frame decoded a recalculation interval after the one before, a key
+    // frame that is not dropped
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    stream.feedFrame(decoder, 0);
+    waitForDecoded(decoder, decoder.getFeedQueueStats().nDecodedFrames + 1);
+    const auto                  feed = decoder.getFeedQueueStats();
+    std::lock_guard<std::mutex> lock(mutex);
+    std::printf(
+        "%-5s %-6s to codec %6.3f ms (waiting for input %6.3f ms) | in codec %6.3f ms | decoded %ld/%d | dropped "
+        "full %ld until key frame %ld\n",
+        async ? "async" : "sync",
+        stall ? "stall" : "paced",
+        last.avgParsingTime_ms,
+        last.avgWaitForInputBTime_ms,
+        last.avgDecodingTime_ms,
+        feed.nDecodedFrames,
+        nFrames + 1,
+        feed.nDroppedFull,
+        feed.nDroppedUntilKeyFrame);
+}
+void vr(const Options& options, bool async)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAsyncMode(async);
+    FakeDecoderBackend::Script rightScript = script(options);
+    rightScript.stalls                     = {{options.fps, std::chrono::milliseconds(options.stallMs)}};
+    auto                left               = std::make_unique<FakeDecoderBackend>(script(options));
+    auto                right              = std::make_unique<FakeDecoderBackend>(rightScript);
+    FakeDecoderBackend* leftFake           = left.get();
+    FakeDecoderBackend* rightFake          = right.get();
+    decoder.setBackend(std::move(left), 0);
+    decoder.setBackend(std::move(right), 1);
+    Stream stream;
+    stream.feedParameterSets(decoder);
+    const int  nFrames         = options.fps * 3;
+    const auto period          = std::chrono::nanoseconds(1000000000 / options.fps);
+    const auto start           = Clock::now();
+    long       leftDuringStall = 0;
+    for (int frame = 0; frame < nFrames; frame++)
+    {
+        std::this_thread::sleep_until(start + frame * period);
+        stream.feedFrame(decoder, frame);
+        if (frame == options.fps + options.stallMs * options.fps / 1000 / 2)
+        {
+            // half way through the stall of the right codec
+            leftDuringStall = leftFake->getStats().nRendered - options.fps;
+        }
+    }
+    waitForDecoded(decoder, nFrames);
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.stallMs + 100));
+    const auto skew = decoder.getOutputSkew();
+    std::printf(
+        "%-5s vr     skew avg %6.3f ms (right - left %6.3f ms) max %7.3f ms | left decoded %ld frames during the "
+        "stall | decoded %ld/%ld of %d | feeder drops %ld\n",
+        async ? "async" : "sync",
+        skew.avgAbsSkew_ms(),
+        skew.avgSkew_ms(),
+        skew.maxAbsSkewUs / 1000.0,
+        leftDuringStall,
+        leftFake->getStats().nRendered,
+        rightFake->getStats().nRendered,
+        nFrames,
+        decoder.getFeedQueueStats().nDroppedFeeder);
+}
+
+void resume(const Options& options, bool async, bool park, bool gopCache)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAsyncMode(async);
+    if (!gopCache) decoder.setGopCacheLimit(0);
+    FakeDecoderBackend::Script fakeScript = script(options);
+    fakeScript.surfaceChangeSupported     = park;
+    fakeScript.waitForKeyFrame            = true;
+    auto                first             = std::make_unique<FakeDecoderBackend>(fakeScript);
+    FakeDecoderBackend* shown             = first.get();
+    decoder.setBackend(std::move(first), 0);
+    Stream stream;
+    stream.feedParameterSets(decoder);
+    const int  nFrames  = options.fps * 3;
+    // not at a key frame, they come every 60 frames
+    const int  detachAt = options.fps + 10;
+    const int  attachAt = options.fps * 3 / 2 + 10;
+    const auto period   = std::chrono::nanoseconds(1000000000 / options.fps);
+    const auto start    = Clock::now();
+    // half way between two frames
+    const Clock::time_point attached = start + attachAt * period - period / 2;
+    Clock::time_point       firstFrame{};
+    long                    nShownBefore = 0;
+    for (int frame = 0; frame < nFrames; frame++)
+    {
+        const auto due = start + frame * period;
+        if (frame == attachAt)
+        {
+            std::this_thread::sleep_until(attached);
+            // the parked codec moves over to the surface, else the surface becomes the new codec
+            auto surface = std::make_unique<FakeDecoderBackend>(fakeScript);
+            if (!park) shown = surface.get();
+            nShownBefore = shown->getStats().nRendered;
+            decoder.attachSurface(std::move(surface), 0);
+        }
+        while (Clock::now() < due)
+        {
+            if (frame > attachAt && firstFrame == Clock::time_point{} && shown->getStats().nRendered > nShownBefore)
+            {
+                firstFrame = Clock::now();
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        stream.feedFrame(decoder, frame);
+        if (frame == detachAt) decoder.detachSurface(0);
+    }
+    std::printf(
+        "%-5s resume %-8s first frame %8.3f ms after the new surface (frame interval %6.3f ms) | created %ld\n",
+        async ? "async" : "sync",
+        park ? "parked" : (gopCache ? "recreate" : "no cache"),
+        firstFrame == Clock::time_point{} ? -1.0
+                                          : std::chrono::duration<double, std::milli>(firstFrame - attached).count(),
+        std::chrono::duration<double, std::milli>(period).count(),
+        shown->getStats().nCreated);
+}
+
+void wedge(const Options& options, bool async, bool survivesFlush)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAsyncMode(async);
+    FakeDecoderBackend::Script fakeScript = script(options);
+    // not at a key frame, they come every 60 frames
+    fakeScript.wedgeAtInput       = options.fps + 10;
+    fakeScript.wedgeSurvivesFlush = survivesFlush;
+    auto                backend   = std::make_unique<FakeDecoderBackend>(fakeScript);
+    FakeDecoderBackend* fake      = backend.get();
+    decoder.setBackend(std::move(backend), 0);
+    Stream stream;
+    stream.feedParameterSets(decoder);
+    const int  nFrames = options.fps * 3;
+    const auto period  = std::chrono::nanoseconds(1000000000 / options.fps);
+    const auto start   = Clock::now();
+    // the longest time without a frame shown
+    long              nRendered = 0;
+    Clock::time_point lastRendered{};
+    Clock::duration   frozen{};
+    for (int frame = 0; frame < nFrames; frame++)
+    {
+        const auto due = start + frame * period;
+        while (Clock::now() < due)
+        {
+            const long rendered = fake->getStats().nRendered;
+            if (rendered != nRendered)
+            {
+                if (nRendered > 0) frozen = std::max(frozen, Clock::now() - lastRendered);
+                nRendered    = rendered;
+                lastRendered = Clock::now();
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        stream.feedFrame(decoder, frame);
+    }
+    const auto feed = decoder.getFeedQueueStats();
+    std::printf(
+        "%-5s wedge  %-8s frozen %8.3f ms | watchdog recovery %8.3f ms | flushed %ld created again %ld | dropped "
+        "%ld\n",
+        async ? "async" : "sync",
+        survivesFlush ? "recreate" : "flush",
+        std::chrono::duration<double, std::milli>(frozen).count(),
+        feed.lastRecoveryUs / 1000.0,
+        feed.nWatchdogFlushes,
+        feed.nWatchdogRecreates,
+        feed.nDroppedFull + feed.nDroppedUntilKeyFrame);
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string arg = argv[i];
+        const int         val = std::max(std::atoi(argv[i + 1]), 1);
+        if (arg == "--frames")
+        {
+            options.frames = val;
+        }
+        else if (arg == "--fps")
+        {
+            options.fps = val;
+        }
+        else if (arg == "--latency-us")
+        {
+            options.latencyUs = val;
+        }
+        else if (arg == "--buffers")
+        {
+            options.buffers = val;
+        }
+        else if (arg == "--stall-ms")
+        {
+            options.stallMs = val;
+        }
+        else
+        {
+            std::fprintf(
+                stderr,
+                "Usage: %s [--frames N] [--fps N] [--latency-us N] [--buffers N] [--stall-ms N]\n",
+                argv[0]);
+            return 1;
+        }
+    }
+    std::printf(
+        "Fake codec: %ld us per frame, %d input buffers | paced at %d fps, stall %d ms\n",
+        options.latencyUs,
+        options.buffers,
+        options.fps,
+        options.stallMs);
+    for (bool async : {false, true}) throughput(options, async);
+    for (bool async : {false, true}) paced(options, async, false);
+    for (bool async : {false, true}) paced(options, async, true);
+    for (bool async : {false, true}) vr(options, async);
+    for (bool async : {false, true}) resume(options, async, true, true);
+    for (bool async : {false, true}) resume(options, async, false, true);
+    for (bool async : {false, true}) resume(options, async, false, false);
+    for (bool async : {false, true}) wedge(options, async, false);
+    for (bool async : {false, true}) wedge(options, async, true);
+    return 0;
+}
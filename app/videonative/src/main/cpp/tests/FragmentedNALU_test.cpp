@@ -0,0 +1,149 @@
+#include "NALU/FragmentedNALU.hpp"  // the class under test
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "RtpStream.h"
+
+namespace
+{
+using namespace RtpStream;
+
+// Single NAL unit, FU start / middle / end and another single NAL unit
+Packets h264Stream()
+{
+    return {
+        rtp(96, 1, false, concat({0x67}, bytes(20, 1))),
+        rtp(96, 2, false, concat({0x7C, 0x85}, bytes(1000, 2))),
+        rtp(96, 3, false, concat({0x7C, 0x05}, bytes(1000, 3))),
+        rtp(96, 4, false, concat({0x7C, 0x45}, bytes(300, 4))),
+        rtp(96, 5, false, concat({0x41}, bytes(50, 5))),
+    };
+}
+
+Packets h265Stream()
+{
+    return {
+        rtp(97, 1, false, concat({0x42, 0x01}, bytes(30, 1))),
+        rtp(97, 2, false, concat({0x62, 0x01, 0x93}, bytes(1000, 2))),
+        rtp(97, 3, false, concat({0x62, 0x01, 0x13}, bytes(1000, 3))),
+        rtp(97, 4, false, concat({0x62, 0x01, 0x53}, bytes(10, 4))),
+    };
+}
+
+// Parses from pool buffers if @param pool is set, else from raw pointers. @param nInUse buffers the parser still holds.
+std::vector<ParsedNALU> parse(const Packets& stream, std::shared_ptr<PacketPool> pool, size_t* nInUse = nullptr)
+{
+    ParseHarness harness;
+    harness.feed(stream, pool.get());
+    if (nInUse != nullptr) *nInUse = pool->getNInUse();
+    return harness.nalus;
+}
+}  // namespace
+
+TEST(FragmentedNALUTest, GathersCopiedAndReferencedSegmentsInOrder)
+{
+    auto      pool = PacketPool::create(64, 4);
+    PacketRef a    = makePacket(*pool, bytes(40, 10));
+    PacketRef b    = makePacket(*pool, bytes(40, 20));
+
+    FragmentedNALU nalu;
+    nalu.appendCopy(std::vector<uint8_t>{0, 0, 0, 1}.data(), 4);
+    nalu.appendCopy(uint8_t{0x65});
+    nalu.appendRef(a, a.data() + 2, 38);
+    nalu.appendRef(b, b.data() + 2, 20);
+    nalu.appendRef(b, b.data() + 22, 18);
+
+    std::vector<uint8_t> expected = {0, 0, 0, 1, 0x65};
+    expected.insert(expected.end(), a.data() + 2, a.data() + 40);
+    expected.insert(expected.end(), b.data() + 2, b.data() + 40);
+    ASSERT_EQ(nalu.size(), expected.size());
+    std::vector<uint8_t> gathered(nalu.size());
+    nalu.gather(gathered.data());
+    EXPECT_EQ(gathered, expected);
+    // adjacent copies and adjacent ranges of one packet are merged
+    EXPECT_EQ(nalu.getNSegments(), 3u);
+    EXPECT_EQ(nalu.getNPackets(), 2u);
+    ASSERT_EQ(nalu.headSize(), FragmentedNALU::HEAD_SIZE);
+    EXPECT_EQ(0, std::memcmp(nalu.head(), expected.data(), FragmentedNALU::HEAD_SIZE));
+
+    // a copy stays valid on its own and keeps the packets alive
+    const FragmentedNALU copy = nalu;
+    a.reset();
+    b.reset();
+    nalu.clear();
+    EXPECT_EQ(pool->getNInUse(), 2u);
+    std::fill(gathered.begin(), gathered.end(), 0);
+    copy.gather(gathered.data());
+    EXPECT_EQ(gathered, expected);
+}
+
+TEST(FragmentedNALUTest, ClearReleasesThePackets)
+{
+    auto           pool = PacketPool::create(64, 4);
+    FragmentedNALU nalu;
+    {
+        PacketRef a = makePacket(*pool, bytes(40, 10));
+        nalu.appendRef(a, a.data(), a.size());
+    }
+    EXPECT_EQ(pool->getNInUse(), 1u);
+    nalu.clear();
+    EXPECT_EQ(pool->getNInUse(), 0u);
+    EXPECT_TRUE(nalu.empty());
+    EXPECT_EQ(nalu.headSize(), 0u);
+}
+
+TEST(FragmentedNALUTest, H264ParserReferencesPacketsAndMatchesTheCopyingPath)
+{
+    auto       pool       = PacketPool::create(2048, 16);
+    const auto copied     = parse(h264Stream(), nullptr);
+    size_t     nInUse     = 0;
+    const auto referenced = parse(h264Stream(), pool, &nInUse);
+    ASSERT_EQ(copied.size(), 3u);
+    ASSERT_EQ(referenced.size(), copied.size());
+    for (size_t i = 0; i < copied.size(); i++)
+    {
+        EXPECT_TRUE(copied[i].contiguous);
+        EXPECT_FALSE(referenced[i].contiguous);
+        EXPECT_EQ(referenced[i].data, copied[i].data) << "NALU " << i;
+        EXPECT_EQ(referenced[i].keyFrame, copied[i].keyFrame);
+    }
+    // start code + reconstructed header + the three fragment payloads
+    EXPECT_EQ(copied[1].data.size(), 4u + 1 + 1000 + 1000 + 300);
+    EXPECT_TRUE(copied[1].keyFrame);
+    // the parser does not hold on to any packet once the NALUs were forwarded
+    EXPECT_EQ(nInUse, 0u);
+}
+
+TEST(FragmentedNALUTest, H265ParserReferencesPacketsAndMatchesTheCopyingPath)
+{
+    auto       pool       = PacketPool::create(2048, 16);
+    const auto copied     = parse(h265Stream(), nullptr);
+    size_t     nInUse     = 0;
+    const auto referenced = parse(h265Stream(), pool, &nInUse);
+    ASSERT_EQ(copied.size(), 2u);
+    ASSERT_EQ(referenced.size(), copied.size());
+    for (size_t i = 0; i < copied.size(); i++)
+    {
+        EXPECT_FALSE(referenced[i].contiguous);
+        EXPECT_EQ(referenced[i].data, copied[i].data) << "NALU " << i;
+    }
+    EXPECT_EQ(copied[1].data.size(), 4u + 2 + 1000 + 1000 + 10);
+    EXPECT_TRUE(referenced[1].keyFrame);
+    EXPECT_EQ(nInUse, 0u);
+}
+
+TEST(FragmentedNALUTest, IncompleteFragmentsAreDroppedAndReleased)
+{
+    auto pool   = PacketPool::create(2048, 16);
+    auto stream = h264Stream();
+    // lose the middle fragment
+    stream.erase(stream.begin() + 2);
+    size_t     nInUse     = 0;
+    const auto referenced = parse(stream, pool, &nInUse);
+    ASSERT_EQ(referenced.size(), 2u);
+    EXPECT_EQ(referenced[0].data.size(), 4u + 21);
+    EXPECT_EQ(referenced[1].data.size(), 4u + 51);
+    EXPECT_EQ(nInUse, 0u);
+}
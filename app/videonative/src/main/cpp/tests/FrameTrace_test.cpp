@@ -0,0 +1,144 @@
+#include "FrameTrace.h"  // the class under test
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FakeDecoderBackend.h"
+#include "VideoDecoder.h"
+
+using namespace std::chrono;
+using Stage = FrameTrace::Stage;
+
+namespace
+{
+bool hasFrame(const std::string& json, uint32_t frameId)
+{
+    return json.find("\"frame " + std::to_string(frameId) + "\"") != std::string::npos;
+}
+
+bool has(const std::string& json, const std::string& text) { return json.find(text) != std::string::npos; }
+}  // namespace
+
+TEST(FrameTraceTest, RecordsNothingWhenDisabled)
+{
+    FrameTrace trace;
+    const auto now = FrameTrace::Clock::now();
+    trace.record(Stage::RECEIVE, 1, now);
+    EXPECT_FALSE(hasFrame(trace.toChromeJSON(seconds(10), now), 1));
+    trace.setEnabled(true);
+    trace.record(Stage::RECEIVE, 1, now);
+    EXPECT_TRUE(hasFrame(trace.toChromeJSON(seconds(10), now), 1));
+}
+
+TEST(FrameTraceTest, ExportsTheStagesOfTheFramesInTheWindow)
+{
+    FrameTrace trace;
+    trace.setEnabled(true);
+    const auto t0 = FrameTrace::Clock::now() - seconds(20);
+    // an old frame, and one in the last 5 seconds
+    trace.record(Stage::RECEIVE, 3000, t0);
+    const auto t1 = t0 + seconds(18);
+    trace.record(Stage::RECEIVE, 6000, t1);
+    trace.record(Stage::RECEIVE, 6000, t1 + microseconds(100));
+    trace.record(Stage::REORDER_RELEASE, 6000, t1 + microseconds(500));
+    trace.record(Stage::NALU_COMPLETE, 6000, t1 + microseconds(600));
+    // two buffers, the frame is fed once the second one is queued
+    trace.record(Stage::CODEC_QUEUE, 6000, t1 + microseconds(700), 41);
+    trace.record(Stage::CODEC_QUEUE, 6000, t1 + microseconds(800), 42);
+    // the codec stages only know the presentation time
+    trace.record(Stage::CODEC_OUTPUT, 0, t1 + microseconds(3800), 42);
+    trace.record(Stage::RENDER_RELEASE, 0, t1 + microseconds(3900), 42);
+    const std::string json = trace.toChromeJSON(seconds(5), t1 + seconds(1));
+    EXPECT_FALSE(hasFrame(json, 3000));
+    ASSERT_TRUE(hasFrame(json, 6000));
+    EXPECT_TRUE(has(json, "\"total_us\":3900"));
+    for (const char* stage : {"network + reorder", "depacketize", "feed", "decode", "render release"})
+    {
+        EXPECT_TRUE(has(json, std::string("\"name\":\"") + stage + "\"")) << stage;
+    }
+    EXPECT_FALSE(hasFrame(json, 0));
+    // the whole history
+    EXPECT_TRUE(hasFrame(trace.toChromeJSON(seconds(30), t1 + seconds(1)), 3000));
+}
+
+TEST(FrameTraceTest, KeepsTheNewestEventsOfAThread)
+{
+    FrameTrace trace;
+    trace.setEnabled(true);
+    const auto     now     = FrameTrace::Clock::now();
+    const uint32_t nFrames = FrameTrace::RING_SIZE + 100;
+    for (uint32_t frameId = 1; frameId <= nFrames; frameId++) trace.record(Stage::RECEIVE, frameId, now);
+    const std::string json = trace.toChromeJSON(seconds(10), now);
+    EXPECT_FALSE(hasFrame(json, 100));
+    EXPECT_TRUE(hasFrame(json, 101));
+    EXPECT_TRUE(hasFrame(json, nFrames));
+}
+
+TEST(FrameTraceTest, ThreadsRecordWhileTheTraceIsDumped)
+{
+    FrameTrace trace;
+    trace.setEnabled(true);
+    // a thread that starts once another one exited takes over its ring, all of them fit into one
+    constexpr uint32_t       N_THREADS = 4, N_FRAMES = 800;
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < N_THREADS; thread++)
+    {
+        threads.emplace_back(
+            [&trace, thread]
+            {
+                for (uint32_t frame = 1; frame <= N_FRAMES; frame++)
+                {
+                    trace.record(Stage::RECEIVE, thread * N_FRAMES + frame, FrameTrace::Clock::now());
+                }
+            });
+    }
+    for (int i = 0; i < 20; i++) trace.toChromeJSON(seconds(10));
+    for (std::thread& thread : threads) thread.join();
+    // the rings of the exited threads are reused
+    std::thread([&trace] { trace.record(Stage::RECEIVE, 0xFFFF, FrameTrace::Clock::now()); }).join();
+    const std::string json = trace.toChromeJSON(seconds(10));
+    for (uint32_t thread = 0; thread < N_THREADS; thread++) EXPECT_TRUE(hasFrame(json, (thread + 1) * N_FRAMES));
+    EXPECT_TRUE(hasFrame(json, 0xFFFF));
+    EXPECT_EQ(trace.getNDropped(), 0);
+}
+
+TEST(FrameTraceTest, DecoderRecordsTheCodecStages)
+{
+    FrameTrace trace;
+    trace.setEnabled(true);
+    VideoDecoder decoder(nullptr);
+    decoder.setFrameTrace(&trace);
+    auto                fake    = std::make_unique<FakeDecoderBackend>(FakeDecoderBackend::Script{});
+    FakeDecoderBackend* backend = fake.get();
+    decoder.setBackend(std::move(fake), 0);
+    const std::vector<std::vector<uint8_t>> parameterSets = {
+        {0,    0,    0,    1,    0x67, 0x64, 0x00, 0x1F, 0xAC, 0xD9, 0x40, 0x50, 0x05, 0xBB, 0x01,
+         0x10, 0x00, 0x00, 0x03, 0x00, 0x10, 0x00, 0x00, 0x03, 0x03, 0xC0, 0xF1, 0x83, 0x19, 0x60},
+        {0, 0, 0, 1, 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0}};
+    for (const auto& data : parameterSets)
+    {
+        NALU nalu(data.data(), data.size());
+        nalu.setEndOfAccessUnit(true);
+        decoder.interpretNALU(nalu);
+    }
+    std::vector<uint8_t> slice = {0, 0, 0, 1, 0x65, 0x88};
+    slice.resize(200, 0x5A);
+    NALU nalu(slice.data(), slice.size());
+    nalu.setEndOfAccessUnit(true);
+    nalu.setFrameId(90000);
+    trace.record(Stage::RECEIVE, 90000, FrameTrace::Clock::now());
+    decoder.interpretNALU(nalu);
+    const auto deadline = steady_clock::now() + seconds(5);
+    while (backend->getStats().nRendered < 1 && steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    ASSERT_EQ(backend->getStats().nRendered, 1);
+    // the output buffer is released right after the render count went up
+    std::this_thread::sleep_for(milliseconds(50));
+    const std::string json = trace.toChromeJSON(seconds(10));
+    ASSERT_TRUE(hasFrame(json, 90000));
+    EXPECT_TRUE(has(json, "\"name\":\"decode\""));
+}
@@ -0,0 +1,84 @@
+#include "GopCache.h"  // the class under test
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+const std::vector<uint8_t> SPS      = {0, 0, 0, 1, 0x67, 0x64, 0x00, 0x1F, 0xAC, 0xD9};
+const std::vector<uint8_t> SPS_1080 = {0, 0, 0, 1, 0x67, 0x64, 0x00, 0x28, 0xAC, 0xD9};
+const std::vector<uint8_t> IDR      = {0, 0, 0, 1, 0x65, 0x88, 0x5A, 0x5A, 0x5A, 0x5A};
+const std::vector<uint8_t> IDR2     = {0, 0, 0, 1, 0x65, 0x40, 0x5A, 0x5A, 0x5A, 0x5A};
+const std::vector<uint8_t> P        = {0, 0, 0, 1, 0x41, 0x9A, 0x5A, 0x5A, 0x5A, 0x5A};
+
+GopCache::Entry add(GopCache& cache, const std::vector<uint8_t>& data)
+{
+    return cache.add(NALU(data.data(), data.size()));
+}
+}  // namespace
+
+TEST(GopCacheTest, HoldsTheNALUsFromTheLastKeyFrameOn)
+{
+    GopCache cache;
+    EXPECT_EQ(add(cache, P), nullptr);
+    EXPECT_EQ(add(cache, SPS), nullptr);
+    EXPECT_NE(add(cache, IDR), nullptr);
+    // the second slice of the key frame does not start a GOP
+    add(cache, IDR2);
+    for (int i = 0; i < 3; i++) add(cache, P);
+    ASSERT_EQ(cache.entries().size(), 5u);
+    EXPECT_EQ(cache.getBytes(), 5 * IDR.size());
+    EXPECT_TRUE(cache.entries()[0]->get_nal().is_keyframe());
+    // the same SPS again is part of the GOP, the next key frame starts a new one
+    add(cache, SPS);
+    EXPECT_EQ(cache.entries().size(), 6u);
+    add(cache, IDR);
+    add(cache, P);
+    EXPECT_EQ(cache.entries().size(), 2u);
+}
+
+TEST(GopCacheTest, EntriesAreSharedWithTheOtherConsumers)
+{
+    GopCache cache;
+    add(cache, IDR);
+    const GopCache::Entry p = add(cache, P);
+    EXPECT_EQ(p, cache.entries()[1]);
+    // a consumer keeps its NALU when the cache moves on
+    add(cache, IDR);
+    EXPECT_EQ(p.use_count(), 1);
+    EXPECT_EQ(p->get_nal().getSize(), P.size());
+}
+
+TEST(GopCacheTest, GOPOverTheLimitIsNotCached)
+{
+    GopCache cache;
+    cache.setLimit(3 * IDR.size());
+    add(cache, IDR);
+    add(cache, P);
+    EXPECT_NE(add(cache, P), nullptr);
+    EXPECT_EQ(add(cache, P), nullptr);
+    EXPECT_TRUE(cache.entries().empty());
+    EXPECT_EQ(cache.getBytes(), 0u);
+    // not even the rest of it
+    EXPECT_EQ(add(cache, P), nullptr);
+    EXPECT_NE(add(cache, IDR), nullptr);
+    cache.setLimit(0);
+    EXPECT_EQ(add(cache, P), nullptr);
+    EXPECT_TRUE(cache.entries().empty());
+}
+
+TEST(GopCacheTest, NewSPSOrAMissingNALUEmptiesIt)
+{
+    GopCache cache;
+    add(cache, SPS);
+    add(cache, IDR);
+    add(cache, P);
+    add(cache, SPS_1080);
+    EXPECT_TRUE(cache.entries().empty());
+    EXPECT_EQ(add(cache, P), nullptr);
+    add(cache, IDR);
+    add(cache, P);
+    cache.invalidate();
+    EXPECT_TRUE(cache.entries().empty());
+    EXPECT_EQ(add(cache, P), nullptr);
+}
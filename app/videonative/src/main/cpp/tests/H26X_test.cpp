@@ -0,0 +1,261 @@
+#include "NALU/H26X.hpp"  // the parsers under test
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "NALU/NALU.hpp"
+
+namespace
+{
+// x264, 1280x720 High profile level 3.1 (with VUI)
+const std::vector<uint8_t> H264_SPS_720P = {0,    0,    0,    1,    0x67, 0x64, 0x00, 0x1F, 0xAC, 0xD9,
+                                            0x40, 0x50, 0x05, 0xBB, 0x01, 0x10, 0x00, 0x00, 0x03, 0x00,
+                                            0x10, 0x00, 0x00, 0x03, 0x03, 0xC0, 0xF1, 0x83, 0x19, 0x60};
+// x264, 1920x1080 (1088 coded, cropped) High profile level 4.0
+const std::vector<uint8_t> H264_SPS_1080P = {0,    0,    0,    1,    0x67, 0x64, 0x00, 0x28, 0xAC, 0xD9,
+                                             0x40, 0x78, 0x02, 0x27, 0xE5, 0x84, 0x00, 0x00, 0x03, 0x00,
+                                             0x04, 0x00, 0x00, 0x03, 0x00, 0xF0, 0x3C, 0x60, 0xC6, 0x58};
+// x265, 1280x720 Main profile level 3.1
+const std::vector<uint8_t> H265_SPS_720P = {
+    0,    0,    0,    1,    0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00,
+    0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5D, 0xA0, 0x02, 0x80, 0x80, 0x2D, 0x16, 0x59, 0x59,
+    0xA4, 0x93, 0x2B, 0xC0, 0x5A, 0x70, 0x80, 0x00, 0x01, 0xF4, 0x80, 0x00, 0x3A, 0x98, 0x04};
+const std::vector<uint8_t> H265_VPS = {0,    0,    0,    1,    0x40, 0x01, 0x0C, 0x01, 0xFF, 0xFF,
+                                       0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03,
+                                       0x00, 0x00, 0x03, 0x00, 0x5D, 0x95, 0x98, 0x09};
+}  // namespace
+
+TEST(BitReaderTest, ExpGolomb)
+{
+    // 1 | 010 | 011 | 00100 | 00101 -> ue 0, 1, 2, 3 then se(4) = -2
+    const std::vector<uint8_t> data = {0xA6, 0x42, 0x80};
+    BitReader                  b(data);
+    EXPECT_EQ(b.read_ue(), 0u);
+    EXPECT_EQ(b.read_ue(), 1u);
+    EXPECT_EQ(b.read_ue(), 2u);
+    EXPECT_EQ(b.read_ue(), 3u);
+    EXPECT_EQ(b.read_se(), -2);
+    EXPECT_FALSE(b.overrun());
+    EXPECT_EQ(b.position(), 17u);
+    b.skip_bits(b.bits_left());
+    EXPECT_EQ(b.read_bits(3), 0u);
+    EXPECT_TRUE(b.overrun());
+}
+
+TEST(RBSPHelperTest, EscapeRoundTrip)
+{
+    const std::vector<uint8_t> rbsp    = {0x00, 0x00, 0x01, 0x42, 0x00, 0x00, 0x00, 0x00, 0x03};
+    const auto                 escaped = RBSPHelper::escapeRbsp(rbsp);
+    EXPECT_EQ(escaped, (std::vector<uint8_t>{0x00, 0x00, 0x03, 0x01, 0x42, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x03}));
+    EXPECT_EQ(RBSPHelper::unescapeRbsp(escaped), rbsp);
+}
+
+TEST(H264SPSTest, Parses720p)
+{
+    const H264::SPS sps(H264_SPS_720P.data(), H264_SPS_720P.size());
+    ASSERT_TRUE(sps.valid);
+    EXPECT_EQ(sps.profile_idc, 100u);
+    EXPECT_EQ(sps.level_idc, 31u);
+    EXPECT_EQ(sps.getWidthHeightPx(), (std::array<int, 2>{1280, 720}));
+    ASSERT_TRUE(sps.vui_parameters_present_flag);
+    ASSERT_TRUE(sps.bitstream_restriction_flag);
+    EXPECT_EQ(sps.max_num_reorder_frames, 2u);
+    EXPECT_EQ(sps.max_dec_frame_buffering, 4u);
+
+    const auto format = sps.getVideoFormat();
+    EXPECT_EQ(format.profile, 100);
+    EXPECT_EQ(format.level, 31);
+    EXPECT_EQ(format.chromaFormat, 1);
+    EXPECT_EQ(format.bitDepth, 8);
+    EXPECT_EQ(format.maxInputSize(), 1280 * 720 * 3 / 2 / 2);
+}
+
+TEST(H264SPSTest, CroppingAndThreeBytePrefix)
+{
+    std::vector<uint8_t> data(H264_SPS_1080P.begin() + 1, H264_SPS_1080P.end());
+    const H264::SPS      sps(data.data(), data.size());
+    ASSERT_TRUE(sps.valid);
+    EXPECT_EQ(sps.level_idc, 40u);
+    EXPECT_EQ(sps.getWidthHeightPx(), (std::array<int, 2>{1920, 1080}));
+}
+
+TEST(H264SPSTest, TruncatedIsInvalid)
+{
+    const H264::SPS sps(H264_SPS_720P.data(), 10);
+    EXPECT_FALSE(sps.valid);
+    // not a SPS
+    const std::vector<uint8_t> pps = {0, 0, 0, 1, 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0};
+    EXPECT_FALSE(H264::SPS(pps.data(), pps.size()).valid);
+}
+
+TEST(H265SPSTest, Parses720p)
+{
+    const H265::SPS sps(H265_SPS_720P.data(), H265_SPS_720P.size());
+    ASSERT_TRUE(sps.valid);
+    EXPECT_EQ(sps.getWidthHeightPx(), (std::array<int, 2>{1280, 720}));
+    EXPECT_EQ(sps.sps_max_dec_pic_buffering_minus1, 4u);
+    EXPECT_EQ(sps.sps_max_num_reorder_pics, 2u);
+
+    const auto format = sps.getVideoFormat();
+    EXPECT_EQ(format.profile, 1);
+    EXPECT_EQ(format.level, 93);
+    EXPECT_FALSE(format.highTier);
+
+    const H265::VPS vps(H265_VPS.data(), H265_VPS.size());
+    ASSERT_TRUE(vps.valid);
+    EXPECT_EQ(vps.profile_tier_level.general_profile_idc, 1u);
+    EXPECT_EQ(vps.profile_tier_level.general_level_idc, 93u);
+
+    EXPECT_FALSE(H265::SPS(H265_SPS_720P.data(), 20).valid);
+}
+
+TEST(BitWriterTest, RoundTrip)
+{
+    BitWriter w;
+    w.write_bits(5, 3);
+    w.write_ue(0);
+    w.write_ue(7);
+    w.write_ue(0xFFFFFFFE);
+    w.write_flag(true);
+    w.write_trailing_bits();
+    EXPECT_EQ(w.position() % 8, 0u);
+
+    BitReader b(w.data());
+    EXPECT_EQ(b.read_bits(3), 5u);
+    EXPECT_EQ(b.read_ue(), 0u);
+    EXPECT_EQ(b.read_ue(), 7u);
+    EXPECT_EQ(b.read_ue(), 0xFFFFFFFEu);
+    EXPECT_TRUE(b.read_flag());
+    EXPECT_EQ(RBSPHelper::stopBitPosition(w.data()), b.position());
+}
+
+TEST(H264SPSTest, LowLatencyRewriteOfRestriction)
+{
+    const H264::SPS original(H264_SPS_720P.data(), H264_SPS_720P.size());
+    ASSERT_FALSE(original.isLowLatency());
+    const auto      rewritten = original.asLowLatencyNALU();
+    const H264::SPS sps(rewritten.data(), rewritten.size());
+    ASSERT_TRUE(sps.valid);
+    EXPECT_TRUE(sps.isLowLatency());
+    EXPECT_EQ(sps.max_num_reorder_frames, 0u);
+    EXPECT_EQ(sps.max_dec_frame_buffering, original.max_num_ref_frames);
+    EXPECT_EQ(sps.getVideoFormat(), original.getVideoFormat());
+    EXPECT_EQ(sps.log2_max_mv_length_horizontal, original.log2_max_mv_length_horizontal);
+    // the VUI in front of the bitstream restriction is unchanged
+    EXPECT_EQ(sps.bitstream_restriction_position, original.bitstream_restriction_position);
+    EXPECT_TRUE(std::equal(
+        rewritten.begin(), rewritten.begin() + 4 + 1 + (long) original.bitstream_restriction_position / 8,
+        H264_SPS_720P.begin()));
+}
+
+TEST(H264SPSTest, LowLatencyRewriteAddsVUI)
+{
+    // baseline 1280x720 SPS without VUI
+    BitWriter w;
+    w.write_bits(66, 8);  // profile_idc
+    w.write_bits(0, 8);   // constraint flags
+    w.write_bits(31, 8);  // level_idc
+    w.write_ue(0);        // seq_parameter_set_id
+    w.write_ue(0);        // log2_max_frame_num_minus4
+    w.write_ue(2);        // pic_order_cnt_type
+    w.write_ue(1);        // max_num_ref_frames
+    w.write_flag(false);  // gaps_in_frame_num_value_allowed_flag
+    w.write_ue(79);       // pic_width_in_mbs_minus1
+    w.write_ue(44);       // pic_height_in_map_units_minus1
+    w.write_flag(true);   // frame_mbs_only_flag
+    w.write_flag(true);   // direct_8x8_inference_flag
+    w.write_flag(false);  // frame_cropping_flag
+    w.write_flag(false);  // vui_parameters_present_flag
+    w.write_trailing_bits();
+    const uint8_t   header = 0x67;
+    const auto      nalu   = RBSPHelper::asNALU(&header, 1, w.data());
+    const H264::SPS original(nalu.data(), nalu.size());
+    ASSERT_TRUE(original.valid);
+    EXPECT_FALSE(original.vui_parameters_present_flag);
+    EXPECT_FALSE(original.isLowLatency());
+
+    const auto      rewritten = original.asLowLatencyNALU();
+    const H264::SPS sps(rewritten.data(), rewritten.size());
+    ASSERT_TRUE(sps.valid);
+    EXPECT_TRUE(sps.vui_parameters_present_flag);
+    EXPECT_TRUE(sps.isLowLatency());
+    EXPECT_EQ(sps.max_dec_frame_buffering, 1u);
+    EXPECT_EQ(sps.getWidthHeightPx(), (std::array<int, 2>{1280, 720}));
+    EXPECT_EQ(RBSPHelper::stopBitPosition(sps.rbsp), sps.bitstream_restriction_position + 1 + 1 + 3 + 3 + 9 + 9 + 1 + 3);
+}
+
+TEST(H265SPSTest, LowLatencyRewrite)
+{
+    const H265::SPS original(H265_SPS_720P.data(), H265_SPS_720P.size());
+    ASSERT_FALSE(original.isLowLatency());
+    const auto      rewritten = original.asLowLatencyNALU();
+    const H265::SPS sps(rewritten.data(), rewritten.size());
+    ASSERT_TRUE(sps.valid);
+    EXPECT_TRUE(sps.isLowLatency());
+    EXPECT_EQ(sps.sps_max_num_reorder_pics, 0u);
+    EXPECT_EQ(sps.sps_max_dec_pic_buffering_minus1, original.sps_max_dec_pic_buffering_minus1);
+    EXPECT_EQ(sps.sps_max_latency_increase_plus1, original.sps_max_latency_increase_plus1);
+    EXPECT_EQ(sps.getVideoFormat(), original.getVideoFormat());
+    EXPECT_EQ(rewritten[4], H265_SPS_720P[4]);
+    EXPECT_EQ(rewritten[5], H265_SPS_720P[5]);
+
+    // the rest of the SPS is copied, the reorder ue(2) -> ue(0) makes the ordering info 2 bits shorter
+    const std::size_t originalRest = RBSPHelper::stopBitPosition(original.rbsp) - original.ordering_info_end_position;
+    const std::size_t rest         = RBSPHelper::stopBitPosition(sps.rbsp) - sps.ordering_info_end_position;
+    EXPECT_EQ(rest, originalRest);
+    EXPECT_EQ(sps.ordering_info_end_position, original.ordering_info_end_position - 2);
+
+    // through NALU, empty once low latency
+    const NALU nalu(H265_SPS_720P.data(), H265_SPS_720P.size(), true);
+    EXPECT_EQ(nalu.getLowLatencySPS(), rewritten);
+    const NALU lowLatency(rewritten.data(), rewritten.size(), true);
+    EXPECT_TRUE(lowLatency.getLowLatencySPS().empty());
+}
+
+TEST(NALUTest, VideoFormatOfSPS)
+{
+    const NALU h264(H264_SPS_1080P.data(), H264_SPS_1080P.size());
+    const auto format = h264.getVideoFormatSPS();
+    ASSERT_TRUE(format.has_value());
+    EXPECT_EQ(format->width, 1920);
+    EXPECT_EQ(format->height, 1080);
+    EXPECT_EQ(h264.getVideoWidthHeightSPS(), (std::array<int, 2>{1920, 1080}));
+
+    const NALU h265(H265_SPS_720P.data(), H265_SPS_720P.size(), true);
+    EXPECT_EQ(h265.getVideoWidthHeightSPS(), (std::array<int, 2>{1280, 720}));
+    EXPECT_NE(*format, *h265.getVideoFormatSPS());
+}
+
+TEST(NALUTest, KeyFramesAndNonReferencePictures)
+{
+    // H.264: nal_ref_idc and the IDR type, first_mb_in_slice 0
+    const std::vector<uint8_t> idr = {0, 0, 0, 1, 0x65, 0x88};
+    const std::vector<uint8_t> p   = {0, 0, 0, 1, 0x41, 0x9A};
+    const std::vector<uint8_t> b   = {0, 0, 0, 1, 0x01, 0x9E};
+    EXPECT_TRUE(NALU(idr.data(), idr.size()).is_keyframe());
+    EXPECT_FALSE(NALU(idr.data(), idr.size()).is_non_reference());
+    EXPECT_TRUE(NALU(p.data(), p.size()).is_frame_but_not_keyframe());
+    EXPECT_FALSE(NALU(p.data(), p.size()).is_non_reference());
+    EXPECT_TRUE(NALU(b.data(), b.size()).is_non_reference());
+    EXPECT_FALSE(NALU(H264_SPS_720P.data(), H264_SPS_720P.size()).is_non_reference());
+    // H.265: nal_unit_type in bits 1..6 of the first header byte
+    const auto h265 = [](int type) { return std::vector<uint8_t>{0, 0, 0, 1, (uint8_t) (type << 1), 0x01, 0x80}; };
+    for (int type : {16, 17, 18, 19, 20, 21})
+    {
+        const auto data = h265(type);
+        const NALU nalu(data.data(), data.size(), true);
+        EXPECT_TRUE(nalu.is_keyframe()) << type;
+        EXPECT_FALSE(nalu.is_frame_but_not_keyframe()) << type;
+        EXPECT_FALSE(nalu.is_non_reference()) << type;
+    }
+    for (int type = 0; type <= 9; type++)
+    {
+        const auto data = h265(type);
+        const NALU nalu(data.data(), data.size(), true);
+        EXPECT_FALSE(nalu.is_keyframe()) << type;
+        EXPECT_TRUE(nalu.is_frame_but_not_keyframe()) << type;
+        // TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N
+        EXPECT_EQ(nalu.is_non_reference(), type % 2 == 0) << type;
+    }
+    EXPECT_FALSE(NALU(H265_VPS.data(), H265_VPS.size(), true).is_frame_but_not_keyframe());
+}
@@ -0,0 +1,95 @@
+#include "IngestReactor.h"  // the class under test
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "RtpDuplicateFilter.h"
+
+// ---------- IngestReactor ---------------------------------------------------
+TEST(IngestReactorTest, DeliversEverySourceOnOneThread)
+{
+    int a[2], b[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, a), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, b), 0);
+
+    std::mutex                       mutex;
+    std::condition_variable          cv;
+    std::vector<std::pair<int, int>> received;  // source, first byte
+    std::vector<std::thread::id>     threads;
+    IngestReactor                    reactor(
+        nullptr,
+        "test",
+        0,
+        [&](size_t source, const DatagramBatch& batch)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const Datagram& d : batch) received.emplace_back((int) source, d.data[0]);
+            threads.push_back(std::this_thread::get_id());
+            cv.notify_all();
+        });
+    ASSERT_EQ(reactor.addSource("a", a[0]), 0);
+    ASSERT_EQ(reactor.addSource("b", b[0]), 1);
+    reactor.start();
+
+    for (uint8_t i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(send(i % 2 ? b[1] : a[1], &i, 1, 0), 1);
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&] { return received.size() == 10; }));
+    }
+    reactor.stop();
+
+    for (const auto& [source, value] : received) EXPECT_EQ(source, value % 2);
+    for (const auto& id : threads) EXPECT_EQ(id, threads[0]);
+    EXPECT_EQ(reactor.getNReceivedBytes(0), 5);
+    EXPECT_EQ(reactor.getNReceivedBytes(1), 5);
+    EXPECT_EQ(reactor.getNReceivedBytes(), 10);
+    close(a[1]);
+    close(b[1]);
+}
+
+TEST(IngestReactorTest, StopsWithoutTraffic)
+{
+    int a[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, a), 0);
+    IngestReactor reactor(nullptr, "test", 0, [](size_t, const DatagramBatch&) {});
+    ASSERT_EQ(reactor.addSource("a", a[0]), 0);
+    EXPECT_EQ(reactor.addSource("invalid", -1), -1);
+    reactor.start();
+    reactor.stop();
+    close(a[1]);
+}
+
+// ---------- RtpDuplicateFilter ----------------------------------------------
+TEST(RtpDuplicateFilterTest, DropsRepeatsAcrossWrapAround)
+{
+    RtpDuplicateFilter filter;
+    for (uint16_t seq = 65530; seq != 10; seq++)
+    {
+        EXPECT_FALSE(filter.isDuplicate(seq));
+        // the same packet from the second input
+        EXPECT_TRUE(filter.isDuplicate(seq));
+    }
+    EXPECT_EQ(filter.getNDuplicates(), 16);
+}
+
+TEST(RtpDuplicateFilterTest, ReorderedPacketsAreNotDuplicates)
+{
+    RtpDuplicateFilter filter;
+    EXPECT_FALSE(filter.isDuplicate(100));
+    EXPECT_FALSE(filter.isDuplicate(103));
+    EXPECT_FALSE(filter.isDuplicate(101));
+    EXPECT_FALSE(filter.isDuplicate(102));
+    EXPECT_TRUE(filter.isDuplicate(101));
+    // a large jump forgets the old window
+    EXPECT_FALSE(filter.isDuplicate(20000));
+    EXPECT_FALSE(filter.isDuplicate(19999));
+    EXPECT_FALSE(filter.isDuplicate(102));
+}
@@ -0,0 +1,83 @@
+#include "KeyFrameRequester.h"  // the class under test
+#include <gtest/gtest.h>
+#include <chrono>
+#include <vector>
+#include "parser/StaticH26XParser.h"
+
+using namespace std::chrono;
+
+namespace
+{
+void countRequest(void* context)
+{
+    (*static_cast<int*>(context))++;
+}
+
+const KeyFrameRequester::Clock::time_point T0 = KeyFrameRequester::Clock::time_point(seconds(100));
+}  // namespace
+
+TEST(KeyFrameRequesterTest, NoRequestWithoutTarget)
+{
+    KeyFrameRequester requester;
+    EXPECT_FALSE(requester.hasTarget());
+    EXPECT_FALSE(requester.onGap(T0));
+    EXPECT_EQ(requester.getNGaps(), 1);
+    EXPECT_EQ(requester.getNRequests(), 0);
+}
+
+TEST(KeyFrameRequesterTest, RequestsAreRateLimited)
+{
+    int               nRequests = 0;
+    KeyFrameRequester requester(milliseconds(200));
+    requester.setTarget(countRequest, &nRequests);
+    EXPECT_TRUE(requester.onGap(T0));
+    EXPECT_FALSE(requester.onGap(T0 + milliseconds(50)));
+    EXPECT_FALSE(requester.onGap(T0 + milliseconds(199)));
+    EXPECT_TRUE(requester.onGap(T0 + milliseconds(200)));
+    EXPECT_EQ(nRequests, 2);
+    EXPECT_EQ(requester.getNRequests(), 2);
+    EXPECT_EQ(requester.getNRateLimited(), 2);
+    requester.setTarget(nullptr, nullptr);
+    EXPECT_FALSE(requester.onGap(T0 + seconds(1)));
+    EXPECT_EQ(nRequests, 2);
+}
+
+TEST(KeyFrameRequesterTest, RecoveryIsMeasuredFromTheFirstGap)
+{
+    KeyFrameRequester requester;
+    // a key frame without a gap before it recovers nothing
+    requester.onKeyFrame(T0);
+    EXPECT_EQ(requester.getNRecoveries(), 0);
+    requester.onGap(T0 + milliseconds(10));
+    requester.onGap(T0 + milliseconds(30));
+    requester.onKeyFrame(T0 + milliseconds(70));
+    requester.onKeyFrame(T0 + milliseconds(80));
+    requester.onGap(T0 + milliseconds(100));
+    requester.onKeyFrame(T0 + milliseconds(140));
+    EXPECT_EQ(requester.getNRecoveries(), 2);
+    EXPECT_EQ(requester.getRecoverySumUs(), 100000);
+}
+
+TEST(KeyFrameRequesterTest, ParserGapsTriggerOneRequestPerPacket)
+{
+    struct Ignore
+    {
+        void operator()(const NALU&) const {}
+    };
+    int               nRequests = 0;
+    KeyFrameRequester requester(milliseconds(0));
+    requester.setTarget(countRequest, &nRequests);
+    StaticH26XParser<false, Ignore> parser{Ignore{}};
+    // single NAL unit packets, 3 and 6 + 7 are lost
+    for (uint16_t seq : {1, 2, 4, 5, 8, 9})
+    {
+        const uint8_t packet[] = {0x80, 96, 0, (uint8_t) seq, 0, 0, 0, 1, 0, 0, 0, 2, 0x41, 0x88, 1, 2};
+        const int     nGaps    = parser.nGaps();
+        parser.parse(packet, sizeof(packet));
+        if (parser.nGaps() != nGaps)
+        {
+            requester.onGap(T0 + milliseconds(seq));
+        }
+    }
+    EXPECT_EQ(nRequests, 2);
+}
@@ -0,0 +1,123 @@
+#include "Metrics.h"  // the class under test
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace
+{
+// What the endpoint on @param port answers, empty if it could not be reached
+std::string fetch(uint16_t port)
+{
+    const int   fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::string response;
+    if (connect(fd, (sockaddr*) &address, sizeof(address)) == 0)
+    {
+        const std::string request = "GET /metrics HTTP/1.0\r\n\r\n";
+        send(fd, request.data(), request.size(), 0);
+        char    buffer[4096];
+        ssize_t n;
+        while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) response.append(buffer, (size_t) n);
+    }
+    close(fd);
+    return response;
+}
+}  // namespace
+
+TEST(MetricsTest, CountersAreSummedOverTheThreads)
+{
+    Metrics                  metrics;
+    Metrics::Counter&        counter = metrics.counter("packets");
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 16; i++)
+    {
+        threads.emplace_back(
+            [&counter]
+            {
+                for (int n = 0; n < 10000; n++) counter.add();
+            });
+    }
+    for (std::thread& thread : threads) thread.join();
+    EXPECT_EQ(counter.value(), 160000);
+    // looked up by name, the same one
+    EXPECT_EQ(&metrics.counter("packets"), &counter);
+}
+
+TEST(MetricsTest, HistogramBucketsAreLogLinear)
+{
+    using Histogram = Metrics::Histogram;
+    for (uint64_t value = 0; value < 100000; value++)
+    {
+        const size_t bucket = Histogram::bucketOf(value);
+        ASSERT_LE(value, Histogram::upperBoundOf(bucket));
+        if (bucket > 0)
+        {
+            ASSERT_GT(value, Histogram::upperBoundOf(bucket - 1));
+        }
+        // at most 1 / 2^SUB_BITS too high
+        ASSERT_LE(Histogram::upperBoundOf(bucket) - value, value >> Histogram::SUB_BITS);
+    }
+    EXPECT_EQ(Histogram::bucketOf(UINT64_MAX), Histogram::N_BUCKETS - 1);
+}
+
+TEST(MetricsTest, HistogramPercentiles)
+{
+    Metrics             metrics;
+    Metrics::Histogram& histogram = metrics.histogram("latency_us");
+    EXPECT_EQ(histogram.summary().count, 0);
+    EXPECT_EQ(histogram.summary().p99, 0);
+    // 1..1000 us, and one outlier
+    for (int64_t value = 1; value <= 1000; value++) histogram.record(value);
+    histogram.record(milliseconds(50));
+    const auto summary = histogram.summary();
+    EXPECT_EQ(summary.count, 1001);
+    EXPECT_EQ(summary.sum, 500500 + 50000);
+    EXPECT_EQ(summary.max, 50000);
+    EXPECT_GE(summary.p50, 500);
+    EXPECT_LE(summary.p50, 500 + 500 / 8);
+    EXPECT_GE(summary.p95, 950);
+    EXPECT_LE(summary.p95, 950 + 950 / 8);
+    EXPECT_GE(summary.p99, 990);
+    EXPECT_LE(summary.p99, 1000 + 1000 / 8);
+}
+
+TEST(MetricsTest, SnapshotAsText)
+{
+    Metrics metrics;
+    metrics.counter("rtp_gaps").add(3);
+    metrics.gauge("queue_depth").set(7);
+    metrics.histogram("decode_us").record(2000);
+    const Metrics::Snapshot snapshot = metrics.snapshot();
+    ASSERT_EQ(snapshot.counters.size(), 1u);
+    EXPECT_EQ(snapshot.counters[0].second, 3);
+    const std::string text = snapshot.toText();
+    EXPECT_NE(text.find("# TYPE rtp_gaps counter\nrtp_gaps 3\n"), std::string::npos);
+    EXPECT_NE(text.find("queue_depth 7\n"), std::string::npos);
+    EXPECT_NE(text.find("decode_us_count 1\n"), std::string::npos);
+    EXPECT_NE(text.find("decode_us_max 2000\n"), std::string::npos);
+}
+
+TEST(MetricsTest, EndpointServesTheSnapshot)
+{
+    Metrics metrics;
+    metrics.counter("rtp_duplicates").add(42);
+    MetricsEndpoint endpoint(metrics, 0);
+    ASSERT_TRUE(endpoint.isListening());
+    ASSERT_NE(endpoint.getPort(), 0);
+    const std::string response = fetch(endpoint.getPort());
+    EXPECT_EQ(response.rfind("HTTP/1.0 200 OK", 0), 0u);
+    EXPECT_NE(response.find("rtp_duplicates 42\n"), std::string::npos);
+    // every request gets the current values
+    metrics.counter("rtp_duplicates").add();
+    EXPECT_NE(fetch(endpoint.getPort()).find("rtp_duplicates 43\n"), std::string::npos);
+}
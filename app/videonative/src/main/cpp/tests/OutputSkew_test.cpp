@@ -0,0 +1,51 @@
+#include "OutputSkew.h"  // the class under test
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace std::chrono;
+
+TEST(OutputSkewTest, PairsTheOutputsOfTheSameNALU)
+{
+    OutputSkew skew;
+    const auto t0 = OutputSkew::Clock::now();
+    // the codecs label their buffers with their own presentation times
+    for (uint64_t seq = 0; seq < 3; seq++)
+    {
+        skew.onQueued(0, 1000 + (int64_t) seq, seq);
+        skew.onQueued(1, 2000 + (int64_t) seq, seq);
+    }
+    skew.onOutput(0, 1000, t0);
+    skew.onOutput(1, 2000, t0 + milliseconds(4));
+    // right first
+    skew.onOutput(1, 2001, t0 + milliseconds(10));
+    skew.onOutput(0, 1001, t0 + milliseconds(12));
+    const auto stats = skew.getStats();
+    EXPECT_EQ(stats.nPairs, 2);
+    EXPECT_FLOAT_EQ(stats.avgAbsSkew_ms(), 3.0f);
+    EXPECT_FLOAT_EQ(stats.avgSkew_ms(), 1.0f);
+    EXPECT_EQ(stats.maxAbsSkewUs, 4000);
+}
+
+TEST(OutputSkewTest, SkipsFramesOnlyOneCodecOutput)
+{
+    OutputSkew skew;
+    const auto t0 = OutputSkew::Clock::now();
+    skew.onQueued(0, 10, 0);
+    skew.onQueued(0, 11, 1);
+    skew.onQueued(0, 12, 2);
+    // the right codec never got NALU 1
+    skew.onQueued(1, 20, 0);
+    skew.onQueued(1, 22, 2);
+    skew.onOutput(0, 10, t0);
+    // buffer 11 was dropped by the left codec
+    skew.onOutput(0, 12, t0 + milliseconds(2));
+    skew.onOutput(1, 20, t0 + milliseconds(1));
+    skew.onOutput(1, 22, t0 + milliseconds(3));
+    // unknown presentation time
+    skew.onOutput(1, 99, t0 + milliseconds(5));
+    const auto stats = skew.getStats();
+    EXPECT_EQ(stats.nPairs, 2);
+    EXPECT_FLOAT_EQ(stats.avgSkew_ms(), 1.0f);
+    skew.reset();
+    EXPECT_EQ(skew.getStats().nPairs, 0);
+}
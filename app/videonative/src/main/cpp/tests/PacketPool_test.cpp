@@ -0,0 +1,110 @@
+#include "PacketPool.h"  // the class under test
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdint>
+#include <vector>
+#include "BufferedPacketQueue.h"
+#include "ReceiveEngine.h"
+
+TEST(PacketPoolTest, ReusesBuffersAndTracksHighWaterMark)
+{
+    auto pool = PacketPool::create(64, 4);
+    {
+        std::vector<PacketRef> held;
+        for (int i = 0; i < 3; i++) held.push_back(pool->acquire());
+        EXPECT_EQ(pool->getNInUse(), 3u);
+        EXPECT_TRUE(held[0].isPooled());
+        EXPECT_EQ(held[0].capacity(), 64u);
+    }
+    EXPECT_EQ(pool->getNInUse(), 0u);
+    EXPECT_EQ(pool->getHighWaterMark(), 3u);
+    EXPECT_EQ(pool->getNExhausted(), 0);
+}
+
+TEST(PacketPoolTest, CopiesShareTheBuffer)
+{
+    auto      pool = PacketPool::create(64, 1);
+    PacketRef a    = pool->acquire();
+    a.data()[0]    = 42;
+    a.setSize(1);
+    PacketRef b = a;
+    a.reset();
+    EXPECT_EQ(pool->getNInUse(), 1u);
+    EXPECT_EQ(b.data()[0], 42);
+    EXPECT_EQ(b.size(), 1u);
+    b.reset();
+    EXPECT_EQ(pool->getNInUse(), 0u);
+}
+
+TEST(PacketPoolTest, FallsBackToHeapWhenExhausted)
+{
+    auto      pool = PacketPool::create(64, 1);
+    PacketRef a    = pool->acquire();
+    PacketRef b    = pool->acquire();
+    ASSERT_TRUE(b);
+    EXPECT_FALSE(b.isPooled());
+    EXPECT_EQ(b.capacity(), 64u);
+    EXPECT_EQ(pool->getNExhausted(), 1);
+}
+
+TEST(PacketPoolTest, OutlivesItsLastOwner)
+{
+    auto      pool = PacketPool::create(64, 2);
+    PacketRef a    = pool->acquire();
+    pool.reset();
+    a.data()[63] = 1;  // still valid, the pool keeps itself alive
+    a.reset();
+}
+
+// The reorder queue keeps out of order packets by handle, delivering the original buffer
+TEST(PacketPoolTest, ReorderQueueMovesHandles)
+{
+    auto                        pool = PacketPool::create(16, 8);
+    BufferedPacketQueue         q;
+    std::vector<const uint8_t*> deliveredPtrs;
+    std::vector<uint8_t>        deliveredSeqs;
+    auto                        cb = [&](const uint8_t* data, std::size_t)
+    {
+        deliveredPtrs.push_back(data);
+        deliveredSeqs.push_back(data[0]);
+    };
+
+    std::vector<const uint8_t*> ptrs;
+    for (uint8_t seq : {0, 2, 1})
+    {
+        PacketRef p = pool->acquire();
+        p.data()[0] = seq;
+        p.setSize(1);
+        ptrs.push_back(p.data());
+        q.processPacket(seq, std::move(p), cb);
+    }
+    EXPECT_EQ(deliveredSeqs, (std::vector<uint8_t>{0, 1, 2}));
+    EXPECT_EQ(deliveredPtrs, (std::vector<const uint8_t*>{ptrs[0], ptrs[2], ptrs[1]}));
+    EXPECT_EQ(pool->getNInUse(), 0u);
+    EXPECT_EQ(pool->getNExhausted(), 0);
+}
+
+TEST(PacketPoolTest, ReceiveEngineFillsPoolBuffers)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+    auto pool = PacketPool::create(32, 16);
+    {
+        ReceiveEngine engine(fds[0], pool, ReceiveEngine::Backend::RECVMMSG, 4);
+        const uint8_t payload[3] = {1, 2, 3};
+        ASSERT_EQ(send(fds[1], payload, sizeof(payload), 0), 3);
+
+        DatagramBatch batch;
+        ASSERT_EQ(engine.receive(batch), 1);
+        PacketRef kept = batch[0].packet;
+        ASSERT_TRUE(kept);
+        EXPECT_EQ(kept.data(), batch[0].data);
+        EXPECT_EQ(kept.size(), 3u);
+        // 4 receive slots + the one we kept
+        EXPECT_EQ(pool->getNInUse(), 5u);
+    }
+    EXPECT_EQ(pool->getNInUse(), 0u);
+    close(fds[0]);
+    close(fds[1]);
+}
@@ -0,0 +1,175 @@
+//
+// ParserDispatch_bench.cpp
+// Per-packet cost of the rtp -> NALU path: H26XParser, where the payload type is checked on every packet and each
+// NALU goes through the std::function callbacks of RTPDecoder and the parser, against StaticH26XParser, where the
+// codec and the sink are template parameters. A synthetic H.264 stream (small single NAL units and FU-A fragmented
+// slices) is parsed over and over into a sink that only touches the NALU, from raw pointers and from pool packets.
+//
+// Usage: parser_dispatch_bench [--rounds N] [--slice-bytes N]
+//   --rounds N       how often the stream is parsed (default 200)
+//   --slice-bytes N  size of the slices, small slices mean more NALUs per packet (default 4000)
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "RtpStream.h"
+#include "parser/StaticH26XParser.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// 600 frames, SPS / PPS every 60, one slice per frame in FU-A fragments of 1400 bytes
+RtpStream::Packets synthesize(size_t sliceBytes)
+{
+    RtpStream::Packets        packets;
+    RtpStream::H264Packetizer packetizer;
+    auto                      addNalu = [&](uint8_t header, size_t size, bool last)
+    {
+        for (auto& packet : packetizer.packetize(header, size, 1, last, 0x88)) packets.push_back(std::move(packet));
+    };
+    for (size_t frame = 0; frame < 600; frame++)
+    {
+        const bool idr = frame % 60 == 0;
+        if (idr)
+        {
+            addNalu(0x67, 24, false);
+            addNalu(0x68, 4, false);
+        }
+        addNalu(0x06, 16, false);
+        addNalu(idr ? 0x65 : 0x41, sliceBytes, true);
+    }
+    return packets;
+}
+
+struct Checksum
+{
+    size_t* sum;
+
+    void operator()(const NALU& nalu) const { *sum += nalu.getSize() + (nalu.isEndOfAccessUnit() ? 1 : 0); }
+};
+
+template <typename Parse>
+double nsPerPacket(const RtpStream::Packets& packets, PacketPool* pool, int rounds, Parse parse)
+{
+    std::vector<PacketRef> refs;
+    Clock::duration        elapsed{};
+    for (int round = 0; round < rounds; round++)
+    {
+        if (pool != nullptr)
+        {
+            // filled outside of the measurement, the receiver did that already
+            refs.clear();
+            for (const auto& packet : packets)
+            {
+                PacketRef ref = pool->acquire();
+                std::memcpy(ref.data(), packet.data(), packet.size());
+                ref.setSize(packet.size());
+                refs.push_back(std::move(ref));
+            }
+        }
+        const auto start = Clock::now();
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            if (pool != nullptr)
+            {
+                parse(refs[i]);
+            }
+            else
+            {
+                parse(packets[i]);
+            }
+        }
+        elapsed += Clock::now() - start;
+    }
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() /
+           (double) (packets.size() * rounds);
+}
+
+void run(const RtpStream::Packets& packets, PacketPool* pool, int rounds)
+{
+    size_t sumRuntime = 0, sumStatic = 0;
+    auto   runtime    = std::make_unique<H26XParser>([&](const NALU& nalu) { Checksum{&sumRuntime}(nalu); });
+    auto   statically = std::make_unique<StaticH26XParser<false, Checksum>>(Checksum{&sumStatic});
+
+    const double runtimeNs = nsPerPacket(
+        packets,
+        pool,
+        rounds,
+        [&](const auto& packet)
+        {
+            if constexpr (std::is_same_v<std::decay_t<decltype(packet)>, PacketRef>)
+            {
+                runtime->parse_rtp_stream(packet);
+            }
+            else
+            {
+                runtime->parse_rtp_stream(packet.data(), packet.size());
+            }
+        });
+    const double staticNs = nsPerPacket(
+        packets,
+        pool,
+        rounds,
+        [&](const auto& packet)
+        {
+            if constexpr (std::is_same_v<std::decay_t<decltype(packet)>, PacketRef>)
+            {
+                if (statically->payloadType(packet.data(), packet.size()) == statically->PAYLOAD_TYPE)
+                {
+                    statically->parse(packet);
+                }
+            }
+            else
+            {
+                if (statically->payloadType(packet.data(), packet.size()) == statically->PAYLOAD_TYPE)
+                {
+                    statically->parse(packet.data(), packet.size());
+                }
+            }
+        });
+    std::printf(
+        "%-10s runtime dispatch %7.1f ns/packet | static dispatch %7.1f ns/packet | %5.1f%% less%s\n",
+        pool != nullptr ? "PacketRef" : "raw",
+        runtimeNs,
+        staticNs,
+        100.0 * (runtimeNs - staticNs) / runtimeNs,
+        sumRuntime == sumStatic ? "" : " (NALUs differ!)");
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    int rounds = 200, sliceBytes = 4000;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string arg = argv[i];
+        const int         val = std::atoi(argv[i + 1]);
+        if (arg == "--rounds")
+        {
+            rounds = std::max(val, 1);
+        }
+        else if (arg == "--slice-bytes")
+        {
+            sliceBytes = std::max(val, 16);
+        }
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--rounds N] [--slice-bytes N]\n", argv[0]);
+            return 1;
+        }
+    }
+    const auto packets = synthesize((size_t) sliceBytes);
+    std::printf("%zu packets, %d rounds, %d byte slices\n", packets.size(), rounds, sliceBytes);
+    auto pool = PacketPool::create(2048, packets.size() + 16);
+    run(packets, nullptr, rounds);
+    run(packets, pool.get(), rounds);
+    return 0;
+}
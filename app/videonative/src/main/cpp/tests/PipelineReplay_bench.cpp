@@ -0,0 +1,751 @@
+//
+// PipelineReplay_bench.cpp
+// Replays an RTP capture through the host-buildable part of the video ingest pipeline:
+//   PacketPool -> BufferedPacketQueue -> H26XParser / RTPDecoder -> null decoder sink
+// and reports throughput, per-stage latency percentiles and heap allocations per packet.
+//
+// Usage: pipeline_replay_bench [options] [capture]
+//   capture            .pcap (Ethernet, Linux cooked, raw IP or loopback; UDP payloads are taken as RTP) or a dump
+//                      written by --write. Without one, a synthetic H.264 stream is generated.
+//   --realtime         replay with the original packet spacing instead of as fast as possible
+//   --port N           only take UDP datagrams to port N from a pcap (default 5600, 0 = any)
+//   --seconds N        length of the synthetic stream (default 60)
+//   --write FILE       write the packets that would be replayed as a dump, then exit
+//   --deadline US      run the reorder queue in deadline mode
+//   --contiguous       let the parser copy every NALU into its own buffer instead of referencing the packets
+//   --loss PERCENT     drop this share of the packets at random before the replay
+//   --loss-policy P    drop, zero, truncate or all: what the parser does with NALUs that lost fragments (default drop).
+//                      all replays once per policy.
+// The reorder queue logs its restarts to stderr, redirect it when only the report is of interest.
+//
+// The sink stands in for VideoDecoder::interpretNALU() with a decoder that accepts every input buffer immediately:
+// it buffers the config NALUs until all of them were seen, then copies (gathers) every NALU into an input buffer.
+//
+// Frames lost and time to a clean picture come from a model of the decoder, see LossReport.
+//
+
+#include <endian.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BufferedPacketQueue.h"
+#include "NALU/KeyFrameFinder.hpp"
+#include "RtpStream.h"
+#include "parser/H26XParser.h"
+
+// ---------- Allocation counting ------------------------------------------------------------------------------------
+namespace
+{
+std::atomic<long> gNAllocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+    gNAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct CapturedPacket
+{
+    // capture time, relative to the first packet
+    int64_t              timestampUs;
+    std::vector<uint8_t> data;
+};
+
+// ---------- Capture formats ----------------------------------------------------------------------------------------
+constexpr char DUMP_MAGIC[8] = {'F', 'P', 'V', 'R', 'T', 'P', '0', '1'};
+
+// Dump: DUMP_MAGIC, then per packet a little endian uint64 timestamp (us) and uint32 length followed by the payload
+bool writeDump(const std::string& path, const std::vector<CapturedPacket>& packets)
+{
+    std::ofstream out(path, std::ios::binary);
+    out.write(DUMP_MAGIC, sizeof(DUMP_MAGIC));
+    for (const CapturedPacket& packet : packets)
+    {
+        const uint64_t ts  = htole64((uint64_t) packet.timestampUs);
+        const uint32_t len = htole32((uint32_t) packet.data.size());
+        out.write(reinterpret_cast<const char*>(&ts), sizeof(ts));
+        out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+        out.write(reinterpret_cast<const char*>(packet.data.data()), (std::streamsize) packet.data.size());
+    }
+    return (bool) out;
+}
+
+bool readDump(const std::vector<uint8_t>& file, std::vector<CapturedPacket>& packets)
+{
+    size_t pos = sizeof(DUMP_MAGIC);
+    while (pos + 12 <= file.size())
+    {
+        uint64_t ts;
+        uint32_t len;
+        std::memcpy(&ts, &file[pos], sizeof(ts));
+        std::memcpy(&len, &file[pos + 8], sizeof(len));
+        pos += 12;
+        len = le32toh(len);
+        if (pos + len > file.size()) return false;
+        packets.push_back({(int64_t) le64toh(ts), {file.begin() + (long) pos, file.begin() + (long) (pos + len)}});
+        pos += len;
+    }
+    return true;
+}
+
+uint16_t be16(const uint8_t* p)
+{
+    return (uint16_t) (p[0] << 8 | p[1]);
+}
+
+// UDP payload of a link layer frame, nullptr if it is not UDP (to @param port)
+const uint8_t* udpPayload(const uint8_t* frame, size_t length, uint32_t linkType, int port, size_t& payloadLength)
+{
+    size_t   off       = 0;
+    uint16_t etherType = 0;
+    switch (linkType)
+    {
+        case 0:  // BSD loopback, host byte order address family
+        {
+            if (length < 4) return nullptr;
+            uint32_t family;
+            std::memcpy(&family, frame, 4);
+            etherType = family == 2 ? 0x0800 : 0x86DD;
+            off       = 4;
+            break;
+        }
+        case 1:  // Ethernet
+            if (length < 14) return nullptr;
+            etherType = be16(&frame[12]);
+            off       = 14;
+            while ((etherType == 0x8100 || etherType == 0x88A8) && off + 4 <= length)
+            {
+                etherType = be16(&frame[off + 2]);
+                off += 4;
+            }
+            break;
+        case 113:  // Linux cooked capture
+            if (length < 16) return nullptr;
+            etherType = be16(&frame[14]);
+            off       = 16;
+            break;
+        case 276:  // Linux cooked capture v2
+            if (length < 20) return nullptr;
+            etherType = be16(&frame[0]);
+            off       = 20;
+            break;
+        case 101:  // raw IP
+        case 228:  // raw IPv4
+        case 229:  // raw IPv6
+            if (length < 1) return nullptr;
+            etherType = (frame[0] >> 4) == 6 ? 0x86DD : 0x0800;
+            break;
+        default:
+            return nullptr;
+    }
+    if (etherType == 0x0800)
+    {
+        if (off + 20 > length || frame[off + 9] != 17) return nullptr;
+        // fragments other than the first one carry no UDP header
+        if ((be16(&frame[off + 6]) & 0x1FFF) != 0) return nullptr;
+        off += (frame[off] & 0x0F) * 4;
+    }
+    else if (etherType == 0x86DD)
+    {
+        if (off + 40 > length || frame[off + 6] != 17) return nullptr;
+        off += 40;
+    }
+    else
+    {
+        return nullptr;
+    }
+    if (off + 8 > length) return nullptr;
+    if (port != 0 && be16(&frame[off + 2]) != port) return nullptr;
+    payloadLength = std::min<size_t>(be16(&frame[off + 4]) - 8u, length - off - 8);
+    return &frame[off + 8];
+}
+
+bool readPcap(const std::vector<uint8_t>& file, int port, std::vector<CapturedPacket>& packets)
+{
+    if (file.size() < 24) return false;
+    uint32_t magic;
+    std::memcpy(&magic, file.data(), 4);
+    if (magic != 0xa1b2c3d4 && magic != 0xd4c3b2a1 && magic != 0xa1b23c4d && magic != 0x4d3cb2a1) return false;
+    const bool swapped = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+    const bool nanos   = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+    auto       u32     = [&](size_t pos)
+    {
+        uint32_t v;
+        std::memcpy(&v, &file[pos], 4);
+        return swapped ? __builtin_bswap32(v) : v;
+    };
+    const uint32_t linkType = u32(20) & 0x0FFFFFFF;
+    size_t         pos      = 24;
+    int64_t        first    = -1;
+    while (pos + 16 <= file.size())
+    {
+        const int64_t ts       = (int64_t) u32(pos) * 1000000 + (nanos ? u32(pos + 4) / 1000 : u32(pos + 4));
+        const size_t  captured = u32(pos + 8);
+        pos += 16;
+        if (pos + captured > file.size()) break;
+        size_t         length  = 0;
+        const uint8_t* payload = udpPayload(&file[pos], captured, linkType, port, length);
+        if (payload != nullptr && length >= 12)
+        {
+            if (first < 0) first = ts;
+            packets.push_back({ts - first, {payload, payload + length}});
+        }
+        pos += captured;
+    }
+    return true;
+}
+
+bool loadCapture(const std::string& path, int port, std::vector<CapturedPacket>& packets)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    const std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (file.size() >= sizeof(DUMP_MAGIC) && std::memcmp(file.data(), DUMP_MAGIC, sizeof(DUMP_MAGIC)) == 0)
+    {
+        return readDump(file, packets);
+    }
+    return readPcap(file, port, packets);
+}
+
+// ---------- Synthetic stream ---------------------------------------------------------------------------------------
+// 60 fps H.264 at roughly 8 MBit/s, an IDR with SPS / PPS every second, FU-A fragments of 1400 bytes.
+// Like a wfb-ng link: a few packets are reordered, one in a thousand is lost.
+std::vector<CapturedPacket> synthesize(int seconds)
+{
+    constexpr size_t            FPS = 60, GOP = 60;
+    std::mt19937                rng(7);
+    std::vector<CapturedPacket> packets;
+    RtpStream::H264Packetizer   packetizer(65000);
+
+    auto addNalu = [&](uint8_t header, size_t size, uint32_t ts, bool last, int64_t timeUs)
+    {
+        for (auto& data : packetizer.packetize(header, size, ts, last)) packets.push_back({timeUs, std::move(data)});
+    };
+    std::uniform_int_distribution<size_t> pSize(8000, 24000);
+    for (size_t frame = 0; frame < seconds * FPS; frame++)
+    {
+        const auto     timeUs = (int64_t) (frame * 1000000 / FPS);
+        const uint32_t ts     = (uint32_t) (frame * 90000 / FPS);
+        if (frame % GOP == 0)
+        {
+            addNalu(0x67, 24, ts, false, timeUs);
+            addNalu(0x68, 4, ts, false, timeUs);
+            addNalu(0x65, 120000, ts, true, timeUs);
+        }
+        else
+        {
+            addNalu(0x41, pSize(rng), ts, true, timeUs);
+        }
+    }
+    // spread the packets of one frame over a few ms like the radio link does, then disturb the order a little
+    for (size_t i = 1; i < packets.size(); i++)
+    {
+        packets[i].timestampUs = std::max(packets[i].timestampUs, packets[i - 1].timestampUs + 150);
+    }
+    std::vector<CapturedPacket> out;
+    out.reserve(packets.size());
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        if (rng() % 1000 == 0) continue;
+        if (rng() % 100 == 0 && i + 1 < packets.size())
+        {
+            std::swap(packets[i].data, packets[i + 1].data);
+        }
+        out.push_back(std::move(packets[i]));
+    }
+    return out;
+}
+
+// ---------- Null decoder -------------------------------------------------------------------------------------------
+class NullDecoderSink
+{
+  public:
+    void interpretNALU(const NALU& nalu)
+    {
+        nNALU++;
+        if (nalu.getSize() <= 4) return;
+        if (!mConfigured)
+        {
+            mKeyFrameFinder.saveIfKeyFrame(nalu);
+            mConfigured = mKeyFrameFinder.allKeyFramesAvailable(nalu.IS_H265_PACKET);
+            return;
+        }
+        if ((size_t) nalu.getSize() > mInputBuffer.size()) return;
+        nalu.copyTo(mInputBuffer.data());
+        nFed++;
+        nBytesFed += (size_t) nalu.getSize();
+    }
+
+    long   nNALU     = 0;
+    long   nFed      = 0;
+    size_t nBytesFed = 0;
+
+  private:
+    KeyFrameFinder       mKeyFrameFinder;
+    bool                 mConfigured = false;
+    std::vector<uint8_t> mInputBuffer = std::vector<uint8_t>(NALU::NALU_MAXLEN);
+};
+
+// ---------- Frame accounting --------------------------------------------------------------------------------------
+// Frames are told apart by their RTP timestamp. Every packet is assigned the index of its frame up front, the sink
+// finds the frame of a NALU by its creationTime, which is the receive timestamp of the packet the NALU started in.
+struct FrameStats
+{
+    int  nVCL      = 0;
+    bool corrupted = false;
+    bool keyFrame  = false;
+};
+
+class FrameTracker
+{
+  public:
+    FrameTracker(size_t nPackets, size_t nFrames) : mFrames(nFrames) { mArrivals.reserve(nPackets); }
+
+    // @return the receive timestamp to give the packet, made unique so the frame can be found again
+    Clock::time_point onPacket(Clock::time_point arrival, int frame)
+    {
+        if (!mArrivals.empty() && arrival <= mArrivals.back().first)
+        {
+            arrival = mArrivals.back().first + Clock::duration(1);
+        }
+        mArrivals.emplace_back(arrival, frame);
+        return arrival;
+    }
+
+    void onNALU(const NALU& nalu)
+    {
+        if (!nalu.is_vcl()) return;
+        const auto it = std::lower_bound(
+            mArrivals.begin(),
+            mArrivals.end(),
+            nalu.creationTime,
+            [](const std::pair<Clock::time_point, int>& a, Clock::time_point t) { return a.first < t; });
+        if (it == mArrivals.end() || it->first != nalu.creationTime || it->second < 0) return;
+        FrameStats& frame = mFrames[(size_t) it->second];
+        frame.nVCL++;
+        frame.corrupted |= nalu.isCorrupted();
+        frame.keyFrame |= nalu.is_keyframe();
+    }
+
+    const std::vector<FrameStats>& frames() const { return mFrames; }
+
+  private:
+    std::vector<std::pair<Clock::time_point, int>> mArrivals;
+    std::vector<FrameStats>                        mFrames;
+};
+
+// Index of the frame of each packet in order of first appearance, -1 for packets that are not video.
+// @param frameTimestamps gets the RTP timestamp of each frame.
+std::vector<int> assignFrames(const std::vector<CapturedPacket>& packets, std::vector<uint32_t>& frameTimestamps)
+{
+    std::vector<int> frameOf;
+    frameOf.reserve(packets.size());
+    for (const CapturedPacket& packet : packets)
+    {
+        const RTP::RTPPacket rtpPacket(packet.data.data(), packet.data.size());
+        if (rtpPacket.header.payload != RTP_PAYLOAD_TYPE_H264 && rtpPacket.header.payload != RTP_PAYLOAD_TYPE_H265)
+        {
+            frameOf.push_back(-1);
+            continue;
+        }
+        const uint32_t ts = rtpPacket.header.getTimestamp();
+        // packets of one frame are next to each other, apart from a little reordering
+        const size_t from = frameTimestamps.size() > 8 ? frameTimestamps.size() - 8 : 0;
+        const auto   it   = std::find(frameTimestamps.begin() + (long) from, frameTimestamps.end(), ts);
+        if (it == frameTimestamps.end())
+        {
+            frameTimestamps.push_back(ts);
+            frameOf.push_back((int) frameTimestamps.size() - 1);
+        }
+        else
+        {
+            frameOf.push_back((int) (it - frameTimestamps.begin()));
+        }
+    }
+    return frameOf;
+}
+
+/**
+ * What the viewer gets under a loss policy, compared to the reference replay without the added loss. The decoder
+ * model: a key frame that arrived intact makes the picture clean, one that arrived damaged (a NALU corrupted or
+ * missing) is shown with artifacts, without it nothing can be shown until the next key frame. Other frames are shown
+ * if they arrived at all and a key frame was decoded before them, but once a frame is damaged or lost every frame
+ * referencing it has artifacts until the next intact key frame.
+ * Time to clean picture is from the first frame that is not clean (lost or with artifacts) until the next clean one,
+ * in stream time (RTP timestamps).
+ */
+struct LossReport
+{
+    long   nFrames    = 0;
+    long   nLost      = 0;
+    long   nCorrupted = 0;
+    long   nEpisodes  = 0;
+    double sumCleanMs = 0;
+    double maxCleanMs = 0;
+
+    LossReport(
+        const std::vector<FrameStats>& reference,
+        const std::vector<FrameStats>& received,
+        const std::vector<uint32_t>&   frameTimestamps)
+    {
+        enum
+        {
+            CLEAN,
+            ARTIFACTS,
+            NO_REFERENCE
+        } picture          = NO_REFERENCE;
+        bool      started  = false;
+        long long episode  = -1;
+        for (size_t i = 0; i < reference.size(); i++)
+        {
+            if (reference[i].nVCL == 0) continue;
+            // from the first key frame on, like a decoder that starts with the stream
+            started = started || reference[i].keyFrame;
+            if (!started) continue;
+            const bool arrived = received[i].nVCL > 0;
+            const bool intact  = received[i].nVCL >= reference[i].nVCL && !received[i].corrupted;
+            if (reference[i].keyFrame)
+            {
+                picture = !arrived ? NO_REFERENCE : intact ? CLEAN : ARTIFACTS;
+            }
+            else if (!intact && picture == CLEAN)
+            {
+                picture = ARTIFACTS;
+            }
+            const bool shown = arrived && picture != NO_REFERENCE;
+            const bool clean = shown && picture == CLEAN;
+            nFrames++;
+            if (!shown) nLost++;
+            if (shown && !clean) nCorrupted++;
+            if (!clean && episode < 0)
+            {
+                episode = (long long) i;
+            }
+            else if (clean && episode >= 0)
+            {
+                const double ms = (double) (uint32_t) (frameTimestamps[i] - frameTimestamps[(size_t) episode]) / 90.0;
+                nEpisodes++;
+                sumCleanMs += ms;
+                maxCleanMs = std::max(maxCleanMs, ms);
+                episode    = -1;
+            }
+        }
+    }
+
+    void print(const char* policy) const
+    {
+        std::printf(
+            "  loss policy %-8s frames %ld  lost %ld (%.2f%%)  shown with artifacts %ld (%.2f%%)  time to clean picture: "
+            "%ld times, mean %.1f ms, max %.1f ms\n",
+            policy,
+            nFrames,
+            nLost,
+            100.0 * (double) nLost / (double) std::max(nFrames, 1L),
+            nCorrupted,
+            100.0 * (double) nCorrupted / (double) std::max(nFrames, 1L),
+            nEpisodes,
+            nEpisodes > 0 ? sumCleanMs / (double) nEpisodes : 0.0,
+            maxCleanMs);
+    }
+};
+
+// ---------- Reporting ----------------------------------------------------------------------------------------------
+class LatencySamples
+{
+  public:
+    explicit LatencySamples(size_t capacity) { mSamples.reserve(capacity); }
+
+    void add(Clock::duration d)
+    {
+        if (mSamples.size() < mSamples.capacity()) mSamples.push_back(d.count());
+    }
+
+    void print(const char* name)
+    {
+        if (mSamples.empty())
+        {
+            std::printf("  %-26s no samples\n", name);
+            return;
+        }
+        std::sort(mSamples.begin(), mSamples.end());
+        auto us = [&](double q)
+        {
+            const size_t i = std::min(mSamples.size() - 1, (size_t) (q * (double) mSamples.size()));
+            return std::chrono::duration<double, std::micro>(Clock::duration(mSamples[i])).count();
+        };
+        std::printf(
+            "  %-26s p50 %9.2f us  p90 %9.2f us  p99 %9.2f us  p99.9 %9.2f us  max %9.2f us\n",
+            name,
+            us(0.5),
+            us(0.9),
+            us(0.99),
+            us(0.999),
+            us(1.0));
+    }
+
+  private:
+    std::vector<Clock::rep> mSamples;
+};
+struct ReplayOptions
+{
+    bool          realtime   = false;
+    int           deadlineUs = 0;
+    bool          contiguous = false;
+    RTPLossPolicy lossPolicy = RTPLossPolicy::DROP;
+};
+
+/**
+ * Replays @param packets through the pipeline. @param frameOf is the frame of each packet (see assignFrames()), the
+ * VCL NALUs that reached the sink per frame end up in @param tracker. Prints the throughput / latency report if
+ * @param report is set. Returns false if no NALU came out.
+ */
+bool replay(
+    const std::vector<CapturedPacket>& packets,
+    const std::vector<int>&            frameOf,
+    const ReplayOptions&               options,
+    FrameTracker&                      tracker,
+    const char*                        report)
+{
+    // What the receive side looks like on the phone: the kernel writes into pool buffers
+    auto                pool = PacketPool::create();
+    BufferedPacketQueue queue;
+    if (options.deadlineUs > 0)
+    {
+        BufferedPacketQueue::DeadlineConfig config;
+        config.maxWait = std::chrono::microseconds(options.deadlineUs);
+        config.minWait = std::min(config.minWait, config.maxWait);
+        queue.enableDeadlineMode(config);
+    }
+    NullDecoderSink sink;
+    LatencySamples  queueLatency(packets.size()), nalLatency(packets.size()), sinkTime(packets.size());
+    LatencySamples  totalLatency(packets.size());
+    // heap allocated, the RTPDecoder holds a 1 MiB NALU buffer
+    auto parser = std::make_unique<H26XParser>(
+        [&](const NALU& nalu)
+        {
+            const auto start = Clock::now();
+            nalLatency.add(start - nalu.creationTime);
+            sink.interpretNALU(nalu);
+            const auto end = Clock::now();
+            sinkTime.add(end - start);
+            totalLatency.add(end - nalu.creationTime);
+            tracker.onNALU(nalu);
+        });
+    parser->setLossPolicy(false, options.lossPolicy);
+    parser->setLossPolicy(true, options.lossPolicy);
+    auto callback = [&](const PacketRef& queued)
+    {
+        queueLatency.add(Clock::now() - queued.timestamp());
+        if (options.contiguous)
+        {
+            parser->parse_rtp_stream(queued.data(), queued.size(), queued.timestamp());
+        }
+        else
+        {
+            parser->parse_rtp_stream(queued);
+        }
+    };
+
+    const long allocationsBefore = gNAllocations.load();
+    const auto start             = Clock::now();
+    size_t     nBytes            = 0;
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        const CapturedPacket& captured = packets[i];
+        if (options.realtime)
+        {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(captured.timestampUs));
+        }
+        if (captured.data.size() > pool->getBufferSize()) continue;
+        PacketRef packet = pool->acquire();
+        std::memcpy(packet.data(), captured.data.data(), captured.data.size());
+        packet.setSize(captured.data.size());
+        packet.setTimestamp(tracker.onPacket(Clock::now(), frameOf[i]));
+        nBytes += captured.data.size();
+        const RTP::RTPPacket rtpPacket(packet.data(), packet.size());
+        queue.processPacket(rtpPacket.header.getSequence(), std::move(packet), callback);
+    }
+    const double elapsed     = std::chrono::duration<double>(Clock::now() - start).count();
+    const long   allocations = gNAllocations.load() - allocationsBefore;
+    if (report == nullptr)
+    {
+        return sink.nNALU > 0;
+    }
+
+    std::printf(
+        "%s, %zu packets, %.1f MB, %s%s%s\n",
+        report,
+        packets.size(),
+        (double) nBytes / 1e6,
+        options.realtime ? "original timing" : "as fast as possible",
+        options.deadlineUs > 0 ? ", deadline mode" : "",
+        options.contiguous ? ", contiguous NALUs" : "");
+    std::printf(
+        "  %.3f s  %.0f packets/s  %.0f NALUs/s  %.1f MBit/s\n",
+        elapsed,
+        (double) packets.size() / elapsed,
+        (double) sink.nNALU / elapsed,
+        (double) nBytes * 8 / 1e6 / elapsed);
+    std::printf(
+        "  NALUs %ld fed %ld  allocations %ld (%.3f per packet)  pool high water %zu exhausted %ld\n",
+        sink.nNALU,
+        sink.nFed,
+        allocations,
+        (double) allocations / (double) packets.size(),
+        pool->getHighWaterMark(),
+        pool->getNExhausted());
+    queueLatency.print("receive -> parser (queue)");
+    nalLatency.print("first fragment -> NALU");
+    sinkTime.print("decoder sink");
+    totalLatency.print("first fragment -> fed");
+    return sink.nNALU > 0;
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::string   capture, writePath, lossPolicy = "drop";
+    ReplayOptions options;
+    int           port        = 5600;
+    int           seconds     = 60;
+    double        lossPercent = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--realtime")
+            options.realtime = true;
+        else if (arg == "--port" && i + 1 < argc)
+            port = std::atoi(argv[++i]);
+        else if (arg == "--seconds" && i + 1 < argc)
+            seconds = std::atoi(argv[++i]);
+        else if (arg == "--write" && i + 1 < argc)
+            writePath = argv[++i];
+        else if (arg == "--deadline" && i + 1 < argc)
+            options.deadlineUs = std::atoi(argv[++i]);
+        else if (arg == "--contiguous")
+            options.contiguous = true;
+        else if (arg == "--loss" && i + 1 < argc)
+            lossPercent = std::atof(argv[++i]);
+        else if (arg == "--loss-policy" && i + 1 < argc)
+            lossPolicy = argv[++i];
+        else if (arg.rfind("--", 0) == 0)
+        {
+            std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 2;
+        }
+        else
+            capture = arg;
+    }
+    const std::vector<std::pair<std::string, RTPLossPolicy>> allPolicies = {
+        {"drop", RTPLossPolicy::DROP}, {"zero", RTPLossPolicy::ZERO_FILL}, {"truncate", RTPLossPolicy::TRUNCATE}};
+    std::vector<std::pair<std::string, RTPLossPolicy>> policies;
+    for (const auto& policy : allPolicies)
+    {
+        if (lossPolicy == "all" || lossPolicy == policy.first) policies.push_back(policy);
+    }
+    if (policies.empty())
+    {
+        std::fprintf(stderr, "unknown loss policy %s\n", lossPolicy.c_str());
+        return 2;
+    }
+
+    std::vector<CapturedPacket> packets;
+    if (capture.empty())
+    {
+        packets = synthesize(seconds);
+    }
+    else if (!loadCapture(capture, port, packets))
+    {
+        std::fprintf(stderr, "cannot read capture %s\n", capture.c_str());
+        return 1;
+    }
+    if (!writePath.empty())
+    {
+        const bool ok = writeDump(writePath, packets);
+        std::printf("wrote %zu packets to %s\n", packets.size(), writePath.c_str());
+        return ok ? 0 : 1;
+    }
+    if (packets.empty())
+    {
+        std::fprintf(stderr, "no RTP packets in the capture\n");
+        return 1;
+    }
+
+    // The reference is the stream as it is, forwarding whatever the parser can get out of it
+    std::vector<uint32_t> frameTimestamps;
+    const auto            frameOf = assignFrames(packets, frameTimestamps);
+    FrameTracker          reference(packets.size(), frameTimestamps.size());
+    ReplayOptions         referenceOptions;
+    referenceOptions.lossPolicy = RTPLossPolicy::TRUNCATE;
+    replay(packets, frameOf, referenceOptions, reference, nullptr);
+
+    std::vector<CapturedPacket> lossy;
+    std::vector<int>            lossyFrameOf;
+    std::mt19937                rng(11);
+    std::uniform_real_distribution<double> percent(0, 100);
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        if (percent(rng) < lossPercent) continue;
+        lossy.push_back(packets[i]);
+        lossyFrameOf.push_back(frameOf[i]);
+    }
+
+    const std::string name = (capture.empty() ? std::string("synthetic H.264") : capture) +
+                             (lossPercent > 0 ? ", " + std::to_string(packets.size() - lossy.size()) + " dropped" : "");
+    std::vector<LossReport> reports;
+    bool                    ok = true;
+    for (const auto& policy : policies)
+    {
+        options.lossPolicy = policy.second;
+        FrameTracker received(lossy.size(), frameTimestamps.size());
+        ok = replay(lossy, lossyFrameOf, options, received, (name + ", loss policy " + policy.first).c_str()) && ok;
+        reports.emplace_back(reference.frames(), received.frames(), frameTimestamps);
+    }
+    for (size_t i = 0; i < policies.size(); i++)
+    {
+        reports[i].print(policies[i].first.c_str());
+    }
+    return ok ? 0 : 1;
+}
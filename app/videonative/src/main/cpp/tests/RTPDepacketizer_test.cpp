@@ -0,0 +1,157 @@
+#include "parser/RTPDepacketizer.hpp"  // the class under test
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "RtpStream.h"
+
+namespace
+{
+using namespace RtpStream;
+
+constexpr size_t FRAGMENT = 100;
+
+// IDR slice as FU-A start / middle / middle / end (the end with the marker), then a single NAL unit slice
+Packets h264Stream()
+{
+    return {
+        rtp(96, 10, false, concat({0x7C, 0x85}, bytes(FRAGMENT, 1))),
+        rtp(96, 11, false, concat({0x7C, 0x05}, bytes(FRAGMENT, 2))),
+        rtp(96, 12, false, concat({0x7C, 0x05}, bytes(FRAGMENT, 3))),
+        rtp(96, 13, true, concat({0x7C, 0x45}, bytes(40, 4))),
+        rtp(96, 14, true, concat({0x41}, bytes(30, 5))),
+    };
+}
+
+std::vector<uint8_t> h264IDR(size_t nMiddle, bool withEnd)
+{
+    std::vector<uint8_t> nalu = concat({0, 0, 0, 1, 0x65}, bytes(FRAGMENT, 1));
+    for (size_t i = 0; i < nMiddle; i++) nalu = concat(nalu, bytes(FRAGMENT, (uint8_t) (2 + i)));
+    return withEnd ? concat(nalu, bytes(40, 4)) : nalu;
+}
+
+// Parses @param stream without the packets at @param lost, from pool buffers if @param pool is set
+std::vector<ParsedNALU> parse(
+    const Packets& stream, std::vector<size_t> lost, RTPLossPolicy policy, bool isH265, PacketPool* pool = nullptr)
+{
+    ParseHarness harness;
+    harness.parser->setLossPolicy(isH265, policy);
+    return harness.feed(stream, pool, lost);
+}
+}  // namespace
+
+TEST(RTPDepacketizerTest, CompleteNALUsAreNotCorrupted)
+{
+    for (RTPLossPolicy policy : {RTPLossPolicy::DROP, RTPLossPolicy::ZERO_FILL, RTPLossPolicy::TRUNCATE})
+    {
+        const auto nalus = parse(h264Stream(), {}, policy, false);
+        ASSERT_EQ(nalus.size(), 2u);
+        EXPECT_EQ(nalus[0].data, h264IDR(2, true));
+        EXPECT_FALSE(nalus[0].corrupted);
+        EXPECT_FALSE(nalus[1].corrupted);
+    }
+}
+
+TEST(RTPDepacketizerTest, DropDiscardsTheNALUWithALostFragment)
+{
+    const auto nalus = parse(h264Stream(), {1}, RTPLossPolicy::DROP, false);
+    ASSERT_EQ(nalus.size(), 1u);
+    EXPECT_EQ(nalus[0].data[4], 0x41);
+    EXPECT_FALSE(nalus[0].corrupted);
+}
+
+TEST(RTPDepacketizerTest, ZeroFillKeepsTheSizeOfTheNALU)
+{
+    auto pool = PacketPool::create(2048, 8);
+    for (PacketPool* p : {(PacketPool*) nullptr, pool.get()})
+    {
+        const auto nalus = parse(h264Stream(), {1, 2}, RTPLossPolicy::ZERO_FILL, false, p);
+        ASSERT_EQ(nalus.size(), 2u);
+        std::vector<uint8_t> expected = h264IDR(2, true);
+        std::fill(expected.begin() + 5 + FRAGMENT, expected.begin() + 5 + 3 * FRAGMENT, 0);
+        EXPECT_EQ(nalus[0].data, expected);
+        EXPECT_TRUE(nalus[0].corrupted);
+        EXPECT_TRUE(nalus[0].endOfAccessUnit);
+        EXPECT_FALSE(nalus[1].corrupted);
+    }
+    EXPECT_EQ(pool->getNInUse(), 0u);
+}
+
+TEST(RTPDepacketizerTest, TruncateForwardsUpToTheFirstLostFragment)
+{
+    const auto nalus = parse(h264Stream(), {2}, RTPLossPolicy::TRUNCATE, false);
+    ASSERT_EQ(nalus.size(), 2u);
+    EXPECT_EQ(nalus[0].data, h264IDR(1, false));
+    EXPECT_TRUE(nalus[0].corrupted);
+    EXPECT_TRUE(nalus[0].endOfAccessUnit);
+}
+
+TEST(RTPDepacketizerTest, LostEndIsForwardedBeforeTheNextNALU)
+{
+    for (RTPLossPolicy policy : {RTPLossPolicy::ZERO_FILL, RTPLossPolicy::TRUNCATE})
+    {
+        const auto nalus = parse(h264Stream(), {3}, policy, false);
+        ASSERT_EQ(nalus.size(), 2u);
+        EXPECT_EQ(nalus[0].data, h264IDR(2, false));
+        EXPECT_TRUE(nalus[0].corrupted);
+        // the marker of the next packet belongs to the next NALU
+        EXPECT_FALSE(nalus[0].endOfAccessUnit);
+        EXPECT_FALSE(nalus[1].corrupted);
+        EXPECT_TRUE(nalus[1].endOfAccessUnit);
+    }
+    EXPECT_EQ(parse(h264Stream(), {3}, RTPLossPolicy::DROP, false).size(), 1u);
+}
+
+TEST(RTPDepacketizerTest, LostStartIsAlwaysDropped)
+{
+    for (RTPLossPolicy policy : {RTPLossPolicy::DROP, RTPLossPolicy::ZERO_FILL, RTPLossPolicy::TRUNCATE})
+    {
+        const auto nalus = parse(h264Stream(), {0}, policy, false);
+        ASSERT_EQ(nalus.size(), 1u);
+        EXPECT_EQ(nalus[0].data[4], 0x41);
+    }
+}
+
+TEST(RTPDepacketizerTest, PolicyIsPerCodec)
+{
+    // IDR_W_RADL as FU start / middle / end
+    const Packets h265 = {
+        rtp(97, 1, false, concat({0x62, 0x01, 0x93}, bytes(FRAGMENT, 1))),
+        rtp(97, 2, false, concat({0x62, 0x01, 0x13}, bytes(FRAGMENT, 2))),
+        rtp(97, 3, true, concat({0x62, 0x01, 0x53}, bytes(20, 3))),
+    };
+    // DROP is the default for H.265 as well, setting the H.264 policy does not change it
+    EXPECT_TRUE(parse(h265, {1}, RTPLossPolicy::ZERO_FILL, false).empty());
+    const auto nalus = parse(h265, {1}, RTPLossPolicy::ZERO_FILL, true);
+    ASSERT_EQ(nalus.size(), 1u);
+    EXPECT_EQ(nalus[0].data.size(), 4 + 2 + 2 * FRAGMENT + 20);
+    EXPECT_TRUE(nalus[0].corrupted);
+}
+
+TEST(RTPDepacketizerTest, LostEndAndNextStartAreNotSplicedTogether)
+{
+    // IDR slice A without its end, then a slice B without its start: of the next frame, or of the same frame after
+    // more packets than one NALU plausibly loses
+    for (const auto& [timestampB, seqB] : {std::pair<uint32_t, uint16_t>{2, 14}, {1, 14 + RTP_FU_MAX_GAP}})
+    {
+        const Packets stream = {
+            rtp(96, 10, false, concat({0x7C, 0x85}, bytes(FRAGMENT, 1))),
+            rtp(96, 11, false, concat({0x7C, 0x05}, bytes(FRAGMENT, 2))),
+            rtp(96, seqB, false, concat({0x7C, 0x01}, bytes(FRAGMENT, 6)), timestampB),
+            rtp(96, seqB + 1, true, concat({0x7C, 0x41}, bytes(40, 7)), timestampB),
+            rtp(96, seqB + 2, true, concat({0x41}, bytes(30, 5)), timestampB + 1),
+        };
+        for (RTPLossPolicy policy : {RTPLossPolicy::ZERO_FILL, RTPLossPolicy::TRUNCATE})
+        {
+            const auto nalus = parse(stream, {}, policy, false);
+            ASSERT_EQ(nalus.size(), 2u);
+            EXPECT_EQ(nalus[0].data, h264IDR(1, false));
+            EXPECT_TRUE(nalus[0].corrupted);
+            EXPECT_FALSE(nalus[0].endOfAccessUnit);
+            EXPECT_EQ(nalus[1].data, concat({0, 0, 0, 1, 0x41}, bytes(30, 5)));
+            EXPECT_FALSE(nalus[1].corrupted);
+        }
+        EXPECT_EQ(parse(stream, {}, RTPLossPolicy::DROP, false).size(), 1u);
+    }
+}
@@ -0,0 +1,94 @@
+//
+// ReceiveEngine_bench.cpp
+// Loopback UDP throughput of the ReceiveEngine backends.
+// Reports packets/s, receiver thread CPU time per packet and receive syscalls per packet.
+//
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
+#include "ReceiveEngine.h"
+
+namespace
+{
+constexpr size_t PACKET_SIZE = 1400;
+
+long threadCpuNs()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void run(ReceiveEngine::Backend backend, long nPackets)
+{
+    const int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    const int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    int       rcvbuf = 8 * 1024 * 1024;
+    setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = 0;
+    bind(rx, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t addrLen = sizeof(addr);
+    getsockname(rx, reinterpret_cast<sockaddr*>(&addr), &addrLen);
+
+    // Stop the receiver the same way UDPReceiver::stopReceiving() does. io_uring ignores SO_RCVTIMEO.
+    std::thread sender(
+        [&]
+        {
+            std::vector<uint8_t> payload(PACKET_SIZE, 0x42);
+            for (long i = 0; i < nPackets; i++)
+            {
+                sendto(tx, payload.data(), payload.size(), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            shutdown(rx, SHUT_RD);
+        });
+
+    ReceiveEngine engine(rx, PACKET_SIZE, backend);
+    DatagramBatch batch;
+    long          received = 0;
+    const long    cpuStart = threadCpuNs();
+    const auto    start    = std::chrono::steady_clock::now();
+    while (true)
+    {
+        const int n = engine.receive(batch);
+        // 0 once the socket has been shut down, whatever is missing by then was dropped by the kernel
+        if (n <= 0) break;
+        received += n;
+    }
+    const auto   end   = std::chrono::steady_clock::now() - std::chrono::milliseconds(200);
+    const long   cpuNs = threadCpuNs() - cpuStart;
+    const double secs  = std::chrono::duration<double>(end - start).count();
+    sender.join();
+
+    std::printf(
+        "%-9s received %8ld/%ld  %10.0f pkt/s  %7.1f cpu ns/pkt  %5.3f syscalls/pkt\n",
+        ReceiveEngine::backendName(engine.getBackend()),
+        received,
+        nPackets,
+        received / secs,
+        received ? (double) cpuNs / received : 0.0,
+        received ? (double) engine.getNSyscalls() / received : 0.0);
+    close(tx);
+    close(rx);
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    const long nPackets = argc > 1 ? std::atol(argv[1]) : 500000;
+    run(ReceiveEngine::Backend::RECVFROM, nPackets);
+    run(ReceiveEngine::Backend::RECVMMSG, nPackets);
+    run(ReceiveEngine::Backend::IO_URING, nPackets);
+    return 0;
+}
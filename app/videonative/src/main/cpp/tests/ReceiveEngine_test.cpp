@@ -0,0 +1,129 @@
+#include "ReceiveEngine.h"  // the class under test
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// ---------- Test fixture ----------------------------------------------------
+class ReceiveEngineTest : public ::testing::TestWithParam<ReceiveEngine::Backend>
+{
+  protected:
+    int fds[2] = {-1, -1};
+
+    void SetUp() override { ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0); }
+
+    void TearDown() override
+    {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    /* Helper: send one datagram whose first byte is its index. */
+    void send(uint8_t index, size_t length)
+    {
+        std::vector<uint8_t> payload(length, index);
+        ASSERT_EQ(::send(fds[1], payload.data(), payload.size(), 0), (ssize_t) length);
+    }
+};
+
+TEST_P(ReceiveEngineTest, DrainsQueuedDatagramsInOrder)
+{
+    ReceiveEngine engine(fds[0], 64, GetParam(), 8);
+    for (uint8_t i = 0; i < 20; i++) send(i, 10 + i);
+
+    DatagramBatch        batch;
+    std::vector<uint8_t> received;
+    size_t               bytes = 0;
+    while (received.size() < 20)
+    {
+        const int n = engine.receive(batch);
+        ASSERT_GT(n, 0);
+        ASSERT_LE(n, 8);
+        for (const Datagram& d : batch)
+        {
+            EXPECT_EQ(d.length, 10u + d.data[0]);
+            received.push_back(d.data[0]);
+        }
+        bytes += batch.totalBytes();
+    }
+    for (uint8_t i = 0; i < 20; i++) EXPECT_EQ(received[i], i);
+    EXPECT_EQ(bytes, 20u * 10 + 190);
+    EXPECT_EQ(engine.getNDatagrams(), 20);
+    if (engine.getBackend() != ReceiveEngine::Backend::RECVFROM)
+    {
+        EXPECT_LT(engine.getNSyscalls(), 20);
+    }
+}
+
+TEST_P(ReceiveEngineTest, CountsTruncatedDatagrams)
+{
+    ReceiveEngine engine(fds[0], 16, GetParam(), 4);
+    send(1, 100);
+
+    DatagramBatch batch;
+    ASSERT_EQ(engine.receive(batch), 1);
+    EXPECT_EQ(batch[0].length, 16u);
+    EXPECT_EQ(engine.getNTruncated(), 1);
+}
+
+TEST_P(ReceiveEngineTest, ShutdownUnblocksReceive)
+{
+    ReceiveEngine engine(fds[0], 64, GetParam(), 4);
+    shutdown(fds[0], SHUT_RDWR);
+
+    DatagramBatch batch;
+    EXPECT_EQ(engine.receive(batch), 0);
+    EXPECT_TRUE(batch.empty());
+}
+
+TEST_P(ReceiveEngineTest, ArrivalIsNotLaterThanReceive)
+{
+    ReceiveEngine engine(fds[0], PacketPool::create(64, 8), GetParam(), 4);
+    const auto    sent = std::chrono::steady_clock::now();
+    send(1, 10);
+
+    DatagramBatch batch;
+    ASSERT_EQ(engine.receive(batch), 1);
+    const auto received = std::chrono::steady_clock::now();
+    // the realtime -> steady mapping may be off by a few microseconds
+    EXPECT_GE(batch[0].arrival, sent - std::chrono::milliseconds(1));
+    EXPECT_LE(batch[0].arrival, received);
+    EXPECT_EQ(batch[0].packet.timestamp(), batch[0].arrival);
+}
+
+TEST(ReceiveEngineTimestampTest, UdpDatagramsCarryKernelTimestamps)
+{
+    const int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    const int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(rx, 0);
+    sockaddr_in addr{};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(rx, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    socklen_t addrLen = sizeof(addr);
+    ASSERT_EQ(getsockname(rx, reinterpret_cast<sockaddr*>(&addr), &addrLen), 0);
+
+    ReceiveEngine engine(rx, 64, ReceiveEngine::Backend::RECVMMSG, 4);
+    const uint8_t payload[10] = {};
+    ASSERT_EQ(sendto(tx, payload, sizeof(payload), 0, reinterpret_cast<sockaddr*>(&addr), addrLen), 10);
+    // let the datagram wait in the socket, the arrival time has to be from before that
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    DatagramBatch batch;
+    ASSERT_EQ(engine.receive(batch), 1);
+    EXPECT_EQ(engine.getNKernelTimestamps(), 1);
+    EXPECT_GE(std::chrono::steady_clock::now() - batch[0].arrival, std::chrono::milliseconds(15));
+    close(rx);
+    close(tx);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Backends,
+    ReceiveEngineTest,
+    ::testing::Values(
+        ReceiveEngine::Backend::RECVFROM, ReceiveEngine::Backend::RECVMMSG, ReceiveEngine::Backend::IO_URING),
+    [](const auto& info) { return std::string(ReceiveEngine::backendName(info.param)); });
@@ -0,0 +1,42 @@
+#include "RtpJitterEstimator.h"  // the class under test
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+
+using namespace std::chrono;
+
+TEST(RtpJitterEstimatorTest, ConstantTransitHasNoJitter)
+{
+    RtpJitterEstimator jitter;
+    // 30 fps, every frame arrives exactly one frame interval later
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        jitter.add(1000 + i * 3000, steady_clock::time_point(seconds(5) + microseconds(i * 33333 + i / 3)));
+    }
+    EXPECT_LE(jitter.getJitter(), 1u);
+}
+
+TEST(RtpJitterEstimatorTest, ConvergesToTheTransitVariation)
+{
+    RtpJitterEstimator jitter;
+    // every other packet is 2 ms late, |D| is always 2 ms = 180 ticks
+    for (uint32_t i = 0; i < 500; i++)
+    {
+        const auto late = i % 2 ? milliseconds(2) : milliseconds(0);
+        jitter.add(i * 900, steady_clock::time_point(seconds(1) + microseconds(i * 10000) + late));
+    }
+    EXPECT_NEAR(jitter.getJitter(), 180, 2);
+    EXPECT_NEAR(jitter.getJitterTime().count(), 2000, 30);
+}
+
+TEST(RtpJitterEstimatorTest, HandlesTimestampWrapAround)
+{
+    RtpJitterEstimator jitter;
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        jitter.add(0xFFFFF000u + i * 900, steady_clock::time_point(microseconds(i * 10000)));
+    }
+    EXPECT_LE(jitter.getJitter(), 1u);
+    jitter.reset();
+    EXPECT_EQ(jitter.getJitter(), 0u);
+}
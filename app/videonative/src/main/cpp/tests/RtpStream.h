@@ -0,0 +1,154 @@
+//
+// RtpStream.h
+// RTP streams for the parser tests and benchmarks: single packets built by hand, H.264 NALUs split into FU-A
+// fragments like the air unit sends them, and a harness that runs a stream through H26XParser and keeps what it
+// forwards.
+//
+
+#ifndef FPVUE_TESTS_RTPSTREAM_H
+#define FPVUE_TESTS_RTPSTREAM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "parser/H26XParser.h"
+
+namespace RtpStream
+{
+using Packets = std::vector<std::vector<uint8_t>>;
+
+// An RTP packet (SSRC 2) with @param payload
+inline std::vector<uint8_t> rtp(
+    uint8_t payloadType, uint16_t seq, bool marker, const std::vector<uint8_t>& payload, uint32_t timestamp = 1)
+{
+    std::vector<uint8_t> packet(12 + payload.size());
+    packet[0] = 0x80;
+    packet[1] = (uint8_t) ((marker ? 0x80 : 0) | payloadType);
+    packet[2] = (uint8_t) (seq >> 8);
+    packet[3] = (uint8_t) seq;
+    for (int i = 0; i < 4; i++) packet[4 + i] = (uint8_t) (timestamp >> (24 - 8 * i));
+    packet[11] = 2;
+    std::copy(payload.begin(), payload.end(), packet.begin() + 12);
+    return packet;
+}
+
+// @param n bytes that differ from those with another @param seed, so a NALU spliced together from the wrong
+// fragments does not compare equal
+inline std::vector<uint8_t> bytes(size_t n, uint8_t seed)
+{
+    std::vector<uint8_t> ret(n);
+    for (size_t i = 0; i < n; i++) ret[i] = (uint8_t) (seed + i * 7 + 1);
+    return ret;
+}
+
+inline std::vector<uint8_t> concat(std::vector<uint8_t> a, const std::vector<uint8_t>& b)
+{
+    a.insert(a.end(), b.begin(), b.end());
+    return a;
+}
+
+// A copy of @param bytes in a buffer of @param pool
+inline PacketRef makePacket(PacketPool& pool, const std::vector<uint8_t>& bytes)
+{
+    PacketRef packet = pool.acquire();
+    std::memcpy(packet.data(), bytes.data(), bytes.size());
+    packet.setSize(bytes.size());
+    return packet;
+}
+
+// Splits H.264 NALUs into RTP packets: a single NAL unit packet if it fits, FU-A fragments of MTU_PAYLOAD otherwise
+class H264Packetizer
+{
+  public:
+    static constexpr size_t  MTU_PAYLOAD = 1400;
+    static constexpr uint8_t FILL        = 0x5A;
+
+    explicit H264Packetizer(uint16_t firstSeq = 0) : mSeq(firstSeq) {}
+
+    /**
+     * The packets of a NALU with @param header and @param size bytes after it, @param firstByte followed by FILL
+     * (0x88 starts a slice with first_mb_in_slice == 0). @param marker: the last packet of the frame.
+     */
+    std::vector<std::vector<uint8_t>> packetize(
+        uint8_t header, size_t size, uint32_t timestamp, bool marker, uint8_t firstByte = FILL)
+    {
+        std::vector<uint8_t> body(size, FILL);
+        if (size > 0) body[0] = firstByte;
+        if (size + 1 <= MTU_PAYLOAD)
+        {
+            return {rtp(RTP_PAYLOAD_TYPE_H264, mSeq++, marker, concat({header}, body), timestamp)};
+        }
+        std::vector<std::vector<uint8_t>> packets;
+        for (size_t off = 0; off < size; off += MTU_PAYLOAD - 2)
+        {
+            const size_t         n        = std::min(MTU_PAYLOAD - 2, size - off);
+            const bool           end      = off + n >= size;
+            std::vector<uint8_t> fragment = {
+                (uint8_t) ((header & 0x60) | 28), (uint8_t) ((off == 0 ? 0x80 : 0) | (end ? 0x40 : 0) | (header & 0x1F))};
+            fragment.insert(fragment.end(), body.begin() + (long) off, body.begin() + (long) (off + n));
+            packets.push_back(rtp(RTP_PAYLOAD_TYPE_H264, mSeq++, marker && end, fragment, timestamp));
+        }
+        return packets;
+    }
+
+  private:
+    uint16_t mSeq;
+};
+
+// What the parser forwarded, copied out of the NALU
+struct ParsedNALU
+{
+    std::vector<uint8_t> data;
+    bool                 keyFrame;
+    bool                 contiguous;
+    bool                 corrupted;
+    bool                 endOfAccessUnit;
+
+    bool operator==(const ParsedNALU& other) const
+    {
+        return data == other.data && keyFrame == other.keyFrame && contiguous == other.contiguous &&
+               corrupted == other.corrupted && endOfAccessUnit == other.endOfAccessUnit;
+    }
+};
+
+inline ParsedNALU toParsed(const NALU& nalu)
+{
+    std::vector<uint8_t> data(nalu.getSize());
+    nalu.copyTo(data.data());
+    return {data, nalu.is_keyframe(), nalu.isContiguous(), nalu.isCorrupted(), nalu.isEndOfAccessUnit()};
+}
+
+// An H26XParser that keeps every NALU it forwards
+struct ParseHarness
+{
+    std::vector<ParsedNALU>     nalus;
+    std::unique_ptr<H26XParser> parser =
+        std::make_unique<H26XParser>([this](const NALU& nalu) { nalus.push_back(toParsed(nalu)); });
+
+    /**
+     * Parses @param stream without the packets at the indices in @param lost, from buffers of @param pool if set,
+     * else from raw pointers. @return all NALUs forwarded so far.
+     */
+    const std::vector<ParsedNALU>& feed(
+        const Packets& stream, PacketPool* pool = nullptr, const std::vector<size_t>& lost = {})
+    {
+        for (size_t i = 0; i < stream.size(); i++)
+        {
+            if (std::find(lost.begin(), lost.end(), i) != lost.end()) continue;
+            if (pool != nullptr)
+            {
+                parser->parse_rtp_stream(makePacket(*pool, stream[i]));
+            }
+            else
+            {
+                parser->parse_rtp_stream(stream[i].data(), stream[i].size());
+            }
+        }
+        return nalus;
+    }
+};
+}  // namespace RtpStream
+
+#endif  // FPVUE_TESTS_RTPSTREAM_H
@@ -0,0 +1,83 @@
+#include "SpscRing.h"  // the class under test
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+TEST(SpscRingTest, RoundsCapacityUpAndReportsFull)
+{
+    SpscRing<int> ring(5);
+    EXPECT_EQ(ring.capacity(), 8u);
+    for (int i = 0; i < 8; i++)
+    {
+        int* slot = ring.writeSlot();
+        ASSERT_NE(slot, nullptr);
+        *slot = i;
+        ring.publish();
+    }
+    EXPECT_EQ(ring.writeSlot(), nullptr);
+    EXPECT_EQ(ring.size(), 8u);
+
+    ASSERT_NE(ring.readSlot(), nullptr);
+    EXPECT_EQ(*ring.readSlot(), 0);
+    ring.release();
+    EXPECT_NE(ring.writeSlot(), nullptr);
+}
+
+TEST(SpscRingTest, SlotsKeepTheirBuffers)
+{
+    SpscRing<std::vector<uint8_t>> ring(2);
+    for (int lap = 0; lap < 3; lap++)
+    {
+        std::vector<uint8_t>* slot = ring.writeSlot();
+        ASSERT_NE(slot, nullptr);
+        if (lap == 2)
+        {
+            // back at the first slot, the capacity from lap 0 is still there
+            EXPECT_GE(slot->capacity(), 1000u);
+        }
+        slot->assign(1000, (uint8_t) lap);
+        ring.publish();
+        EXPECT_EQ((*ring.readSlot())[0], lap);
+        ring.release();
+    }
+    EXPECT_TRUE(ring.empty());
+}
+
+TEST(SpscRingTest, TwoThreadsSeeEveryItemInOrder)
+{
+    constexpr uint32_t N = 200000;
+    SpscRing<uint32_t> ring(64);
+    std::thread        producer(
+        [&]
+        {
+            for (uint32_t i = 0; i < N;)
+            {
+                if (uint32_t* slot = ring.writeSlot())
+                {
+                    *slot = i++;
+                    ring.publish();
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    uint32_t expected = 0;
+    while (expected < N)
+    {
+        if (const uint32_t* slot = ring.readSlot())
+        {
+            ASSERT_EQ(*slot, expected);
+            expected++;
+            ring.release();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(ring.empty());
+}
@@ -0,0 +1,95 @@
+#include "parser/StaticH26XParser.h"  // the class under test
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "RtpStream.h"
+
+namespace
+{
+using namespace RtpStream;
+
+struct Collect
+{
+    std::vector<ParsedNALU>* nalus;
+
+    void operator()(const NALU& nalu) const { nalus->push_back(toParsed(nalu)); }
+};
+
+// STAP-A with SPS + PPS, FU-A start / middle / end with the marker, single NAL unit with the marker
+Packets h264Stream()
+{
+    return {
+        rtp(96, 1, false, {0x18, 0, 5, 0x67, 1, 2, 3, 4, 0, 3, 0x68, 5, 6}),
+        rtp(96, 2, false, concat({0x7C, 0x85, 0x88}, bytes(800, 2))),
+        rtp(96, 3, false, concat({0x7C, 0x05}, bytes(800, 3))),
+        rtp(96, 4, true, concat({0x7C, 0x45}, bytes(200, 4))),
+        rtp(96, 5, true, concat({0x41, 0x88}, bytes(60, 5))),
+    };
+}
+
+// AP with VPS + SPS, FU start / middle / end with the marker, single NAL unit with the marker
+Packets h265Stream()
+{
+    return {
+        rtp(97, 1, false, {0x60, 0x01, 0, 4, 0x40, 0x01, 1, 2, 0, 4, 0x42, 0x01, 3, 4}),
+        rtp(97, 2, false, concat({0x62, 0x01, 0x93, 0x80}, bytes(800, 2))),
+        rtp(97, 3, false, concat({0x62, 0x01, 0x13}, bytes(800, 3))),
+        rtp(97, 4, true, concat({0x62, 0x01, 0x53}, bytes(100, 4))),
+        rtp(97, 5, true, concat({0x02, 0x01, 0x80}, bytes(60, 5))),
+    };
+}
+
+template <bool IS_H265>
+std::vector<ParsedNALU> parseStatic(const Packets& stream, PacketPool* pool)
+{
+    std::vector<ParsedNALU> nalus;
+    auto                    parser = std::make_unique<StaticH26XParser<IS_H265, Collect>>(Collect{&nalus});
+    for (const auto& packet : stream)
+    {
+        EXPECT_EQ(parser->payloadType(packet.data(), packet.size()), parser->PAYLOAD_TYPE);
+        if (pool != nullptr)
+        {
+            parser->parse(makePacket(*pool, packet));
+        }
+        else
+        {
+            parser->parse(packet.data(), packet.size());
+        }
+    }
+    EXPECT_EQ(parser->nParsedNALUs, (long) nalus.size());
+    return nalus;
+}
+}  // namespace
+
+TEST(StaticH26XParserTest, H264SameNALUsAsTheRuntimeParser)
+{
+    auto pool = PacketPool::create(2048, 8);
+    for (PacketPool* p : {(PacketPool*) nullptr, pool.get()})
+    {
+        const auto expected = ParseHarness().feed(h264Stream(), p);
+        ASSERT_EQ(expected.size(), 4u);
+        EXPECT_EQ(expected[2].endOfAccessUnit, true);
+        EXPECT_EQ(parseStatic<false>(h264Stream(), p), expected);
+    }
+    EXPECT_EQ(pool->getNInUse(), 0u);
+}
+
+TEST(StaticH26XParserTest, H265SameNALUsAsTheRuntimeParser)
+{
+    auto pool = PacketPool::create(2048, 8);
+    for (PacketPool* p : {(PacketPool*) nullptr, pool.get()})
+    {
+        const auto expected = ParseHarness().feed(h265Stream(), p);
+        ASSERT_EQ(expected.size(), 4u);
+        EXPECT_EQ(expected[2].endOfAccessUnit, true);
+        EXPECT_EQ(parseStatic<true>(h265Stream(), p), expected);
+    }
+    EXPECT_EQ(pool->getNInUse(), 0u);
+}
+
+TEST(StaticH26XParserTest, PayloadTypeOfTooShortPacket)
+{
+    const std::vector<uint8_t> packet = {0x80, 96, 0, 1};
+    EXPECT_EQ((StaticH26XParser<false, Collect>::payloadType(packet.data(), packet.size())), 0);
+}
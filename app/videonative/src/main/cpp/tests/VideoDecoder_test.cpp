@@ -0,0 +1,442 @@
+#include "VideoDecoder.h"  // the class under test
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "FakeDecoderBackend.h"
+
+using namespace std::chrono;
+
+namespace
+{
+// x264, 1280x720 and 1920x1080 High profile (the SPS from H26X_test)
+const std::vector<uint8_t> H264_SPS_720P  = {0,    0,    0,    1,    0x67, 0x64, 0x00, 0x1F, 0xAC, 0xD9,
+                                             0x40, 0x50, 0x05, 0xBB, 0x01, 0x10, 0x00, 0x00, 0x03, 0x00,
+                                             0x10, 0x00, 0x00, 0x03, 0x03, 0xC0, 0xF1, 0x83, 0x19, 0x60};
+const std::vector<uint8_t> H264_SPS_1080P = {0,    0,    0,    1,    0x67, 0x64, 0x00, 0x28, 0xAC, 0xD9,
+                                             0x40, 0x78, 0x02, 0x27, 0xE5, 0x84, 0x00, 0x00, 0x03, 0x00,
+                                             0x04, 0x00, 0x00, 0x03, 0x00, 0xF0, 0x3C, 0x60, 0xC6, 0x58};
+const std::vector<uint8_t> H264_PPS       = {0, 0, 0, 1, 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0};
+
+std::vector<uint8_t> slice(bool idr)
+{
+    std::vector<uint8_t> data = {0, 0, 0, 1, (uint8_t) (idr ? 0x65 : 0x41), 0x88};
+    data.resize(200, 0x5A);
+    return data;
+}
+
+void feed(VideoDecoder& decoder, const std::vector<uint8_t>& data)
+{
+    NALU nalu(data.data(), data.size());
+    nalu.setEndOfAccessUnit(true);
+    decoder.interpretNALU(nalu);
+}
+
+// SPS, PPS, then a key frame and @param nFrames - 1 frames
+void feedGOP(VideoDecoder& decoder, int nFrames, const std::vector<uint8_t>& sps = H264_SPS_720P)
+{
+    feed(decoder, sps);
+    feed(decoder, H264_PPS);
+    for (int i = 0; i < nFrames; i++) feed(decoder, slice(i == 0));
+}
+
+// @param nFrames frames that are not key frames, one every @param interval as from a camera
+void feedPaced(VideoDecoder& decoder, int nFrames, milliseconds interval = milliseconds(5))
+{
+    for (int i = 0; i < nFrames; i++)
+    {
+        feed(decoder, slice(false));
+        std::this_thread::sleep_for(interval);
+    }
+}
+
+template <typename Condition>
+bool waitFor(Condition condition)
+{
+    const auto deadline = steady_clock::now() + seconds(5);
+    while (!condition())
+    {
+        if (steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+}
+
+// Owned by the decoder, stays valid until its backend is replaced
+FakeDecoderBackend* addFake(VideoDecoder& decoder, FakeDecoderBackend::Script script = {}, int idx = 0)
+{
+    auto                fake = std::make_unique<FakeDecoderBackend>(script);
+    FakeDecoderBackend* ret  = fake.get();
+    decoder.setBackend(std::move(fake), idx);
+    return ret;
+}
+}  // namespace
+
+TEST(VideoDecoderTest, ConfiguresFromTheParameterSetsAndDecodes)
+{
+    VideoDecoder     decoder(nullptr);
+    std::atomic<int> width = 0, height = 0;
+    decoder.registerOnDecoderRatioChangedCallback(
+        [&](const VideoRatio ratio)
+        {
+            width  = ratio.width;
+            height = ratio.height;
+        });
+    FakeDecoderBackend* fake = addFake(decoder);
+    feedGOP(decoder, 30);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 30; }));
+    const auto stats = fake->getStats();
+    EXPECT_EQ(stats.nCreated, 1);
+    EXPECT_EQ(stats.nConfigured, 1);
+    EXPECT_FALSE(stats.h265);
+    EXPECT_FALSE(stats.async);
+    // the parameter sets went in with configure(), only the frames were queued
+    EXPECT_EQ(stats.nQueuedBuffers, 30);
+    EXPECT_EQ(stats.nRendered, 30);
+    EXPECT_EQ(decoder.getFeedQueueStats().nInputBuffers, 30);
+    ASSERT_TRUE(waitFor([&] { return width == 1280; }));
+    EXPECT_EQ(height, 720);
+}
+
+TEST(VideoDecoderTest, AsyncModeDecodesThroughTheCallbacks)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAsyncMode(true);
+    FakeDecoderBackend* fake = addFake(decoder);
+    feedGOP(decoder, 30);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 30; }));
+    EXPECT_TRUE(fake->getStats().async);
+    EXPECT_EQ(fake->getStats().nRendered, 30);
+}
+
+TEST(VideoDecoderTest, AsyncModeFallsBackToPolling)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAsyncMode(true);
+    FakeDecoderBackend::Script script;
+    script.asyncSupported    = false;
+    FakeDecoderBackend* fake = addFake(decoder, script);
+    feedGOP(decoder, 30);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 30; }));
+    EXPECT_FALSE(fake->getStats().async);
+}
+
+TEST(VideoDecoderTest, StalledCodecDropsUntilTheNextKeyFrame)
+{
+    VideoDecoder decoder(nullptr);
+    // a stall the codec comes back from, not a wedge
+    decoder.setCodecWatchdog(0);
+    FakeDecoderBackend::Script script;
+    script.nInputBuffers     = 2;
+    script.stalls            = {{1, milliseconds(300)}};
+    FakeDecoderBackend* fake = addFake(decoder, script);
+    // the codec stalls after the second frame, the feed queue runs full behind it
+    feedGOP(decoder, 200);
+    const auto feedStats = decoder.getFeedQueueStats();
+    EXPECT_GT(feedStats.nDroppedFull, 0);
+    EXPECT_GT(feedStats.nDroppedUntilKeyFrame, 0);
+    // everything that was queued reaches the codec once it is back (only the SPS / PPS before the configure do not
+    // go into a buffer), and decoding resumes with the next key frame
+    const auto allDecoded = [&]
+    {
+        const auto stats   = decoder.getFeedQueueStats();
+        const long nQueued = fake->getStats().nQueuedBuffers;
+        return nQueued == stats.nQueued - 2 && stats.nDecodedFrames == nQueued;
+    };
+    ASSERT_TRUE(waitFor(allDecoded));
+    const long decoded = decoder.getFeedQueueStats().nDecodedFrames;
+    EXPECT_LT(decoded, 200);
+    for (int i = 0; i < 10; i++) feed(decoder, slice(i == 0));
+    ASSERT_TRUE(waitFor(allDecoded));
+    EXPECT_EQ(decoder.getFeedQueueStats().nDecodedFrames, decoded + 10);
+}
+
+TEST(VideoDecoderTest, NewSPSReconfiguresTheCodec)
+{
+    VideoDecoder     decoder(nullptr);
+    std::atomic<int> width = 0;
+    decoder.registerOnDecoderRatioChangedCallback([&](const VideoRatio ratio) { width = ratio.width; });
+    FakeDecoderBackend* fake = addFake(decoder);
+    feedGOP(decoder, 5);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 5; }));
+    // the same SPS again does not touch the codec, SPS and PPS are queued as any other NALU
+    feedGOP(decoder, 5);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 12; }));
+    EXPECT_EQ(fake->getStats().nConfigured, 1);
+    feedGOP(decoder, 5, H264_SPS_1080P);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 17; }));
+    const auto stats = fake->getStats();
+    EXPECT_EQ(stats.nCreated, 1);
+    EXPECT_EQ(stats.nConfigured, 2);
+    EXPECT_EQ(stats.nStarted, 2);
+    EXPECT_EQ(stats.height, 1080);
+    ASSERT_TRUE(waitFor([&] { return width == 1920; }));
+}
+
+TEST(VideoDecoderTest, ReplacedBackendStartsWithTheCachedParameterSets)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAsyncMode(true);
+    decoder.setGopCacheLimit(0);
+    addFake(decoder);
+    feedGOP(decoder, 5);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 5; }));
+    decoder.setBackend(nullptr, 0);
+    FakeDecoderBackend* fake = addFake(decoder);
+    // configured right away, decoding starts with the next key frame
+    feed(decoder, slice(false));
+    for (int i = 0; i < 5; i++) feed(decoder, slice(i == 0));
+    ASSERT_TRUE(waitFor([&] { return fake->getStats().nRendered == 5; }));
+    EXPECT_EQ(fake->getStats().nConfigured, 1);
+    EXPECT_EQ(fake->getStats().nQueuedBuffers, 5);
+}
+
+TEST(VideoDecoderTest, ParkedCodecShowsTheNextFrameOnTheNewSurface)
+{
+    VideoDecoder        decoder(nullptr);
+    FakeDecoderBackend* fake = addFake(decoder);
+    feedGOP(decoder, 5);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 5; }));
+    decoder.detachSurface(0);
+    EXPECT_TRUE(fake->getStats().parked);
+    // still decoding, nothing is rendered
+    for (int i = 0; i < 5; i++) feed(decoder, slice(false));
+    ASSERT_TRUE(waitFor([&] { return fake->getStats().nOutputs == 10; }));
+    EXPECT_EQ(fake->getStats().nRendered, 5);
+    decoder.attachSurface(std::make_unique<FakeDecoderBackend>(), 0);
+    // the frame after the resume is shown, no key frame needed
+    feed(decoder, slice(false));
+    ASSERT_TRUE(waitFor([&] { return fake->getStats().nRendered == 6; }));
+    const auto stats = fake->getStats();
+    EXPECT_FALSE(stats.parked);
+    EXPECT_EQ(stats.nSurfaceChanges, 2);
+    EXPECT_EQ(stats.nCreated, 1);
+    EXPECT_EQ(stats.nConfigured, 1);
+}
+
+TEST(VideoDecoderTest, CodecThatCannotSwitchSurfacesIsCreatedAgain)
+{
+    VideoDecoder               decoder(nullptr);
+    FakeDecoderBackend::Script script;
+    script.surfaceChangeSupported = false;
+    addFake(decoder, script);
+    feedGOP(decoder, 5);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 5; }));
+    decoder.detachSurface(0);
+    auto                surface = std::make_unique<FakeDecoderBackend>();
+    FakeDecoderBackend* fake    = surface.get();
+    decoder.attachSurface(std::move(surface), 0);
+    EXPECT_EQ(fake->getStats().nCreated, 0);
+    // the new codec is configured with the next NALU and gets the GOP up to it, which is not shown
+    feed(decoder, slice(false));
+    ASSERT_TRUE(waitFor([&] { return fake->getStats().nOutputs == 6; }));
+    EXPECT_EQ(fake->getStats().nRendered, 0);
+    EXPECT_EQ(decoder.getFeedQueueStats().nPrimedNALUs, 6);
+    // the frame after it is
+    feed(decoder, slice(false));
+    ASSERT_TRUE(waitFor([&] { return fake->getStats().nRendered == 1; }));
+    EXPECT_EQ(fake->getStats().nConfigured, 1);
+    EXPECT_EQ(fake->getStats().nQueuedBuffers, 7);
+}
+
+TEST(VideoDecoderTest, CodecConfiguredInTheMiddleOfAGOPStartsFromTheCache)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAccessUnitMode(true);
+    // the stream runs before there is a surface
+    feedGOP(decoder, 20);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().gopCacheBytes == 20 * 200; }));
+    FakeDecoderBackend::Script script;
+    script.waitForKeyFrame   = true;
+    FakeDecoderBackend* fake = addFake(decoder, script);
+    for (int i = 0; i < 5; i++) feed(decoder, slice(false));
+    ASSERT_TRUE(waitFor([&] { return fake->getStats().nRendered == 4; }));
+    // one input buffer per frame: the key frame, 19 + 1 frames of the cache, then the stream
+    const auto stats = fake->getStats();
+    EXPECT_EQ(stats.nQueuedBuffers, 25);
+    EXPECT_EQ(stats.nBeforeKeyFrame, 0);
+    EXPECT_EQ(stats.nOutputs, 25);
+    EXPECT_EQ(decoder.getFeedQueueStats().nDecodedFrames, 4);
+}
+
+TEST(VideoDecoderTest, VRModeSecondCodecStartsFromTheCache)
+{
+    VideoDecoder        decoder(nullptr);
+    FakeDecoderBackend* left = addFake(decoder, {}, 0);
+    feedGOP(decoder, 10);
+    ASSERT_TRUE(waitFor([&] { return left->getStats().nRendered == 10; }));
+    FakeDecoderBackend::Script script;
+    script.waitForKeyFrame    = true;
+    FakeDecoderBackend* right = addFake(decoder, script, 1);
+    for (int i = 0; i < 10; i++) feed(decoder, slice(false));
+    ASSERT_TRUE(waitFor([&] { return left->getStats().nRendered == 20 && right->getStats().nRendered == 9; }));
+    EXPECT_EQ(right->getStats().nConfigured, 1);
+    EXPECT_EQ(right->getStats().nOutputs, 20);
+}
+
+TEST(VideoDecoderTest, WedgedCodecIsFlushedAndPrimedFromTheCache)
+{
+    VideoDecoder               decoder(nullptr);
+    FakeDecoderBackend::Script script;
+    script.wedgeAtInput      = 10;
+    FakeDecoderBackend* fake = addFake(decoder, script);
+    feedGOP(decoder, 10);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 10; }));
+    // nothing comes out for the watchdog timeout (MIN_TIMEOUT at this frame rate), the feed queue does not run full
+    feedPaced(decoder, 80);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().lastRecoveryUs > 0; }));
+    const auto stats = decoder.getFeedQueueStats();
+    EXPECT_EQ(stats.nWatchdogFlushes, 1);
+    EXPECT_EQ(stats.nWatchdogRecreates, 0);
+    EXPECT_EQ(stats.nDroppedFull, 0);
+    EXPECT_GT(stats.nPrimedNALUs, 10);
+    EXPECT_EQ(fake->getStats().nFlushes, 1);
+    EXPECT_EQ(fake->getStats().nCreated, 1);
+    // the 4 frames in the wedged codec are gone with the flush, then every frame is shown again
+    ASSERT_TRUE(waitFor([&] { return fake->getStats().nOutputs + 4 == fake->getStats().nQueuedBuffers; }));
+    const long rendered = fake->getStats().nRendered;
+    feedPaced(decoder, 10);
+    ASSERT_TRUE(waitFor([&] { return fake->getStats().nRendered == rendered + 10; }));
+    // each of the 100 frames once after the flush, from the cache or the stream
+    EXPECT_EQ(fake->getStats().nQueuedBuffers, 14 + 100);
+}
+
+TEST(VideoDecoderTest, CodecThatStaysWedgedIsCreatedAgain)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAsyncMode(true);
+    decoder.setCodecWatchdog(10);
+    FakeDecoderBackend::Script script;
+    script.wedgeAtInput       = 10;
+    script.wedgeSurvivesFlush = true;
+    FakeDecoderBackend* fake  = addFake(decoder, script);
+    feedGOP(decoder, 10);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 10; }));
+    // flushed after the timeout, still wedged after another one
+    feedPaced(decoder, 60, milliseconds(10));
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().lastRecoveryUs > 0; }));
+    const auto stats = decoder.getFeedQueueStats();
+    EXPECT_EQ(stats.nWatchdogFlushes, 1);
+    EXPECT_EQ(stats.nWatchdogRecreates, 1);
+    EXPECT_EQ(stats.nDroppedFull, 0);
+    // from the first reset on, a flush and a timeout
+    EXPECT_GE(stats.lastRecoveryUs, duration_cast<microseconds>(CodecWatchdog::MIN_TIMEOUT).count());
+    EXPECT_EQ(fake->getStats().nFlushes, 1);
+    EXPECT_EQ(fake->getStats().nCreated, 2);
+    EXPECT_TRUE(fake->getStats().async);
+    const long decoded = decoder.getFeedQueueStats().nDecodedFrames;
+    ASSERT_TRUE(waitFor([&] { return fake->getStats().nOutputs + 4 == fake->getStats().nQueuedBuffers; }));
+    feedPaced(decoder, 10);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames >= decoded + 10; }));
+}
+
+TEST(VideoDecoderTest, CodecThatReportsAnErrorIsCreatedAgainRightAway)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAsyncMode(true);
+    FakeDecoderBackend::Script script;
+    script.wedgeAtInput       = 10;
+    script.wedgeSurvivesFlush = true;
+    script.errorAtWedge       = true;
+    FakeDecoderBackend* fake  = addFake(decoder, script);
+    feedGOP(decoder, 10);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 10; }));
+    feedPaced(decoder, 20, milliseconds(10));
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().lastRecoveryUs > 0; }));
+    const auto stats = decoder.getFeedQueueStats();
+    // not flushed first, and without waiting for the timeout
+    EXPECT_EQ(stats.nWatchdogFlushes, 0);
+    EXPECT_EQ(stats.nWatchdogRecreates, 1);
+    EXPECT_LT(stats.lastRecoveryUs, duration_cast<microseconds>(CodecWatchdog::MIN_TIMEOUT).count());
+    EXPECT_EQ(fake->getStats().nErrors, 1);
+    EXPECT_EQ(fake->getStats().nFlushes, 0);
+    EXPECT_EQ(fake->getStats().nCreated, 2);
+}
+
+TEST(VideoDecoderTest, CodecThatReportsARecoverableErrorIsConfiguredAgain)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAsyncMode(true);
+    FakeDecoderBackend::Script script;
+    script.wedgeAtInput       = 10;
+    script.wedgeSurvivesFlush = true;
+    script.errorAtWedge       = true;
+    script.errorActionCode    = AsyncCodecListener::ACTION_RECOVERABLE;
+    FakeDecoderBackend* fake  = addFake(decoder, script);
+    feedGOP(decoder, 10);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().nDecodedFrames == 10; }));
+    feedPaced(decoder, 20, milliseconds(10));
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().lastRecoveryUs > 0; }));
+    const auto stats = decoder.getFeedQueueStats();
+    // the same codec, stopped and configured again
+    EXPECT_EQ(stats.nWatchdogRecreates, 0);
+    EXPECT_LT(stats.lastRecoveryUs, duration_cast<microseconds>(CodecWatchdog::MIN_TIMEOUT).count());
+    EXPECT_EQ(fake->getStats().nErrors, 1);
+    EXPECT_EQ(fake->getStats().nFlushes, 0);
+    EXPECT_EQ(fake->getStats().nCreated, 1);
+    EXPECT_EQ(fake->getStats().nConfigured, 2);
+}
+
+TEST(VideoDecoderTest, VRModeWedgedCodecRecoversWithoutTheOther)
+{
+    VideoDecoder               decoder(nullptr);
+    FakeDecoderBackend*        left = addFake(decoder, {}, 0);
+    FakeDecoderBackend::Script script;
+    script.wedgeAtInput       = 10;
+    FakeDecoderBackend* right = addFake(decoder, script, 1);
+    feedGOP(decoder, 10);
+    ASSERT_TRUE(waitFor([&] { return left->getStats().nRendered == 10 && right->getStats().nRendered == 10; }));
+    feedPaced(decoder, 80);
+    ASSERT_TRUE(waitFor([&] { return decoder.getFeedQueueStats().lastRecoveryUs > 0; }));
+    ASSERT_TRUE(waitFor([&] { return left->getStats().nRendered == 90; }));
+    EXPECT_EQ(left->getStats().nFlushes, 0);
+    EXPECT_EQ(right->getStats().nFlushes, 1);
+    EXPECT_EQ(decoder.getFeedQueueStats().nDroppedFeeder, 0);
+    // what the feeder of the right codec still had was fed with the priming, not again
+    ASSERT_TRUE(waitFor([&] { return right->getStats().nOutputs + 4 == right->getStats().nQueuedBuffers; }));
+    const long rendered = right->getStats().nRendered;
+    feedPaced(decoder, 10);
+    ASSERT_TRUE(waitFor([&] { return right->getStats().nRendered == rendered + 10; }));
+    EXPECT_EQ(right->getStats().nQueuedBuffers, 14 + 100);
+    EXPECT_EQ(left->getStats().nRendered, 100);
+}
+
+TEST(VideoDecoderTest, VRModeFeedsBothCodecsIndependently)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setCodecWatchdog(0);
+    FakeDecoderBackend*        left = addFake(decoder, {}, 0);
+    FakeDecoderBackend::Script script;
+    script.stalls             = {{1, milliseconds(500)}};
+    FakeDecoderBackend* right = addFake(decoder, script, 1);
+    feedGOP(decoder, 30);
+    // the right codec hangs after its second frame, the left one does not wait for it
+    ASSERT_TRUE(waitFor([&] { return left->getStats().nRendered == 30; }));
+    EXPECT_LT(right->getStats().nRendered, 30);
+    ASSERT_TRUE(waitFor([&] { return right->getStats().nRendered == 30; }));
+    EXPECT_EQ(decoder.getFeedQueueStats().nDroppedFeeder, 0);
+    // every frame was output by both, late on the right while it hung
+    const auto skew = decoder.getOutputSkew();
+    EXPECT_EQ(skew.nPairs, 30);
+    EXPECT_GT(skew.avgSkew_ms(), 0);
+    EXPECT_GE(skew.maxAbsSkewUs, 300000);
+}
+
+TEST(VideoDecoderTest, VRModeInAccessUnitModeAndBackToOneCodec)
+{
+    VideoDecoder decoder(nullptr);
+    decoder.setAccessUnitMode(true);
+    decoder.setAsyncMode(true);
+    FakeDecoderBackend* left  = addFake(decoder, {}, 0);
+    FakeDecoderBackend* right = addFake(decoder, {}, 1);
+    feedGOP(decoder, 20);
+    ASSERT_TRUE(waitFor([&] { return left->getStats().nRendered == 20 && right->getStats().nRendered == 20; }));
+    EXPECT_EQ(left->getStats().nQueuedBuffers, right->getStats().nQueuedBuffers);
+    // the right eye is gone, the left codec is fed by the feed thread again
+    decoder.setBackend(nullptr, 1);
+    for (int i = 0; i < 10; i++) feed(decoder, slice(false));
+    ASSERT_TRUE(waitFor([&] { return left->getStats().nRendered == 30; }));
+}
@@ -0,0 +1,44 @@
+//
+// Minimal stand-in for the NDK <android/log.h> so that the native sources can be compiled and benchmarked on a
+// desktop host. Everything goes to stderr.
+//
+
+#ifndef FPVUE_HOST_ANDROID_LOG_H
+#define FPVUE_HOST_ANDROID_LOG_H
+
+#include <cstdarg>
+#include <cstdio>
+
+typedef enum android_LogPriority
+{
+    ANDROID_LOG_UNKNOWN = 0,
+    ANDROID_LOG_DEFAULT,
+    ANDROID_LOG_VERBOSE,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+    ANDROID_LOG_SILENT,
+} android_LogPriority;
+
+static inline int __android_log_vprint(int prio, const char* tag, const char* fmt, va_list ap)
+{
+    // Debug output is noise in benchmarks, only forward warnings and errors
+    if (prio < ANDROID_LOG_WARN) return 0;
+    std::fprintf(stderr, "%s: ", tag);
+    const int ret = std::vfprintf(stderr, fmt, ap);
+    std::fputc('\n', stderr);
+    return ret;
+}
+
+static inline int __android_log_print(int prio, const char* tag, const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    const int ret = __android_log_vprint(prio, tag, fmt, ap);
+    va_end(ap);
+    return ret;
+}
+
+#endif  // FPVUE_HOST_ANDROID_LOG_H
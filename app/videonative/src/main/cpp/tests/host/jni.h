@@ -0,0 +1,8 @@
+// Host stand-in for the NDK <jni.h>, enough for headers that only pass JavaVM* around.
+#ifndef HOST_JNI_H
+#define HOST_JNI_H
+
+struct _JavaVM;
+typedef _JavaVM JavaVM;
+
+#endif  // HOST_JNI_H
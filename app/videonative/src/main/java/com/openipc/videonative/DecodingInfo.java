@@ -13,6 +13,13 @@ public class DecodingInfo {
     public final float avgWaitForInputBTime_ms;
     public final float avgHWDecodingTime_ms; //time the hw decoder was holding on to frames. Not the full decoding time !
     public final float avgTotalDecodingTime_ms;
+    public final float rtpJitter_ms; //RFC 3550 interarrival jitter of the video stream
+    public final float avgKernelToUserDelay_ms; //time a packet waited in the socket (included in avgParsingTime_ms)
+    public final float avgSliceLeadTime_ms; //slice streaming: first slice of a frame at the codec before the whole frame
+    public final float avgDecodingTimeOriginalSPS_ms; //avgHWDecodingTime_ms with the SPS as sent by the camera
+    public final float avgDecodingTimeLowLatencySPS_ms; //avgHWDecodingTime_ms with the SPS rewritten to zero reorder
+    public final float avgKeyFrameRecovery_ms; //time from a gap in the stream to the next complete key frame
+    public final float avgStereoSkew_ms; //VR mode: time between the left and the right decoder outputting a frame
     public final int nNALU;
     public final int nNALUSFeeded;
     public final int nDecodedFrames;
@@ -24,6 +31,13 @@ public class DecodingInfo {
         avgParsingTime_ms = 0;
         avgWaitForInputBTime_ms = 0;
         avgHWDecodingTime_ms = 0;
+        rtpJitter_ms = 0;
+        avgKernelToUserDelay_ms = 0;
+        avgSliceLeadTime_ms = 0;
+        avgDecodingTimeOriginalSPS_ms = 0;
+        avgDecodingTimeLowLatencySPS_ms = 0;
+        avgKeyFrameRecovery_ms = 0;
+        avgStereoSkew_ms = 0;
         nNALU = 0;
         nNALUSFeeded = 0;
         avgTotalDecodingTime_ms = 0;
@@ -33,6 +47,9 @@ public class DecodingInfo {
 
     public DecodingInfo(float currentFPS, float currentKiloBitsPerSecond, float avgParsingTime_ms,
                         float avgWaitForInputBTime_ms, float avgHWDecodingTime_ms,
+                        float rtpJitter_ms, float avgKernelToUserDelay_ms, float avgSliceLeadTime_ms,
+                        float avgDecodingTimeOriginalSPS_ms, float avgDecodingTimeLowLatencySPS_ms,
+                        float avgKeyFrameRecovery_ms, float avgStereoSkew_ms,
                         int nNALU, int nNALUSFeeded, int nDecodedFrames, int nCodec) {
         this.currentFPS = currentFPS;
         this.currentKiloBitsPerSecond = currentKiloBitsPerSecond;
@@ -40,6 +57,13 @@ public class DecodingInfo {
         this.avgWaitForInputBTime_ms = avgWaitForInputBTime_ms;
         this.avgHWDecodingTime_ms = avgHWDecodingTime_ms;
         this.avgTotalDecodingTime_ms = avgParsingTime_ms + avgWaitForInputBTime_ms + avgHWDecodingTime_ms;
+        this.rtpJitter_ms = rtpJitter_ms;
+        this.avgKernelToUserDelay_ms = avgKernelToUserDelay_ms;
+        this.avgSliceLeadTime_ms = avgSliceLeadTime_ms;
+        this.avgDecodingTimeOriginalSPS_ms = avgDecodingTimeOriginalSPS_ms;
+        this.avgDecodingTimeLowLatencySPS_ms = avgDecodingTimeLowLatencySPS_ms;
+        this.avgKeyFrameRecovery_ms = avgKeyFrameRecovery_ms;
+        this.avgStereoSkew_ms = avgStereoSkew_ms;
         this.nNALU = nNALU;
         this.nNALUSFeeded = nNALUSFeeded;
         this.nDecodedFrames = nDecodedFrames;
@@ -52,6 +76,13 @@ public class DecodingInfo {
         decodingInfo.put("avgParsingTime_ms", avgParsingTime_ms);
         decodingInfo.put("avgWaitForInputBTime_ms", avgWaitForInputBTime_ms);
         decodingInfo.put("avgHWDecodingTime_ms", avgHWDecodingTime_ms);
+        decodingInfo.put("avgKernelToUserDelay_ms", avgKernelToUserDelay_ms);
+        decodingInfo.put("avgSliceLeadTime_ms", avgSliceLeadTime_ms);
+        decodingInfo.put("avgDecodingTimeOriginalSPS_ms", avgDecodingTimeOriginalSPS_ms);
+        decodingInfo.put("avgDecodingTimeLowLatencySPS_ms", avgDecodingTimeLowLatencySPS_ms);
+        decodingInfo.put("avgKeyFrameRecovery_ms", avgKeyFrameRecovery_ms);
+        decodingInfo.put("avgStereoSkew_ms", avgStereoSkew_ms);
+        decodingInfo.put("rtpJitter_ms", rtpJitter_ms);
         decodingInfo.put("currentFPS", currentFPS);
         decodingInfo.put("currentKiloBitsPerSecond", currentKiloBitsPerSecond);
         decodingInfo.put("nNALU", nNALU);
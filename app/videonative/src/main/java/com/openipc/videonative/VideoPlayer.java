@@ -3,6 +3,9 @@ package com.openipc.videonative;
 import android.content.Context;
 import android.content.res.AssetManager;
 import android.graphics.SurfaceTexture;
+import android.media.MediaCodecInfo;
+import android.media.MediaCodecList;
+import android.media.MediaFormat;
 import android.os.Looper;
 import android.util.Log;
 import android.view.Surface;
@@ -22,6 +25,10 @@ import java.util.TimerTask;
  */
 public class VideoPlayer implements IVideoParamsChanged {
     private static final String TAG = "pixelpilot";
+    // setLossPolicy(), same values as RTPLossPolicy on the native side
+    public static final int LOSS_POLICY_DROP = 0;
+    public static final int LOSS_POLICY_ZERO_FILL = 1;
+    public static final int LOSS_POLICY_TRUNCATE = 2;
 
     //All the native binding(s)
     static {
@@ -57,6 +64,24 @@ public class VideoPlayer implements IVideoParamsChanged {
     public static native boolean nativeIsRecording(long nativeInstance);
     public static native void nativeStartAudio(long nativeInstance);
     public static native void nativeStopAudio(long nativeInstance);
+    public static native void nativeSetJitterBufferDeadline(long nativeInstance, int maxWaitUs);
+    public static native void nativeSetAccessUnitMode(long nativeInstance, boolean enabled);
+    public static native void nativeSetSliceStreaming(long nativeInstance, boolean enabled,
+                                                      boolean partialFramesH264, boolean partialFramesH265);
+    public static native void nativeSetLowLatencySPS(long nativeInstance, boolean enabled);
+    public static native void nativeSetAsyncDecoder(long nativeInstance, boolean enabled);
+    public static native void nativeSetCatchUpBudget(long nativeInstance, int budgetMs);
+    public static native void nativeSetGopCacheLimit(long nativeInstance, int limitKb);
+    public static native void nativeSetCodecWatchdog(long nativeInstance, int frameIntervals);
+    public static native void nativeSetLossPolicy(long nativeInstance, boolean h265, int policy);
+
+    public static native void nativeSetKeyFrameRequester(long nativeInstance, long function, long context);
+
+    public static native void nativeSetLatencyTrace(long nativeInstance, boolean enabled);
+    public static native boolean nativeDumpLatencyTrace(long nativeInstance, String path, int seconds);
+
+    public static native String nativeGetMetrics(long nativeInstance);
+    public static native boolean nativeSetMetricsEndpoint(long nativeInstance, int port);
 
     //get members or other information. Some might be only usable in between (nativeStart <-> nativeStop)
     public static native String getVideoInfoString(long nativeInstance);
@@ -120,6 +145,155 @@ public class VideoPlayer implements IVideoParamsChanged {
         nativeStopAudio(nativeVideoPlayer);
     }
 
+    /**
+     * Wait at most maxWaitUs for a missing packet before skipping it (less if the measured reordering allows).
+     * 0 restores the default packet count based reordering.
+     */
+    public void setJitterBufferDeadline(int maxWaitUs)
+    {
+        nativeSetJitterBufferDeadline(nativeVideoPlayer, maxWaitUs);
+    }
+
+    /**
+     * Queue each frame to the decoder in one input buffer instead of one buffer per NALU.
+     * Off by default.
+     */
+    public void setAccessUnitMode(boolean enabled)
+    {
+        nativeSetAccessUnitMode(nativeVideoPlayer, enabled);
+    }
+
+    /**
+     * Hand every slice to the decoder as soon as it is complete, as a partial frame if the decoder supports it
+     * (else in its own buffer). Takes precedence over setAccessUnitMode.
+     */
+    public void setSliceStreaming(boolean enabled)
+    {
+        nativeSetSliceStreaming(nativeVideoPlayer, enabled,
+                enabled && supportsPartialFrames(MediaFormat.MIMETYPE_VIDEO_AVC),
+                enabled && supportsPartialFrames(MediaFormat.MIMETYPE_VIDEO_HEVC));
+    }
+
+    /**
+     * Rewrite the SPS to announce zero reordered frames, so the decoder outputs every frame right away instead of
+     * holding back a few. DecodingInfo has the decoding time with and without it. Off by default.
+     */
+    public void setLowLatencySPS(boolean enabled)
+    {
+        nativeSetLowLatencySPS(nativeVideoPlayer, enabled);
+    }
+
+    /**
+     * Run the decoder in asynchronous mode (Android 9+): MediaCodec reports free input buffers and decoded frames
+     * itself instead of being polled, without an output thread per decoder. Applies to decoders created afterwards,
+     * ignored on older devices. Off by default.
+     */
+    public void setAsyncDecoder(boolean enabled)
+    {
+        nativeSetAsyncDecoder(nativeVideoPlayer, enabled);
+    }
+
+    /**
+     * Catch-up mode: when frames reach the decoder more than budgetMs after they were received (after a GC pause or
+     * a decoder stall), skip the non-reference frames and, if that is not enough, everything up to the next key
+     * frame instead of decoding the backlog. 0 (default) disables it.
+     */
+    public void setCatchUpBudget(int budgetMs)
+    {
+        nativeSetCatchUpBudget(nativeVideoPlayer, budgetMs);
+    }
+
+    /**
+     * Memory for the frames since the last key frame (default 8 MB). A decoder that starts in the middle of a GOP
+     * (surface attached, VR mode) decodes them without showing them and shows the next frame right away instead of
+     * waiting for the next key frame. 0 disables it.
+     */
+    public void setGopCacheLimit(int limitKb)
+    {
+        nativeSetGopCacheLimit(nativeVideoPlayer, limitKb);
+    }
+
+    /**
+     * Codec watchdog: a decoder that outputs nothing for frameIntervals frames (at least 200 ms) while the stream
+     * keeps coming is flushed, or created again if that does not help, and restarted from the last key frame instead
+     * of leaving the video frozen. 0 disables it, the default is 30.
+     */
+    public void setCodecWatchdog(int frameIntervals)
+    {
+        nativeSetCodecWatchdog(nativeVideoPlayer, frameIntervals);
+    }
+
+    /**
+     * What happens to a NALU when packets in the middle of it were lost, per codec: LOSS_POLICY_DROP discards it
+     * (the default), LOSS_POLICY_ZERO_FILL replaces the lost packets by zeros, LOSS_POLICY_TRUNCATE forwards it up to
+     * the first lost packet. The decoder conceals the damage of a forwarded NALU instead of losing the whole frame.
+     */
+    public void setLossPolicy(boolean h265, int policy)
+    {
+        nativeSetLossPolicy(nativeVideoPlayer, h265, policy);
+    }
+
+    /**
+     * Request a key frame from the link right away whenever packets are lost for good. function is a native
+     * void (*)(void* context) that must not block, e.g. from WfbNgLink.getKeyFrameRequestFunction(), context has to
+     * stay valid while it is set. function = 0 turns it off.
+     */
+    public void setKeyFrameRequester(long function, long context)
+    {
+        nativeSetKeyFrameRequester(nativeVideoPlayer, function, context);
+    }
+
+    /**
+     * Timestamp every video frame at each stage from the socket to the surface, see dumpLatencyTrace. Off by
+     * default.
+     */
+    public void setLatencyTrace(boolean enabled)
+    {
+        nativeSetLatencyTrace(nativeVideoPlayer, enabled);
+    }
+
+    /**
+     * Write the traced frames of the last seconds to path as Chrome trace JSON, to be opened in ui.perfetto.dev or
+     * chrome://tracing. False if the file could not be written.
+     */
+    public boolean dumpLatencyTrace(String path, int seconds)
+    {
+        return nativeDumpLatencyTrace(nativeVideoPlayer, path, seconds);
+    }
+
+    /**
+     * All counters, gauges and latency histograms (p50/p95/p99/max) of the native pipeline, in the Prometheus text
+     * format.
+     */
+    public String getMetrics()
+    {
+        return nativeGetMetrics(nativeVideoPlayer);
+    }
+
+    /**
+     * Serve getMetrics() on 127.0.0.1:port (reachable with adb forward), 0 stops it. False if the port could not be
+     * bound.
+     */
+    public boolean setMetricsEndpoint(int port)
+    {
+        return nativeSetMetricsEndpoint(nativeVideoPlayer, port);
+    }
+
+    // True if the decoder the native side gets for mime (the first one listed) accepts partial frames
+    private static boolean supportsPartialFrames(String mime)
+    {
+        for (MediaCodecInfo info : new MediaCodecList(MediaCodecList.REGULAR_CODECS).getCodecInfos()) {
+            if (info.isEncoder()) continue;
+            for (String type : info.getSupportedTypes()) {
+                if (type.equalsIgnoreCase(mime)) {
+                    return info.getCapabilitiesForType(type)
+                            .isFeatureSupported(MediaCodecInfo.CodecCapabilities.FEATURE_PartialFrame);
+                }
+            }
+        }
+        return false;
+    }
+
     public boolean isRunning() {
         return timer != null;
     }
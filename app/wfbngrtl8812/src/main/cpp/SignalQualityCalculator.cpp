@@ -5,22 +5,24 @@
 
 namespace {
 
-std::string generate_random_string(size_t length) {
-    const std::string characters = "abcdefghijklmnopqrstuvwxyz";
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(0, characters.size() - 1);
-
-    std::string result;
-    result.reserve(length);
-    for (size_t i = 0; i < length; ++i) {
-        result += characters[distrib(gen)];
-    }
-    return result;
-}
+// 4 lower case letters
+constexpr uint32_t kIdrCodeCount = 26 * 26 * 26 * 26;
 
 } // namespace
 
+SignalQualityCalculator::SignalQualityCalculator() : m_idr_salt(std::random_device{}() % kIdrCodeCount) {}
+
+std::string SignalQualityCalculator::idr_code() const {
+    // The request count in base 26, no two of the last kIdrCodeCount requests share a code
+    uint32_t n = (m_idr_salt + m_idr_requests.load(std::memory_order_relaxed) % kIdrCodeCount) % kIdrCodeCount;
+    std::string code(4, 'a');
+    for (char &c : code) {
+        c = static_cast<char>('a' + n % 26);
+        n /= 26;
+    }
+    return code;
+}
+
 // Remove RSSI samples older than 1 second
 void SignalQualityCalculator::cleanup_old_rssi_data() {
     auto now = std::chrono::steady_clock::now();
@@ -104,7 +106,7 @@ SignalQualityCalculator::SignalQuality SignalQualityCalculator::calculate_signal
     ret.recovered_last_second = p_recovered;
 
     ret.snr = avg_snr;
-    ret.idr_code = m_idr_code;
+    ret.idr_code = idr_code();
 
     cleanup_old_rssi_data();
     cleanup_old_snr_data();
@@ -152,7 +154,7 @@ void SignalQualityCalculator::add_fec_data(uint32_t p_all, uint32_t p_recovered,
     entry.lost = p_lost;
 
     if (p_lost > 0) {
-        m_idr_code = generate_random_string(4);
+        request_idr();
     }
 
     m_fec_data.push_back(entry);
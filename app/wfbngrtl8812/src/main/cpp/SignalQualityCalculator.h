@@ -1,6 +1,7 @@
 #pragma once
 #include <algorithm>
 #include <android/log.h>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <mutex>
@@ -20,7 +21,7 @@ class SignalQualityCalculator {
         std::string idr_code;
     };
 
-    SignalQualityCalculator() = default;
+    SignalQualityCalculator();
     ~SignalQualityCalculator() = default;
 
     void add_rssi(uint8_t ant1, uint8_t ant2);
@@ -55,6 +56,10 @@ class SignalQualityCalculator {
 
     SignalQuality calculate_signal_quality();
 
+    // Rotates the IDR request code, the drone sends one keyframe for each new code it sees. Lock free, can be called
+    // from any thread; the code goes out with the next link quality message.
+    void request_idr() { m_idr_requests.fetch_add(1, std::memory_order_relaxed); }
+
     static SignalQualityCalculator &get_instance() {
         static SignalQualityCalculator instance;
         return instance;
@@ -104,5 +109,8 @@ class SignalQualityCalculator {
 
     std::vector<FecEntry> m_fec_data;
 
-    std::string m_idr_code{"aaaa"};
+    // The code is derived from the number of requests, randomized per session so a restart never repeats the last one
+    std::string idr_code() const;
+    uint32_t m_idr_salt;
+    std::atomic<uint32_t> m_idr_requests{0};
 };
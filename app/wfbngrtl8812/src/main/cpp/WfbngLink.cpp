@@ -12,6 +12,7 @@
 #include "wfb-ng/src/wifibroadcast.hpp"
 
 #include <arpa/inet.h>
+#include <cerrno>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
@@ -22,10 +23,12 @@
 #include <map>
 #include <mutex>
 #include <netinet/in.h>
+#include <poll.h>
 #include <random>
 #include <span>
 #include <sstream>
 #include <string>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <thread>
 #include <unistd.h>
@@ -58,8 +61,34 @@ WfbngLink::WfbngLink(JNIEnv *env, jobject context)
     initAgg();
     Logger_t log;
     wifi_driver = std::make_unique<WiFiDriver>(log);
+    keyframe_request_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (keyframe_request_fd < 0) {
+        // the link quality thread sends the new idr code with its next tick then
+        __android_log_print(ANDROID_LOG_ERROR, TAG, "keyframe request eventfd failed: %s", strerror(errno));
+    }
+}
+
+WfbngLink::~WfbngLink() {
+    stop_adaptive_link();
+    if (keyframe_request_fd >= 0) {
+        close(keyframe_request_fd);
+        keyframe_request_fd = -1;
+    }
 }
 
+void WfbngLink::request_keyframe() {
+    SignalQualityCalculator::get_instance().request_idr();
+    if (keyframe_request_fd >= 0) {
+        uint64_t one = 1;
+        // EAGAIN: the counter is full, the link quality thread is woken anyway
+        if (write(keyframe_request_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            __android_log_print(ANDROID_LOG_ERROR, TAG, "keyframe request eventfd write failed: %s", strerror(errno));
+        }
+    }
+}
+
+void WfbngLink::request_keyframe_callback(void *link) { static_cast<WfbngLink *>(link)->request_keyframe(); }
+
 void WfbngLink::initAgg() {
     std::string client_addr = "127.0.0.1";
     uint64_t epoch = 0;
@@ -390,6 +419,11 @@ extern "C" JNIEXPORT void JNICALL Java_com_openipc_wfbngrtl8812_WfbNgLink_native
     native(wfbngLinkN)->should_clear_stats = true;
 }
 
+extern "C" JNIEXPORT jlong JNICALL
+Java_com_openipc_wfbngrtl8812_WfbNgLink_nativeGetKeyFrameRequestFunction(JNIEnv *env, jclass clazz) {
+    return reinterpret_cast<jlong>(&WfbngLink::request_keyframe_callback);
+}
+
 extern "C" JNIEXPORT void JNICALL Java_com_openipc_wfbngrtl8812_WfbNgLink_nativeRefreshKey(JNIEnv *env,
                                                                                            jclass clazz,
                                                                                            jlong wfbngLinkN) {
@@ -512,7 +546,24 @@ void WfbngLink::start_link_quality_thread(int fd) {
                     break;
                 }
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            // Wait for the next tick, a keyframe request cuts it short so the new idr code goes out right away
+            if (keyframe_request_fd < 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            struct pollfd pfd = {keyframe_request_fd, POLLIN, 0};
+            const int ready = poll(&pfd, 1, 100);
+            if (ready > 0) {
+                uint64_t n_requests;
+                // EAGAIN: nothing to read after all, the counter is only reset here
+                if (read(keyframe_request_fd, &n_requests, sizeof(n_requests)) < 0 && errno != EAGAIN) {
+                    __android_log_print(
+                        ANDROID_LOG_ERROR, TAG, "keyframe request eventfd read failed: %s", strerror(errno));
+                }
+            } else if (ready < 0 && errno != EINTR) {
+                __android_log_print(ANDROID_LOG_ERROR, TAG, "keyframe request poll failed: %s", strerror(errno));
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
         }
         close(sockfd);
         this->adaptive_link_should_stop = false;
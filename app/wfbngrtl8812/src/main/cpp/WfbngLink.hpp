@@ -30,6 +30,9 @@ class WfbngLink {
     int fec_recovered_to_1 = 8;
     WfbngLink(JNIEnv *env, jobject context);
 
+    // Stops the link quality thread and closes the keyframe request eventfd
+    ~WfbngLink();
+
     int run(JNIEnv *env, jobject androidContext, jint wifiChannel, jint bw, jint fd);
 
     void initAgg();
@@ -43,6 +46,12 @@ class WfbngLink {
 
     void start_link_quality_thread(int fd);
 
+    // Ask the drone for a keyframe now: rotates the idr code and wakes the link quality thread to send it. Lock free,
+    // for the video parser thread. Rate limiting is up to the caller.
+    void request_keyframe();
+    // request_keyframe() as a plain C function, for code in other libraries that only gets the link as a void*
+    static void request_keyframe_callback(void *link);
+
     // adaptive link
     // TODO: move this to private section
     int current_fd;
@@ -103,6 +112,8 @@ class WfbngLink {
     std::unique_ptr<std::thread> usb_event_thread{nullptr};
     std::unique_ptr<std::thread> usb_tx_thread{nullptr};
     uint32_t link_id{7669206};
+    // eventfd, signaled by request_keyframe()
+    int keyframe_request_fd{-1};
     SignalQualityCalculator rssi_calculator;
 };
 
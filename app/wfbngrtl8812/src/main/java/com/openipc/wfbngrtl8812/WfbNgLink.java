@@ -49,6 +49,7 @@ public class WfbNgLink implements WfbNGStatsChanged {
     public static native void nativeSetUseFec(long nativeInstance, int use);
     public static native void nativeSetUseLdpc(long nativeInstance, int use);
     public static native void nativeSetUseStbc(long nativeInstance, int use);
+    public static native long nativeGetKeyFrameRequestFunction();
 
     public WfbNgLink(final AppCompatActivity parent) {
         this.context = parent;
@@ -92,6 +93,16 @@ public class WfbNgLink implements WfbNGStatsChanged {
         nativeSetUseStbc(nativeWfbngLink, use);
     }
 
+    // Native void (*)(void*) that asks the drone for a keyframe, called with getKeyFrameRequestContext().
+    // Lets the video player request keyframes without a round trip through java.
+    public long getKeyFrameRequestFunction() {
+        return nativeGetKeyFrameRequestFunction();
+    }
+
+    public long getKeyFrameRequestContext() {
+        return nativeWfbngLink;
+    }
+
     public synchronized void start(int wifiChannel, int bandWidth, UsbDevice usbDevice) {
         Log.d(TAG, "wfb-ng monitoring on " + usbDevice.getDeviceName() + " using wifi channel " + wifiChannel);
         UsbManager usbManager = (UsbManager) context.getSystemService(Context.USB_SERVICE);